@@ -65,3 +65,32 @@ void Orc::TableOutput::ApacheOrc::MemoryPool::InitializeHeap()
     if (m_heap == NULL)
         throw Orc::Exception(Fatal, HRESULT_FROM_WIN32(GetLastError()), L"Failed to initialize heap");
 }
+
+Orc::TableOutput::ApacheOrc::BatchArena::BatchArena(size_t blockSize)
+    : m_blockSize(blockSize)
+{
+}
+
+char* Orc::TableOutput::ApacheOrc::BatchArena::Reserve(size_t size)
+{
+    if (m_current < m_blocks.size() && m_blocks[m_current].Size - m_used >= size)
+        return m_blocks[m_current].Data.get() + m_used;
+
+    // the next block is reused when large enough, a new one is inserted before it otherwise
+    const size_t next = m_blocks.empty() ? 0 : m_current + 1;
+
+    if (next >= m_blocks.size() || m_blocks[next].Size < size)
+    {
+        Block block;
+        block.Size = std::max(m_blockSize, size);
+        block.Data.reset(new (std::nothrow) char[block.Size]);
+        if (block.Data == nullptr)
+            return nullptr;
+
+        m_blocks.insert(m_blocks.begin() + next, std::move(block));
+    }
+
+    m_current = next;
+    m_used = 0;
+    return m_blocks[m_current].Data.get();
+}
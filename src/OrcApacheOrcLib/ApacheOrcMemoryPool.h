@@ -13,6 +13,9 @@
 
 #include "OrcException.h"
 
+#include <memory>
+#include <vector>
+
 namespace Orc::TableOutput::ApacheOrc {
 
 class MemoryPool : public orc::MemoryPool
@@ -40,4 +43,42 @@ private:
     size_t m_initialSize = 0;
 };
 
+// Bump allocator for the strings of a row batch: they are only needed until the batch is added to the orc writer
+// Reset releases them all at once and keeps the blocks for the next batch, a steady flow of batches does not allocate.
+class BatchArena
+{
+public:
+    BatchArena(size_t blockSize = 1024 * 1024);
+
+    // Returns room for at least size bytes (nullptr when out of memory), only the committed bytes are kept
+    char* Reserve(size_t size);
+    void Commit(size_t size) { m_used += size; }
+
+    char* Allocate(size_t size)
+    {
+        auto retval = Reserve(size);
+        if (retval != nullptr)
+            Commit(size);
+        return retval;
+    }
+
+    void Reset()
+    {
+        m_current = 0;
+        m_used = 0;
+    }
+
+private:
+    struct Block
+    {
+        std::unique_ptr<char[]> Data;
+        size_t Size = 0;
+    };
+
+    size_t m_blockSize;
+    std::vector<Block> m_blocks;
+    size_t m_current = 0;  // index of the block being filled
+    size_t m_used = 0;  // bytes committed in the current block
+};
+
 }  // namespace Orc::TableOutput::OptRowColumn
@@ -32,6 +32,12 @@ void Orc::TableOutput::ApacheOrc::Stream::write(const void* buf, size_t length)
         if (auto hr = m_Stream->Write((PVOID)buf, length, &ullBytesWritten); FAILED(hr))
         {
             log::Error(_L_, hr, L"Failed to write into orc file");
+            if (SUCCEEDED(m_hrWrite))
+                m_hrWrite = hr;
+        }
+        else if (ullBytesWritten < length && SUCCEEDED(m_hrWrite))
+        {
+            m_hrWrite = HRESULT_FROM_WIN32(ERROR_WRITE_FAULT);
         }
     }
 }
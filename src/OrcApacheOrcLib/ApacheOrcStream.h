@@ -45,12 +45,16 @@ public:
 
     virtual void close() override final;
 
+    // orc cannot be told a write failed: the first failure is kept for the writer to report it
+    HRESULT GetWriteError() const { return m_hrWrite; }
+
     ~Stream() {}
 
 private:
     std::shared_ptr<ByteStream> m_Stream;
     std::string m_Name;
     logger _L_;
+    HRESULT m_hrWrite = S_OK;
 };
 
 }  // namespace Orc::TableOutput::OptRowColumn
@@ -33,6 +33,30 @@ using namespace msl::utilities;
 
 namespace fs = std::filesystem;
 
+namespace {
+
+// orc's default is 0.0 (no dictionary), a column falls back to direct encoding when its values are mostly distinct
+constexpr double DICTIONARY_KEY_SIZE_THRESHOLD = 0.8;
+
+orc::CompressionKind GetOrcCompression(Orc::TableOutput::ColumnCompression compression)
+{
+    switch (compression)
+    {
+        case Orc::TableOutput::ColumnCompression::None:
+            return orc::CompressionKind::CompressionKind_NONE;
+        case Orc::TableOutput::ColumnCompression::Snappy:
+            return orc::CompressionKind::CompressionKind_SNAPPY;
+        case Orc::TableOutput::ColumnCompression::LZ4:
+            return orc::CompressionKind::CompressionKind_LZ4;
+        case Orc::TableOutput::ColumnCompression::ZStd:
+            return orc::CompressionKind::CompressionKind_ZSTD;
+        default:
+            return orc::CompressionKind::CompressionKind_ZLIB;
+    }
+}
+
+}  // namespace
+
 class Orc::TableOutput::ApacheOrc::WriterTermination : public TerminationHandler
 {
 public:
@@ -83,6 +107,12 @@ Orc::TableOutput::ApacheOrc::Writer::Writer(logger pLog, std::unique_ptr<Options
     {
         m_dwBatchSize = m_Options->BatchSize.value();
     }
+
+    if (m_Options && m_Options->InFlightBatches.value_or(0L) > 0)
+    {
+        m_pBackgroundFlush = std::make_unique<BackgroundFlush>(_L_, m_Options->InFlightBatches.value());
+        m_pSpareBatches = std::make_shared<Concurrency::concurrent_queue<std::shared_ptr<RowBatch>>>();
+    }
 }
 
 Orc::TableOutput::ApacheOrc::Writer::~Writer() {}
@@ -275,6 +305,13 @@ Orc::TableOutput::ApacheOrc::Writer::WriteToStream(const std::shared_ptr<ByteStr
 {
     HRESULT hr = E_FAIL;
 
+    if (m_pBackgroundFlush)
+    {
+        // pending batches are added to the current m_Writer
+        if (FAILED(hr = m_pBackgroundFlush->Wait()))
+            return hr;
+    }
+
     if (m_pByteStream && m_bCloseStream)
     {
         m_pByteStream->Close();
@@ -292,34 +329,145 @@ Orc::TableOutput::ApacheOrc::Writer::WriteToStream(const std::shared_ptr<ByteStr
     options.setFileVersion(orc::FileVersion(0, 11));
     options.setCompression(orc::CompressionKind::CompressionKind_ZLIB);
 
+    if (m_Options && m_Options->RowGroupSize.has_value())
+        options.setStripeSize(m_Options->RowGroupSize.value());
+
+    // orc applies the encoding and the compression to the whole file: the column hints are merged
+    // the dictionary threshold applies to every string column, it is only set when most of them hint a dictionary
+    std::optional<ColumnCompression> compression;
+    bool bMixedCompressions = false;
+    DWORD dwDictionaryColumns = 0L;
+    DWORD dwOtherStringColumns = 0L;
+    for (const auto& column : m_Schema)
+    {
+        switch (column->Type)
+        {
+            case UTF16Type:
+            case UTF8Type:
+            case GUIDType:
+            case XMLType:
+                if (column->Encoding == ColumnEncoding::Dictionary)
+                    dwDictionaryColumns++;
+                else
+                    dwOtherStringColumns++;
+                break;
+            default:
+                break;
+        }
+
+        if (column->Compression == ColumnCompression::Default)
+            continue;
+        if (compression.has_value() && compression.value() != column->Compression)
+            bMixedCompressions = true;
+        compression = column->Compression;
+    }
+    if (bMixedCompressions)
+        log::Verbose(_L_, L"Orc columns hint different compressions, the file is compressed with zlib\r\n");
+    else if (compression.has_value())
+        options.setCompression(GetOrcCompression(compression.value()));
+
+    if (dwDictionaryColumns > dwOtherStringColumns)
+        options.setDictionaryKeySizeThreshold(DICTIONARY_KEY_SIZE_THRESHOLD);
+    else if (dwDictionaryColumns > 0)
+        log::Verbose(_L_, L"Orc string columns mostly hint no dictionary, the dictionary hints are ignored\r\n");
+
     m_Writer = orc::createWriter(*m_OrcSchema, m_OrcStream.get(), options);
 
-    m_Batch = m_Writer->createRowBatch(m_dwBatchSize);
+    if (m_pSpareBatches)
+        m_pSpareBatches->clear();
 
-    m_BatchPool = std::make_unique<MemoryPool>(1024 * 1024 * 20);
+    m_Batch = std::make_shared<RowBatch>(*m_Writer, m_dwBatchSize);
+    m_dwBatchRow = 0;
 
     return S_OK;
 }
 
-STDMETHODIMP Orc::TableOutput::ApacheOrc::Writer::Flush()
+Orc::TableOutput::ApacheOrc::Writer::RowBatch::RowBatch(orc::Writer& writer, DWORD dwBatchSize)
+    : Root(writer.createRowBatch(dwBatchSize))
 {
-    auto root = dynamic_cast<orc::StructVectorBatch*>(m_Batch.get());
+    auto root = dynamic_cast<orc::StructVectorBatch*>(Root.get());
+    if (root == nullptr)
+        return;
 
-    if (root)
+    Columns.reserve(root->fields.size());
+    for (auto field : root->fields)
     {
-        ScopedLock sl(m_cs);
-
-        root->numElements = m_dwBatchRow;
+        ColumnVectors vectors;
+        vectors.Any = field;
+        vectors.Longs = dynamic_cast<orc::LongVectorBatch*>(field);
+        vectors.Strings = dynamic_cast<orc::StringVectorBatch*>(field);
+        vectors.TimeStamps = dynamic_cast<orc::TimestampVectorBatch*>(field);
+        Columns.push_back(vectors);
+    }
+}
 
-        for (DWORD i = 0; i < m_dwColumnNumber; i++)
+void Orc::TableOutput::ApacheOrc::Writer::RowBatch::Reset()
+{
+    for (auto& column : Columns)
+    {
+        if (column.Any->hasNulls)
         {
-            root->fields[m_dwColumnCounter]->numElements = m_dwBatchRow;
+            std::memset(column.Any->notNull.data(), 1, column.Any->capacity);
+            column.Any->hasNulls = false;
         }
+        column.Any->numElements = 0;
+    }
+    Root->numElements = 0;
+    Strings.Reset();
+}
+
+STDMETHODIMP Orc::TableOutput::ApacheOrc::Writer::Flush()
+{
+    ScopedLock sl(m_cs);
+
+    HRESULT hr = FlushBatch();
+
+    if (m_pBackgroundFlush)
+    {
+        if (auto hrWait = m_pBackgroundFlush->Wait(); SUCCEEDED(hr))
+            hr = hrWait;
+    }
+    return hr;
+}
+
+HRESULT Orc::TableOutput::ApacheOrc::Writer::FlushBatch()
+{
+    ScopedLock sl(m_cs);
+
+    if (m_Batch == nullptr)
+        return S_OK;
+
+    m_Batch->Root->numElements = m_dwBatchRow;
+    for (auto& column : m_Batch->Columns)
+    {
+        column.Any->numElements = m_dwBatchRow;
     }
-    m_Writer->add(*m_Batch);
-    m_BatchPool = std::make_unique<MemoryPool>(20 * 1024 * 1024);
     m_dwBatchRow = 0;
-    return S_OK;
+
+    if (m_pBackgroundFlush)
+    {
+        // the batch comes back as a spare one once added, the producer continues with another batch
+        auto write = [pWriter = m_Writer.get(),
+                      pStream = m_OrcStream.get(),
+                      pBatch = m_Batch,
+                      pSpareBatches = m_pSpareBatches]() {
+            pWriter->add(*pBatch->Root);
+            pBatch->Reset();
+            pSpareBatches->push(pBatch);
+            return pStream->GetWriteError();
+        };
+        m_Batch.reset();
+
+        HRESULT hr = m_pBackgroundFlush->Post(std::move(write));
+
+        if (!m_pSpareBatches->try_pop(m_Batch))
+            m_Batch = std::make_shared<RowBatch>(*m_Writer, m_dwBatchSize);
+        return hr;
+    }
+
+    m_Writer->add(*m_Batch->Root);
+    m_Batch->Reset();
+    return m_OrcStream->GetWriteError();
 }
 
 STDMETHODIMP Orc::TableOutput::ApacheOrc::Writer::Close()
@@ -339,18 +487,21 @@ STDMETHODIMP Orc::TableOutput::ApacheOrc::Writer::Close()
         Robustness::RemoveTerminationHandler(m_pTermination);
         m_pTermination = nullptr;
     }
+
+    if (auto hr = m_OrcStream->GetWriteError(); FAILED(hr))
+    {
+        log::Error(_L_, hr, L"Failed to write orc file\r\n");
+        return hr;
+    }
     return S_OK;
 }
 
 STDMETHODIMP Orc::TableOutput::ApacheOrc::Writer::WriteNothing()
 {
-    auto root = dynamic_cast<orc::StructVectorBatch*>(m_Batch.get());
-    if (root)
+    if (auto vectors = GetCurrentVectors(); vectors != nullptr)
     {
-        auto col = dynamic_cast<orc::ColumnVectorBatch*>(root->fields[m_dwColumnCounter]);
-
-        col->notNull[m_dwBatchRow] = false;
-        col->hasNulls = true;
+        vectors->Any->notNull[m_dwBatchRow] = false;
+        vectors->Any->hasNulls = true;
     }
     AddColumnAndCheckNumbers();
     return S_OK;
@@ -358,16 +509,15 @@ STDMETHODIMP Orc::TableOutput::ApacheOrc::Writer::WriteNothing()
 
 STDMETHODIMP Orc::TableOutput::ApacheOrc::Writer::AbandonRow()
 {
-    auto root = dynamic_cast<orc::StructVectorBatch*>(m_Batch.get());
-    for (auto i = m_dwColumnCounter; i < m_dwColumnNumber; i++)
+    if (m_Batch == nullptr)
+        return S_OK;
+
+    for (auto i = m_dwColumnCounter; i < m_Batch->Columns.size(); i++)
     {
-        auto col = dynamic_cast<orc::ColumnVectorBatch*>(root->fields[i]);
+        auto col = m_Batch->Columns[i].Any;
 
-        if (col)
-        {
-            col->notNull[m_dwBatchRow] = false;
-            col->hasNulls = true;
-        }
+        col->notNull[m_dwBatchRow] = false;
+        col->hasNulls = true;
     }
     return S_OK;
 }
@@ -380,6 +530,90 @@ STDMETHODIMP Orc::TableOutput::ApacheOrc::Writer::AbandonColumn()
     return E_FAIL;
 }
 
+HRESULT Orc::TableOutput::ApacheOrc::Writer::WriteLong(int64_t value)
+{
+    auto vectors = GetCurrentVectors();
+    if (vectors == nullptr || vectors->Longs == nullptr)
+        return AbandonColumn();
+
+    vectors->Longs->data[m_dwBatchRow] = value;
+    AddColumnAndCheckNumbers();
+    return S_OK;
+}
+
+HRESULT Orc::TableOutput::ApacheOrc::Writer::WriteUnixTime(int64_t seconds)
+{
+    auto vectors = GetCurrentVectors();
+    if (vectors == nullptr || vectors->TimeStamps == nullptr)
+        return AbandonColumn();
+
+    vectors->TimeStamps->data[m_dwBatchRow] = seconds;
+    vectors->TimeStamps->nanoseconds[m_dwBatchRow] = 0;
+    AddColumnAndCheckNumbers();
+    return S_OK;
+}
+
+HRESULT Orc::TableOutput::ApacheOrc::Writer::WriteUTF8(const CHAR* szString, size_t cchCount)
+{
+    auto vectors = GetCurrentVectors();
+    if (vectors == nullptr || vectors->Strings == nullptr)
+        return AbandonColumn();
+
+    auto data = m_Batch->Strings.Allocate(cchCount);
+    if (data == nullptr)
+    {
+        AbandonColumn();
+        return E_OUTOFMEMORY;
+    }
+    memcpy(data, szString, cchCount);
+
+    vectors->Strings->data[m_dwBatchRow] = data;
+    vectors->Strings->length[m_dwBatchRow] = cchCount;
+    AddColumnAndCheckNumbers();
+    return S_OK;
+}
+
+HRESULT Orc::TableOutput::ApacheOrc::Writer::WriteUTF16(const WCHAR* szString, size_t cchCount)
+{
+    auto vectors = GetCurrentVectors();
+    if (vectors == nullptr || vectors->Strings == nullptr)
+        return AbandonColumn();
+
+    // transcoded straight into the batch's arena: a UTF-16 code unit is at most 3 UTF-8 bytes
+    size_t cbMax = 0;
+    if (!msl::utilities::SafeMultiply(cchCount, 3, cbMax) || cbMax > INT_MAX)
+    {
+        AbandonColumn();
+        return E_INVALIDARG;
+    }
+
+    auto data = m_Batch->Strings.Reserve(cbMax);
+    if (data == nullptr)
+    {
+        AbandonColumn();
+        return E_OUTOFMEMORY;
+    }
+
+    int cbData = 0;
+    if (cchCount > 0)
+    {
+        cbData = WideCharToMultiByte(
+            CP_UTF8, 0, szString, static_cast<int>(cchCount), data, static_cast<int>(cbMax), NULL, NULL);
+        if (cbData == 0)
+        {
+            auto hr = HRESULT_FROM_WIN32(GetLastError());
+            AbandonColumn();
+            return hr;
+        }
+    }
+    m_Batch->Strings.Commit(cbData);
+
+    vectors->Strings->data[m_dwBatchRow] = data;
+    vectors->Strings->length[m_dwBatchRow] = cbData;
+    AddColumnAndCheckNumbers();
+    return S_OK;
+}
+
 HRESULT Orc::TableOutput::ApacheOrc::Writer::AddColumnAndCheckNumbers()
 {
     m_dwColumnCounter++;
@@ -428,153 +662,29 @@ HRESULT Orc::TableOutput::ApacheOrc::Writer::WriteEndOfLine()
 
     if (m_dwBatchRow >= m_dwBatchSize)
     {
-        return Flush();
+        return FlushBatch();
     }
     return S_OK;
 }
 
 STDMETHODIMP Orc::TableOutput::ApacheOrc::Writer::WriteString(const std::wstring& strString)
 {
-    auto root = dynamic_cast<orc::StructVectorBatch*>(m_Batch.get());
-    if (root)
-    {
-        auto col = dynamic_cast<orc::StringVectorBatch*>(root->fields[m_dwColumnCounter]);
-        auto data = (char*)m_BatchPool->malloc(strString.size());
-        if (data == nullptr)
-        {
-            AbandonColumn();
-            return E_OUTOFMEMORY;
-        }
-
-        Buffer<CHAR, MAX_PATH> ansiString;
-
-        if (auto hr = WideToAnsi(_L_, strString, ansiString); FAILED(hr))
-        {
-            AbandonColumn();
-            return hr;
-        }
-        auto pStr = m_BatchPool->malloc(ansiString.size());
-        if (pStr == nullptr)
-        {
-            AbandonColumn();
-            return E_OUTOFMEMORY;
-        }
-
-        memcpy_s(pStr, ansiString.size(), ansiString.get(), ansiString.size());
-
-        col->data[m_dwBatchRow] = pStr;
-        col->length[m_dwBatchRow] = strString.size();
-    }
-    AddColumnAndCheckNumbers();
-    return S_OK;
+    return WriteUTF16(strString.data(), strString.size());
 }
 
 STDMETHODIMP Orc::TableOutput::ApacheOrc::Writer::WriteString(const std::wstring_view& strString)
 {
-    auto root = dynamic_cast<orc::StructVectorBatch*>(m_Batch.get());
-    if (root)
-    {
-        auto col = dynamic_cast<orc::StringVectorBatch*>(root->fields[m_dwColumnCounter]);
-        auto data = (char*)m_BatchPool->malloc(strString.size());
-        if (data == nullptr)
-        {
-            AbandonColumn();
-            return E_OUTOFMEMORY;
-        }
-        Buffer<CHAR, MAX_PATH> ansiString;
-
-        if (auto hr = WideToAnsi(_L_, strString, ansiString); FAILED(hr))
-        {
-            AbandonColumn();
-            return hr;
-        }
-        auto pStr = m_BatchPool->malloc(ansiString.size());
-        if (pStr == nullptr)
-        {
-            AbandonColumn();
-            return E_OUTOFMEMORY;
-        }
-
-        memcpy_s(pStr, ansiString.size(), ansiString.get(), ansiString.size());
-
-        col->data[m_dwBatchRow] = pStr;
-        col->length[m_dwBatchRow] = strString.size();
-    }
-    AddColumnAndCheckNumbers();
-    return S_OK;
+    return WriteUTF16(strString.data(), strString.size());
 }
 
 STDMETHODIMP Orc::TableOutput::ApacheOrc::Writer::WriteString(const WCHAR* szString)
 {
-    auto root = dynamic_cast<orc::StructVectorBatch*>(m_Batch.get());
-    if (root)
-    {
-        auto strSize = wcslen(szString);
-
-        auto col = dynamic_cast<orc::StringVectorBatch*>(root->fields[m_dwColumnCounter]);
-        auto data = (char*)m_BatchPool->malloc(strSize);
-        if (data == nullptr)
-        {
-            AbandonColumn();
-            return E_OUTOFMEMORY;
-        }
-        Buffer<CHAR, MAX_PATH> ansiString;
-
-        if (auto hr = WideToAnsi(_L_, szString, static_cast<DWORD>(strSize), ansiString); FAILED(hr))
-        {
-            AbandonColumn();
-            return hr;
-        }
-
-        auto pStr = m_BatchPool->malloc(ansiString.size());
-        if (pStr == nullptr)
-        {
-            AbandonColumn();
-            return E_OUTOFMEMORY;
-        }
-        memcpy_s(pStr, ansiString.size(), ansiString.get(), ansiString.size());
-
-        col->data[m_dwBatchRow] = pStr;
-        col->length[m_dwBatchRow] = strSize;
-    }
-    AddColumnAndCheckNumbers();
-    return S_OK;
+    return WriteUTF16(szString, wcslen(szString));
 }
 
 STDMETHODIMP Orc::TableOutput::ApacheOrc::Writer::WriteCharArray(const WCHAR* szString, DWORD dwCharCount)
 {
-    auto root = dynamic_cast<orc::StructVectorBatch*>(m_Batch.get());
-    if (root)
-    {
-        auto col = dynamic_cast<orc::StringVectorBatch*>(root->fields[m_dwColumnCounter]);
-        auto data = (char*)m_BatchPool->malloc(dwCharCount);
-        if (data == nullptr)
-        {
-            AbandonColumn();
-            return E_OUTOFMEMORY;
-        }
-        Buffer<CHAR, MAX_PATH> ansiString;
-
-        if (auto hr = WideToAnsi(_L_, szString, dwCharCount, ansiString); FAILED(hr))
-        {
-            AbandonColumn();
-            return hr;
-        }
-
-        auto pStr = m_BatchPool->malloc(ansiString.size());
-        if (pStr == nullptr)
-        {
-            AbandonColumn();
-            return E_OUTOFMEMORY;
-        }
-
-        memcpy_s(pStr, ansiString.size(), ansiString.get(), ansiString.size());
-
-        col->data[m_dwBatchRow] = pStr;
-        col->length[m_dwBatchRow] = dwCharCount;
-    }
-    AddColumnAndCheckNumbers();
-    return S_OK;
+    return WriteUTF16(szString, dwCharCount);
 }
 
 STDMETHODIMP
@@ -592,91 +702,22 @@ Orc::TableOutput::ApacheOrc::Writer::WriteFormated_(const std::wstring_view& szF
 
 STDMETHODIMP Orc::TableOutput::ApacheOrc::Writer::WriteString(const std::string& strString)
 {
-    auto root = dynamic_cast<orc::StructVectorBatch*>(m_Batch.get());
-    if (root)
-    {
-        auto col = dynamic_cast<orc::StringVectorBatch*>(root->fields[m_dwColumnCounter]);
-        auto data = (char*)m_BatchPool->malloc(strString.size());
-        if (data == nullptr)
-        {
-            AbandonColumn();
-            return E_OUTOFMEMORY;
-        }
-        memcpy(data, strString.data(), strString.size());
-
-        col->data[m_dwBatchRow] = data;
-        col->length[m_dwBatchRow] = strString.size();
-    }
-    AddColumnAndCheckNumbers();
-    return S_OK;
+    return WriteUTF8(strString.data(), strString.size());
 }
 
 STDMETHODIMP Orc::TableOutput::ApacheOrc::Writer::WriteString(const std::string_view& strString)
 {
-    auto root = dynamic_cast<orc::StructVectorBatch*>(m_Batch.get());
-    if (root)
-    {
-        auto col = dynamic_cast<orc::StringVectorBatch*>(root->fields[m_dwColumnCounter]);
-        auto data = (char*)m_BatchPool->malloc(strString.size());
-        if (data == nullptr)
-        {
-            AbandonColumn();
-            return E_OUTOFMEMORY;
-        }
-
-        memcpy(data, strString.data(), strString.size());
-
-        col->data[m_dwBatchRow] = data;
-        col->length[m_dwBatchRow] = strString.size();
-    }
-    AddColumnAndCheckNumbers();
-    return S_OK;
+    return WriteUTF8(strString.data(), strString.size());
 }
 
 STDMETHODIMP Orc::TableOutput::ApacheOrc::Writer::WriteString(const CHAR* szString)
 {
-    auto root = dynamic_cast<orc::StructVectorBatch*>(m_Batch.get());
-    if (root)
-    {
-        auto col = dynamic_cast<orc::StringVectorBatch*>(root->fields[m_dwColumnCounter]);
-
-        auto strSize = strlen(szString);
-
-        auto data = (char*)m_BatchPool->malloc(strSize);
-        if (data == nullptr)
-        {
-            AbandonColumn();
-            return E_OUTOFMEMORY;
-        }
-        memcpy(data, szString, strSize);
-
-        col->data[m_dwBatchRow] = data;
-        col->length[m_dwBatchRow] = strSize;
-    }
-    AddColumnAndCheckNumbers();
-    return S_OK;
+    return WriteUTF8(szString, strlen(szString));
 }
 
 STDMETHODIMP Orc::TableOutput::ApacheOrc::Writer::WriteCharArray(const CHAR* szString, DWORD dwCharCount)
 {
-    auto root = dynamic_cast<orc::StructVectorBatch*>(m_Batch.get());
-    if (root)
-    {
-        auto col = dynamic_cast<orc::StringVectorBatch*>(root->fields[m_dwColumnCounter]);
-        auto data = (char*)m_BatchPool->malloc(dwCharCount);
-        if (data == nullptr)
-        {
-            AbandonColumn();
-            return E_OUTOFMEMORY;
-        }
-
-        memcpy(data, szString, dwCharCount);
-
-        col->data[m_dwBatchRow] = data;
-        col->length[m_dwBatchRow] = dwCharCount;
-    }
-    AddColumnAndCheckNumbers();
-    return S_OK;
+    return WriteUTF8(szString, dwCharCount);
 }
 
 STDMETHODIMP
@@ -719,104 +760,40 @@ STDMETHODIMP Orc::TableOutput::ApacheOrc::Writer::WriteAttributes(DWORD dwFileAt
 
 HRESULT Orc::TableOutput::ApacheOrc::Writer::WriteFileTime(FILETIME fileTime)
 {
-    auto root = dynamic_cast<orc::StructVectorBatch*>(m_Batch.get());
-    if (root)
-    {
-        auto col = dynamic_cast<orc::TimestampVectorBatch*>(root->fields[m_dwColumnCounter]);
-
-        auto time_point = Orc::ConvertTo(fileTime);
+    auto time_point = Orc::ConvertTo(fileTime);
 
-        col->data[m_dwBatchRow] = std::chrono::system_clock::to_time_t(time_point);
-        col->nanoseconds[m_dwBatchRow] = 0;
-
-        AddColumnAndCheckNumbers();
-        return S_OK;
-    }
-    else
-        return AbandonColumn();
+    return WriteUnixTime(std::chrono::system_clock::to_time_t(time_point));
 }
 
 STDMETHODIMP Orc::TableOutput::ApacheOrc::Writer::WriteFileTime(LONGLONG fileTime)
 {
-    auto root = dynamic_cast<orc::StructVectorBatch*>(m_Batch.get());
-    if (root)
-    {
-        auto col = dynamic_cast<orc::TimestampVectorBatch*>(root->fields[m_dwColumnCounter]);
-
-        ULARGE_INTEGER uli;
-        uli.QuadPart = fileTime;
-        FILETIME ft;
-        ft.dwHighDateTime = uli.HighPart;
-        ft.dwLowDateTime = uli.LowPart;
+    ULARGE_INTEGER uli;
+    uli.QuadPart = fileTime;
+    FILETIME ft;
+    ft.dwHighDateTime = uli.HighPart;
+    ft.dwLowDateTime = uli.LowPart;
 
-        auto time_point = Orc::ConvertTo(ft);
-
-        col->data[m_dwBatchRow] = std::chrono::system_clock::to_time_t(time_point);
-        col->nanoseconds[m_dwBatchRow] = 0;
-
-        AddColumnAndCheckNumbers();
-        return S_OK;
-    }
-    else
-        return AbandonColumn();
+    return WriteFileTime(ft);
 }
 
 STDMETHODIMP Orc::TableOutput::ApacheOrc::Writer::WriteTimeStamp(time_t tmStamp)
 {
-    auto root = dynamic_cast<orc::StructVectorBatch*>(m_Batch.get());
-    if (root)
-    {
-        auto col = dynamic_cast<orc::TimestampVectorBatch*>(root->fields[m_dwColumnCounter]);
-
-        AddColumnAndCheckNumbers();
-        return S_OK;
-    }
-    else
-        return AbandonColumn();
+    return WriteUnixTime(tmStamp);
 }
 
 STDMETHODIMP Orc::TableOutput::ApacheOrc::Writer::WriteTimeStamp(tm tmStamp)
 {
-    auto root = dynamic_cast<orc::StructVectorBatch*>(m_Batch.get());
-    if (root)
-    {
-        auto col = dynamic_cast<orc::TimestampVectorBatch*>(root->fields[m_dwColumnCounter]);
-
-        AddColumnAndCheckNumbers();
-        return S_OK;
-    }
-    else
-        return AbandonColumn();
+    return WriteUnixTime(_mkgmtime(&tmStamp));
 }
 
 STDMETHODIMP Orc::TableOutput::ApacheOrc::Writer::WriteFileSize(LARGE_INTEGER fileSize)
 {
-    auto root = dynamic_cast<orc::StructVectorBatch*>(m_Batch.get());
-    if (root)
-    {
-        auto col = dynamic_cast<orc::LongVectorBatch*>(root->fields[m_dwColumnCounter]);
-
-        col->data[m_dwBatchRow] = fileSize.QuadPart;
-        AddColumnAndCheckNumbers();
-        return S_OK;
-    }
-    else
-        return AbandonColumn();
+    return WriteLong(fileSize.QuadPart);
 }
 
 STDMETHODIMP Orc::TableOutput::ApacheOrc::Writer::WriteFileSize(ULONGLONG fileSize)
 {
-    auto root = dynamic_cast<orc::StructVectorBatch*>(m_Batch.get());
-    if (root)
-    {
-        auto col = dynamic_cast<orc::LongVectorBatch*>(root->fields[m_dwColumnCounter]);
-
-        col->data[m_dwBatchRow] = fileSize;
-        AddColumnAndCheckNumbers();
-        return S_OK;
-    }
-    else
-        return AbandonColumn();
+    return WriteLong(static_cast<int64_t>(fileSize));
 }
 
 STDMETHODIMP Orc::TableOutput::ApacheOrc::Writer::WriteFileSize(DWORD nFileSizeHigh, DWORD nFileSizeLow)
@@ -832,61 +809,22 @@ STDMETHODIMP Orc::TableOutput::ApacheOrc::Writer::WriteFileSize(DWORD nFileSizeH
 
 STDMETHODIMP Orc::TableOutput::ApacheOrc::Writer::WriteBool(bool bBoolean)
 {
-    auto root = dynamic_cast<orc::StructVectorBatch*>(m_Batch.get());
-    if (root)
-    {
-        auto col = dynamic_cast<orc::LongVectorBatch*>(root->fields[m_dwColumnCounter]);
-
-        col->data[m_dwBatchRow] = bBoolean;
-        AddColumnAndCheckNumbers();
-        return S_OK;
-    }
-    else
-        return AbandonColumn();
+    return WriteLong(bBoolean);
 }
 
 STDMETHODIMP Orc::TableOutput::ApacheOrc::Writer::WriteEnum(DWORD dwEnum)
 {
-    auto root = dynamic_cast<orc::StructVectorBatch*>(m_Batch.get());
-    if (root)
-    {
-        auto col = dynamic_cast<orc::LongVectorBatch*>(root->fields[m_dwColumnCounter]);
-
-        col->data[m_dwBatchRow] = dwEnum;
-        AddColumnAndCheckNumbers();
-        return S_OK;
-    }
-    else
-        return AbandonColumn();
+    return WriteLong(dwEnum);
 }
+
 STDMETHODIMP Orc::TableOutput::ApacheOrc::Writer::WriteEnum(DWORD dwEnum, const WCHAR* EnumValues[])
 {
-    auto root = dynamic_cast<orc::StructVectorBatch*>(m_Batch.get());
-    if (root)
-    {
-        auto col = dynamic_cast<orc::LongVectorBatch*>(root->fields[m_dwColumnCounter]);
-
-        col->data[m_dwBatchRow] = dwEnum;
-        AddColumnAndCheckNumbers();
-    }
-    else
-        return AbandonColumn();
-    return S_OK;
+    return WriteLong(dwEnum);
 }
 
 STDMETHODIMP Orc::TableOutput::ApacheOrc::Writer::WriteFlags(DWORD dwFlags)
 {
-    auto root = dynamic_cast<orc::StructVectorBatch*>(m_Batch.get());
-    if (root)
-    {
-        auto col = dynamic_cast<orc::LongVectorBatch*>(root->fields[m_dwColumnCounter]);
-
-        col->data[m_dwBatchRow] = dwFlags;
-        AddColumnAndCheckNumbers();
-    }
-    else
-        return AbandonColumn();
-    return S_OK;
+    return WriteLong(dwFlags);
 }
 
 STDMETHODIMP
@@ -907,25 +845,7 @@ STDMETHODIMP Orc::TableOutput::ApacheOrc::Writer::WriteExactFlags(DWORD dwFlags,
 
 STDMETHODIMP Orc::TableOutput::ApacheOrc::Writer::WriteGUID(const GUID& guid)
 {
-    auto root = dynamic_cast<orc::StructVectorBatch*>(m_Batch.get());
-    if (root)
-    {
-        auto col = dynamic_cast<orc::StringVectorBatch*>(root->fields[m_dwColumnCounter]);
-
-        auto guidSize = sizeof(GUID);
-
-        auto data = (char*)m_BatchPool->malloc(guidSize);
-        if (data == nullptr)
-            return E_OUTOFMEMORY;
-
-        memcpy_s(data, 16, &guid, sizeof(GUID));
-        col->data[m_dwBatchRow] = data;
-        col->length[m_dwBatchRow] = guidSize;
-        AddColumnAndCheckNumbers();
-    }
-    else
-        return AbandonColumn();
-    return S_OK;
+    return WriteUTF8(reinterpret_cast<const CHAR*>(&guid), sizeof(GUID));
 }
 
 STDMETHODIMP Orc::TableOutput::ApacheOrc::Writer::WriteXML(const WCHAR* szString)
@@ -950,60 +870,21 @@ STDMETHODIMP Orc::TableOutput::ApacheOrc::Writer::WriteXML(const CHAR* szString,
 
 STDMETHODIMP Orc::TableOutput::ApacheOrc::Writer::WriteInteger(DWORD dwInteger)
 {
-    auto root = dynamic_cast<orc::StructVectorBatch*>(m_Batch.get());
-    if (root)
-    {
-        auto col = dynamic_cast<orc::LongVectorBatch*>(root->fields[m_dwColumnCounter]);
-
-        if (!SafeCast(dwInteger, col->data[m_dwBatchRow]))
-        {
-            AbandonRow();
-            return E_FAIL;
-        }
-        AddColumnAndCheckNumbers();
-    }
-    else
-        return AbandonColumn();
-    return S_OK;
+    return WriteLong(dwInteger);
 }
 
 STDMETHODIMP Orc::TableOutput::ApacheOrc::Writer::WriteInteger(LONGLONG llInteger)
 {
-    auto root = dynamic_cast<orc::StructVectorBatch*>(m_Batch.get());
-    if (root)
-    {
-        auto col = dynamic_cast<orc::LongVectorBatch*>(root->fields[m_dwColumnCounter]);
-
-        if (!SafeCast(llInteger, col->data[m_dwBatchRow]))
-        {
-            AbandonColumn();
-            return E_FAIL;
-        }
-        AddColumnAndCheckNumbers();
-    }
-    else
-        return AbandonColumn();
-    return S_OK;
+    return WriteLong(llInteger);
 }
 
 STDMETHODIMP Orc::TableOutput::ApacheOrc::Writer::WriteInteger(ULONGLONG ullInteger)
 {
-    auto root = dynamic_cast<orc::StructVectorBatch*>(m_Batch.get());
-    if (root)
-    {
-        auto col = dynamic_cast<orc::LongVectorBatch*>(root->fields[m_dwColumnCounter]);
-
-        if (!SafeCast(ullInteger, col->data[m_dwBatchRow]))
-        {
-            AbandonColumn();
-            return E_FAIL;
-        }
-        AddColumnAndCheckNumbers();
-    }
-    else
+    int64_t value = 0;
+    if (!msl::utilities::SafeCast(ullInteger, value))
         return AbandonColumn();
 
-    return S_OK;
+    return WriteLong(value);
 }
 
 STDMETHODIMP Orc::TableOutput::ApacheOrc::Writer::WriteBytes(const BYTE pBytes[], DWORD dwLen)
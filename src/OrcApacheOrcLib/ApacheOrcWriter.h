@@ -8,6 +8,7 @@
 #pragma once
 
 #include "TableOutputWriter.h"
+#include "TableOutputBackgroundFlush.h"
 #include "OutputSpec.h"
 #include "CriticalSection.h"
 
@@ -16,6 +17,8 @@
 
 #include "Convert.h"
 
+#include <concurrent_queue.h>
+
 #pragma warning(disable : 4521)
 #include "orc/OrcFile.hh"
 #pragma warning(default : 4521)
@@ -131,6 +134,43 @@ private:
 
     HRESULT AddColumnAndCheckNumbers();
 
+    // Column vectors of a batch, resolved once when the batch is created (only the one matching its type is set)
+    struct ColumnVectors
+    {
+        orc::ColumnVectorBatch* Any = nullptr;
+        orc::LongVectorBatch* Longs = nullptr;
+        orc::StringVectorBatch* Strings = nullptr;
+        orc::TimestampVectorBatch* TimeStamps = nullptr;
+    };
+
+    // A row batch and the arena holding its strings, both are reused once the batch is added to m_Writer
+    struct RowBatch
+    {
+        RowBatch(orc::Writer& writer, DWORD dwBatchSize);
+
+        // Every value is released and every row is set back to not null
+        void Reset();
+
+        std::unique_ptr<orc::ColumnVectorBatch> Root;
+        std::vector<ColumnVectors> Columns;
+        BatchArena Strings;
+    };
+
+    ColumnVectors* GetCurrentVectors()
+    {
+        if (m_Batch == nullptr || m_dwColumnCounter >= m_Batch->Columns.size())
+            return nullptr;
+        return &m_Batch->Columns[m_dwColumnCounter];
+    }
+
+    HRESULT WriteLong(int64_t value);
+    HRESULT WriteUnixTime(int64_t seconds);
+    HRESULT WriteUTF8(const CHAR* szString, size_t cchCount);
+    HRESULT WriteUTF16(const WCHAR* szString, size_t cchCount);
+
+    // Adds the current batch to m_Writer, or hands it to the background writer, and starts a new batch
+    HRESULT FlushBatch();
+
     logger _L_;
 
     std::unique_ptr<Options> m_Options;
@@ -150,14 +190,16 @@ private:
 
     DWORD m_dwRows = 0L;
 
-    std::unique_ptr<MemoryPool> m_BatchPool;
-
     std::shared_ptr<ByteStream> m_pByteStream = nullptr;
     bool m_bCloseStream = true;
 
     std::unique_ptr<orc::Type> m_OrcSchema;
     std::unique_ptr<orc::Writer> m_Writer;
-    std::unique_ptr<orc::ColumnVectorBatch> m_Batch;
+    std::shared_ptr<RowBatch> m_Batch;
+
+    // With Options::InFlightBatches, full batches are added by a background task and come back as spare batches
+    std::unique_ptr<BackgroundFlush> m_pBackgroundFlush;
+    std::shared_ptr<Concurrency::concurrent_queue<std::shared_ptr<RowBatch>>> m_pSpareBatches;
 
     static constexpr auto UTC_zoneinfo =
         L"VFppZjIAAAAAAAAAAAAAAAAAAAAAAAABAAAAAQAAAAAAAAAAAAAAAQAAAAQAAAAAAABVVEMAAABUWmlmMgAAAAAAAAAAAAAAAAAAAAAAAAEAAAABAAAAAAAAAAEAAAABAAAABPgAAAAAAAAAAAAAAAAAAFVUQwAAAApVVEMwCg=="sv;
@@ -154,6 +154,12 @@ public:
         std::wstring YaraSource;
         std::unique_ptr<YaraConfig> Yara;
 
+        bool bShadowsDiff = false;
+
+        DWORD dwParallelLocations = 1L;
+        DWORD dwLocationsPerDisk = 1L;
+        DWORDLONG dwlReadCache = 0LL;
+
         CryptoHashStream::Algorithm CryptoHashAlgs =
             CryptoHashStream::Algorithm::MD5 | CryptoHashStream::Algorithm::SHA1;
         FuzzyHashStream::Algorithm FuzzyHashAlgs = FuzzyHashStream::Algorithm::Undefined;
@@ -345,6 +345,8 @@ HRESULT Main::GetConfigurationFromArgcArgv(int argc, LPCWSTR argv[])
                         ;
                     else if (BooleanOption(argv[i] + 1, L"Shadows", config.bAddShadows))
                         ;
+                    else if (BooleanOption(argv[i] + 1, L"ShadowsDiff", config.bShadowsDiff))
+                        ;
                     else if (ParameterOption(argv[i] + 1, L"Password", config.Output.Password))
                         ;
                     else if (FileSizeOption(argv[i] + 1, L"MaxPerSampleBytes", config.limits.dwlMaxBytesPerSample))
@@ -357,6 +359,14 @@ HRESULT Main::GetConfigurationFromArgcArgv(int argc, LPCWSTR argv[])
                         ;
                     else if (ParameterOption(argv[i] + 1, L"Compression", config.Output.Compression))
                         ;
+                    else if (ParameterOption(argv[i] + 1, L"ParallelLocations", config.dwParallelLocations))
+                        ;
+                    else if (ParameterOption(argv[i] + 1, L"LocationsPerDisk", config.dwLocationsPerDisk))
+                        ;
+                    else if (FileSizeOption(argv[i] + 1, L"ReadCache", config.dwlReadCache))
+                        ;
+                    else if (HashBackendOption(argv[i] + 1))
+                        ;
                     else if (ParameterOption(argv[i] + 1, L"Content", strContent))
                     {
                         config.content = config.GetContentSpecFromString(strContent);
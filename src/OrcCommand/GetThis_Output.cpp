@@ -52,6 +52,12 @@ void Main::PrintUsage()
         L"\t/xor=0xBADF00D0                      : Pattern used to XOR sample files (optional)\r\n"
         L"\t/hash=<MD5|SHA1|SHA256>             : List hash values stored in GetThis.csv\r\n"
         L"\t/fuzzyhash=<SSDeep|TLSH>             : List fuzzy hash values stored in GetThis.csv\r\n"
+        L"\t/ShadowsDiff                         : Only search the records of shadow copies that differ from their volume\r\n"
+        L"\t/ParallelLocations=<N>               : Number of volumes and shadow copies searched at once (default is 1)\r\n"
+        L"\t/LocationsPerDisk=<N>                : Maximum locations of the same physical disk searched at once (default is 1)\r\n"
+        L"\t/ReadCache=<Size>                    : Memory caching index and attribute list clusters, per location\r\n"
+        L"\t/HashBackend=<Name>                  : Implementation of the hashes: CryptoAPI (default), Native, NativeScalar "
+        L"or NativeSHANI\r\n"
         L"\r\n"
         L"Note: config file settings are superseded by command line options\r\n"
         L"\r\n"
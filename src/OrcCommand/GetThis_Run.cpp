@@ -955,6 +955,12 @@ HRESULT Main::FindMatchingSamples()
         log::Error(_L_, hr, L"Failed to initialize Yara scan\r\n");
     }
 
+    FileFinder.SetParallelLocations(config.dwParallelLocations, config.dwLocationsPerDisk);
+    FileFinder.SetReadCache(static_cast<size_t>(config.dwlReadCache));
+
+    if (config.bShadowsDiff)
+        FileFinder.SetBaseline(std::make_shared<MFTBaseline>());
+
     if (FAILED(
             hr = FileFinder.Find(
                 config.Locations,
@@ -103,6 +103,13 @@ public:
         boost::logic::tribool bAddShadows;
         boost::logic::tribool bPopSystemObjects;
 
+        DWORD dwParseThreads = 0L;
+        DWORD dwFRSPerRead = 0L;
+        DWORD dwReadAhead = 0L;
+        DWORDLONG dwlReadCache = 0LL;
+
+        bool bShadowsDiff = false;
+
         Intentions ColumnIntentions;
         Intentions DefaultIntentions;
         std::vector<Filter> Filters;
@@ -300,10 +300,22 @@ HRESULT Main::GetConfigurationFromArgcArgv(int argc, LPCWSTR argv[])
                         ;
                     else if (BooleanOption(argv[i] + 1, L"Shadows", config.bAddShadows))
                         ;
+                    else if (BooleanOption(argv[i] + 1, L"ShadowsDiff", config.bShadowsDiff))
+                        ;
                     else if (ParameterOption(argv[i] + 1, L"ResurrectRecords", config.bResurrectRecords))
                         ;
                     else if (ParameterOption(argv[i] + 1, L"PopSysObj", config.bPopSystemObjects))
                         ;
+                    else if (ParameterOption(argv[i] + 1, L"ParseThreads", config.dwParseThreads))
+                        ;
+                    else if (ParameterOption(argv[i] + 1, L"FRSPerRead", config.dwFRSPerRead))
+                        ;
+                    else if (ParameterOption(argv[i] + 1, L"ReadAhead", config.dwReadAhead))
+                        ;
+                    else if (FileSizeOption(argv[i] + 1, L"ReadCache", config.dwlReadCache))
+                        ;
+                    else if (HashBackendOption(argv[i] + 1))
+                        ;
                     else if (EncodingOption(argv[i] + 1, config.outFileInfo.OutputEncoding))
                     {
                         config.outI30Info.OutputEncoding =
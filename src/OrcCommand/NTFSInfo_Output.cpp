@@ -54,9 +54,17 @@ void Main::PrintUsage()
         L"tag)\r\n"
         L"\t/Walker=USN|MFT      : Walks the file systems entries through MFT parsing or USN Journal enumeration "
         L"(default is MFT)\r\n"
+        L"\t/ParseThreads=<N>    : Number of threads parsing MFT records (default is 1, MFT walker only)\r\n"
+        L"\t/FRSPerRead=<N>      : Number of MFT records read at once (default is 64, MFT walker only)\r\n"
+        L"\t/ReadAhead=<N>       : Number of MFT reads queued, 1 disables read ahead (default is 2, MFT walker only)\r\n"
+        L"\t/ReadCache=<Size>    : Memory caching the clusters of indexes and attribute lists (default is none, "
+        L"MFT walker only)\r\n"
+        L"\t/HashBackend=<Name>  : Implementation of MD5, SHA1 and SHA256: CryptoAPI (default), Native, NativeScalar or "
+        L"NativeSHANI\r\n"
         L"\r\n"
         L"\t/KnownLocations|/kl  : Scan a set of locations known to be of interest\r\n"
         L"\t/Shadows             : Add Volume Shadows Copies for selected volumes to parse\r\n"
+        L"\t/ShadowsDiff         : Only list the records of a shadow copy that differ from its volume (walked first)\r\n"
         L"\r\n"
         L"\t/<DefaultColumnSelection>,...: \r\n"
         L"\tSelects the columns to fill for each file system entry:"
@@ -662,6 +662,9 @@ HRESULT Main::RunThroughMFT()
         return hr;
     }
 
+    // records of the shadow copies identical to the ones of the first walk of their volume are not listed again
+    auto baseline = config.bShadowsDiff ? std::make_shared<MFTBaseline>() : nullptr;
+
     auto fileinfoIterator = begin(m_FileInfoOutput.Outputs());
     auto attrIterator = begin(m_AttrOutput.Outputs());
     auto i30Iterator = begin(m_I30Output.Outputs());
@@ -778,6 +781,11 @@ HRESULT Main::RunThroughMFT()
         MFTWalker walker(_L_);
         HRESULT hr = E_FAIL;
 
+        walker.SetParseThreads(config.dwParseThreads);
+        walker.SetReadAhead(config.dwFRSPerRead, config.dwReadAhead);
+        walker.SetReadCache(static_cast<size_t>(config.dwlReadCache));
+        walker.SetBaseline(baseline);
+
         if (FAILED(hr = walker.Initialize(loc, (bool)config.bResurrectRecords)))
         {
             if (hr == HRESULT_FROM_WIN32(ERROR_FILE_SYSTEM_LIMITATION))
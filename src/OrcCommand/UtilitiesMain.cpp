@@ -1014,6 +1014,35 @@ bool UtilitiesMain::CryptoHashAlgorithmOption(LPCWSTR szArg, LPCWSTR szOption, C
     return true;
 }
 
+bool UtilitiesMain::HashBackendOption(LPCWSTR szArg, LPCWSTR szOption)
+{
+    HRESULT hr = E_FAIL;
+
+    if (_wcsnicmp(szArg, szOption, wcslen(szOption)))
+        return false;
+
+    LPCWSTR pEquals = wcschr(szArg, L'=');
+    if (!pEquals)
+    {
+        log::Error(_L_, E_INVALIDARG, L"Option /%s should be like: /%s=CryptoAPI|Native\r\n", szArg, szOption);
+        return false;
+    }
+
+    auto backend = CryptoHashStream::GetSupportedBackend(pEquals + 1);
+    if (!backend)
+    {
+        log::Warning(_L_, E_NOTIMPL, L"Hash backend %s is not supported\r\n", pEquals + 1);
+        return true;
+    }
+
+    if (FAILED(hr = CryptoHashStream::SetDefaultBackend(*backend)))
+    {
+        log::Warning(
+            _L_, hr, L"Hash backend %s is not available on this processor, CryptoAPI is used\r\n", pEquals + 1);
+    }
+    return true;
+}
+
 bool UtilitiesMain::FuzzyHashAlgorithmOption(LPCWSTR szArg, LPCWSTR szOption, FuzzyHashStream::Algorithm& algo)
 {
     HRESULT hr = E_FAIL;
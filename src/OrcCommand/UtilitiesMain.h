@@ -588,6 +588,7 @@ protected:
 
     bool CryptoHashAlgorithmOption(LPCWSTR szArg, LPCWSTR szOption, CryptoHashStream::Algorithm& algo);
     bool FuzzyHashAlgorithmOption(LPCWSTR szArg, LPCWSTR szOption, FuzzyHashStream::Algorithm& algo);
+    bool HashBackendOption(LPCWSTR szArg, LPCWSTR szOption = L"HashBackend");
 
     bool ProcessPriorityOption(LPCWSTR szArg, LPCWSTR szOption = L"Low");
     bool EncodingOption(LPCWSTR szArg, OutputSpec::Encoding& anEncoding);
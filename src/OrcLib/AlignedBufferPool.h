@@ -0,0 +1,115 @@
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+//
+// Copyright © 2011-2019 ANSSI. All Rights Reserved.
+//
+// Author(s): Jean Gautier (ANSSI)
+//
+#pragma once
+
+#include "OrcLib.h"
+
+#pragma managed(push, off)
+
+namespace Orc {
+
+// Fixed size buffers aligned on a page (hence on any sector size), recycled between unbuffered reads
+// Free buffers are kept in an interlocked singly linked list threaded through the buffers themselves: acquiring and
+// releasing a buffer never takes a lock and only calls VirtualAlloc when the pool runs dry.
+class AlignedBufferPool
+{
+public:
+    static constexpr size_t DEFAULT_BUFFER_SIZE = 256 * 1024;
+    static constexpr USHORT DEFAULT_MAX_FREE = 16;
+
+    class Buffer
+    {
+    public:
+        Buffer() = default;
+        Buffer(const Buffer&) = delete;
+        Buffer& operator=(const Buffer&) = delete;
+
+        Buffer(Buffer&& other) noexcept
+            : m_pPool(other.m_pPool)
+            , m_pData(other.m_pData)
+        {
+            other.m_pData = nullptr;
+        }
+
+        Buffer& operator=(Buffer&& other) noexcept
+        {
+            std::swap(m_pPool, other.m_pPool);
+            std::swap(m_pData, other.m_pData);
+            return *this;
+        }
+
+        BYTE* GetData() const { return m_pData; }
+        size_t GetSize() const { return m_pPool != nullptr ? m_pPool->BufferSize() : 0L; }
+
+        explicit operator bool() const { return m_pData != nullptr; }
+
+        ~Buffer()
+        {
+            if (m_pData != nullptr)
+                m_pPool->Release(m_pData);
+        }
+
+    private:
+        friend class AlignedBufferPool;
+
+        AlignedBufferPool* m_pPool = nullptr;
+        BYTE* m_pData = nullptr;
+    };
+
+    AlignedBufferPool(size_t cbBuffer = DEFAULT_BUFFER_SIZE, USHORT maxFree = DEFAULT_MAX_FREE)
+        : m_cbBuffer(cbBuffer)
+        , m_maxFree(maxFree)
+    {
+        InitializeSListHead(&m_Free);
+    }
+
+    AlignedBufferPool(const AlignedBufferPool&) = delete;
+    AlignedBufferPool& operator=(const AlignedBufferPool&) = delete;
+
+    size_t BufferSize() const { return m_cbBuffer; }
+
+    // The buffer returned is empty when memory is exhausted
+    Buffer Acquire()
+    {
+        Buffer buffer;
+        buffer.m_pPool = this;
+
+        if (auto pEntry = InterlockedPopEntrySList(&m_Free))
+            buffer.m_pData = reinterpret_cast<BYTE*>(pEntry);
+        else
+            buffer.m_pData =
+                static_cast<BYTE*>(VirtualAlloc(NULL, m_cbBuffer, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE));
+
+        return buffer;
+    }
+
+    ~AlignedBufferPool()
+    {
+        while (auto pEntry = InterlockedPopEntrySList(&m_Free))
+            VirtualFree(pEntry, 0L, MEM_RELEASE);
+    }
+
+private:
+    SLIST_HEADER m_Free;
+    size_t m_cbBuffer;
+    USHORT m_maxFree;
+
+    void Release(BYTE* pData) noexcept
+    {
+        if (QueryDepthSList(&m_Free) >= m_maxFree)
+        {
+            VirtualFree(pData, 0L, MEM_RELEASE);
+            return;
+        }
+        InterlockedPushEntrySList(&m_Free, reinterpret_cast<PSLIST_ENTRY>(pData));
+    }
+};
+
+}  // namespace Orc
+
+#pragma managed(pop)
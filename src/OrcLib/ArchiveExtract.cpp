@@ -41,16 +41,23 @@ using namespace Orc;
 
 std::shared_ptr<ArchiveExtract> ArchiveExtract::MakeExtractor(ArchiveFormat fmt, logger pLog, bool bComputeHash)
 {
+    std::shared_ptr<ArchiveExtract> retval;
     switch (fmt)
     {
         case ArchiveFormat::Cabinet:
-            return std::make_shared<CabExtract>(std::move(pLog), bComputeHash);
+            retval = std::make_shared<CabExtract>(std::move(pLog), bComputeHash);
+            break;
         case ArchiveFormat::SevenZip:
-            return std::make_shared<ZipExtract>(std::move(pLog), bComputeHash);
+            retval = std::make_shared<ZipExtract>(std::move(pLog), bComputeHash);
+            break;
         case ArchiveFormat::Zip:
-            return std::make_shared<ZipExtract>(std::move(pLog), bComputeHash);
+            retval = std::make_shared<ZipExtract>(std::move(pLog), bComputeHash);
+            break;
+        default:
+            return nullptr;
     }
-    return nullptr;
+    retval->m_Format = fmt;
+    return retval;
 }
 
 STDMETHODIMP ArchiveExtract::Extract(__in PCWSTR pwzZipFilePath, __in PCWSTR pwzExtractRootDir, __in PCWSTR szSDDL)
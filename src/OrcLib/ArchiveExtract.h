@@ -36,6 +36,8 @@ protected:
     MakeArchiveStream m_MakeArchiveStream;
     ItemShouldBeExtractedCallback m_ShouldBeExtracted;
 
+    ArchiveFormat m_Format = ArchiveFormat::Unknown;
+
     ArchiveExtract(logger pLog, bool bComputeHash)
         : Archive(std::move(pLog), bComputeHash) {};
 
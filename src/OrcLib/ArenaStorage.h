@@ -0,0 +1,209 @@
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+//
+// Copyright © 2011-2019 ANSSI. All Rights Reserved.
+//
+// Author(s): Jean Gautier (ANSSI)
+//
+#pragma once
+
+#include "OrcLib.h"
+
+#include <concrt.h>
+
+#include <atomic>
+#include <new>
+#include <type_traits>
+
+#pragma managed(push, off)
+
+namespace Orc {
+
+// Bump allocator for small objects sharing the same lifetime (like the attributes of the records of a MFT walk)
+// Memory is carved from chunks aligned on their size, each chunk counts its live allocations and is released in one
+// go once they are all deallocated. Objects may outlive the arena and be released from any thread.
+// Each allocating thread claims a slot and carves from its own chunk without locking, threads left without a slot
+// share a chunk under a lock.
+class ArenaStorage
+{
+public:
+    static constexpr size_t CHUNK_SIZE = 64 * 1024;  // VirtualAlloc allocation granularity
+    static constexpr size_t LARGE_ALLOCATION = CHUNK_SIZE / 8;
+    static constexpr size_t SLOT_COUNT = 64;
+
+    // Allocator for standard containers, a default constructed allocator uses the process heap
+    template <class _Ty>
+    class Allocator
+    {
+    public:
+        using value_type = _Ty;
+        using propagate_on_container_copy_assignment = std::true_type;
+        using propagate_on_container_move_assignment = std::true_type;
+        using propagate_on_container_swap = std::true_type;
+
+        Allocator() noexcept = default;
+
+        Allocator(ArenaStorage* pArena) noexcept
+            : m_pArena(pArena)
+        {
+        }
+
+        template <class _Other>
+        Allocator(const Allocator<_Other>& other) noexcept
+            : m_pArena(other.m_pArena)
+        {
+        }
+
+        _Ty* allocate(size_t count)
+        {
+            if (m_pArena == nullptr)
+                return static_cast<_Ty*>(::operator new(count * sizeof(_Ty)));
+            return static_cast<_Ty*>(m_pArena->Allocate(count * sizeof(_Ty)));
+        }
+        void deallocate(_Ty* ptr, size_t count) noexcept
+        {
+            if (m_pArena == nullptr)
+                ::operator delete(ptr);
+            else
+                ArenaStorage::Deallocate(ptr, count * sizeof(_Ty));
+        }
+
+        template <class _Other>
+        bool operator==(const Allocator<_Other>& other) const noexcept
+        {
+            return m_pArena == other.m_pArena;
+        }
+        template <class _Other>
+        bool operator!=(const Allocator<_Other>& other) const noexcept
+        {
+            return m_pArena != other.m_pArena;
+        }
+
+    private:
+        template <class _Other>
+        friend class Allocator;
+
+        ArenaStorage* m_pArena = nullptr;
+    };
+
+    ArenaStorage() = default;
+    ArenaStorage(const ArenaStorage&) = delete;
+    ArenaStorage& operator=(const ArenaStorage&) = delete;
+
+    void* Allocate(size_t size)
+    {
+        size = Align(size);
+
+        if (size >= LARGE_ALLOCATION)
+            return ::operator new(size);
+
+        // a slot is only used by the thread that claimed it, a thread id reused after its thread exited inherits it
+        const DWORD dwThreadId = GetCurrentThreadId();
+        for (size_t i = 0; i < SLOT_COUNT; i++)
+        {
+            auto& slot = m_Slots[(dwThreadId / 4 + i) % SLOT_COUNT];
+
+            DWORD dwOwner = slot.ThreadId.load(std::memory_order_acquire);
+            if (dwOwner == 0L && slot.ThreadId.compare_exchange_strong(dwOwner, dwThreadId))
+                dwOwner = dwThreadId;
+
+            if (dwOwner == dwThreadId)
+                return Carve(slot.pCurrent, size);
+        }
+
+        Concurrency::critical_section::scoped_lock sl(m_cs);
+        return Carve(m_pShared, size);
+    }
+
+    static void Deallocate(void* ptr, size_t size) noexcept
+    {
+        if (ptr == nullptr)
+            return;
+
+        if (Align(size) >= LARGE_ALLOCATION)
+        {
+            ::operator delete(ptr);
+            return;
+        }
+
+        Release(reinterpret_cast<Chunk*>(reinterpret_cast<ULONG_PTR>(ptr) & ~(ULONG_PTR)(CHUNK_SIZE - 1)));
+    }
+
+    // Number of chunks carved by this arena since its creation
+    size_t ChunkCount() const { return m_ChunkCount; }
+
+    // Must not be destroyed while threads allocate from it
+    ~ArenaStorage()
+    {
+        for (auto& slot : m_Slots)
+        {
+            if (slot.pCurrent != nullptr)
+                Release(slot.pCurrent);
+        }
+        if (m_pShared != nullptr)
+            Release(m_pShared);
+    }
+
+private:
+    struct Chunk
+    {
+        std::atomic<LONG> Live;
+        size_t Used;
+    };
+
+    struct Slot
+    {
+        std::atomic<DWORD> ThreadId {0L};
+        Chunk* pCurrent = nullptr;
+    };
+
+    Slot m_Slots[SLOT_COUNT];
+
+    Concurrency::critical_section m_cs;
+    Chunk* m_pShared = nullptr;
+
+    std::atomic<size_t> m_ChunkCount {0L};
+
+    static constexpr size_t Align(size_t size)
+    {
+        return (size + (MEMORY_ALLOCATION_ALIGNMENT - 1)) & ~(size_t)(MEMORY_ALLOCATION_ALIGNMENT - 1);
+    }
+
+    void* Carve(Chunk*& pCurrent, size_t size)
+    {
+        if (pCurrent == nullptr || pCurrent->Used + size > CHUNK_SIZE)
+        {
+            auto pChunk = static_cast<Chunk*>(VirtualAlloc(NULL, CHUNK_SIZE, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE));
+            if (pChunk == nullptr)
+                throw std::bad_alloc();
+
+            // the arena holds a reference on the chunk it carves from
+            new (pChunk) Chunk;
+            pChunk->Live = 1;
+            pChunk->Used = Align(sizeof(Chunk));
+
+            if (pCurrent != nullptr)
+                Release(pCurrent);
+            pCurrent = pChunk;
+            m_ChunkCount++;
+        }
+
+        auto retval = reinterpret_cast<BYTE*>(pCurrent) + pCurrent->Used;
+        pCurrent->Used += size;
+        pCurrent->Live++;
+        return retval;
+    }
+
+    static void Release(Chunk* pChunk) noexcept
+    {
+        if (--pChunk->Live == 0)
+        {
+            pChunk->~Chunk();
+            VirtualFree(pChunk, 0L, MEM_RELEASE);
+        }
+    }
+};
+
+}  // namespace Orc
+
+#pragma managed(pop)
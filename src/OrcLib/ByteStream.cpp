@@ -74,24 +74,96 @@ HRESULT ByteStream::CopyTo(__in ByteStream& outStream, const ULONGLONG ullChunk,
     if (FAILED(hr = SetFilePointer(0, SEEK_SET, NULL)))
         return hr;
 
-    while (qwBytesCopied < GetSize())
+    // S_FALSE when the end of the file comes before ullEnd, the last read may go past ullEnd unless bExact
+    auto CopyUntil = [&](ULONGLONG ullEnd, bool bExact) -> HRESULT {
+        while (qwBytesCopied < ullEnd)
+        {
+            const ULONGLONG ullToRead =
+                bExact ? std::min<ULONGLONG>(buffer.GetCount(), ullEnd - qwBytesCopied) : buffer.GetCount();
+
+            if (FAILED(hr = Read(buffer.GetData(), ullToRead, &ullBytesRead)))
+                return hr;
+
+            if (ullBytesRead == 0LL)
+                return S_FALSE;  // When read returns 0 bytes read, we have reached the end of the file
+
+            if (FAILED(hr = outStream.Write(buffer.GetData(), ullBytesRead, &ullBytesWritten)))
+                return hr;
+
+            _ASSERT(ullBytesRead == ullBytesWritten);
+            qwBytesCopied += ullBytesRead;
+
+            if (pcbBytesWritten)
+                *pcbBytesWritten = qwBytesCopied;
+        }
+        return S_OK;
+    };
+
+    std::vector<DataRange> ranges;
+    if (GetDataRanges(ranges) == S_OK)
     {
-        if (FAILED(hr = Read(buffer.GetData(), buffer.GetCount(), &ullBytesRead)))
-            return hr;
+        for (const auto& range : ranges)
+        {
+            if (!range.bHole)
+            {
+                if ((hr = CopyUntil(range.Offset + range.Length, true)) != S_OK)
+                    return FAILED(hr) ? hr : S_OK;
+                continue;
+            }
+
+            if (FAILED(hr = SetFilePointer(range.Offset + range.Length, FILE_BEGIN, NULL)))
+                return hr;
+
+            if (FAILED(hr = outStream.WriteZeroes(range.Length, &ullBytesWritten)))
+                return hr;
+
+            _ASSERT(range.Length == ullBytesWritten);
+            qwBytesCopied += ullBytesWritten;
+
+            if (pcbBytesWritten)
+                *pcbBytesWritten = qwBytesCopied;
+        }
+    }
+
+    if (FAILED(hr = CopyUntil(GetSize(), false)))
+        return hr;
 
-        if (ullBytesRead == 0LL)
-            break;  // When read returns 0 bytes read, we have reached the end of the file
+    return S_OK;
+}
 
-        if (FAILED(hr = outStream.Write(buffer.GetData(), ullBytesRead, &ullBytesWritten)))
+HRESULT ByteStream::GetDataRanges(std::vector<DataRange>& ranges)
+{
+    DBG_UNREFERENCED_PARAMETER(ranges);
+    return E_NOTIMPL;
+}
+
+HRESULT ByteStream::WriteZeroes(__in ULONGLONG cbBytes, __out_opt PULONGLONG pcbBytesWritten)
+{
+    HRESULT hr = E_FAIL;
+    static const BYTE zeroes[0x10000] = {0};
+
+    if (pcbBytesWritten)
+        *pcbBytesWritten = 0LL;
+
+    ULONGLONG ullWritten = 0LL;
+    while (ullWritten < cbBytes)
+    {
+        ULONGLONG ullThisWrite = 0LL;
+        if (FAILED(
+                hr = Write(
+                    const_cast<BYTE*>(zeroes),
+                    std::min<ULONGLONG>(sizeof(zeroes), cbBytes - ullWritten),
+                    &ullThisWrite)))
             return hr;
 
-        _ASSERT(ullBytesRead == ullBytesWritten);
-        qwBytesCopied += ullBytesRead;
+        if (ullThisWrite == 0LL)
+            break;
+
+        ullWritten += ullThisWrite;
 
         if (pcbBytesWritten)
-            *pcbBytesWritten = qwBytesCopied;
+            *pcbBytesWritten = ullWritten;
     }
-
     return S_OK;
 }
 
@@ -12,6 +12,7 @@
 #include "ByteStreamVisitor.h"
 
 #include <memory>
+#include <vector>
 
 #pragma managed(push, off)
 
@@ -65,6 +66,22 @@ public:
     STDMETHOD(SetFilePointer)
     (__in LONGLONG DistanceToMove, __in DWORD dwMoveMethod, __out_opt PULONG64 pCurrPointer) PURE;
 
+    // A run of the stream, holes are runs known to read as zeroes (sparse or unallocated)
+    struct DataRange
+    {
+        ULONGLONG Offset = 0LL;
+        ULONGLONG Length = 0LL;
+        bool bHole = false;
+    };
+
+    // Contiguous ranges from the beginning of the stream, E_NOTIMPL if the stream does not know where its holes are
+    // Bytes past the last range are data.
+    STDMETHOD(GetDataRanges)(std::vector<DataRange>& ranges);
+
+    // Writes cbBytes zeroes, overridden by streams which can store them without writing them
+    STDMETHOD(WriteZeroes)(__in ULONGLONG cbBytes, __out_opt PULONGLONG pcbBytesWritten);
+
+    // Holes of the stream are not read but passed to WriteZeroes
     STDMETHOD(CopyTo)(__in const std::shared_ptr<ByteStream>& pOutStream, __out_opt PULONGLONG pcbBytesWritten);
 
     STDMETHOD(CopyTo)(__in ByteStream& pOutStream, __out_opt PULONGLONG pcbBytesWritten);
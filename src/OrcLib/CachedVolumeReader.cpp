@@ -0,0 +1,213 @@
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+//
+// Copyright © 2011-2019 ANSSI. All Rights Reserved.
+//
+// Author(s): Jean Gautier (ANSSI)
+//
+#include "StdAfx.h"
+
+#include "CachedVolumeReader.h"
+
+#include "LogFileWriter.h"
+
+using namespace Orc;
+
+CachedVolumeReader::CachedVolumeReader(
+    logger pLog,
+    std::shared_ptr<VolumeReader> pReader,
+    size_t cbBudget,
+    DWORD dwClustersPerBlock,
+    ULONGLONG ullBypassSize)
+    : VolumeReader(std::move(pLog), pReader->GetLocation())
+    , m_pReader(std::move(pReader))
+    , m_pCache(std::make_shared<Cache>())
+{
+    m_pCache->cbBudget = cbBudget;
+    m_pCache->dwClustersPerBlock = dwClustersPerBlock ? dwClustersPerBlock : DEFAULT_CLUSTERS_PER_BLOCK;
+    m_pCache->ullBypassSize = ullBypassSize;
+
+    CopyProperties();
+}
+
+CachedVolumeReader::CachedVolumeReader(
+    logger pLog,
+    std::shared_ptr<VolumeReader> pReader,
+    std::shared_ptr<Cache> pCache)
+    : VolumeReader(std::move(pLog), pReader->GetLocation())
+    , m_pReader(std::move(pReader))
+    , m_pCache(std::move(pCache))
+{
+    CopyProperties();
+}
+
+void CachedVolumeReader::CopyProperties()
+{
+    m_bReadyForEnumeration = m_pReader->IsReady();
+    m_BytesPerFRS = m_pReader->GetBytesPerFRS();
+    m_BytesPerSector = m_pReader->GetBytesPerSector();
+    m_BytesPerCluster = m_pReader->GetBytesPerCluster();
+    m_llVolumeSerialNumber = m_pReader->VolumeSerialNumber();
+    m_dwMaxComponentLength = m_pReader->MaxComponentLength();
+    m_fsType = m_pReader->GetFSType();
+    m_BoostSector = m_pReader->GetBootSector();
+}
+
+HRESULT CachedVolumeReader::LoadDiskProperties()
+{
+    HRESULT hr = E_FAIL;
+
+    if (FAILED(hr = m_pReader->LoadDiskProperties()))
+        return hr;
+
+    CopyProperties();
+    return S_OK;
+}
+
+ULONGLONG CachedVolumeReader::BlockSize() const
+{
+    const ULONG ulCluster = m_pReader->GetBytesPerCluster();
+    return (ULONGLONG)(ulCluster ? ulCluster : 4096) * m_pCache->dwClustersPerBlock;
+}
+
+HRESULT CachedVolumeReader::GetBlock(ULONGLONG ullIndex, std::shared_ptr<const Block>& block)
+{
+    HRESULT hr = E_FAIL;
+    Shard& shard = m_pCache->Shards[ullIndex % SHARD_COUNT];
+
+    {
+        Concurrency::critical_section::scoped_lock sl(shard.cs);
+
+        auto it = shard.Index.find(ullIndex);
+        if (it != std::end(shard.Index))
+        {
+            shard.LRU.splice(std::begin(shard.LRU), shard.LRU, it->second);
+            block = *it->second;
+            m_pCache->Hits++;
+            return S_OK;
+        }
+    }
+
+    // read without holding the shard: a block missed by two threads at once is read twice, not waited for
+    const ULONGLONG ullBlockSize = BlockSize();
+
+    auto pBlock = std::make_shared<Block>();
+    pBlock->Index = ullIndex;
+
+    ULONGLONG ullBytesRead = 0LL;
+    if (FAILED(hr = m_pReader->ReadAt(ullIndex * ullBlockSize, pBlock->Data, ullBlockSize, ullBytesRead)))
+        return hr;
+
+    pBlock->Data.SetCount(static_cast<size_t>(ullBytesRead));
+    m_pCache->Misses++;
+
+    block = pBlock;
+    AddBlock(block);
+    return S_OK;
+}
+
+void CachedVolumeReader::AddBlock(const std::shared_ptr<const Block>& block)
+{
+    const size_t cbShardBudget = m_pCache->cbBudget / SHARD_COUNT;
+    if (block->Data.GetCount() > cbShardBudget)
+        return;
+
+    Shard& shard = m_pCache->Shards[block->Index % SHARD_COUNT];
+    Concurrency::critical_section::scoped_lock sl(shard.cs);
+
+    if (shard.Index.find(block->Index) != std::end(shard.Index))
+        return;
+
+    while (!shard.LRU.empty() && shard.BytesCached + block->Data.GetCount() > cbShardBudget)
+    {
+        const auto& evicted = shard.LRU.back();
+        shard.BytesCached -= evicted->Data.GetCount();
+        shard.Index.erase(evicted->Index);
+        shard.LRU.pop_back();
+        m_pCache->Evicted++;
+    }
+
+    shard.LRU.push_front(block);
+    shard.Index.emplace(block->Index, std::begin(shard.LRU));
+    shard.BytesCached += block->Data.GetCount();
+}
+
+HRESULT
+CachedVolumeReader::Read(ULONGLONG offset, CBinaryBuffer& data, ULONGLONG ullBytesToRead, ULONGLONG& ullBytesRead)
+{
+    HRESULT hr = E_FAIL;
+
+    ullBytesRead = 0LL;
+
+    if (ullBytesToRead >= m_pCache->ullBypassSize || m_pCache->cbBudget == 0)
+    {
+        m_pCache->Bypassed++;
+        return m_pReader->ReadAt(offset, data, ullBytesToRead, ullBytesRead);
+    }
+
+    if (data.OwnsBuffer())
+    {
+        if (!data.CheckCount(static_cast<size_t>(ullBytesToRead)))
+            return E_OUTOFMEMORY;
+    }
+    else if (ullBytesToRead > data.GetCount())
+    {
+        ullBytesToRead = data.GetCount();
+    }
+
+    const ULONGLONG ullBlockSize = BlockSize();
+    const ULONGLONG ullEnd = offset + ullBytesToRead;
+    ULONGLONG ullPosition = offset;
+
+    while (ullPosition < ullEnd)
+    {
+        std::shared_ptr<const Block> block;
+        if (FAILED(hr = GetBlock(ullPosition / ullBlockSize, block)))
+            return hr;
+
+        const ULONGLONG ullInBlock = ullPosition % ullBlockSize;
+        if (ullInBlock >= block->Data.GetCount())
+            break;  // end of the volume
+
+        const ULONGLONG ullToCopy = std::min<ULONGLONG>(block->Data.GetCount() - ullInBlock, ullEnd - ullPosition);
+        CopyMemory(
+            data.GetData() + (ullPosition - offset),
+            block->Data.GetData() + ullInBlock,
+            static_cast<size_t>(ullToCopy));
+
+        ullPosition += ullToCopy;
+    }
+
+    ullBytesRead = ullPosition - offset;
+    return S_OK;
+}
+
+CachedVolumeReader::Statistics CachedVolumeReader::GetStatistics() const
+{
+    Statistics stats;
+    stats.Hits = m_pCache->Hits;
+    stats.Misses = m_pCache->Misses;
+    stats.Bypassed = m_pCache->Bypassed;
+    stats.Evicted = m_pCache->Evicted;
+
+    for (auto& shard : m_pCache->Shards)
+    {
+        Concurrency::critical_section::scoped_lock sl(shard.cs);
+        stats.BytesCached += shard.BytesCached;
+    }
+    return stats;
+}
+
+std::shared_ptr<VolumeReader> CachedVolumeReader::ReOpen(DWORD dwDesiredAccess, DWORD dwShareMode, DWORD dwFlags)
+{
+    auto pReader = m_pReader->ReOpen(dwDesiredAccess, dwShareMode, dwFlags);
+    if (pReader == nullptr)
+        return nullptr;
+
+    return std::shared_ptr<CachedVolumeReader>(new CachedVolumeReader(_L_, std::move(pReader), m_pCache));
+}
+
+std::shared_ptr<VolumeReader> CachedVolumeReader::DuplicateReader()
+{
+    return std::shared_ptr<CachedVolumeReader>(new CachedVolumeReader(_L_, m_pReader, m_pCache));
+}
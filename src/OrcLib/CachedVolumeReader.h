@@ -0,0 +1,129 @@
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+//
+// Copyright © 2011-2019 ANSSI. All Rights Reserved.
+//
+// Author(s): Jean Gautier (ANSSI)
+//
+#pragma once
+
+#include "VolumeReader.h"
+#include "BinaryBuffer.h"
+
+#include <concrt.h>
+
+#include <atomic>
+#include <list>
+#include <unordered_map>
+
+#pragma managed(push, off)
+
+namespace Orc {
+
+// Caches the blocks read at an offset from any VolumeReader (image, VHD, snapshot, mounted volume...)
+// Blocks are a whole number of clusters, kept in LRU lists sharded by block index so that concurrent readers rarely
+// contend. Reads of the bypass size or more (sequential scans of the MFT or of a file's data) go straight to the
+// underlying reader and evict nothing. Sequential reads (Seek + Read) are not cached.
+// Readers obtained through ReOpen share the cache of the reader they come from.
+class ORCLIB_API CachedVolumeReader : public VolumeReader
+{
+public:
+    static constexpr size_t DEFAULT_BUDGET = 64 * 1024 * 1024;
+    static constexpr DWORD DEFAULT_CLUSTERS_PER_BLOCK = 4;
+    static constexpr ULONGLONG DEFAULT_BYPASS_SIZE = 64 * 1024;
+
+    struct Statistics
+    {
+        ULONGLONG Hits = 0LL;  // blocks found in the cache
+        ULONGLONG Misses = 0LL;  // blocks read from the underlying reader
+        ULONGLONG Bypassed = 0LL;  // reads of the bypass size or more
+        ULONGLONG Evicted = 0LL;
+        size_t BytesCached = 0L;
+    };
+
+    CachedVolumeReader(
+        logger pLog,
+        std::shared_ptr<VolumeReader> pReader,
+        size_t cbBudget = DEFAULT_BUDGET,
+        DWORD dwClustersPerBlock = DEFAULT_CLUSTERS_PER_BLOCK,
+        ULONGLONG ullBypassSize = DEFAULT_BYPASS_SIZE);
+
+    const std::shared_ptr<VolumeReader>& GetUnderlyingReader() const { return m_pReader; }
+
+    Statistics GetStatistics() const;
+
+    const WCHAR* ShortVolumeName() { return m_pReader->ShortVolumeName(); }
+
+    HRESULT LoadDiskProperties();
+    HANDLE GetDevice() { return m_pReader->GetDevice(); }
+
+    ULONG GetBytesPerFRS() const { return m_pReader->GetBytesPerFRS(); }
+    ULONG GetBytesPerCluster() const { return m_pReader->GetBytesPerCluster(); }
+    ULONG GetBytesPerSector() const { return m_pReader->GetBytesPerSector(); }
+
+    HRESULT Seek(ULONGLONG offset) { return m_pReader->Seek(offset); }
+    HRESULT Read(ULONGLONG offset, CBinaryBuffer& data, ULONGLONG ullBytesToRead, ULONGLONG& ullBytesRead);
+    HRESULT Read(CBinaryBuffer& data, ULONGLONG ullBytesToRead, ULONGLONG& ullBytesRead)
+    {
+        return m_pReader->Read(data, ullBytesToRead, ullBytesRead);
+    }
+    HRESULT ReadAt(ULONGLONG offset, CBinaryBuffer& data, ULONGLONG ullBytesToRead, ULONGLONG& ullBytesRead)
+    {
+        return Read(offset, data, ullBytesToRead, ullBytesRead);
+    }
+    using VolumeReader::ReadAt;
+
+    std::shared_ptr<VolumeReader> ReOpen(DWORD dwDesiredAccess, DWORD dwShareMode, DWORD dwFlags);
+
+    ~CachedVolumeReader() {}
+
+private:
+    static constexpr size_t SHARD_COUNT = 16;
+
+    struct Block
+    {
+        ULONGLONG Index;
+        CBinaryBuffer Data;  // shorter than a block at the end of the volume
+    };
+    using BlockList = std::list<std::shared_ptr<const Block>>;
+
+    struct Shard
+    {
+        Concurrency::critical_section cs;
+        BlockList LRU;  // most recently used first
+        std::unordered_map<ULONGLONG, BlockList::iterator> Index;
+        size_t BytesCached = 0L;
+    };
+
+    struct Cache
+    {
+        size_t cbBudget;
+        DWORD dwClustersPerBlock;
+        ULONGLONG ullBypassSize;
+
+        Shard Shards[SHARD_COUNT];
+
+        std::atomic<ULONGLONG> Hits{0LL};
+        std::atomic<ULONGLONG> Misses{0LL};
+        std::atomic<ULONGLONG> Bypassed{0LL};
+        std::atomic<ULONGLONG> Evicted{0LL};
+    };
+
+    std::shared_ptr<VolumeReader> m_pReader;
+    std::shared_ptr<Cache> m_pCache;
+
+    CachedVolumeReader(logger pLog, std::shared_ptr<VolumeReader> pReader, std::shared_ptr<Cache> pCache);
+
+    ULONGLONG BlockSize() const;
+
+    HRESULT GetBlock(ULONGLONG ullIndex, std::shared_ptr<const Block>& block);
+    void AddBlock(const std::shared_ptr<const Block>& block);
+
+    void CopyProperties();
+
+    std::shared_ptr<VolumeReader> DuplicateReader();
+};
+
+}  // namespace Orc
+
+#pragma managed(pop)
@@ -22,6 +22,8 @@ public:
         : ByteStream(std::move(pLog)) {};
     virtual ~ChainingStream(void);
 
+    const std::shared_ptr<ByteStream>& GetChainedStream() const { return m_pChainedStream; }
+
     STDMETHOD(IsOpen)()
     {
         if (m_pChainedStream == NULL)
@@ -12,6 +12,8 @@
 #include "ByteStream.h"
 #include "Kernel32Extension.h"
 
+#include <ppl.h>
+
 using namespace Orc;
 
 CompleteVolumeReader::CompleteVolumeReader(logger pLog, const WCHAR* szLocation)
@@ -147,6 +149,116 @@ CompleteVolumeReader::Read(ULONGLONG offset, CBinaryBuffer& data, ULONGLONG ullB
     return S_OK;
 }
 
+HRESULT
+CompleteVolumeReader::ReadAt(ULONGLONG offset, CBinaryBuffer& data, ULONGLONG ullBytesToRead, ULONGLONG& ullBytesRead)
+{
+    HRESULT hr = E_FAIL;
+
+    ullBytesRead = 0LL;
+
+    if (m_Extents.empty())
+        return E_POINTER;
+    if (offset > m_Extents[0].GetLength())
+        return E_INVALIDARG;
+
+    // without an overlapped handle, reads go through the shared file pointer under the reader's lock
+    if (!m_Extents[0].CanReadAt())
+        return Read(offset, data, ullBytesToRead, ullBytesRead);
+
+    if (data.OwnsBuffer())
+    {
+        if (!data.CheckCount(static_cast<size_t>(ullBytesToRead)))
+            return E_OUTOFMEMORY;
+    }
+    else if (ullBytesToRead > data.GetCount())
+    {
+        ullBytesToRead = data.GetCount();
+    }
+
+    // unbuffered reads must start and end on a sector boundary, into sector aligned memory
+    const ULONGLONG ullSector = m_BytesPerSector ? m_BytesPerSector : 1;
+    auto IsAligned = [ullSector](ULONGLONG value) { return value % ullSector == 0; };
+
+    AlignedBufferPool::Buffer buffer;
+
+    const ULONGLONG ullEnd = offset + ullBytesToRead;
+    ULONGLONG ullPosition = offset;
+
+    while (ullPosition < ullEnd)
+    {
+        BYTE* pDestination = data.GetData() + (ullPosition - offset);
+        ULONGLONG ullPieceSize = 0LL;
+        ULONGLONG ullPieceRead = 0LL;
+        DWORD dwBytesRead = 0L;
+
+        if (IsAligned(ullPosition) && IsAligned(reinterpret_cast<ULONG_PTR>(pDestination))
+            && ullEnd - ullPosition >= ullSector)
+        {
+            // whole sectors straight into data
+            ullPieceSize = std::min<ULONGLONG>((ullEnd - ullPosition) / ullSector * ullSector, DEFAULT_READ_SIZE);
+
+            if (FAILED(hr = m_Extents[0].ReadAt(ullPosition, pDestination, (DWORD)ullPieceSize, &dwBytesRead)))
+                return hr;
+
+            ullPieceRead = dwBytesRead;
+        }
+        else
+        {
+            // head or tail sectors, or misaligned memory: the sectors spanned go through an aligned buffer
+            if (!buffer && !(buffer = m_AlignedBuffers.Acquire()))
+                return E_OUTOFMEMORY;
+
+            const ULONGLONG ullSpanStart = ullPosition / ullSector * ullSector;
+            const ULONGLONG ullSpanEnd =
+                std::min<ULONGLONG>((ullEnd + ullSector - 1) / ullSector * ullSector, ullSpanStart + buffer.GetSize());
+
+            if (FAILED(
+                    hr = m_Extents[0].ReadAt(
+                        ullSpanStart, buffer.GetData(), (DWORD)(ullSpanEnd - ullSpanStart), &dwBytesRead)))
+                return hr;
+
+            ullPieceSize = std::min(ullSpanEnd, ullEnd) - ullPosition;
+            if (ullSpanStart + dwBytesRead > ullPosition)
+                ullPieceRead = std::min(ullSpanStart + dwBytesRead - ullPosition, ullPieceSize);
+
+            CopyMemory(
+                pDestination, buffer.GetData() + (ullPosition - ullSpanStart), static_cast<size_t>(ullPieceRead));
+        }
+
+        ullPosition += ullPieceRead;
+
+        // end of the volume
+        if (ullPieceRead < ullPieceSize)
+            break;
+    }
+
+    ullBytesRead = ullPosition - offset;
+    return S_OK;
+}
+
+HRESULT CompleteVolumeReader::ReadAt(ReadRequest* pRequests, size_t nRequests)
+{
+    if (nRequests <= 1 || m_Extents.empty() || !m_Extents[0].CanReadAt())
+        return VolumeReader::ReadAt(pRequests, nRequests);
+
+    // positional reads do not share any state: all the pieces are in flight at once
+    std::vector<HRESULT> results(nRequests, S_OK);
+
+    concurrency::parallel_for(size_t(0), nRequests, [this, pRequests, &results](size_t i) {
+        auto& request = pRequests[i];
+        CBinaryBuffer buffer(request.Data, static_cast<size_t>(request.Size));
+
+        results[i] = ReadAt(request.Offset, buffer, request.Size, request.Read);
+    });
+
+    for (auto hr : results)
+    {
+        if (FAILED(hr))
+            return hr;
+    }
+    return S_OK;
+}
+
 std::shared_ptr<VolumeReader> CompleteVolumeReader::ReOpen(DWORD dwDesiredAccess, DWORD dwShareMode, DWORD dwFlags)
 {
     auto retval = DuplicateReader();
@@ -10,6 +10,7 @@
 #include "VolumeReader.h"
 #include "DiskExtent.h"
 #include "BinaryBuffer.h"
+#include "AlignedBufferPool.h"
 
 #include <concrt.h>
 
@@ -27,6 +28,8 @@ public:
 
     HRESULT Seek(ULONGLONG offset);
     HRESULT Read(ULONGLONG offset, CBinaryBuffer& data, ULONGLONG ullBytesToRead, ULONGLONG& ullBytesRead);
+    HRESULT ReadAt(ULONGLONG offset, CBinaryBuffer& data, ULONGLONG ullBytesToRead, ULONGLONG& ullBytesRead);
+    HRESULT ReadAt(ReadRequest* pRequests, size_t nRequests);
 
     virtual std::shared_ptr<VolumeReader> ReOpen(DWORD dwDesiredAccess, DWORD dwShareMode, DWORD dwFlags);
 
@@ -40,6 +43,9 @@ protected:
 
 private:
     concurrency::critical_section m_cs;
+
+    // sector aligned buffers for the parts of positional reads that cannot land directly in the caller's buffer
+    AlignedBufferPool m_AlignedBuffers;
 };
 
 }  // namespace Orc
@@ -42,6 +42,12 @@ HRESULT Orc::Config::Common::output(ConfigItem& parent, DWORD dwIndex, const WCH
         return hr;
     if (FAILED(hr = parent.SubItems[dwIndex].AddAttribute(L"password", CONFIG_OUTPUT_PASSWORD, ConfigItem::OPTION)))
         return hr;
+    if (FAILED(hr = parent.SubItems[dwIndex].AddAttribute(L"batchsize", CONFIG_OUTPUT_BATCHSIZE, ConfigItem::OPTION)))
+        return hr;
+    if (FAILED(
+            hr = parent.SubItems[dwIndex].AddAttribute(
+                L"rowgroupsize", CONFIG_OUTPUT_ROWGROUPSIZE, ConfigItem::OPTION)))
+        return hr;
     return S_OK;
 }
 
@@ -470,6 +476,10 @@ HRESULT Orc::Config::Common::sch_column_common(ConfigItem& item)
         return hr;
     if (FAILED(hr = item.AddAttribute(L"fmt", CONFIG_SCHEMA_COLUMN_FMT, ConfigItem::OPTION)))
         return hr;
+    if (FAILED(hr = item.AddAttribute(L"encoding", CONFIG_SCHEMA_COLUMN_ENCODING, ConfigItem::OPTION)))
+        return hr;
+    if (FAILED(hr = item.AddAttribute(L"compression", CONFIG_SCHEMA_COLUMN_COMPRESSION, ConfigItem::OPTION)))
+        return hr;
     return S_OK;
 }
 
@@ -179,6 +179,8 @@ constexpr auto CONFIG_OUTPUT_TABLE = 5U;
 constexpr auto CONFIG_OUTPUT_KEY = 6U;
 constexpr auto CONFIG_OUTPUT_DISPOSITION = 7U;
 constexpr auto CONFIG_OUTPUT_PASSWORD = 8U;
+constexpr auto CONFIG_OUTPUT_BATCHSIZE = 9U;
+constexpr auto CONFIG_OUTPUT_ROWGROUPSIZE = 10U;
 
 // UPLOAD
 constexpr auto CONFIG_UPLOAD_METHOD = 0U;
@@ -304,7 +306,9 @@ constexpr auto CONFIG_SCHEMA_COLUMN_ARTIFACT = 2U;
 constexpr auto CONFIG_SCHEMA_COLUMN_NULL = 3U;
 constexpr auto CONFIG_SCHEMA_COLUMN_NOTNULL = 4U;
 constexpr auto CONFIG_SCHEMA_COLUMN_FMT = 5U;
-constexpr auto CONFIG_SCHEMA_COLUMN_COMMON_MAX = 5U;
+constexpr auto CONFIG_SCHEMA_COLUMN_ENCODING = 6U;
+constexpr auto CONFIG_SCHEMA_COLUMN_COMPRESSION = 7U;
+constexpr auto CONFIG_SCHEMA_COLUMN_COMMON_MAX = 7U;
 
 constexpr auto CONFIG_SCHEMA_COLUMN_UTF8_MAXLEN = CONFIG_SCHEMA_COLUMN_COMMON_MAX + 1U;
 constexpr auto CONFIG_SCHEMA_COLUMN_UTF8_LEN = CONFIG_SCHEMA_COLUMN_COMMON_MAX + 2U;
@@ -20,11 +20,14 @@
 #include <sstream>
 #include <iomanip>
 
+#include <ppl.h>
+
 using namespace std;
 
 using namespace Orc;
 
 HCRYPTPROV CryptoHashStream::g_hProv = NULL;
+CryptoHashStream::Backend CryptoHashStream::g_DefaultBackend = CryptoHashStream::Backend::CryptoAPI;
 
 CryptoHashStream::~CryptoHashStream(void)
 {
@@ -39,6 +42,75 @@ CryptoHashStream::~CryptoHashStream(void)
     m_bHashIsValid = false;
 }
 
+namespace {
+
+NativeHash::Kernel GetKernel(CryptoHashStream::Backend backend)
+{
+    switch (backend)
+    {
+        case CryptoHashStream::Backend::NativeScalar:
+            return NativeHash::Kernel::Scalar;
+        case CryptoHashStream::Backend::NativeSHANI:
+            return NativeHash::Kernel::SHANI;
+        default:
+            return NativeHash::Kernel::Auto;
+    }
+}
+
+}  // namespace
+
+HRESULT CryptoHashStream::IsBackendSupported(Backend backend)
+{
+    switch (backend)
+    {
+        case Backend::CryptoAPI:
+            return S_OK;
+        case Backend::Native:
+        case Backend::NativeScalar:
+        case Backend::NativeSHANI:
+            return NativeHash::IsKernelSupported(GetKernel(backend)) ? S_OK : HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+        default:
+            return E_INVALIDARG;
+    }
+}
+
+HRESULT CryptoHashStream::SetBackend(Backend backend)
+{
+    HRESULT hr = E_FAIL;
+    if (FAILED(hr = IsBackendSupported(backend)))
+        return hr;
+
+    m_Backend = backend;
+    return S_OK;
+}
+
+HRESULT CryptoHashStream::SetDefaultBackend(Backend backend)
+{
+    HRESULT hr = E_FAIL;
+    if (FAILED(hr = IsBackendSupported(backend)))
+        return hr;
+
+    g_DefaultBackend = backend;
+    return S_OK;
+}
+
+std::optional<CryptoHashStream::Backend> CryptoHashStream::GetSupportedBackend(std::wstring_view svBackend)
+{
+    using namespace std::string_view_literals;
+
+    constexpr std::pair<std::wstring_view, Backend> backends[] = {{L"CryptoAPI"sv, Backend::CryptoAPI},
+                                                                  {L"Native"sv, Backend::Native},
+                                                                  {L"NativeScalar"sv, Backend::NativeScalar},
+                                                                  {L"NativeSHANI"sv, Backend::NativeSHANI}};
+
+    for (const auto& [name, backend] : backends)
+    {
+        if (svBackend.size() == name.size() && equalCaseInsensitive(svBackend, name, name.size()))
+            return backend;
+    }
+    return std::nullopt;
+}
+
 HRESULT CryptoHashStream::OpenToRead(Algorithm algs, const std::shared_ptr<ByteStream>& pChained)
 {
     HRESULT hr = E_FAIL;
@@ -88,9 +160,25 @@ HRESULT CryptoHashStream::ResetHash(bool bContinue)
         CryptDestroyHash(m_Sha256);
 
     m_MD5 = m_Sha1 = m_Sha256 = NULL;
+    m_NativeMD5.reset();
+    m_NativeSha1.reset();
+    m_NativeSha256.reset();
     m_bHashIsValid = false;
 
-    if (bContinue)
+    if (bContinue && m_Backend != Backend::CryptoAPI)
+    {
+        const auto kernel = GetKernel(m_Backend);
+
+        if (m_Algorithms & MD5)
+            m_NativeMD5 = NativeHash::MakeMD5(kernel);
+        if (m_Algorithms & SHA1)
+            m_NativeSha1 = NativeHash::MakeSHA1(kernel);
+        if (m_Algorithms & SHA256)
+            m_NativeSha256 = NativeHash::MakeSHA256(kernel);
+
+        m_bHashIsValid = true;
+    }
+    else if (bContinue)
     {
         if (g_hProv == NULL)
         {
@@ -123,17 +211,59 @@ HRESULT CryptoHashStream::ResetHash(bool bContinue)
 
 HRESULT CryptoHashStream::HashData(LPBYTE pBuffer, DWORD dwBytesToHash)
 {
-    if (m_bHashIsValid)
+    if (!m_bHashIsValid)
+        return S_OK;
+
+    HCRYPTHASH hashes[3];
+    NativeHash* natives[3];
+    size_t nHashes = 0;
+    for (auto hHash : {m_MD5, m_Sha1, m_Sha256})
+    {
+        if (hHash != NULL)
+        {
+            natives[nHashes] = nullptr;
+            hashes[nHashes++] = hHash;
+        }
+    }
+    for (auto pNative : {m_NativeMD5.get(), m_NativeSha1.get(), m_NativeSha256.get()})
+    {
+        if (pNative != nullptr)
+        {
+            natives[nHashes] = pNative;
+            hashes[nHashes++] = NULL;
+        }
+    }
+
+    auto Hash = [&](size_t i) -> HRESULT {
+        if (natives[i] != nullptr)
+        {
+            natives[i]->Update(pBuffer, dwBytesToHash);
+            return S_OK;
+        }
+        if (!CryptHashData(hashes[i], pBuffer, dwBytesToHash, 0))
+            return HRESULT_FROM_WIN32(GetLastError());
+        return S_OK;
+    };
+
+    if (nHashes > 1 && dwBytesToHash >= PARALLEL_HASH_THRESHOLD)
+    {
+        // hash objects are independent, each algorithm runs on its own worker
+        HRESULT results[3] = {S_OK, S_OK, S_OK};
+        Concurrency::parallel_for(size_t(0), nHashes, [&](size_t i) { results[i] = Hash(i); });
+
+        for (size_t i = 0; i < nHashes; i++)
+        {
+            if (FAILED(results[i]))
+                return results[i];
+        }
+        return S_OK;
+    }
+
+    HRESULT hr = E_FAIL;
+    for (size_t i = 0; i < nHashes; i++)
     {
-        if (m_MD5)
-            if (!CryptHashData(m_MD5, pBuffer, dwBytesToHash, 0))
-                return HRESULT_FROM_WIN32(GetLastError());
-        if (m_Sha1)
-            if (!CryptHashData(m_Sha1, pBuffer, dwBytesToHash, 0))
-                return HRESULT_FROM_WIN32(GetLastError());
-        if (m_Sha256)
-            if (!CryptHashData(m_Sha256, pBuffer, dwBytesToHash, 0))
-                return HRESULT_FROM_WIN32(GetLastError());
+        if (FAILED(hr = Hash(i)))
+            return hr;
     }
     return S_OK;
 }
@@ -143,25 +273,36 @@ HRESULT CryptoHashStream::GetHash(Algorithm alg, CBinaryBuffer& hash)
     if (m_bHashIsValid)
     {
         HCRYPTHASH hHash = NULL;
+        NativeHash* pNative = nullptr;
         DWORD cbHash = 0L;
         switch (alg)
         {
             case MD5:
                 cbHash = BYTES_IN_MD5_HASH;
                 hHash = m_MD5;
+                pNative = m_NativeMD5.get();
                 break;
             case SHA1:
                 cbHash = BYTES_IN_SHA1_HASH;
                 hHash = m_Sha1;
+                pNative = m_NativeSha1.get();
                 break;
             case SHA256:
                 cbHash = BYTES_IN_SHA256_HASH;
                 hHash = m_Sha256;
+                pNative = m_NativeSha256.get();
                 break;
             default:
                 return E_INVALIDARG;
         }
 
+        if (pNative != nullptr)
+        {
+            hash.SetCount(cbHash);
+            pNative->GetDigest(hash.GetData());
+            return S_OK;
+        }
+
         if (hHash == NULL)
         {
             hash.RemoveAll();
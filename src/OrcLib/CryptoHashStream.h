@@ -11,8 +11,11 @@
 #include "HashStream.h"
 
 #include <memory>
+#include <optional>
+#include <string_view>
 
 #include "CryptoUtilities.h"
+#include "NativeHash.h"
 
 #pragma managed(push, off)
 
@@ -56,15 +59,37 @@ public:
         return static_cast<Algorithm>(static_cast<char>(left) & static_cast<char>(rigth));
     }
 
+    // Implementation of the algorithms: the CryptoAPI provider or the in-tree ones (NativeHash)
+    enum class Backend
+    {
+        CryptoAPI,
+        Native,  // SHA extensions when the processor has them
+        NativeScalar,
+        NativeSHANI
+    };
+
+    static HRESULT IsBackendSupported(Backend backend);
 
+    // Backend of the streams created from now on (CryptoAPI unless changed, e.g. by the /HashBackend option)
+    static HRESULT SetDefaultBackend(Backend backend);
+    static Backend GetDefaultBackend() { return g_DefaultBackend; }
+
+    // CryptoAPI, Native, NativeScalar or NativeSHANI (case insensitive)
+    static std::optional<Backend> GetSupportedBackend(std::wstring_view svBackend);
 
 protected:
     Algorithm m_Algorithms;
+    Backend m_Backend = Backend::CryptoAPI;
     HCRYPTHASH m_Sha1;
     HCRYPTHASH m_Sha256;
     HCRYPTHASH m_MD5;
 
+    std::unique_ptr<NativeHash> m_NativeMD5;
+    std::unique_ptr<NativeHash> m_NativeSha1;
+    std::unique_ptr<NativeHash> m_NativeSha256;
+
     static HCRYPTPROV g_hProv;
+    static Backend g_DefaultBackend;
 
     STDMETHOD(ResetHash(bool bContinue = false));
     STDMETHOD(HashData(LPBYTE pBuffer, DWORD dwBytesToHash));
@@ -72,6 +97,7 @@ protected:
 public:
     CryptoHashStream(logger pLog)
         : HashStream(std::move(pLog))
+        , m_Backend(g_DefaultBackend)
         , m_Sha256(NULL)
         , m_Sha1(NULL)
         , m_MD5(NULL) {};
@@ -82,6 +108,10 @@ public:
 
     // CryptoHashStream Specifics
 
+    // Takes effect when the stream is opened
+    HRESULT SetBackend(Backend backend);
+    Backend GetBackend() const { return m_Backend; }
+
     virtual HRESULT OpenToRead(Algorithm algs, const std::shared_ptr<ByteStream>& pChainedStream);
     virtual HRESULT OpenToWrite(Algorithm algs, const std::shared_ptr<ByteStream>& pChainedStream);
 
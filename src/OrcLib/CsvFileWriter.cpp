@@ -19,6 +19,7 @@
 
 #include "ByteStream.h"
 #include "FileStream.h"
+#include "TableOutputBackgroundFlush.h"
 
 #include "OrcException.h"
 
@@ -26,9 +27,153 @@
 
 #include <fmt/ostream.h>
 
+#if defined(_M_IX86) || defined(_M_X64)
+#    include <immintrin.h>
+#endif
+
 using namespace Orc;
 namespace fs = std::filesystem;
 
+namespace {
+
+constexpr size_t MAX_UTF8_PER_WCHAR = 3;  // a surrogate pair (2 WCHARs) is 4 bytes
+
+// Same output as WideCharToMultiByte(CP_UTF8, 0, ...): unpaired surrogates are replaced with U+FFFD
+// ASCII runs are narrowed 16 characters at a time
+LPSTR UTF16ToUTF8(const WCHAR* pSrc, size_t cchSrc, LPSTR pOut)
+{
+    const WCHAR* pEnd = pSrc + cchSrc;
+
+    while (pSrc < pEnd)
+    {
+        const WCHAR* pBlockEnd = pSrc + std::min<size_t>(16, pEnd - pSrc);
+
+#if defined(_M_IX86) || defined(_M_X64)
+        if (pBlockEnd - pSrc == 16)
+        {
+            const __m128i low = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pSrc));
+            const __m128i high = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pSrc + 8));
+            const __m128i nonASCII =
+                _mm_and_si128(_mm_or_si128(low, high), _mm_set1_epi16(static_cast<short>(0xFF80)));
+
+            if (_mm_movemask_epi8(_mm_cmpeq_epi16(nonASCII, _mm_setzero_si128())) == 0xFFFF)
+            {
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(pOut), _mm_packus_epi16(low, high));
+                pSrc += 16;
+                pOut += 16;
+                continue;
+            }
+        }
+#endif
+
+        while (pSrc < pBlockEnd)
+        {
+            const WCHAR c = *pSrc++;
+
+            if (c < 0x80)
+            {
+                *pOut++ = static_cast<CHAR>(c);
+            }
+            else if (c < 0x800)
+            {
+                *pOut++ = static_cast<CHAR>(0xC0 | (c >> 6));
+                *pOut++ = static_cast<CHAR>(0x80 | (c & 0x3F));
+            }
+            else if (c >= 0xD800 && c <= 0xDBFF && pSrc < pEnd && *pSrc >= 0xDC00 && *pSrc <= 0xDFFF)
+            {
+                const DWORD dwCodePoint = 0x10000 + ((static_cast<DWORD>(c) - 0xD800) << 10) + (*pSrc++ - 0xDC00);
+                *pOut++ = static_cast<CHAR>(0xF0 | (dwCodePoint >> 18));
+                *pOut++ = static_cast<CHAR>(0x80 | ((dwCodePoint >> 12) & 0x3F));
+                *pOut++ = static_cast<CHAR>(0x80 | ((dwCodePoint >> 6) & 0x3F));
+                *pOut++ = static_cast<CHAR>(0x80 | (dwCodePoint & 0x3F));
+            }
+            else if (c >= 0xD800 && c <= 0xDFFF)
+            {
+                *pOut++ = static_cast<CHAR>(0xEF);
+                *pOut++ = static_cast<CHAR>(0xBF);
+                *pOut++ = static_cast<CHAR>(0xBD);
+            }
+            else
+            {
+                *pOut++ = static_cast<CHAR>(0xE0 | (c >> 12));
+                *pOut++ = static_cast<CHAR>(0x80 | ((c >> 6) & 0x3F));
+                *pOut++ = static_cast<CHAR>(0x80 | (c & 0x3F));
+            }
+        }
+    }
+    return pOut;
+}
+
+std::string ToUTF8(const std::wstring_view& str)
+{
+    std::string retval(str.size() * MAX_UTF8_PER_WCHAR, '\0');
+    retval.resize(UTF16ToUTF8(str.data(), str.size(), retval.data()) - retval.data());
+    return retval;
+}
+
+bool IsASCII(const std::string_view& str)
+{
+    size_t i = 0;
+
+#if defined(_M_IX86) || defined(_M_X64)
+    for (; i + 16 <= str.size(); i += 16)
+    {
+        if (_mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(str.data() + i))) != 0)
+            return false;
+    }
+#endif
+
+    for (; i < str.size(); i++)
+    {
+        if (static_cast<BYTE>(str[i]) >= 0x80)
+            return false;
+    }
+    return true;
+}
+
+// Doubles the quotes that EscapeQuoteInserter doubles: all but the first one and the last character
+// There must be room after pEnd for the added quotes
+LPSTR EscapeQuotes(LPSTR pStart, LPSTR pEnd)
+{
+    const LPSTR pFirst = std::find(pStart, pEnd, '"');
+    if (pEnd - pFirst < 2)
+        return pEnd;
+
+    const LPSTR pLast = pEnd - 1;
+    const auto added = std::count(pFirst + 1, pLast, '"');
+    if (added == 0)
+        return pEnd;
+
+    const LPSTR pNewEnd = pEnd + added;
+    LPSTR pOut = pNewEnd;
+    *--pOut = *pLast;
+    for (LPSTR pIn = pLast; pIn > pFirst + 1;)
+    {
+        *--pOut = *--pIn;
+        if (*pIn == '"')
+            *--pOut = '"';
+    }
+    return pNewEnd;
+}
+
+// fmt's "{:0<width>}"
+LPSTR AppendDecimal(LPSTR pOut, int value, int width)
+{
+    const fmt::format_int digits(value);
+    const char* pDigits = digits.data();
+    const char* pDigitsEnd = pDigits + digits.size();
+
+    if (value < 0)
+        *pOut++ = *pDigits++;
+
+    for (auto cchPadding = width - static_cast<int>(digits.size()); cchPadding > 0; cchPadding--)
+        *pOut++ = '0';
+
+    return std::copy(pDigits, pDigitsEnd, pOut);
+}
+
+}  // namespace
+
 class Orc::TableOutput::CSV::WriterTermination : public TerminationHandler
 {
 public:
@@ -74,6 +219,13 @@ Orc::TableOutput::CSV::Writer::MakeNew(logger pLog, std::unique_ptr<TableOutput:
     if (FAILED(retval->InitializeBuffer(retval->m_Options->dwBufferSize)))
         return nullptr;
 
+    if (retval->m_Options->dwInFlightBuffers > 0)
+    {
+        retval->m_pBackgroundFlush =
+            std::make_unique<BackgroundFlush>(retval->_L_, retval->m_Options->dwInFlightBuffers);
+        retval->m_pSpareBuffers = std::make_shared<Concurrency::concurrent_queue<LPVOID>>();
+    }
+
     std::wstring strDescr = L"Termination for CSV::Writer";
     retval->m_pTermination = std::make_shared<WriterTermination>(strDescr, retval);
     Robustness::AddTerminationHandler(retval->m_pTermination);
@@ -120,6 +272,36 @@ STDMETHODIMP Orc::TableOutput::CSV::Writer::SetSchema(const Schema& schema)
                 fmt::format(L"{}{}", bFirst ? emptyStr : m_Options->Delimiter, csv_col->Format.value_or(L"{}"));
         }
 
+        if (!csv_col->Format.has_value())
+        {
+            const auto delimiter = bFirst ? std::string() : ToUTF8(m_Options->Delimiter);
+
+            switch (csv_col->Type)
+            {
+                case ColumnType::UTF16Type:
+                case ColumnType::UTF8Type:
+                case ColumnType::XMLType:
+                    csv_col->Direct = Column::DirectFormat::Value;
+                    csv_col->PrefixUTF8 = delimiter + ToUTF8(m_Options->StringDelimiter);
+                    csv_col->SuffixUTF8 = ToUTF8(m_Options->StringDelimiter);
+                    break;
+                case ColumnType::BinaryType:
+                case ColumnType::FixedBinaryType:
+                    csv_col->Direct = Column::DirectFormat::Hex;
+                    csv_col->PrefixUTF8 = delimiter;
+                    break;
+                case ColumnType::TimeStampType:
+                    csv_col->Direct = Column::DirectFormat::TimeStamp;
+                    csv_col->PrefixUTF8 = delimiter;
+                    break;
+                default:
+                    csv_col->Direct = Column::DirectFormat::Value;
+                    csv_col->PrefixUTF8 = delimiter;
+                    break;
+            }
+            csv_col->EscapeQuotes = csv_col->FormatColumn.find(L"\"{}\"") != std::wstring::npos;
+        }
+
         m_Schema.AddColumn(std::move(csv_col));
         bFirst = false;
     }
@@ -160,29 +342,42 @@ STDMETHODIMP Orc::TableOutput::CSV::Writer::InitializeBuffer(DWORD dwBufferSize)
         dwPagesToAlloc++;
 
     DWORD dwBytesToAlloc = dwPagesToAlloc * PageSize();
-    m_pBuffer = (WCHAR*)VirtualAlloc(NULL, dwBytesToAlloc, MEM_COMMIT, PAGE_READWRITE);
-    if (m_pBuffer == NULL)
-        return HRESULT_FROM_WIN32(GetLastError());
 
-    m_pCurrent = m_pBuffer;
     m_dwCount = 0;
     m_dwBufferSize = dwBytesToAlloc;
 
     switch (m_Options->Encoding)
     {
         case OutputSpec::Encoding::UTF8:
-            m_pUTF8Buffer = (LPSTR)VirtualAlloc(NULL, dwBytesToAlloc, MEM_COMMIT, PAGE_READWRITE);
-            if (m_pUTF8Buffer == NULL)
-                return HRESULT_FROM_WIN32(GetLastError());
+            // values are formatted straight to UTF-8, there is no UTF-16 staging buffer
+            if (auto hr = AllocateBuffer((LPVOID&)m_pUTF8Buffer); FAILED(hr))
+                return hr;
             m_dwUTF8BufferSize = dwBytesToAlloc;
+            m_pCurrentUTF8 = m_pUTF8Buffer;
+
+            m_strDelimiterUTF8 = ToUTF8(m_Options->Delimiter);
+            m_strEndOfLineUTF8 = ToUTF8(m_Options->EndOfLine);
             break;
         default:
+            if (auto hr = AllocateBuffer((LPVOID&)m_pBuffer); FAILED(hr))
+                return hr;
+            m_pCurrent = m_pBuffer;
             break;
     }
 
     return S_OK;
 }
 
+HRESULT Orc::TableOutput::CSV::Writer::AllocateBuffer(LPVOID& pBuffer)
+{
+    pBuffer = VirtualAlloc(NULL, m_dwBufferSize, MEM_COMMIT, PAGE_READWRITE);
+    if (pBuffer == NULL)
+        return HRESULT_FROM_WIN32(GetLastError());
+
+    m_Buffers.push_back(pBuffer);
+    return S_OK;
+}
+
 STDMETHODIMP Orc::TableOutput::CSV::Writer::WriteBOM()
 {
     if (m_pByteStream == nullptr)
@@ -242,6 +437,13 @@ HRESULT Orc::TableOutput::CSV::Writer::WriteToFile(const WCHAR* szFileName)
 
 STDMETHODIMP Orc::TableOutput::CSV::Writer::WriteToStream(const std::shared_ptr<ByteStream>& pStream, bool bCloseStream)
 {
+    if (m_pBackgroundFlush)
+    {
+        // pending writes go to the previous stream
+        if (auto hr = m_pBackgroundFlush->Wait(); FAILED(hr))
+            return hr;
+    }
+
     if (m_pByteStream != nullptr && m_bCloseStream)
     {
         m_pByteStream->Close();
@@ -265,19 +467,29 @@ STDMETHODIMP Orc::TableOutput::CSV::Writer::Flush()
 {
     ScopedLock sl(m_cs);
 
+    HRESULT hr = FlushBuffer();
+
+    if (m_pBackgroundFlush)
+    {
+        // even when the buffer could not be posted, the writes already posted must complete
+        if (auto hrWait = m_pBackgroundFlush->Wait(); SUCCEEDED(hr))
+            hr = hrWait;
+    }
+    return hr;
+}
+
+HRESULT Orc::TableOutput::CSV::Writer::FlushBuffer()
+{
+    ScopedLock sl(m_cs);
+
     LPBYTE pBuffer = NULL;
     DWORD dwBytesToWrite = 0L;
 
     switch (m_Options->Encoding)
     {
         case OutputSpec::Encoding::UTF8:
-            dwBytesToWrite = WideCharToMultiByte(
-                CP_UTF8, 0L, m_pBuffer, (m_dwCount / sizeof(WCHAR)), m_pUTF8Buffer, m_dwUTF8BufferSize, NULL, NULL);
-            if (!dwBytesToWrite)
-            {
-                return HRESULT_FROM_WIN32(GetLastError());
-            }
             pBuffer = (LPBYTE)m_pUTF8Buffer;
+            dwBytesToWrite = m_dwCount;
             break;
         case OutputSpec::Encoding::UTF16:
             pBuffer = (LPBYTE)m_pBuffer;
@@ -287,7 +499,39 @@ STDMETHODIMP Orc::TableOutput::CSV::Writer::Flush()
             return E_INVALIDARG;
     }
 
-    if (m_pByteStream)
+    if (m_pByteStream && m_pBackgroundFlush)
+    {
+        if (dwBytesToWrite == 0L)
+            return S_OK;
+
+        auto write = [pStream = m_pByteStream, pSpareBuffers = m_pSpareBuffers, pBuffer, dwBytesToWrite]() {
+            ULONGLONG ullBytesWritten = 0LL;
+            HRESULT hr = pStream->Write(pBuffer, dwBytesToWrite, &ullBytesWritten);
+
+            if (SUCCEEDED(hr) && ullBytesWritten < dwBytesToWrite)
+                hr = HRESULT_FROM_WIN32(ERROR_WRITE_FAULT);
+
+            pSpareBuffers->push(pBuffer);
+            return hr;
+        };
+
+        if (auto hr = m_pBackgroundFlush->Post(std::move(write)); FAILED(hr))
+            return hr;
+
+        // the posted buffer belongs to the background writer until it is back in the spare buffers
+        LPVOID pNext = nullptr;
+        if (!m_pSpareBuffers->try_pop(pNext))
+        {
+            if (auto hr = AllocateBuffer(pNext); FAILED(hr))
+                return hr;
+        }
+
+        if (m_pUTF8Buffer != nullptr)
+            m_pUTF8Buffer = (LPSTR)pNext;
+        if (m_pBuffer != nullptr)
+            m_pBuffer = (LPWSTR)pNext;
+    }
+    else if (m_pByteStream)
     {
         ULONGLONG ullBytesWritten;
         if (auto hr = m_pByteStream->Write((LPBYTE)pBuffer, dwBytesToWrite, &ullBytesWritten); FAILED(hr))
@@ -299,12 +543,16 @@ STDMETHODIMP Orc::TableOutput::CSV::Writer::Flush()
         }
     }
 
-    DWORD dwOldProtect = 0L;
     if (m_pCurrent != nullptr && m_pBuffer != nullptr)
     {
         m_pCurrent = m_pBuffer;
         m_dwCount = 0;
     }
+    if (m_pCurrentUTF8 != nullptr && m_pUTF8Buffer != nullptr)
+    {
+        m_pCurrentUTF8 = m_pUTF8Buffer;
+        m_dwCount = 0;
+    }
     return S_OK;
 }
 
@@ -312,26 +560,35 @@ STDMETHODIMP Orc::TableOutput::CSV::Writer::Close()
 {
     ScopedLock sl(m_cs);
 
+    HRESULT hr = S_OK;
+
     if (m_pTermination)
     {
         Robustness::RemoveTerminationHandler(m_pTermination);
         m_pTermination = nullptr;
     }
-    if (m_pCurrent)
+    if (m_pCurrent || m_pCurrentUTF8)
     {
-        Flush();
+        // also waits for the background writes, their failure is reported here
+        if (FAILED(hr = Flush()))
+            log::Error(_L_, hr, L"Failed to flush CSV output\r\n");
         m_pCurrent = NULL;
+        m_pCurrentUTF8 = NULL;
     }
     if (m_pByteStream != nullptr && m_bCloseStream)
     {
         m_pByteStream->Close();
     }
-    if (m_pBuffer)
+    for (auto pBuffer : m_Buffers)
     {
-        VirtualFree(m_pBuffer, 0, MEM_RELEASE);
-        m_pBuffer = NULL;
+        VirtualFree(pBuffer, 0, MEM_RELEASE);
     }
-    return S_OK;
+    m_Buffers.clear();
+    m_pBuffer = NULL;
+    m_pUTF8Buffer = NULL;
+    if (m_pSpareBuffers)
+        m_pSpareBuffers->clear();
+    return hr;
 }
 
 HRESULT Orc::TableOutput::CSV::Writer::AddColumnAndCheckNumbers()
@@ -350,6 +607,149 @@ HRESULT Orc::TableOutput::CSV::Writer::AddColumnAndCheckNumbers()
     return S_OK;
 }
 
+template <typename FillFn>
+HRESULT Orc::TableOutput::CSV::Writer::AppendUTF8(size_t cbMax, FillFn fill)
+{
+    if (cbMax > m_dwUTF8BufferSize)
+    {
+        // larger than the whole buffer
+        std::string str(cbMax, '\0');
+        str.resize(fill(str.data()) - str.data());
+        return AppendUTF8(str);
+    }
+
+    if (m_dwCount + cbMax > m_dwUTF8BufferSize)
+    {
+        if (auto hr = FlushBuffer(); FAILED(hr))
+            return hr;
+    }
+
+    const LPSTR pEnd = fill(m_pCurrentUTF8);
+    m_dwCount += static_cast<DWORD>(pEnd - m_pCurrentUTF8);
+    m_pCurrentUTF8 = pEnd;
+    return S_OK;
+}
+
+HRESULT Orc::TableOutput::CSV::Writer::AppendUTF8(const std::string_view& str)
+{
+    for (size_t cbDone = 0; cbDone < str.size();)
+    {
+        if (m_dwCount == m_dwUTF8BufferSize)
+        {
+            if (auto hr = FlushBuffer(); FAILED(hr))
+                return hr;
+        }
+
+        const size_t cbCopy = std::min<size_t>(str.size() - cbDone, m_dwUTF8BufferSize - m_dwCount);
+        m_pCurrentUTF8 = std::copy_n(str.data() + cbDone, cbCopy, m_pCurrentUTF8);
+        m_dwCount += static_cast<DWORD>(cbCopy);
+        cbDone += cbCopy;
+    }
+    return S_OK;
+}
+
+HRESULT Orc::TableOutput::CSV::Writer::AppendUTF16(const std::wstring_view& str)
+{
+    return AppendUTF8(
+        str.size() * MAX_UTF8_PER_WCHAR, [&str](LPSTR pOut) { return UTF16ToUTF8(str.data(), str.size(), pOut); });
+}
+
+HRESULT Orc::TableOutput::CSV::Writer::WriteUTF8(const Column& column, const std::wstring_view& value)
+{
+    size_t cbMax = column.PrefixUTF8.size() + value.size() * MAX_UTF8_PER_WCHAR + column.SuffixUTF8.size();
+    if (column.EscapeQuotes)
+        cbMax *= 2;
+
+    return AppendUTF8(cbMax, [&column, &value](LPSTR pStart) {
+        LPSTR pOut = std::copy(column.PrefixUTF8.begin(), column.PrefixUTF8.end(), pStart);
+        pOut = UTF16ToUTF8(value.data(), value.size(), pOut);
+        pOut = std::copy(column.SuffixUTF8.begin(), column.SuffixUTF8.end(), pOut);
+        return column.EscapeQuotes ? EscapeQuotes(pStart, pOut) : pOut;
+    });
+}
+
+HRESULT Orc::TableOutput::CSV::Writer::WriteUTF8(const Column& column, const std::string_view& value)
+{
+    size_t cbMax = column.PrefixUTF8.size() + value.size() + column.SuffixUTF8.size();
+    if (column.EscapeQuotes)
+        cbMax *= 2;
+
+    return AppendUTF8(cbMax, [&column, &value](LPSTR pStart) {
+        LPSTR pOut = std::copy(column.PrefixUTF8.begin(), column.PrefixUTF8.end(), pStart);
+        pOut = std::copy(value.begin(), value.end(), pOut);
+        pOut = std::copy(column.SuffixUTF8.begin(), column.SuffixUTF8.end(), pOut);
+        return column.EscapeQuotes ? EscapeQuotes(pStart, pOut) : pOut;
+    });
+}
+
+HRESULT Orc::TableOutput::CSV::Writer::WriteHexUTF8(const Column& column, const BYTE pBytes[], DWORD dwLen)
+{
+    static const char hex[] = "0123456789ABCDEF";
+
+    return AppendUTF8(column.PrefixUTF8.size() + dwLen * 2, [&column, pBytes, dwLen](LPSTR pStart) {
+        LPSTR pOut = std::copy(column.PrefixUTF8.begin(), column.PrefixUTF8.end(), pStart);
+        for (DWORD i = 0; i < dwLen; i++)
+        {
+            *pOut++ = hex[pBytes[i] >> 4];
+            *pOut++ = hex[pBytes[i] & 0x0F];
+        }
+        return pOut;
+    });
+}
+
+HRESULT Orc::TableOutput::CSV::Writer::WriteTimeStampUTF8(
+    const Column& column,
+    int year,
+    int month,
+    int day,
+    int hour,
+    int minute,
+    int second,
+    int millisecond)
+{
+    // each field is at most 11 characters
+    return AppendUTF8(column.PrefixUTF8.size() + 7 * 12, [&](LPSTR pStart) {
+        LPSTR pOut = std::copy(column.PrefixUTF8.begin(), column.PrefixUTF8.end(), pStart);
+        pOut = AppendDecimal(pOut, year, 4);
+        *pOut++ = '-';
+        pOut = AppendDecimal(pOut, month, 2);
+        *pOut++ = '-';
+        pOut = AppendDecimal(pOut, day, 2);
+        *pOut++ = ' ';
+        pOut = AppendDecimal(pOut, hour, 2);
+        *pOut++ = ':';
+        pOut = AppendDecimal(pOut, minute, 2);
+        *pOut++ = ':';
+        pOut = AppendDecimal(pOut, second, 2);
+        *pOut++ = '.';
+        return AppendDecimal(pOut, millisecond, 3);
+    });
+}
+
+HRESULT Orc::TableOutput::CSV::Writer::WriteAnsiColumn(const std::string_view& str)
+{
+    auto pCol = static_cast<const Column*>(&m_Schema[m_dwColumnCounter]);
+
+    if (m_pCurrentUTF8 != nullptr && pCol->Direct == Column::DirectFormat::Value && IsASCII(str))
+    {
+        if (auto hr = WriteUTF8(*pCol, str); FAILED(hr))
+        {
+            AbandonColumn();
+            return hr;
+        }
+        AddColumnAndCheckNumbers();
+        return S_OK;
+    }
+
+    auto [hr, wstr] = AnsiToWide(_L_, str);
+    if (FAILED(hr))
+    {
+        AbandonColumn();
+        return hr;
+    }
+    return WriteColumn(wstr);
+}
+
 STDMETHODIMP Orc::TableOutput::CSV::Writer::WriteHeaders(const TableOutput::Schema& columns)
 {
     bool bFirst = true;
@@ -384,13 +784,28 @@ STDMETHODIMP Orc::TableOutput::CSV::Writer::WriteNothing()
 {
     if (m_dwColumnCounter > 0)  // First column does not need the ",", second column will be prepended with it
     {
-        if (auto hr = FormatToBuffer(m_Options->Delimiter); FAILED(hr))
+        if (m_pCurrentUTF8 != nullptr)
+        {
+            if (auto hr = AppendUTF8(m_strDelimiterUTF8); FAILED(hr))
+                return hr;
+        }
+        else if (auto hr = FormatToBuffer(m_Options->Delimiter); FAILED(hr))
             return hr;
     }
     AddColumnAndCheckNumbers();
     return S_OK;
 }
 
+STDMETHODIMP Orc::TableOutput::CSV::Writer::WriteString(const std::string_view& strString)
+{
+    if (strString.empty())
+    {
+        return WriteNothing();
+    }
+
+    return WriteAnsiColumn(strString);
+}
+
 STDMETHODIMP
 Orc::TableOutput::CSV::Writer::WriteFormated_(const std::wstring_view& szFormat, IOutput::wformat_args args)
 {
@@ -417,21 +832,7 @@ STDMETHODIMP Orc::TableOutput::CSV::Writer::WriteFormated_(const std::string_vie
 
     std::string_view result_string((LPCSTR)buffer, buffer.size());
 
-    if (auto [hr, wstr] = AnsiToWide(_L_, result_string); SUCCEEDED(hr))
-    {
-        if (auto hr = FormatColumn(wstr); FAILED(hr))
-        {
-            AbandonColumn();
-            return hr;
-        }
-        AddColumnAndCheckNumbers();
-    }
-    else
-    {
-        AbandonColumn();
-        return hr;
-    }
-    return S_OK;
+    return WriteAnsiColumn(result_string);
 }
 
 STDMETHODIMP Orc::TableOutput::CSV::Writer::WriteAttributes(DWORD dwFileAttributes)
@@ -465,6 +866,27 @@ HRESULT Orc::TableOutput::CSV::Writer::WriteFileTime(FILETIME fileTime)
     SYSTEMTIME stUTC;
     FileTimeToSystemTime(&fileTime, &stUTC);
 
+    auto pCol = static_cast<const Column*>(&m_Schema[m_dwColumnCounter]);
+    if (m_pCurrentUTF8 != nullptr && pCol->Direct == Column::DirectFormat::TimeStamp)
+    {
+        if (auto hr = WriteTimeStampUTF8(
+                *pCol,
+                stUTC.wYear,
+                stUTC.wMonth,
+                stUTC.wDay,
+                stUTC.wHour,
+                stUTC.wMinute,
+                stUTC.wSecond,
+                stUTC.wMilliseconds);
+            FAILED(hr))
+        {
+            AbandonColumn();
+            return hr;
+        }
+        AddColumnAndCheckNumbers();
+        return S_OK;
+    }
+
     if (auto hr = FormatColumn(
             fmt::arg(L"YYYY", stUTC.wYear),
             fmt::arg(L"MM", stUTC.wMonth),
@@ -502,6 +924,27 @@ STDMETHODIMP Orc::TableOutput::CSV::Writer::WriteTimeStamp(time_t time)
 
 STDMETHODIMP Orc::TableOutput::CSV::Writer::WriteTimeStamp(tm tmStamp)
 {
+    auto pCol = static_cast<const Column*>(&m_Schema[m_dwColumnCounter]);
+    if (m_pCurrentUTF8 != nullptr && pCol->Direct == Column::DirectFormat::TimeStamp)
+    {
+        if (auto hr = WriteTimeStampUTF8(
+                *pCol,
+                tmStamp.tm_year + 1900,
+                tmStamp.tm_mon + 1,
+                tmStamp.tm_mday,
+                tmStamp.tm_hour,
+                tmStamp.tm_min,
+                tmStamp.tm_sec,
+                0);
+            FAILED(hr))
+        {
+            AbandonColumn();
+            return hr;
+        }
+        AddColumnAndCheckNumbers();
+        return S_OK;
+    }
+
     if (auto hr = FormatColumn(
             fmt::arg(L"YYYY", tmStamp.tm_year + 1900),
             fmt::arg(L"MM", tmStamp.tm_mon + 1),
@@ -554,7 +997,12 @@ STDMETHODIMP Orc::TableOutput::CSV::Writer::AbandonColumn()
 
 HRESULT Orc::TableOutput::CSV::Writer::WriteEndOfLine()
 {
-    if (auto hr = FormatToBuffer(m_Options->EndOfLine); FAILED(hr))
+    if (m_pCurrentUTF8 != nullptr)
+    {
+        if (auto hr = AppendUTF8(m_strEndOfLineUTF8); FAILED(hr))
+            return hr;
+    }
+    else if (auto hr = FormatToBuffer(m_Options->EndOfLine); FAILED(hr))
         return hr;
 
     auto counter = m_dwColumnCounter;
@@ -920,6 +1368,18 @@ STDMETHODIMP Orc::TableOutput::CSV::Writer::WriteXML(const CHAR* szString, DWORD
 
 STDMETHODIMP Orc::TableOutput::CSV::Writer::WriteBytes(const BYTE pBytes[], DWORD dwLen)
 {
+    auto pCol = static_cast<const Column*>(&m_Schema[m_dwColumnCounter]);
+    if (m_pCurrentUTF8 != nullptr && pCol->Direct == Column::DirectFormat::Hex)
+    {
+        if (auto hr = WriteHexUTF8(*pCol, pBytes, dwLen); FAILED(hr))
+        {
+            AbandonColumn();
+            return hr;
+        }
+        AddColumnAndCheckNumbers();
+        return S_OK;
+    }
+
     Buffer<BYTE> buffer;
 
     buffer.view_of((BYTE*)pBytes, dwLen, dwLen);
@@ -11,11 +11,14 @@
 #include "OrcLib.h"
 
 #include "TableOutputWriter.h"
+#include "TableOutputBackgroundFlush.h"
 
 #include "OutputSpec.h"
 #include "WideAnsi.h"
 #include "CriticalSection.h"
 
+#include <concurrent_queue.h>
+
 #pragma managed(push, off)
 
 namespace Orc::TableOutput::CSV {
@@ -29,6 +32,19 @@ public:
         : ::Orc::TableOutput::Column(base) {};
     std::wstring FormatColumn;
 
+    // Columns without a custom format are written straight into the UTF-8 buffer (without fmt nor UTF-16 staging)
+    enum class DirectFormat
+    {
+        None,  // formatted with FormatColumn
+        Value,  // "{}"
+        Hex,  // "{:02X}" for each byte
+        TimeStamp  // "YYYY-MM-DD hh:mm:ss.mmm"
+    };
+    DirectFormat Direct = DirectFormat::None;
+    bool EscapeQuotes = false;  // FormatColumn contains "{}", see EscapeQuoteInserter
+    std::string PrefixUTF8;  // delimiter and string delimiter before the value
+    std::string SuffixUTF8;  // string delimiter after the value
+
     virtual ~Column() override final {};
 };
 
@@ -53,6 +69,9 @@ public:
         std::swap(m_Options, other.m_Options);
         std::swap(m_pUTF8Buffer, other.m_pUTF8Buffer);
         std::swap(m_dwUTF8BufferSize, other.m_dwUTF8BufferSize);
+        std::swap(m_pCurrentUTF8, other.m_pCurrentUTF8);
+        std::swap(m_strDelimiterUTF8, other.m_strDelimiterUTF8);
+        std::swap(m_strEndOfLineUTF8, other.m_strEndOfLineUTF8);
         std::swap(m_bBOMWritten, other.m_bBOMWritten);
         std::swap(m_pByteStream, other.m_pByteStream);
         std::swap(m_bCloseStream, other.m_bCloseStream);
@@ -61,6 +80,9 @@ public:
         std::swap(m_dwCount, other.m_dwCount);
         std::swap(m_dwColumnNumber, other.m_dwColumnNumber);
         std::swap(m_dwPageSize, other.m_dwPageSize);
+        std::swap(m_pBackgroundFlush, other.m_pBackgroundFlush);
+        std::swap(m_Buffers, other.m_Buffers);
+        std::swap(m_pSpareBuffers, other.m_pSpareBuffers);
     }
 
     std::shared_ptr<ByteStream> GetStream() const { return m_pByteStream; };
@@ -93,34 +115,9 @@ public:
 
     STDMETHOD(WriteString)(const std::string& strString) override final
     {
-        if (strString.empty())
-        {
-            return WriteNothing();
-        }
-
-        auto [hr, wstr] = AnsiToWide(_L_, strString);
-        if (FAILED(hr))
-        {
-            return hr;
-        }
-
-        return WriteColumn(wstr);
-    }
-    STDMETHOD(WriteString)(const std::string_view& strString) override final
-    {
-        if (strString.empty())
-        {
-            return WriteNothing();
-        }
-
-        auto [hr, wstr] = AnsiToWide(_L_, strString);
-        if (FAILED(hr))
-        {
-            return hr;
-        }
-
-        return WriteColumn(wstr);
+        return WriteString(std::string_view(strString));
     }
+    STDMETHOD(WriteString)(const std::string_view& strString) override final;
 
     STDMETHOD(WriteString)(const CHAR* szString) override final
     {
@@ -221,6 +218,10 @@ private:
 
     LPSTR m_pUTF8Buffer = nullptr;
     DWORD m_dwUTF8BufferSize = 0L;  // in CHARs
+    LPSTR m_pCurrentUTF8 = nullptr;  // UTF-8 output is staged in m_pUTF8Buffer, m_pBuffer is not allocated
+
+    std::string m_strDelimiterUTF8;
+    std::string m_strEndOfLineUTF8;
 
     bool m_bBOMWritten = false;
     std::shared_ptr<ByteStream> m_pByteStream = nullptr;
@@ -235,6 +236,11 @@ private:
 
     std::unique_ptr<Options> m_Options;
 
+    // With Options::dwInFlightBuffers, a full buffer is handed to m_pBackgroundFlush and swapped with a spare one
+    std::unique_ptr<BackgroundFlush> m_pBackgroundFlush;
+    std::vector<LPVOID> m_Buffers;  // every allocated buffer, the current one included
+    std::shared_ptr<Concurrency::concurrent_queue<LPVOID>> m_pSpareBuffers;
+
     // Taille d'une page (en octets)
     DWORD m_dwPageSize = 0L;
     DWORD PageSize()
@@ -294,20 +300,9 @@ private:
         size_t quoteCount;
     };
 
-    template <typename... Args>
-    HRESULT FormatToBuffer(const std::wstring_view& strFormat, Args&&... args)
+    template <typename Output, typename... Args>
+    HRESULT FormatTo(Output& buffer, const std::wstring_view& strFormat, Args&&... args)
     {
-        using char_type = WCHAR;
-        using buffer_type = Buffer<char_type>;
-        using wformat_iterator = std::back_insert_iterator<buffer_type>;
-        using wformat_args = fmt::format_args_t<wformat_iterator, char_type>;
-        using context = fmt::basic_format_context<wformat_iterator, char_type>;
-
-        DWORD remaining = (m_dwBufferSize - m_dwCount) / sizeof(char_type);
-
-        buffer_type buffer;
-        buffer.view_of(m_pCurrent, remaining);
-
         try
         {
             if (strFormat.find(L"\"{}\"") != std::wstring::npos)
@@ -318,20 +313,6 @@ private:
             {
                 fmt::format_to(std::back_inserter(buffer), strFormat, args...);
             }
-
-            if (!buffer.is_view())
-            {
-                // if buffer is no longer a non owning view on the reserved data, we need to flush
-                if (auto hr = Flush(); FAILED(hr))
-                    return hr;
-
-                buffer_type new_buffer;
-                new_buffer.view_of(m_pCurrent, (m_dwBufferSize - m_dwCount) / sizeof(char_type));
-                new_buffer.append(buffer);
-                std::swap(buffer, new_buffer);
-            }
-            m_dwCount += buffer.size() * sizeof(char_type);
-            m_pCurrent += buffer.size();
         }
         catch (const fmt::format_error& error)
         {
@@ -348,22 +329,87 @@ private:
         return S_OK;
     }
 
+    template <typename... Args>
+    HRESULT FormatToBuffer(const std::wstring_view& strFormat, Args&&... args)
+    {
+        using char_type = WCHAR;
+        using buffer_type = Buffer<char_type>;
+
+        if (m_pCurrentUTF8 != nullptr)
+        {
+            Buffer<char_type, MAX_PATH> buffer;
+            if (auto hr = FormatTo(buffer, strFormat, std::forward<Args>(args)...); FAILED(hr))
+                return hr;
+
+            return AppendUTF16(std::wstring_view(buffer.get(), buffer.size()));
+        }
+
+        DWORD remaining = (m_dwBufferSize - m_dwCount) / sizeof(char_type);
+
+        buffer_type buffer;
+        buffer.view_of(m_pCurrent, remaining);
+
+        if (auto hr = FormatTo(buffer, strFormat, std::forward<Args>(args)...); FAILED(hr))
+            return hr;
+
+        if (!buffer.is_view())
+        {
+            // if buffer is no longer a non owning view on the reserved data, we need to flush
+            if (auto hr = FlushBuffer(); FAILED(hr))
+                return hr;
+
+            buffer_type new_buffer;
+            new_buffer.view_of(m_pCurrent, (m_dwBufferSize - m_dwCount) / sizeof(char_type));
+            new_buffer.append(buffer);
+            std::swap(buffer, new_buffer);
+        }
+        m_dwCount += buffer.size() * sizeof(char_type);
+        m_pCurrent += buffer.size();
+        return S_OK;
+    }
+
+    // Values written without fmt: integers, characters and strings
+    template <typename T>
+    static constexpr bool IsDirectValue = std::is_same_v<T, WCHAR> || std::is_convertible_v<const T&, std::wstring_view>
+        || (std::is_integral_v<T> && sizeof(T) >= sizeof(DWORD));
+
+    template <typename T>
+    HRESULT WriteDirect(const Column& column, const T& value)
+    {
+        if constexpr (std::is_same_v<T, WCHAR>)
+        {
+            return WriteUTF8(column, std::wstring_view(&value, 1));
+        }
+        else if constexpr (std::is_integral_v<T>)
+        {
+            const fmt::format_int digits(value);
+            return WriteUTF8(column, std::string_view(digits.data(), digits.size()));
+        }
+        else
+        {
+            return WriteUTF8(column, std::wstring_view(value));
+        }
+    }
+
     template <typename... Args>
     HRESULT FormatColumn(Args&&... args)
     {
 
         auto pCol = static_cast<const Column*>(&m_Schema[m_dwColumnCounter]);
 
+        if constexpr (sizeof...(Args) == 1 && (IsDirectValue<std::decay_t<Args>> && ...))
+        {
+            if (m_pCurrentUTF8 != nullptr && pCol->Direct == Column::DirectFormat::Value)
+                return WriteDirect(*pCol, std::forward<Args>(args)...);
+        }
+
         return FormatToBuffer(pCol->FormatColumn, std::forward<Args>(args)...);
     }
 
     template <typename... Args>
     HRESULT WriteColumn(Args&&... args)
     {
-
-        auto pCol = static_cast<const Column*>(&m_Schema[m_dwColumnCounter]);
-
-        if (auto hr = FormatToBuffer(pCol->FormatColumn, std::forward<Args>(args)...); FAILED(hr))
+        if (auto hr = FormatColumn(std::forward<Args>(args)...); FAILED(hr))
         {
             AbandonColumn();
             return hr;
@@ -374,9 +420,35 @@ private:
 
     HRESULT AddColumnAndCheckNumbers();
 
+    // UTF-8 (or ANSI) value, converted to UTF-16 unless it is ASCII and written directly
+    HRESULT WriteAnsiColumn(const std::string_view& str);
+
     STDMETHOD(InitializeBuffer)(DWORD dwBufferSize);
+    HRESULT AllocateBuffer(LPVOID& pBuffer);
+
+    // Writes the current buffer, or hands it to the background writer, and starts a new one
+    HRESULT FlushBuffer();
 
     STDMETHOD(WriteBOM)();
+
+    // UTF-8 staging, the column's prefix and suffix surround the value
+    template <typename FillFn>
+    HRESULT AppendUTF8(size_t cbMax, FillFn fill);
+    HRESULT AppendUTF8(const std::string_view& str);
+    HRESULT AppendUTF16(const std::wstring_view& str);
+
+    HRESULT WriteUTF8(const Column& column, const std::wstring_view& value);
+    HRESULT WriteUTF8(const Column& column, const std::string_view& value);  // value is ASCII
+    HRESULT WriteHexUTF8(const Column& column, const BYTE pBytes[], DWORD dwLen);
+    HRESULT WriteTimeStampUTF8(
+        const Column& column,
+        int year,
+        int month,
+        int day,
+        int hour,
+        int minute,
+        int second,
+        int millisecond);
 };
 }  // namespace Orc::TableOutput::CSV
 
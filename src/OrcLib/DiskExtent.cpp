@@ -51,6 +51,10 @@ CDiskExtent::CDiskExtent(CDiskExtent&& Other) noexcept
     std::swap(_L_, Other._L_);
     m_hFile = Other.m_hFile;
     Other.m_hFile = INVALID_HANDLE_VALUE;
+    m_hPositional = Other.m_hPositional;
+    Other.m_hPositional = NULL;
+    std::swap(m_Events, Other.m_Events);
+    m_dwFlags = Other.m_dwFlags;
     m_Length = Other.m_Length;
     Other.m_Length = 0;
     m_LogicalSectorSize = Other.m_LogicalSectorSize;
@@ -67,6 +71,7 @@ CDiskExtent::CDiskExtent(const CDiskExtent& Other) noexcept
     , m_Name(Other.m_Name)
 {
     m_hFile = INVALID_HANDLE_VALUE;
+    m_dwFlags = Other.m_dwFlags;
     m_Length = Other.m_Length;
     m_LogicalSectorSize = Other.m_LogicalSectorSize;
     m_PhysicalSectorSize = Other.m_PhysicalSectorSize;
@@ -78,6 +83,8 @@ CDiskExtent& CDiskExtent::operator=(const CDiskExtent& other)
 {
     _L_ = other._L_;
     m_hFile = INVALID_HANDLE_VALUE;
+    m_hPositional = NULL;
+    m_dwFlags = other.m_dwFlags;
     m_Length = other.m_Length;
     m_liCurrentPos.QuadPart = 0LL;
     m_LogicalSectorSize = other.m_LogicalSectorSize;
@@ -118,6 +125,7 @@ HRESULT CDiskExtent::Open(DWORD dwShareMode, DWORD dwCreationDisposition, DWORD
     }
 
     m_hFile = CreateFile(m_Name.c_str(), GENERIC_READ, dwShareMode, NULL, dwCreationDisposition, dwFlags, NULL);
+    m_dwFlags = dwFlags;
 
     if (INVALID_HANDLE_VALUE == m_hFile)
     {
@@ -227,6 +235,111 @@ HRESULT CDiskExtent::Seek(LARGE_INTEGER liDistanceToMove, PLARGE_INTEGER pliNewF
     return S_OK;
 }
 
+HANDLE CDiskExtent::GetPositionalHandle()
+{
+    HANDLE hPositional = m_hPositional;
+    if (hPositional != NULL)
+        return hPositional;
+
+    // A handle of its own opened for overlapped I/O: reads neither share a file pointer nor wait for each other
+    const auto k32 = ExtensionLibrary::GetLibrary<Kernel32Extension>(_L_, true);
+    if (k32 != nullptr)
+    {
+        hPositional = k32->ReOpenFile(
+            m_hFile,
+            GENERIC_READ,
+            FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+            (m_dwFlags & ~FILE_FLAG_SEQUENTIAL_SCAN) | FILE_FLAG_OVERLAPPED);
+    }
+    else
+    {
+        hPositional = INVALID_HANDLE_VALUE;
+    }
+
+    if (hPositional == INVALID_HANDLE_VALUE)
+        log::Verbose(_L_, L"Positional reads on %s use the extent's synchronous handle\r\n", m_Name.c_str());
+
+    HANDLE hOpened = InterlockedCompareExchangePointer(&m_hPositional, hPositional, NULL);
+    if (hOpened != NULL)
+    {
+        // another thread was first
+        if (hPositional != INVALID_HANDLE_VALUE)
+            CloseHandle(hPositional);
+        return hOpened;
+    }
+    return hPositional;
+}
+
+HANDLE CDiskExtent::AcquireEvent()
+{
+    {
+        concurrency::critical_section::scoped_lock sl(m_EventsLock);
+        if (!m_Events.empty())
+        {
+            HANDLE hEvent = m_Events.back();
+            m_Events.pop_back();
+            return hEvent;
+        }
+    }
+    // ReadFile resets the event when the read starts, a manual reset event is enough
+    return CreateEvent(NULL, TRUE, FALSE, NULL);
+}
+
+void CDiskExtent::ReleaseEvent(HANDLE hEvent)
+{
+    concurrency::critical_section::scoped_lock sl(m_EventsLock);
+    m_Events.push_back(hEvent);
+}
+
+HRESULT CDiskExtent::ReadAt(ULONGLONG ullOffset, __out_bcount(dwCount) PVOID lpBuf, DWORD dwCount, PDWORD pdwBytesRead)
+{
+    _ASSERT(INVALID_HANDLE_VALUE != m_hFile);
+    _ASSERT(pdwBytesRead != nullptr);
+
+    *pdwBytesRead = 0;
+
+    OVERLAPPED overlapped;
+    ZeroMemory(&overlapped, sizeof(OVERLAPPED));
+
+    ULARGE_INTEGER uliPosition;
+    uliPosition.QuadPart = m_Start + ullOffset;
+    overlapped.Offset = uliPosition.LowPart;
+    overlapped.OffsetHigh = uliPosition.HighPart;
+
+    DWORD dwBytesRead = 0;
+    DWORD dwLastError = ERROR_SUCCESS;
+
+    // a read on the synchronous handle would move the file pointer Seek relies upon
+    HANDLE hPositional = GetPositionalHandle();
+    if (hPositional == INVALID_HANDLE_VALUE)
+        return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+
+    overlapped.hEvent = AcquireEvent();
+    if (overlapped.hEvent == NULL)
+        return HRESULT_FROM_WIN32(GetLastError());
+
+    if (!ReadFile(hPositional, lpBuf, dwCount, NULL, &overlapped) && GetLastError() != ERROR_IO_PENDING)
+        dwLastError = GetLastError();
+    else if (!GetOverlappedResult(hPositional, &overlapped, &dwBytesRead, TRUE))
+        dwLastError = GetLastError();
+
+    ReleaseEvent(overlapped.hEvent);
+
+    if (dwLastError != ERROR_SUCCESS && dwLastError != ERROR_HANDLE_EOF)
+    {
+        log::Warning(
+            _L_,
+            HRESULT_FROM_WIN32(dwLastError),
+            L"Failed to read %d bytes at offset %I64d from disk extent\r\n",
+            dwCount,
+            ullOffset);
+        return HRESULT_FROM_WIN32(dwLastError);
+    }
+
+    *pdwBytesRead = dwBytesRead;
+    return S_OK;
+}
+
 void CDiskExtent::Close()
 {
     if (INVALID_HANDLE_VALUE != m_hFile)
@@ -234,6 +347,15 @@ void CDiskExtent::Close()
         CloseHandle(m_hFile);
         m_hFile = INVALID_HANDLE_VALUE;
     }
+    if (m_hPositional != NULL)
+    {
+        if (m_hPositional != INVALID_HANDLE_VALUE)
+            CloseHandle(m_hPositional);
+        m_hPositional = NULL;
+    }
+    for (auto hEvent : m_Events)
+        CloseHandle(hEvent);
+    m_Events.clear();
 }
 
 CDiskExtent CDiskExtent::ReOpen(DWORD dwDesiredAccess, DWORD dwShareMode, DWORD dwFlags) const
@@ -246,6 +368,7 @@ CDiskExtent CDiskExtent::ReOpen(DWORD dwDesiredAccess, DWORD dwShareMode, DWORD
     ext.m_Name = m_Name;
     ext.m_PhysicalSectorSize = m_PhysicalSectorSize;
     ext.m_Start = m_Start;
+    ext.m_dwFlags = dwFlags;
 
     const auto k32 = ExtensionLibrary::GetLibrary<Kernel32Extension>(_L_, true);
 
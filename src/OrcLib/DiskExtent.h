@@ -10,6 +10,10 @@
 #include "OrcLib.h"
 #include "IDiskExtent.h"
 
+#include <concrt.h>
+
+#include <vector>
+
 #pragma managed(push, off)
 
 namespace Orc {
@@ -53,6 +57,19 @@ private:
     ULONG m_LogicalSectorSize = 0LU;
     ULONG m_PhysicalSectorSize = 0LU;
     HANDLE m_hFile = INVALID_HANDLE_VALUE;
+    DWORD m_dwFlags = 0L;
+
+    // overlapped handle used by ReadAt, opened on first use (INVALID_HANDLE_VALUE if it could not be)
+    HANDLE volatile m_hPositional = NULL;
+
+    HANDLE GetPositionalHandle();
+
+    // events of the overlapped reads of ReadAt, one per concurrent read, created once and kept until Close
+    concurrency::critical_section m_EventsLock;
+    std::vector<HANDLE> m_Events;
+
+    HANDLE AcquireEvent();
+    void ReleaseEvent(HANDLE hEvent);
 
     logger _L_;
 
@@ -63,6 +80,14 @@ public:
     virtual HRESULT Read(__in_bcount(dwCount) PVOID lpBuf, DWORD dwCount, PDWORD pdwBytesRead);
     virtual void Close();
 
+    // True when ReadAt can be used: the extent could be reopened for overlapped reads
+    bool CanReadAt() { return GetPositionalHandle() != INVALID_HANDLE_VALUE; }
+
+    // Reads at ullOffset (from the start of the extent) without using the position set by Seek
+    // Several threads may read from the same extent at the same time
+    // Fails with ERROR_NOT_SUPPORTED when CanReadAt is false: Seek and Read must then be used under the owner's lock
+    HRESULT ReadAt(ULONGLONG ullOffset, __out_bcount(dwCount) PVOID lpBuf, DWORD dwCount, PDWORD pdwBytesRead);
+
     virtual const std::wstring& GetName() const { return m_Name; }
     virtual ULONGLONG GetStartOffset() const { return m_Start; }
     virtual ULONGLONG GetSeekOffset() const { return m_liCurrentPos.QuadPart; }
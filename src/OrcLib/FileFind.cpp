@@ -28,10 +28,14 @@
 #include "ConfigFile_Common.h"
 
 #include "SystemDetails.h"
+#include "Semaphore.h"
 
 #include <sstream>
 #include <Shlwapi.h>
 #include <iomanip>
+#include <map>
+
+#include <ppl.h>
 
 #include <boost\algorithm\searching\boyer_moore.hpp>
 
@@ -41,6 +45,8 @@ constexpr const unsigned int FILESPEC_FILENAME_INDEX = 1;
 constexpr const unsigned int FILESPEC_SPEC_INDEX = 3;
 constexpr const unsigned int FILESPEC_SUBNAME_INDEX = 4;
 
+constexpr const size_t DATA_EVALUATION_CHUNK = 4 * 1024 * 1024;
+
 using namespace std;
 using namespace Orc;
 
@@ -1460,7 +1466,7 @@ HRESULT FileFind::InitializeYara(std::unique_ptr<YaraConfig>& config)
     if (yara_content.empty() && yara_rules.empty())
         return S_OK;
 
-    m_YaraScan = std::make_unique<YaraScanner>(_L_);
+    m_YaraScan = std::make_shared<YaraScanner>(_L_);
     if (!m_YaraScan)
         return E_OUTOFMEMORY;
 
@@ -1550,6 +1556,497 @@ FileFind::SearchTerm::Criteria FileFind::DiscriminateEA(const std::wstring& strE
     return SearchTerm::Criteria::EA_EXACT;
 }
 
+// Longest literal piece of a PathMatchSpec pattern: '*', '?' and '.' (which has special meanings in DOS patterns
+// like "*.*") break pieces, as do non ASCII characters, compared case insensitively
+std::wstring FileFind::WildcardLiteral(const std::wstring& strPattern)
+{
+    // a list of patterns is matched when any of them does
+    if (strPattern.find(L';') != std::wstring::npos)
+        return std::wstring();
+
+    std::wstring strBest, strCurrent;
+    for (auto wc : strPattern)
+    {
+        if (wc == L'*' || wc == L'?' || wc == L'.' || wc >= 0x80)
+        {
+            if (strCurrent.size() > strBest.size())
+                strBest = strCurrent;
+            strCurrent.clear();
+        }
+        else
+            strCurrent.push_back(wc);
+    }
+    if (strCurrent.size() > strBest.size())
+        strBest = strCurrent;
+    return strBest;
+}
+
+// Longest literal piece every match of an ECMAScript regex has to contain
+// Only the characters outside of any group are considered and alternations make the regex opaque
+std::wstring FileFind::RegexLiteral(const std::wstring& strRegex)
+{
+    std::wstring strBest, strCurrent;
+    auto cutPiece = [&strBest, &strCurrent]() {
+        if (strCurrent.size() > strBest.size())
+            strBest = strCurrent;
+        strCurrent.clear();
+    };
+
+    const size_t cchRegex = strRegex.size();
+    DWORD dwDepth = 0L;
+    bool bLastIsLiteral = false;
+
+    size_t i = 0;
+    while (i < cchRegex)
+    {
+        const WCHAR wc = strRegex[i];
+        bool bLiteral = false;
+        WCHAR wcLiteral = L'\0';
+
+        switch (wc)
+        {
+            case L'\\':
+            {
+                if (i + 1 >= cchRegex)
+                    return std::wstring();
+
+                const WCHAR wcEscaped = strRegex[i + 1];
+                i += 2;
+                if (iswalnum(wcEscaped))
+                {
+                    // character class, back reference or character code: skip its operands
+                    if (wcEscaped == L'x')
+                        i += 2;
+                    else if (wcEscaped == L'u')
+                        i += 4;
+                    else if (wcEscaped == L'c')
+                        i += 1;
+                    else if (iswdigit(wcEscaped))
+                        while (i < cchRegex && iswdigit(strRegex[i]))
+                            i++;
+                }
+                else
+                {
+                    bLiteral = true;
+                    wcLiteral = wcEscaped;
+                }
+                break;
+            }
+            case L'[':
+            {
+                i++;
+                if (i < cchRegex && strRegex[i] == L'^')
+                    i++;
+                while (i < cchRegex && strRegex[i] != L']')
+                    i += strRegex[i] == L'\\' ? 2 : 1;
+                i++;
+                break;
+            }
+            case L'(':
+                dwDepth++;
+                i++;
+                break;
+            case L')':
+                if (dwDepth > 0)
+                    dwDepth--;
+                i++;
+                break;
+            case L'|':
+                if (dwDepth == 0)
+                    return std::wstring();
+                i++;
+                break;
+            case L'*':
+            case L'?':
+            case L'{':
+                // the previous character may not be there at all
+                if (bLastIsLiteral && dwDepth == 0)
+                    strCurrent.pop_back();
+                if (wc == L'{')
+                    while (i < cchRegex && strRegex[i] != L'}')
+                        i++;
+                i++;
+                break;
+            case L'+':
+                // the previous character is there (at least once) but what follows may be another repetition
+                i++;
+                break;
+            case L'.':
+            case L'^':
+            case L'$':
+                i++;
+                break;
+            default:
+                bLiteral = true;
+                wcLiteral = wc;
+                i++;
+                break;
+        }
+
+        if (dwDepth == 0 && bLiteral && wcLiteral < 0x80)
+        {
+            strCurrent.push_back(wcLiteral);
+            bLastIsLiteral = true;
+        }
+        else
+        {
+            cutPiece();
+            bLastIsLiteral = false;
+        }
+    }
+    cutPiece();
+    return strBest;
+}
+
+void FileFind::AddToTerms(const std::shared_ptr<SearchTerm>& aTerm)
+{
+    const DWORD dwIndex = static_cast<DWORD>(m_Terms.size());
+    m_Terms.push_back(aTerm);
+
+    std::wstring strNameLiteral;
+    if (aTerm->Required & SearchTerm::Criteria::NAME_REGEX)
+        strNameLiteral = RegexLiteral(aTerm->FileName);
+    else if (aTerm->Required & (SearchTerm::Criteria::NAME_MATCH | SearchTerm::Criteria::NAME_EXACT))
+        strNameLiteral = WildcardLiteral(aTerm->FileName);
+
+    if (!strNameLiteral.empty() && SUCCEEDED(m_NameLiterals.AddPattern(strNameLiteral, dwIndex)))
+    {
+        m_AlwaysEvaluated.push_back(0);
+        return;
+    }
+
+    std::wstring strPathLiteral;
+    if (aTerm->Required & SearchTerm::Criteria::PATH_REGEX)
+        strPathLiteral = RegexLiteral(aTerm->Path);
+    else if (aTerm->Required & (SearchTerm::Criteria::PATH_MATCH | SearchTerm::Criteria::PATH_EXACT))
+        strPathLiteral = WildcardLiteral(aTerm->Path);
+
+    if (!strPathLiteral.empty() && SUCCEEDED(m_PathLiterals.AddPattern(strPathLiteral, dwIndex)))
+    {
+        m_AlwaysEvaluated.push_back(0);
+        return;
+    }
+
+    m_AlwaysEvaluated.push_back(1);
+}
+
+HRESULT FileFind::CompileTerms()
+{
+    HRESULT hr = E_FAIL;
+
+    if (!m_NameLiterals.IsCompiled() && FAILED(hr = m_NameLiterals.Compile()))
+        return hr;
+    if (!m_PathLiterals.IsCompiled() && FAILED(hr = m_PathLiterals.Compile()))
+        return hr;
+
+    log::Verbose(
+        _L_,
+        L"%d out of %d search terms are only evaluated when their name or path pattern is found\r\n",
+        static_cast<int>(std::count(begin(m_AlwaysEvaluated), end(m_AlwaysEvaluated), 0)),
+        static_cast<int>(m_Terms.size()));
+    return S_OK;
+}
+
+void FileFind::SelectCandidateTerms(MFTRecord* pElt)
+{
+    m_Candidates = m_AlwaysEvaluated;
+
+    if (!m_NameLiterals.IsEmpty())
+    {
+        for (const auto& pFileName : pElt->GetFileNames())
+            m_NameLiterals.Search(pFileName->FileName, pFileName->FileNameLength, m_Candidates);
+    }
+
+    if (!m_PathLiterals.IsEmpty() && m_FullNameBuilder != nullptr)
+    {
+        for (const auto& pFileName : pElt->GetFileNames())
+        {
+            // path criteria only apply to names in location
+            if (!m_InLocationBuilder(pFileName))
+                continue;
+
+            if (LPCWSTR szFullName = m_FullNameBuilder(pFileName, nullptr))
+                m_PathLiterals.Search(szFullName, wcslen(szFullName), m_Candidates);
+        }
+    }
+}
+
+void FileFind::SelectCandidateTerms(const PFILE_NAME pFileName)
+{
+    m_Candidates = m_AlwaysEvaluated;
+
+    if (!m_NameLiterals.IsEmpty())
+        m_NameLiterals.Search(pFileName->FileName, pFileName->FileNameLength, m_Candidates);
+
+    if (!m_PathLiterals.IsEmpty() && m_FullNameBuilder != nullptr && m_InLocationBuilder(pFileName))
+    {
+        if (LPCWSTR szFullName = m_FullNameBuilder(pFileName, nullptr))
+            m_PathLiterals.Search(szFullName, wcslen(szFullName), m_Candidates);
+    }
+}
+
+void FileFind::ResetPendingData()
+{
+    m_PendingData.dwHeaderLen = 0L;
+    m_PendingData.bHash = false;
+    m_PendingData.bYara = false;
+    m_PendingData.Contains.assign(m_ContainsTerms.size(), 0);
+
+    m_DataEvaluations.clear();
+    m_PendingTerms.clear();
+}
+
+void FileFind::AddPendingData(const std::shared_ptr<SearchTerm>& aTerm)
+{
+    if (!aTerm->DependsOnData())
+        return;
+
+    if (aTerm->Required
+        & (SearchTerm::Criteria::HEADER | SearchTerm::Criteria::HEADER_HEX | SearchTerm::Criteria::HEADER_REGEX))
+        m_PendingData.dwHeaderLen = std::max(m_PendingData.dwHeaderLen, aTerm->HeaderLen);
+
+    if (aTerm->Required
+        & (SearchTerm::Criteria::DATA_MD5 | SearchTerm::Criteria::DATA_SHA1 | SearchTerm::Criteria::DATA_SHA256))
+        m_PendingData.bHash = true;
+
+    if (aTerm->Required & SearchTerm::Criteria::YARA)
+        m_PendingData.bYara = true;
+
+    if (aTerm->Required & SearchTerm::Criteria::CONTAINS)
+    {
+        auto it = m_ContainsIndex.find(aTerm.get());
+        if (it != end(m_ContainsIndex))
+            m_PendingData.Contains[it->second] = 1;
+    }
+}
+
+const FileFind::DataEvaluation& FileFind::EvaluateData(const std::shared_ptr<DataAttribute>& pDataAttr) const
+{
+    HRESULT hr = E_FAIL;
+
+    auto [it, bInserted] = m_DataEvaluations.try_emplace(pDataAttr.get());
+    auto& eval = it->second;
+
+    // nothing is evaluated when nothing is pending: each criteria then reads what it needs
+    if (!bInserted || m_PendingData.IsEmpty())
+        return eval;
+
+    auto pDataStream = pDataAttr->GetDataStream(_L_, m_pVolReader);
+    if (pDataStream == nullptr)
+        return eval;
+
+    if (FAILED(hr = pDataStream->SetFilePointer(0LL, SEEK_SET, nullptr)))
+    {
+        log::Verbose(_L_, L"Failed to seek pointer to 0 for data attribute (hr=0x%lx)\r\n", hr);
+        return eval;
+    }
+
+    const ULONGLONG ullDataSize = pDataStream->GetSize();
+
+    // yara scans small data at once and bigger data block by block (left to MatchYara with file mapping)
+    bool bYaraAtOnce = false;
+    std::unique_ptr<YaraScanner::BlockScanState> pYaraBlocks;
+    if (m_PendingData.bYara && m_YaraScan)
+    {
+        const auto& yaraConfig = m_YaraScan->Config();
+        if (ullDataSize < yaraConfig.blockSize())
+            bYaraAtOnce = true;
+        else if (yaraConfig.ScanMethod() == YaraScanMethod::Blocks)
+            pYaraBlocks = std::make_unique<YaraScanner::BlockScanState>(yaraConfig.overlapSize());
+    }
+
+    const bool bScanAll = m_PendingData.bHash || m_PendingData.bYara
+        || std::find(std::cbegin(m_PendingData.Contains), std::cend(m_PendingData.Contains), 1)
+            != std::cend(m_PendingData.Contains);
+
+    // only the header is read when nothing else is pending
+    size_t cbChunk = pYaraBlocks ? m_YaraScan->Config().blockSize() : DATA_EVALUATION_CHUNK;
+    if (!bScanAll)
+        cbChunk = m_PendingData.dwHeaderLen;
+    if (bYaraAtOnce || ullDataSize < cbChunk)
+        cbChunk = std::max<size_t>(static_cast<size_t>(ullDataSize), 1);
+
+    std::shared_ptr<CryptoHashStream> pHashStream;
+    if (m_PendingData.bHash)
+    {
+        const auto& details = pDataAttr->GetDetails();
+        CryptoHashStream::Algorithm needed = CryptoHashStream::Algorithm::Undefined;
+
+        if (m_NeededHash & CryptoHashStream::Algorithm::MD5 && details->MD5().empty())
+            needed |= CryptoHashStream::Algorithm::MD5;
+        if (m_NeededHash & CryptoHashStream::Algorithm::SHA1 && details->SHA1().empty())
+            needed |= CryptoHashStream::Algorithm::SHA1;
+        if (m_NeededHash & CryptoHashStream::Algorithm::SHA256 && details->SHA256().empty())
+            needed |= CryptoHashStream::Algorithm::SHA256;
+
+        if (needed != CryptoHashStream::Algorithm::Undefined)
+        {
+            pHashStream = std::make_shared<CryptoHashStream>(_L_);
+            if (FAILED(hr = pHashStream->OpenToWrite(needed, nullptr)))
+                return eval;
+        }
+    }
+
+    std::vector<std::pair<DWORD, boost::algorithm::boyer_moore<BYTE*>>> needles;
+    size_t cbCarry = 0L;
+    for (DWORD i = 0; i < m_ContainsTerms.size(); i++)
+    {
+        if (!m_PendingData.Contains[i])
+            continue;
+        auto& contains = m_ContainsTerms[i]->Contains;
+        if (contains.GetCount() == 0)
+            continue;
+        needles.emplace_back(i, boost::algorithm::boyer_moore<BYTE*>(contains.begin(), contains.end()));
+        cbCarry = std::max(cbCarry, contains.GetCount() - 1);
+    }
+
+    eval.ContainsEvaluated.assign(m_ContainsTerms.size(), 0);
+    eval.ContainsFound.assign(m_ContainsTerms.size(), 0);
+
+    // the end of the previous chunk is kept in front of the current one so that needles across chunks are found
+    CBinaryBuffer buffer;
+    if (!buffer.SetCount(cbCarry + cbChunk))
+        return eval;
+
+    size_t cbCarried = 0L;
+    ULONGLONG ullAccumulatedBytes = 0LL;
+    size_t cbChunkRead = 0L;
+    size_t cbNeedlesFound = 0L;
+    bool bYaraScanned = false;
+
+    // reading stops once the header is complete, every needle found and no hash nor yara scan needs the rest
+    auto IsEvaluationComplete = [&]() -> bool {
+        return eval.Header.GetCount() >= m_PendingData.dwHeaderLen && pHashStream == nullptr
+            && cbNeedlesFound == needles.size() && pYaraBlocks == nullptr && (!bYaraAtOnce || bYaraScanned);
+    };
+
+    do
+    {
+        BYTE* pChunk = buffer.GetData() + cbCarried;
+
+        cbChunkRead = 0L;
+        while (cbChunkRead < cbChunk)
+        {
+            ULONGLONG ullBytesRead = 0LL;
+            if (FAILED(hr = pDataStream->Read(pChunk + cbChunkRead, cbChunk - cbChunkRead, &ullBytesRead)))
+            {
+                log::Verbose(_L_, L"Failed to read data attribute (hr=0x%lx)\r\n", hr);
+                return eval;
+            }
+            if (ullBytesRead == 0LL)
+                break;
+            cbChunkRead += static_cast<size_t>(ullBytesRead);
+        }
+        ullAccumulatedBytes += cbChunkRead;
+
+        if (eval.Header.GetCount() < m_PendingData.dwHeaderLen)
+        {
+            const size_t cbHeader = eval.Header.GetCount();
+            const size_t cbToCopy = std::min<size_t>(m_PendingData.dwHeaderLen - cbHeader, cbChunkRead);
+            if (!eval.Header.SetCount(cbHeader + cbToCopy))
+                return eval;
+            CopyMemory(eval.Header.GetData() + cbHeader, pChunk, cbToCopy);
+        }
+
+        const size_t cbSearch = cbCarried + cbChunkRead;
+
+        HRESULT hrHash = S_OK;
+        auto HashAndSearchChunk = [&]() {
+            if (pHashStream && cbChunkRead > 0)
+            {
+                ULONGLONG ullWritten = 0LL;
+                hrHash = pHashStream->Write(pChunk, cbChunkRead, &ullWritten);
+            }
+
+            for (auto& needle : needles)
+            {
+                if (eval.ContainsFound[needle.first])
+                    continue;
+
+                auto found = needle.second(buffer.GetData(), buffer.GetData() + cbSearch);
+                if (found.first != buffer.GetData() + cbSearch)
+                {
+                    eval.ContainsFound[needle.first] = 1;
+                    cbNeedlesFound++;
+                }
+            }
+        };
+
+        if (pYaraBlocks && cbChunkRead > 0)
+        {
+            // the block, its overlap with the previous one and the other criteria are evaluated concurrently, the
+            // scanner's rules are shared by its scans
+            CBinaryBuffer block(pChunk, cbChunkRead);
+            const ULONG ulBlock = static_cast<ULONG>(cbChunkRead);
+            MatchingRuleCollection blockRules, overlapRules;
+            HRESULT hrBlock = S_OK, hrOverlap = S_OK;
+
+            Concurrency::parallel_invoke(
+                HashAndSearchChunk,
+                [&]() { hrBlock = m_YaraScan->Scan(block, ulBlock, blockRules); },
+                [&]() { hrOverlap = m_YaraScan->ScanOverlap(block, ulBlock, *pYaraBlocks, overlapRules); });
+
+            if (FAILED(hr = hrBlock) || FAILED(hr = hrOverlap))
+            {
+                log::Verbose(_L_, L"Failed to yara scan data attribute (hr=0x%lx)\r\n", hr);
+                pYaraBlocks.reset();
+            }
+            else
+            {
+                // block matches first, then the overlap's, as when they were scanned one after the other
+                eval.YaraRules.insert(end(eval.YaraRules), begin(blockRules), end(blockRules));
+                eval.YaraRules.insert(end(eval.YaraRules), begin(overlapRules), end(overlapRules));
+            }
+        }
+        else
+        {
+            HashAndSearchChunk();
+
+            if (bYaraAtOnce)
+            {
+                // the whole data fits in this chunk
+                CBinaryBuffer data(pChunk, cbChunkRead);
+                if (FAILED(hr = m_YaraScan->Scan(data, static_cast<ULONG>(cbChunkRead), eval.YaraRules)))
+                {
+                    log::Verbose(_L_, L"Failed to yara scan data attribute (hr=0x%lx)\r\n", hr);
+                    bYaraAtOnce = false;
+                }
+                bYaraScanned = true;
+            }
+        }
+
+        if (FAILED(hrHash))
+            return eval;
+
+        cbCarried = std::min(cbCarry, cbSearch);
+        if (cbCarried > 0)
+            MoveMemory(buffer.GetData(), buffer.GetData() + cbSearch - cbCarried, cbCarried);
+
+    } while (cbChunkRead == cbChunk && ullAccumulatedBytes < ullDataSize && !IsEvaluationComplete());
+
+    if (pHashStream)
+    {
+        const auto& details = pDataAttr->GetDetails();
+        CBinaryBuffer hash;
+        if (details->MD5().empty() && SUCCEEDED(pHashStream->GetMD5(hash)) && !hash.empty())
+            details->SetMD5(std::move(hash));
+        if (details->SHA1().empty() && SUCCEEDED(pHashStream->GetSHA1(hash)) && !hash.empty())
+            details->SetSHA1(std::move(hash));
+        if (details->SHA256().empty() && SUCCEEDED(pHashStream->GetSHA256(hash)) && !hash.empty())
+            details->SetSHA256(std::move(hash));
+    }
+
+    if (FAILED(hr = pDataStream->SetFilePointer(0LL, SEEK_SET, nullptr)))
+        log::Verbose(_L_, L"Failed to seek pointer to 0 for data attribute (hr=0x%lx)\r\n", hr);
+
+    for (const auto& needle : needles)
+        eval.ContainsEvaluated[needle.first] = 1;
+    eval.dwHeaderLen = m_PendingData.dwHeaderLen;
+    eval.bYaraScanned = bYaraAtOnce || pYaraBlocks != nullptr;
+    eval.hr = S_OK;
+    return eval;
+}
+
 HRESULT FileFind::AddTerm(const shared_ptr<SearchTerm>& pMatch)
 {
     if (pMatch->Required == SearchTerm::Criteria::NONE)
@@ -1601,6 +2098,12 @@ HRESULT FileFind::AddTerm(const shared_ptr<SearchTerm>& pMatch)
 
     m_AllTerms.push_back(pMatch);
 
+    if (pMatch->Required & SearchTerm::Criteria::CONTAINS)
+    {
+        m_ContainsIndex.emplace(pMatch.get(), static_cast<DWORD>(m_ContainsTerms.size()));
+        m_ContainsTerms.push_back(pMatch);
+    }
+
     if (pMatch->Required & SearchTerm::Criteria::NAME)
     {
         // We received a "generic name", doing something more specific
@@ -1626,7 +2129,7 @@ HRESULT FileFind::AddTerm(const shared_ptr<SearchTerm>& pMatch)
                 m_SizeTerms.emplace(pMatch->SizeEQ, pMatch);
             }
             else
-                m_Terms.push_back(pMatch);
+                AddToTerms(pMatch);
 
             if (pMatch->DependsOnlyOnNameOrPath())
             {
@@ -1654,7 +2157,7 @@ HRESULT FileFind::AddTerm(const shared_ptr<SearchTerm>& pMatch)
                     m_SizeTerms.emplace(pMatch->SizeEQ, pMatch);
                 }
                 else
-                    m_Terms.push_back(pMatch);
+                    AddToTerms(pMatch);
 
                 if (pMatch->DependsOnlyOnNameOrPath())
                 {
@@ -1672,7 +2175,7 @@ HRESULT FileFind::AddTerm(const shared_ptr<SearchTerm>& pMatch)
             else
             {
                 // No name specified
-                m_Terms.push_back(pMatch);
+                AddToTerms(pMatch);
             }
 
             if (m1[FILESPEC_SPEC_INDEX].matched && m1[FILESPEC_SUBNAME_INDEX].matched)
@@ -1726,7 +2229,7 @@ HRESULT FileFind::AddTerm(const shared_ptr<SearchTerm>& pMatch)
         }
         else
         {
-            m_Terms.push_back(pMatch);
+            AddToTerms(pMatch);
             if (pMatch->DependsOnlyOnNameOrPath())
                 m_I30Terms.push_back(pMatch);
         }
@@ -2805,6 +3308,9 @@ FileFind::SearchTerm::Criteria FileFind::MatchHash(
         if (pDataAttr == nullptr)
             return SearchTerm::Criteria::NONE;
 
+        // hashes computed by the data evaluation are kept in the attribute details
+        EvaluateData(pDataAttr);
+
         if (FAILED(hr = pDataAttr->GetHashInformation(_L_, m_pVolReader, m_NeededHash)))
         {
             log::Error(_L_, hr, L"Failed to compute hash for data attribute\r\n");
@@ -2848,6 +3354,11 @@ FileFind::SearchTerm::Criteria FileFind::MatchContains(
 
     if (aTerm->Required & SearchTerm::Criteria::CONTAINS)
     {
+        const auto& eval = EvaluateData(pDataAttr);
+        auto it = m_ContainsIndex.find(aTerm.get());
+        if (SUCCEEDED(eval.hr) && it != end(m_ContainsIndex) && eval.ContainsEvaluated[it->second])
+            return eval.ContainsFound[it->second] ? SearchTerm::Criteria::CONTAINS : SearchTerm::Criteria::NONE;
+
         auto pDataStream = pDataAttr->GetDataStream(_L_, m_pVolReader);
         if (pDataStream == nullptr)
             return SearchTerm::Criteria::NONE;
@@ -2924,21 +3435,30 @@ std::pair<Orc::FileFind::SearchTerm::Criteria, std::optional<MatchingRuleCollect
 
     if (aTerm->Required & SearchTerm::Criteria::YARA)
     {
-        auto pDataStream = pDataAttr->GetDataStream(_L_, m_pVolReader);
-        if (pDataStream == nullptr)
-            return { SearchTerm::Criteria::NONE, std::nullopt };
+        MatchingRuleCollection matchingRules;
 
-        if (FAILED(hr = pDataStream->SetFilePointer(0LL, SEEK_SET, nullptr)))
+        const auto& eval = EvaluateData(pDataAttr);
+        if (SUCCEEDED(eval.hr) && eval.bYaraScanned)
         {
-            log::Verbose(_L_, L"Failed to seek pointer to 0 for data attribute (hr=0x%lx)\r\n", hr);
-            return { SearchTerm::Criteria::NONE, std::nullopt };
+            matchingRules = eval.YaraRules;
         }
-
-        auto [hr, matchingRules] = m_YaraScan->Scan(pDataStream);
-        if (FAILED(hr))
+        else
         {
-            log::Verbose(_L_, L"Failed to yara scan data attribute (hr=0x%lx)\r\n", hr);
-            return { SearchTerm::Criteria::NONE, std::nullopt };
+            auto pDataStream = pDataAttr->GetDataStream(_L_, m_pVolReader);
+            if (pDataStream == nullptr)
+                return {SearchTerm::Criteria::NONE, std::nullopt};
+
+            if (FAILED(hr = pDataStream->SetFilePointer(0LL, SEEK_SET, nullptr)))
+            {
+                log::Verbose(_L_, L"Failed to seek pointer to 0 for data attribute (hr=0x%lx)\r\n", hr);
+                return {SearchTerm::Criteria::NONE, std::nullopt};
+            }
+
+            if (FAILED(hr = m_YaraScan->Scan(pDataStream, matchingRules)))
+            {
+                log::Verbose(_L_, L"Failed to yara scan data attribute (hr=0x%lx)\r\n", hr);
+                return {SearchTerm::Criteria::NONE, std::nullopt};
+            }
         }
         if (!matchingRules.empty())
         {
@@ -2974,6 +3494,16 @@ FileFind::SearchTerm::Criteria FileFind::MatchHeader(
 
     if (aTerm->Required & SearchTerm::Criteria::HEADER)
     {
+        const auto& eval = EvaluateData(pDataAttr);
+        if (SUCCEEDED(eval.hr) && aTerm->HeaderLen <= eval.dwHeaderLen)
+        {
+            if (eval.Header.GetCount() < aTerm->HeaderLen)
+                return SearchTerm::Criteria::NONE;
+            if (!memcmp(eval.Header.GetData(), aTerm->Header.GetData(), aTerm->HeaderLen))
+                return SearchTerm::Criteria::HEADER;
+            return SearchTerm::Criteria::NONE;
+        }
+
         auto pDataStream = pDataAttr->GetDataStream(_L_, m_pVolReader);
         if (pDataStream == nullptr)
             return SearchTerm::Criteria::NONE;
@@ -3015,6 +3545,16 @@ FileFind::RegExHeader(const std::shared_ptr<SearchTerm>& aTerm, const std::share
 
     if (aTerm->Required & SearchTerm::Criteria::HEADER_REGEX)
     {
+        const auto& eval = EvaluateData(pDataAttr);
+        if (SUCCEEDED(eval.hr) && aTerm->HeaderLen <= eval.dwHeaderLen)
+        {
+            const size_t cbHeader = std::min<size_t>(eval.Header.GetCount(), aTerm->HeaderLen);
+            const LPSTR szHeader = (LPSTR)eval.Header.GetData();
+            if (regex_match(szHeader, szHeader + cbHeader, aTerm->HeaderRegEx))
+                return SearchTerm::Criteria::HEADER_REGEX;
+            return SearchTerm::Criteria::NONE;
+        }
+
         auto pDataStream = pDataAttr->GetDataStream(_L_, m_pVolReader);
         if (pDataStream == nullptr)
             return SearchTerm::Criteria::NONE;
@@ -3058,6 +3598,16 @@ FileFind::HexHeader(const std::shared_ptr<SearchTerm>& aTerm, const std::shared_
     {
         SearchTerm::Criteria matchedSpec = SearchTerm::Criteria::NONE;
 
+        const auto& eval = EvaluateData(pDataAttr);
+        if (SUCCEEDED(eval.hr) && aTerm->HeaderLen <= eval.dwHeaderLen)
+        {
+            if (eval.Header.GetCount() < aTerm->HeaderLen)
+                return SearchTerm::Criteria::NONE;
+            if (!memcmp(eval.Header.GetData(), aTerm->Header.GetData(), aTerm->HeaderLen))
+                return SearchTerm::Criteria::HEADER_HEX;
+            return SearchTerm::Criteria::NONE;
+        }
+
         auto pDataStream = pDataAttr->GetDataStream(_L_, m_pVolReader);
         if (pDataStream == nullptr)
             return SearchTerm::Criteria::NONE;
@@ -3282,15 +3832,12 @@ FileFind::Match::AttributeMatch::AttributeMatch(const std::shared_ptr<MftRecordA
     RawStream = pAttr->GetDetails()->GetRawStream();
 }
 
-FileFind::SearchTerm::Criteria FileFind::LookupTermInRecordAddMatching(
+bool FileFind::LookupTermInRecordAddMatchingWithoutData(
     const std::shared_ptr<SearchTerm>& aTerm,
-    const SearchTerm::Criteria matched,
+    SearchTerm::Criteria& matchedSpecs,
     std::shared_ptr<Match>& aFileMatch,
     MFTRecord* pElt) const
 {
-    SearchTerm::Criteria requiredSpecs = aTerm->Required;
-    SearchTerm::Criteria matchedSpecs = matched;
-
     if (aTerm->DependsOnName())
     {
         SearchTerm::Criteria requiredNameSpecs =
@@ -3299,7 +3846,7 @@ FileFind::SearchTerm::Criteria FileFind::LookupTermInRecordAddMatching(
         if (requiredNameSpecs == matchedNameSpecs)
             matchedSpecs |= matchedNameSpecs;
         else
-            return SearchTerm::Criteria::NONE;
+            return false;
     }
     if (aTerm->DependsOnPath())
     {
@@ -3309,7 +3856,7 @@ FileFind::SearchTerm::Criteria FileFind::LookupTermInRecordAddMatching(
         if (requiredPathSpecs == matchedPathSpecs)
             matchedSpecs |= matchedPathSpecs;
         else
-            return SearchTerm::Criteria::NONE;
+            return false;
     }
 
     if (aTerm->DependsOnDataNameOrSize())
@@ -3321,7 +3868,7 @@ FileFind::SearchTerm::Criteria FileFind::LookupTermInRecordAddMatching(
         if (matchedDataNameOrSizeSpecs == requiredNameOrSizeSpecs)
             matchedSpecs |= matchedDataNameOrSizeSpecs;
         else
-            return SearchTerm::Criteria::NONE;
+            return false;
     }
 
     // before evaluating if more expensive attributes match, we check we are in location
@@ -3332,7 +3879,7 @@ FileFind::SearchTerm::Criteria FileFind::LookupTermInRecordAddMatching(
     {
         // none of this record file name is in location
         // unappropriate to continue...
-        return SearchTerm::Criteria::NONE;
+        return false;
     }
 
     if (aTerm->DependsOnAttribute())
@@ -3343,9 +3890,21 @@ FileFind::SearchTerm::Criteria FileFind::LookupTermInRecordAddMatching(
         if (requiredAttributeSpecs == matchedAttributeSpecs)
             matchedSpecs |= matchedAttributeSpecs;
         else
-            return SearchTerm::Criteria::NONE;
+            return false;
     }
 
+    return true;
+}
+
+FileFind::SearchTerm::Criteria FileFind::LookupTermInDataAddMatching(
+    const std::shared_ptr<SearchTerm>& aTerm,
+    const SearchTerm::Criteria matched,
+    std::shared_ptr<Match>& aFileMatch,
+    MFTRecord* pElt) const
+{
+    SearchTerm::Criteria requiredSpecs = aTerm->Required;
+    SearchTerm::Criteria matchedSpecs = matched;
+
     if (aTerm->DependsOnData())
     {
         SearchTerm::Criteria requiredDataSpecs =
@@ -3655,7 +4214,22 @@ HRESULT FileFind::EvaluateMatchCallCallback(
 HRESULT FileFind::FindMatch(MFTRecord* pElt, bool& bStop, FileFind::FoundMatchCallback aCallback)
 {
     HRESULT hr = E_FAIL;
-    shared_ptr<FileFind::Match> retval;
+
+    ResetPendingData();
+
+    if (!m_Terms.empty())
+        SelectCandidateTerms(pElt);
+
+    // Data criteria are only evaluated for the terms whose other criteria matched, once the data all of them need is
+    // known so that it is read once
+    auto AddPendingTerm = [this, pElt](const std::shared_ptr<SearchTerm>& aTerm, SearchTerm::Criteria matched) {
+        std::shared_ptr<Match> aMatch;
+        if (!LookupTermInRecordAddMatchingWithoutData(aTerm, matched, aMatch, pElt))
+            return;
+
+        AddPendingData(aTerm);
+        m_PendingTerms.push_back({aTerm, matched, std::move(aMatch)});
+    };
 
     if (!m_ExactNameTerms.empty() || (!m_ExactPathTerms.empty() && m_FullNameBuilder != nullptr))
     {
@@ -3677,19 +4251,7 @@ HRESULT FileFind::FindMatch(MFTRecord* pElt, bool& bStop, FileFind::FoundMatchCa
                 auto name_list = m_ExactNameTerms.equal_range(strName);
 
                 for (auto name_it = name_list.first; name_it != name_list.second; ++name_it)
-                {
-                    auto matched =
-                        LookupTermInRecordAddMatching(name_it->second, SearchTerm::Criteria::NAME_EXACT, retval, pElt);
-                    if (matched != SearchTerm::Criteria::NONE)
-                    {
-                        // we do have a match!
-                        if (FAILED(hr = EvaluateMatchCallCallback(aCallback, bStop, retval)))
-                            return hr;
-                        retval.reset();
-                    }
-                    else if (retval != nullptr)
-                        retval->Reset();
-                }
+                    AddPendingTerm(name_it->second, SearchTerm::Criteria::NAME_EXACT);
             }
             if (!m_ExactPathTerms.empty() && m_FullNameBuilder != nullptr)
             {
@@ -3698,19 +4260,7 @@ HRESULT FileFind::FindMatch(MFTRecord* pElt, bool& bStop, FileFind::FoundMatchCa
                 auto path_list = m_ExactPathTerms.equal_range(strPath);
 
                 for (auto path_it = path_list.first; path_it != path_list.second; ++path_it)
-                {
-                    auto matched =
-                        LookupTermInRecordAddMatching(path_it->second, SearchTerm::Criteria::PATH_EXACT, retval, pElt);
-                    if (matched != SearchTerm::Criteria::NONE)
-                    {
-                        // we do have a match!
-                        if (FAILED(hr = EvaluateMatchCallCallback(aCallback, bStop, retval)))
-                            return hr;
-                        retval.reset();
-                    }
-                    else if (retval != nullptr)
-                        retval->Reset();
-                }
+                    AddPendingTerm(path_it->second, SearchTerm::Criteria::PATH_EXACT);
             }
         }
     }
@@ -3731,34 +4281,25 @@ HRESULT FileFind::FindMatch(MFTRecord* pElt, bool& bStop, FileFind::FoundMatchCa
             auto attr_list = m_SizeTerms.equal_range(ullDataSize);
 
             for (auto attr_it = attr_list.first; attr_it != attr_list.second; ++attr_it)
-            {
-                auto matched =
-                    LookupTermInRecordAddMatching(attr_it->second, SearchTerm::Criteria::SIZE_EQ, retval, pElt);
-                if (matched != SearchTerm::Criteria::NONE)
-                {
-                    // we do have a match!
-                    if (FAILED(hr = EvaluateMatchCallCallback(aCallback, bStop, retval)))
-                        return hr;
-                    retval.reset();
-                }
-                else if (retval != nullptr)
-                    retval->Reset();
-            }
+                AddPendingTerm(attr_it->second, SearchTerm::Criteria::SIZE_EQ);
         }
     }
 
-    for (auto term_it : m_Terms)
+    for (size_t i = 0; i < m_Terms.size(); i++)
+    {
+        if (m_Candidates[i])
+            AddPendingTerm(m_Terms[i], SearchTerm::Criteria::NONE);
+    }
+
+    for (auto& pending : m_PendingTerms)
     {
-        auto matched = LookupTermInRecordAddMatching(term_it, SearchTerm::Criteria::NONE, retval, pElt);
+        auto matched = LookupTermInDataAddMatching(pending.Term, pending.Matched, pending.FileMatch, pElt);
         if (matched != SearchTerm::Criteria::NONE)
         {
             // we do have a match!
-            if (FAILED(hr = EvaluateMatchCallCallback(aCallback, bStop, retval)))
+            if (FAILED(hr = EvaluateMatchCallCallback(aCallback, bStop, pending.FileMatch)))
                 return hr;
-            retval.reset();
         }
-        else if (retval != nullptr)
-            retval->Reset();
     }
 
     return S_OK;
@@ -3814,9 +4355,15 @@ HRESULT FileFind::FindI30Match(const PFILE_NAME pFileName, bool& bStop, FileFind
                 retval->Reset();
         }
     }
-    for (auto term_it = begin(m_Terms); term_it != end(m_Terms); ++term_it)
+    if (!m_Terms.empty())
+        SelectCandidateTerms(pFileName);
+
+    for (size_t i = 0; i < m_Terms.size(); i++)
     {
-        auto matched = LookupTermIn$I30AddMatching(*term_it, SearchTerm::Criteria::NONE, retval, pFileName);
+        if (!m_Candidates[i])
+            continue;
+
+        auto matched = LookupTermIn$I30AddMatching(m_Terms[i], SearchTerm::Criteria::NONE, retval, pFileName);
         if (matched != SearchTerm::Criteria::NONE)
         {
             // we do have a match!
@@ -3991,110 +4538,276 @@ HRESULT FileFind::Find(const LocationSet& locations, FileFind::FoundMatchCallbac
 
     m_NeededHash = GetNeededHashAlgorithms();
 
+    if (FAILED(hr = CompileTerms()))
+        return hr;
+
     if (FAILED(hr = InitializeYara()))
         return hr;
 
+    if (m_dwMaxLocations > 1 && locs.size() > 1)
+        return FindInLocations(locations, locs, aCallback, bParseI30Data);
+
+    std::atomic<bool> bStopAll = false;
     for (const auto& aLoc : locs)
     {
-        HRESULT hr = E_FAIL;
-        MFTWalker walk(_L_);
+        if (bStopAll)
+            break;
+        FindInLocation(aLoc, aCallback, bParseI30Data, bStopAll);
+    }
 
-        m_FullNameBuilder = walk.GetFullNameBuilder();
-        m_InLocationBuilder = walk.GetInLocationBuilder();
+    return S_OK;
+}
+
+HRESULT FileFind::FindInLocation(
+    const std::shared_ptr<Location>& aLoc,
+    FileFind::FoundMatchCallback aCallback,
+    bool bParseI30Data,
+    std::atomic<bool>& bStopAll)
+{
+    HRESULT hr = E_FAIL;
+    MFTWalker walk(_L_);
 
-        m_pVolReader = aLoc->GetReader();
+    walk.SetBaseline(m_pBaseline);
+    walk.SetReadCache(m_cbReadCache);
 
-        if (FAILED(hr = walk.Initialize(aLoc, false)))
+    m_FullNameBuilder = walk.GetFullNameBuilder();
+    m_InLocationBuilder = walk.GetInLocationBuilder();
+
+    m_pVolReader = aLoc->GetReader();
+
+    if (FAILED(hr = walk.Initialize(aLoc, false)))
+    {
+        if (hr == HRESULT_FROM_WIN32(ERROR_FILE_SYSTEM_LIMITATION))
+        {
+            log::Verbose(
+                _L_, L"\tFile system not eligible for volume %s (%lx)\r\n\r\n", aLoc->GetLocation().c_str(), hr);
+        }
+        else
         {
-            if (hr == HRESULT_FROM_WIN32(ERROR_FILE_SYSTEM_LIMITATION))
+            log::Verbose(
+                _L_, L"\tFailed to init walk for volume %s (%lx)\r\n\r\n", aLoc->GetLocation().c_str(), hr);
+        }
+    }
+    else
+    {
+        MFTWalker::Callbacks cbs;
+        auto pCB = aCallback;
+
+        bool bStop = false;
+
+        cbs.ElementCallback =
+            [this, aCallback, &bStop, &bStopAll, &hr](const std::shared_ptr<VolumeReader>& volreader, MFTRecord* pElt) {
+            DBG_UNREFERENCED_PARAMETER(volreader);
+            try
             {
-                log::Verbose(
-                    _L_, L"\tFile system not eligible for volume %s (%lx)\r\n\r\n", aLoc->GetLocation().c_str(), hr);
+                if (bStop || bStopAll)
+                {
+                    // another walk asked to stop, this one ends at the next progress report
+                    bStop = true;
+                    return;
+                }
+                if (pElt)
+                {
+                    if (FAILED(hr = FindMatch(pElt, bStop, aCallback)))
+                    {
+                        log::Error(_L_, hr, L"FindMatch failed\r\n");
+                        pElt->CleanCachedData();
+                        return;
+                    }
+                    pElt->CleanCachedData();
+                    if (bStop)
+                        bStopAll = true;
+                }
             }
-            else
+            catch (WCHAR * e)
             {
-                log::Verbose(
-                    _L_, L"\tFailed to init walk for volume %s (%lx)\r\n\r\n", aLoc->GetLocation().c_str(), hr);
+                log::Error(_L_, E_ABORT, L"\r\nCould not parse record for %s : %s\r\n", nullptr, e);
             }
-        }
-        else
-        {
-            MFTWalker::Callbacks cbs;
-            auto pCB = aCallback;
+            return;
+        };
 
-            bool bStop = false;
+        cbs.ProgressCallback = [&bStop, &bStopAll](ULONG ulProgress) -> HRESULT {
+            if (bStop || bStopAll)
+            {
+                return HRESULT_FROM_WIN32(ERROR_NO_MORE_FILES);
+            }
+            return S_OK;
+        };
 
-            cbs.ElementCallback =
-                [this, aCallback, &bStop, &hr](const std::shared_ptr<VolumeReader>& volreader, MFTRecord* pElt) {
+        if (bParseI30Data && (!m_I30ExactNameTerms.empty() || !m_I30ExactPathTerms.empty() || !m_I30Terms.empty()))
+        {
+            cbs.I30Callback = [this, aCallback, &bStop, &bStopAll, &hr](
+                const std::shared_ptr<VolumeReader>& volreader,
+                MFTRecord* pElt,
+                const PINDEX_ENTRY pEntry,
+                const PFILE_NAME pFileName,
+                bool bCarvedEntry) {
                 DBG_UNREFERENCED_PARAMETER(volreader);
+                DBG_UNREFERENCED_PARAMETER(bCarvedEntry);
+                DBG_UNREFERENCED_PARAMETER(pEntry);
+                DBG_UNREFERENCED_PARAMETER(pElt);
                 try
                 {
-                    if (pElt)
+                    if (bStop || bStopAll)
                     {
-                        if (FAILED(hr = FindMatch(pElt, bStop, aCallback)))
-                        {
-                            log::Error(_L_, hr, L"FindMatch failed\r\n");
-                            pElt->CleanCachedData();
-                            return;
-                        }
-                        pElt->CleanCachedData();
+                        bStop = true;
+                        return;
                     }
+                    if (FAILED(hr = FindI30Match(pFileName, bStop, aCallback)))
+                    {
+                        log::Error(_L_, hr, L"FindI30Match failed\r\n");
+                        return;
+                    }
+                    if (bStop)
+                        bStopAll = true;
                 }
                 catch (WCHAR * e)
                 {
-                    log::Error(_L_, E_ABORT, L"\r\nCould not parse record for %s : %s\r\n", nullptr, e);
+                    log::Error(_L_, E_ABORT, L"\r\nCould not parse record : %s\r\n", e);
                 }
                 return;
             };
+        }
 
-            cbs.ProgressCallback = [&bStop](ULONG ulProgress) -> HRESULT {
-                if (bStop)
-                {
-                    return HRESULT_FROM_WIN32(ERROR_NO_MORE_FILES);
-                }
-                return S_OK;
-            };
+        if (FAILED(hr = walk.Walk(cbs)))
+        {
+            log::Verbose(_L_, L"Failed to walk volume %s (%lx)\r\n", aLoc->GetLocation().c_str(), hr);
+        }
+        else
+        {
+            log::Verbose(_L_, L"Done!\r\n");
+            walk.Statistics(L"Done");
+        }
+    }
 
-            if (bParseI30Data && (!m_I30ExactNameTerms.empty() || !m_I30ExactPathTerms.empty() || !m_I30Terms.empty()))
-            {
-                cbs.I30Callback = [this, aCallback, &bStop, &hr](
-                    const std::shared_ptr<VolumeReader>& volreader,
-                    MFTRecord* pElt,
-                    const PINDEX_ENTRY pEntry,
-                    const PFILE_NAME pFileName,
-                    bool bCarvedEntry) {
-                    DBG_UNREFERENCED_PARAMETER(volreader);
-                    DBG_UNREFERENCED_PARAMETER(bCarvedEntry);
-                    DBG_UNREFERENCED_PARAMETER(pEntry);
-                    DBG_UNREFERENCED_PARAMETER(pElt);
-                    try
-                    {
-                        if (FAILED(hr = FindI30Match(pFileName, bStop, aCallback)))
-                        {
-                            log::Error(_L_, hr, L"FindI30Match failed\r\n");
-                            return;
-                        }
-                    }
-                    catch (WCHAR * e)
-                    {
-                        log::Error(_L_, E_ABORT, L"\r\nCould not parse record : %s\r\n", e);
-                    }
-                    return;
-                };
-            }
+    return hr;
+}
 
-            if (FAILED(hr = walk.Walk(cbs)))
-            {
-                log::Verbose(_L_, L"Failed to walk volume %s (%lx)\r\n", aLoc->GetLocation().c_str(), hr);
-            }
-            else
-            {
-                log::Verbose(_L_, L"Done!\r\n");
-                walk.Statistics(L"Done");
-            }
+std::unique_ptr<FileFind> FileFind::MakeLocationWorker() const
+{
+    auto worker = std::make_unique<FileFind>(_L_, m_bProvideStream, m_MatchHash);
+
+    worker->m_ExactNameTerms = m_ExactNameTerms;
+    worker->m_ExactPathTerms = m_ExactPathTerms;
+    worker->m_SizeTerms = m_SizeTerms;
+    worker->m_Terms = m_Terms;
+
+    worker->m_NameLiterals = m_NameLiterals;
+    worker->m_PathLiterals = m_PathLiterals;
+    worker->m_AlwaysEvaluated = m_AlwaysEvaluated;
+
+    worker->m_I30ExactNameTerms = m_I30ExactNameTerms;
+    worker->m_I30ExactPathTerms = m_I30ExactPathTerms;
+    worker->m_I30Terms = m_I30Terms;
+
+    worker->m_ExcludeNameTerms = m_ExcludeNameTerms;
+    worker->m_ExcludePathTerms = m_ExcludePathTerms;
+    worker->m_ExcludeSizeTerms = m_ExcludeSizeTerms;
+    worker->m_ExcludeTerms = m_ExcludeTerms;
+
+    worker->m_AllTerms = m_AllTerms;
+
+    worker->m_ContainsTerms = m_ContainsTerms;
+    worker->m_ContainsIndex = m_ContainsIndex;
+
+    // compiled rules can be scanned from several threads at once
+    worker->m_YaraScan = m_YaraScan;
+
+    worker->m_bProvideStream = m_bProvideStream;
+    worker->m_NeededHash = m_NeededHash;
+    worker->m_pBaseline = m_pBaseline;
+    worker->m_cbReadCache = m_cbReadCache;
+
+    return worker;
+}
+
+HRESULT FileFind::FindInLocations(
+    const LocationSet& locations,
+    const std::vector<std::shared_ptr<Location>>& locs,
+    FileFind::FoundMatchCallback aCallback,
+    bool bParseI30Data)
+{
+    // shadow copies (and other locations without extents) share the disk of the volume with the same serial number
+    std::map<ULONGLONG, std::wstring> disksOfVolumes;
+    for (const auto& [name, loc] : locations.GetLocations())
+    {
+        const auto& extents = loc->GetExtents();
+        const ULONGLONG ullSerial = loc->SerialNumber();
+
+        if (!extents.empty() && ullSerial != 0LL)
+            disksOfVolumes.emplace(ullSerial, extents.front().GetName());
+    }
+
+    auto diskOf = [&disksOfVolumes](const std::shared_ptr<Location>& loc) -> std::wstring {
+        if (!loc->GetExtents().empty())
+            return loc->GetExtents().front().GetName();
+
+        if (auto it = disksOfVolumes.find(loc->SerialNumber()); it != end(disksOfVolumes))
+            return it->second;
+
+        return loc->GetLocation();
+    };
+
+    Semaphore locationSlots(m_dwMaxLocations);
+    std::map<std::wstring, std::unique_ptr<Semaphore>, CaseInsensitive> diskSlots;
+
+    for (const auto& aLoc : locs)
+    {
+        auto& slots = diskSlots[diskOf(aLoc)];
+        if (slots == nullptr)
+            slots = std::make_unique<Semaphore>(m_dwMaxLocationsPerDisk);
+    }
+
+    log::Verbose(
+        _L_,
+        L"Walking %Iu locations on %Iu disks (at most %d at once, %d per disk)\r\n",
+        locs.size(),
+        diskSlots.size(),
+        m_dwMaxLocations,
+        m_dwMaxLocationsPerDisk);
+
+    // each walk has its own searcher, matches are added and passed to the callback one at a time
+    // once a callback asked to stop, the matches still found by the other walks are dropped
+    Concurrency::critical_section cs;
+    std::atomic<bool> bStopAll = false;
+    auto serializedCallback = [this, &cs, &bStopAll, aCallback](const std::shared_ptr<Match>& aMatch, bool& bStop) {
+        Concurrency::critical_section::scoped_lock sl(cs);
+
+        if (bStopAll)
+        {
+            bStop = true;
+            return;
         }
+
+        m_Matches.push_back(aMatch);
+        if (aCallback)
+            aCallback(aMatch, bStop);
+
+        if (bStop)
+            bStopAll = true;
+    };
+
+    Concurrency::task_group walks;
+
+    for (const auto& aLoc : locs)
+    {
+        Semaphore& diskSlot = *diskSlots[diskOf(aLoc)];
+
+        walks.run([this, aLoc, &diskSlot, &locationSlots, &serializedCallback, &bStopAll, bParseI30Data]() {
+            // waiting for the disk first does not hold a location slot another disk could use
+            Semaphore::ScopedLock diskLock(diskSlot);
+            Semaphore::ScopedLock locationLock(locationSlots);
+
+            if (bStopAll)
+                return;
+
+            auto worker = MakeLocationWorker();
+            worker->FindInLocation(aLoc, serializedCallback, bParseI30Data, bStopAll);
+        });
     }
 
+    walks.wait();
+
     return S_OK;
 }
 
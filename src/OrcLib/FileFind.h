@@ -10,6 +10,7 @@
 #include "OrcLib.h"
 
 #include "CaseInsensitive.h"
+#include "MultiStringMatcher.h"
 
 #include "VolumeReader.h"
 #include "MFTWalker.h"
@@ -20,11 +21,13 @@
 #include "TableOutput.h"
 #include "YaraScanner.h"
 
+#include <algorithm>
 #include <string>
 #include <unordered_map>
 #include <vector>
 #include <iterator>
 #include <regex>
+#include <atomic>
 
 #pragma managed(push, off)
 
@@ -363,10 +366,31 @@ public:
     HRESULT AddExcludeTermsFromConfig(const ConfigItem& items);
     HRESULT AddExcludeTerm(const std::shared_ptr<SearchTerm>& FindSpec);
 
+    // Walks up to dwMaxLocations locations at once (the default of 1 walks them one after the other) but never more
+    // than dwMaxPerDisk locations stored on the same physical disk (shadow copies are stored with their volume).
+    // Matches are still added and passed to the callback one at a time.
+    void SetParallelLocations(DWORD dwMaxLocations, DWORD dwMaxPerDisk = 1L)
+    {
+        m_dwMaxLocations = std::max(dwMaxLocations, 1UL);
+        m_dwMaxLocationsPerDisk = std::max(dwMaxPerDisk, 1UL);
+    }
+
+    // Records identical to the ones of the first walk of their volume (like most records of its shadow copies) are
+    // not searched again by walks sharing this baseline
+    void SetBaseline(std::shared_ptr<MFTBaseline> pBaseline) { m_pBaseline = std::move(pBaseline); }
+
+    // Clusters read to parse the MFT, its indexes and attribute lists are cached within cbBudget bytes per location
+    void SetReadCache(size_t cbBudget) { m_cbReadCache = cbBudget; }
+
     HRESULT Find(const LocationSet& locations, FoundMatchCallback aCallback, bool bParseI30Data);
 
     const std::vector<std::shared_ptr<Match>>& Matches() const { return m_Matches; }
 
+    // Longest literal piece every name matching the pattern has to contain (empty when there is none), used to only
+    // evaluate the terms whose piece is found in the names of a record
+    static std::wstring WildcardLiteral(const std::wstring& strPattern);
+    static std::wstring RegexLiteral(const std::wstring& strRegex);
+
     void PrintSpecs() const;
 
     ~FileFind(void);
@@ -386,6 +410,13 @@ private:
     TermMapOfSizes m_SizeTerms;
     std::vector<std::shared_ptr<SearchTerm>> m_Terms;
 
+    // Literal pieces of the name and path criteria of m_Terms: a term with such a piece is only evaluated when it
+    // occurs in one of the names (or paths) of the record
+    MultiStringMatcher m_NameLiterals;
+    MultiStringMatcher m_PathLiterals;
+    std::vector<BYTE> m_AlwaysEvaluated;  // per term of m_Terms, 1 when the term has no literal piece
+    std::vector<BYTE> m_Candidates;
+
     TermMapOfNames m_I30ExactNameTerms;
     TermMapOfNames m_I30ExactPathTerms;
     std::vector<std::shared_ptr<SearchTerm>> m_I30Terms;
@@ -398,6 +429,48 @@ private:
 
     std::vector<std::shared_ptr<SearchTerm>> m_AllTerms;
 
+    // Content criteria (headers, hashes, contains and yara) of the terms pending for a record are all evaluated
+    // in a single read of each of its data attributes
+    struct PendingData
+    {
+        DWORD dwHeaderLen = 0L;
+        bool bHash = false;
+        bool bYara = false;
+        std::vector<BYTE> Contains;  // per term of m_ContainsTerms
+
+        bool IsEmpty() const
+        {
+            return dwHeaderLen == 0L && !bHash && !bYara
+                && std::find(std::cbegin(Contains), std::cend(Contains), 1) == std::cend(Contains);
+        }
+    };
+
+    struct DataEvaluation
+    {
+        HRESULT hr = E_FAIL;
+        CBinaryBuffer Header;  // may be shorter than dwHeaderLen when the data is shorter
+        DWORD dwHeaderLen = 0L;
+        std::vector<BYTE> ContainsEvaluated;
+        std::vector<BYTE> ContainsFound;
+        bool bYaraScanned = false;
+        MatchingRuleCollection YaraRules;
+    };
+
+    std::vector<std::shared_ptr<SearchTerm>> m_ContainsTerms;
+    std::unordered_map<const SearchTerm*, DWORD> m_ContainsIndex;
+
+    // Terms of the current record whose criteria other than data matched, in the order they are evaluated
+    struct PendingTerm
+    {
+        std::shared_ptr<SearchTerm> Term;
+        SearchTerm::Criteria Matched;
+        std::shared_ptr<Match> FileMatch;
+    };
+
+    PendingData m_PendingData;
+    std::vector<PendingTerm> m_PendingTerms;
+    mutable std::unordered_map<const DataAttribute*, DataEvaluation> m_DataEvaluations;
+
     static std::wregex& DOSPattern();
     static std::wregex& RegexPattern();
     static std::wregex& RegexOnlyPattern();
@@ -408,7 +481,7 @@ private:
     MFTWalker::InLocationBuilder m_InLocationBuilder;
     std::shared_ptr<VolumeReader> m_pVolReader;
 
-    std::unique_ptr<YaraScanner> m_YaraScan;
+    std::shared_ptr<YaraScanner> m_YaraScan;
 
     std::vector<std::shared_ptr<Match>> m_Matches;
 
@@ -417,7 +490,22 @@ private:
 
     CryptoHashStream::Algorithm m_NeededHash = CryptoHashStream::Algorithm::Undefined;
 
+    std::shared_ptr<MFTBaseline> m_pBaseline;
+    size_t m_cbReadCache = 0L;
+
+    DWORD m_dwMaxLocations = 1L;
+    DWORD m_dwMaxLocationsPerDisk = 1L;
+
     SearchTerm::Criteria DiscriminateName(const std::wstring& strName);
+
+    void AddToTerms(const std::shared_ptr<SearchTerm>& aTerm);
+    HRESULT CompileTerms();
+    void SelectCandidateTerms(MFTRecord* pElt);
+    void SelectCandidateTerms(const PFILE_NAME pFileName);
+
+    void ResetPendingData();
+    void AddPendingData(const std::shared_ptr<SearchTerm>& aTerm);
+    const DataEvaluation& EvaluateData(const std::shared_ptr<DataAttribute>& pDataAttr) const;
     SearchTerm::Criteria DiscriminateADS(const std::wstring& strADS);
     SearchTerm::Criteria DiscriminateEA(const std::wstring& strEA);
 
@@ -548,11 +636,16 @@ private:
         SearchTerm::Criteria required,
         const std::shared_ptr<Match>& aFileMatch) const;
 
-    SearchTerm::Criteria LookupTermInRecordAddMatching(
+    bool LookupTermInRecordAddMatchingWithoutData(
+        const std::shared_ptr<SearchTerm>& aTerm,
+        SearchTerm::Criteria& matched,
+        std::shared_ptr<Match>& aMatch,
+        MFTRecord* pElt) const;  // matches against a MFTRecord all but the data criteria
+    SearchTerm::Criteria LookupTermInDataAddMatching(
         const std::shared_ptr<SearchTerm>& aTerm,
         const SearchTerm::Criteria matched,
         std::shared_ptr<Match>& aMatch,
-        MFTRecord* pElt) const;  // matches against a MFTRecord
+        MFTRecord* pElt) const;  // matches the data criteria and completes the match
     SearchTerm::Criteria LookupTermIn$I30AddMatching(
         const std::shared_ptr<SearchTerm>& aTerm,
         const SearchTerm::Criteria matched,
@@ -575,6 +668,21 @@ private:
 
     HRESULT FindI30Match(const PFILE_NAME pFileName, bool& bStop, FileFind::FoundMatchCallback aCallback);
 
+    // bStopAll is shared by all the walks of a Find: a stop requested by a callback ends them all
+    HRESULT FindInLocation(
+        const std::shared_ptr<Location>& aLoc,
+        FileFind::FoundMatchCallback aCallback,
+        bool bParseI30Data,
+        std::atomic<bool>& bStopAll);
+    HRESULT FindInLocations(
+        const LocationSet& locations,
+        const std::vector<std::shared_ptr<Location>>& locs,
+        FileFind::FoundMatchCallback aCallback,
+        bool bParseI30Data);
+
+    // a searcher sharing the terms and the yara scanner of this one, with its own walk state
+    std::unique_ptr<FileFind> MakeLocationWorker() const;
+
     CryptoHashStream::Algorithm GetNeededHashAlgorithms();
 };
 
@@ -20,6 +20,7 @@ FileMappingStream::Open(_In_ HANDLE hFile, _In_ DWORD flProtect, _In_ ULONGLONG
     liMaxSize.QuadPart = ullMaximumSize;
 
     m_dwProtect = flProtect;
+    m_bZeroInitialized = hFile == INVALID_HANDLE_VALUE;
 
     switch (m_dwProtect)
     {
@@ -143,6 +144,24 @@ HRESULT FileMappingStream::Write(
     return S_OK;
 }
 
+HRESULT FileMappingStream::WriteZeroes(__in ULONGLONG cbBytes, __out_opt PULONGLONG pcbBytesWritten)
+{
+    HRESULT hr = E_FAIL;
+
+    if (!m_bZeroInitialized || m_ullCurrentPosition < m_ullDataSize)
+        return ByteStream::WriteZeroes(cbBytes, pcbBytesWritten);
+
+    if (pcbBytesWritten)
+        *pcbBytesWritten = 0LL;
+
+    if (FAILED(hr = SetFilePointer(m_ullCurrentPosition + cbBytes, FILE_BEGIN, NULL)))
+        return hr;
+
+    if (pcbBytesWritten)
+        *pcbBytesWritten = cbBytes;
+    return S_OK;
+}
+
 HRESULT FileMappingStream::SetFilePointer(
     __in LONGLONG DistanceToMove,
     __in DWORD dwMoveMethod,
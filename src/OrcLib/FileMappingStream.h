@@ -29,6 +29,8 @@ private:
     DWORD m_dwViewProtect;
     DWORD m_dwPageProtect;
 
+    bool m_bZeroInitialized;  // backed by the paging file: pages never written read as zeroes
+
     HRESULT CommitSize(ULONGLONG ullNewSize);
 
 public:
@@ -41,7 +43,8 @@ public:
         , m_dwViewProtect(0L)
         , m_ullCommittedSize(0LL)
         , m_ullCurrentPosition(0LL)
-        , m_ullDataSize(0LL) {};
+        , m_ullDataSize(0LL)
+        , m_bZeroInitialized(false) {};
 
     STDMETHOD(IsOpen)() { return m_hMapping != INVALID_HANDLE_VALUE ? S_OK : S_FALSE; };
     STDMETHOD(CanRead)() { return S_OK; };
@@ -58,6 +61,9 @@ public:
     STDMETHOD(Write)
     (__in_bcount(cbBytes) const PVOID pBuffer, __in ULONGLONG cbBytes, __out_opt PULONGLONG pcbBytesWritten);
 
+    // Past the data written to a mapping of the paging file, zeroes are skipped over
+    STDMETHOD(WriteZeroes)(__in ULONGLONG cbBytes, __out_opt PULONGLONG pcbBytesWritten);
+
     STDMETHOD(SetFilePointer)
     (__in LONGLONG DistanceToMove, __in DWORD dwMoveMethod, __out_opt PULONG64 pCurrPointer);
 
@@ -16,6 +16,8 @@
 #    include "ssdeep/fuzzy.h"
 #endif // ORC_BUILD_SSDEEP
 
+#include <ppl.h>
+
 using namespace Orc;
 
 FuzzyHashStream::Algorithm FuzzyHashStream::GetSupportedAlgorithm(LPCWSTR szAlgo)
@@ -137,6 +139,17 @@ HRESULT FuzzyHashStream::ResetHash(bool bContinue)
 
 HRESULT FuzzyHashStream::HashData(LPBYTE pBuffer, DWORD dwBytesToHash)
 {
+#ifdef ORC_BUILD_SSDEEP
+    if (m_tlsh && m_ssdeep && dwBytesToHash >= PARALLEL_HASH_THRESHOLD)
+    {
+        bool bFailed = false;
+        Concurrency::parallel_invoke(
+            [&]() { m_tlsh->update(pBuffer, dwBytesToHash); },
+            [&]() { bFailed = fuzzy_update(m_ssdeep, pBuffer, dwBytesToHash) != 0; });
+        return bFailed ? E_FAIL : S_OK;
+    }
+#endif  // ORC_BUILD_SSDEEP
+
     if (m_tlsh)
     {
         m_tlsh->update(pBuffer, dwBytesToHash);
@@ -8,6 +8,8 @@
 #include "stdafx.h"
 #include "HashStream.h"
 
+#include <ppl.h>
+
 using namespace Orc;
 
 HRESULT HashStream::Read(
@@ -65,9 +67,6 @@ HRESULT HashStream::Write(
         return E_INVALIDARG;
     }
 
-    if (FAILED(hr = HashData((LPBYTE)pWriteBuffer, (DWORD)cbBytesToWrite)))
-        return hr;
-
     if (m_pChainedStream != nullptr && m_bWriteOnly)
     {
         ULONGLONG cbBytesWritten = 0;
@@ -75,13 +74,37 @@ HRESULT HashStream::Write(
         if (m_pChainedStream->CanWrite() != S_OK)
             return HRESULT_FROM_WIN32(ERROR_INVALID_ACCESS);
 
-        if (FAILED(hr = m_pChainedStream->Write(pWriteBuffer, cbBytesToWrite, &cbBytesWritten)))
-            return hr;
+        if (cbBytesToWrite >= PARALLEL_HASH_THRESHOLD)
+        {
+            // the chained stream (often another hash stream) consumes the buffer while it is hashed
+            HRESULT hrHash = S_OK;
+            Concurrency::parallel_invoke(
+                [&]() { hrHash = HashData((LPBYTE)pWriteBuffer, (DWORD)cbBytesToWrite); },
+                [&]() { hr = m_pChainedStream->Write(pWriteBuffer, cbBytesToWrite, &cbBytesWritten); });
+
+            if (FAILED(hrHash))
+                return hrHash;
+            if (FAILED(hr))
+                return hr;
+        }
+        else
+        {
+            if (FAILED(hr = HashData((LPBYTE)pWriteBuffer, (DWORD)cbBytesToWrite)))
+                return hr;
+
+            if (FAILED(hr = m_pChainedStream->Write(pWriteBuffer, cbBytesToWrite, &cbBytesWritten)))
+                return hr;
+        }
 
         *pcbBytesWritten = cbBytesWritten;
     }
     else
+    {
+        if (FAILED(hr = HashData((LPBYTE)pWriteBuffer, (DWORD)cbBytesToWrite)))
+            return hr;
+
         *pcbBytesWritten = cbBytesToWrite;
+    }
 
     return S_OK;
 }
@@ -17,6 +17,10 @@ namespace Orc {
 class HashStream : public ChainingStream
 {
 protected:
+    // Buffers of this size or more are hashed by each algorithm on its own worker, and concurrently with the chained
+    // stream's Write. Smaller ones are not worth the scheduling.
+    static constexpr DWORD PARALLEL_HASH_THRESHOLD = 64 * 1024;
+
     bool m_bHashIsValid;
     bool m_bWriteOnly;
 
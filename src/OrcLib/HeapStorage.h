@@ -75,7 +75,9 @@ public:
         if (cell)
         {
             m_NumberOfAllocatedCells--;
-            _ASSERT(HeapFree(m_heap, 0L, cell));
+            const auto bFreed = HeapFree(m_heap, 0L, cell);
+            _ASSERT(bFreed);
+            DBG_UNREFERENCED_LOCAL_VARIABLE(bFreed);
         }
     }
 
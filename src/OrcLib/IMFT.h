@@ -9,6 +9,8 @@
 
 #include "OrcLib.h"
 #include "MFTUtils.h"
+#include "MFTReadAhead.h"
+#include "MFTFetcher.h"
 
 #pragma managed(push, off)
 
@@ -28,6 +30,27 @@ public:
 
     virtual ULONG GetMFTRecordCount() const PURE;
     virtual MFTUtils::SafeMFTSegmentNumber GetUSNRoot() const PURE;
+
+    // Number of FRS per read and number of reads queued ahead while enumerating (0 means default, depth 1 is synchronous)
+    void SetReadAhead(DWORD dwFRSPerRead, DWORD dwQueueDepth)
+    {
+        m_dwFRSPerRead = dwFRSPerRead;
+        m_dwQueueDepth = dwQueueDepth;
+    }
+
+    // Maximum number of unwanted FRS read to merge two fetched records and number of fetched FRS kept in cache
+    void SetFetchOptions(DWORD dwGapThreshold, DWORD dwCacheSize)
+    {
+        m_dwFetchGapThreshold = dwGapThreshold;
+        m_dwFetchCacheSize = dwCacheSize;
+    }
+
+protected:
+    DWORD m_dwFRSPerRead = MFTReadAhead::DEFAULT_FRS_PER_READ;
+    DWORD m_dwQueueDepth = MFTReadAhead::DEFAULT_QUEUE_DEPTH;
+
+    DWORD m_dwFetchGapThreshold = MFTFetcher::DEFAULT_GAP_THRESHOLD;
+    DWORD m_dwFetchCacheSize = MFTFetcher::DEFAULT_CACHE_SIZE;
 };  // IMFT
 
 }  // namespace Orc
@@ -0,0 +1,86 @@
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+//
+// Copyright © 2011-2019 ANSSI. All Rights Reserved.
+//
+// Author(s): Jean Gautier (ANSSI)
+//
+#include "StdAfx.h"
+
+#include "MFTBaseline.h"
+
+#include "NtfsDataStructures.h"
+
+using namespace Orc;
+
+MFTBaseline::Digest MFTBaseline::GetDigest(const BYTE* pFRS, ULONG ulBytesPerFRS)
+{
+    // FNV-1a over 64 bit words, folded after each word so that changes in the upper bits are mixed as well
+    constexpr ULONGLONG FNV_OFFSET_BASIS = 14695981039346656037ULL;
+    constexpr ULONGLONG FNV_PRIME = 1099511628211ULL;
+
+    Digest digest;
+    ULONGLONG ullHash = FNV_OFFSET_BASIS;
+
+    const ULONG ulWords = ulBytesPerFRS / sizeof(ULONGLONG);
+    for (ULONG i = 0; i < ulWords; i++)
+    {
+        ULONGLONG ullWord = 0LL;
+        memcpy(&ullWord, pFRS + i * sizeof(ULONGLONG), sizeof(ULONGLONG));
+        ullHash = (ullHash ^ ullWord) * FNV_PRIME;
+        ullHash ^= ullHash >> 32;
+    }
+    for (ULONG i = ulWords * sizeof(ULONGLONG); i < ulBytesPerFRS; i++)
+    {
+        ullHash = (ullHash ^ pFRS[i]) * FNV_PRIME;
+    }
+
+    digest.ullHash = ullHash != 0LL ? ullHash : 1LL;
+
+    if (ulBytesPerFRS >= sizeof(FILE_RECORD_SEGMENT_HEADER))
+    {
+        // Reserved1 holds the LSN of the last logged change to the record
+        auto pHeader = reinterpret_cast<const FILE_RECORD_SEGMENT_HEADER*>(pFRS);
+        digest.llLSN = static_cast<LONGLONG>(pHeader->Reserved1);
+    }
+    return digest;
+}
+
+MFTBaseline::Role MFTBaseline::BeginWalk(
+    ULONGLONG ullVolumeSerial,
+    Location::Type locationType,
+    std::shared_ptr<const Digests>& baseline)
+{
+    Concurrency::critical_section::scoped_lock sl(m_cs);
+
+    if (locationType != Location::Type::Snapshot)
+    {
+        // the unchanged records of a live volume are never skipped, only its first walk builds the baseline
+        auto [it, bInserted] = m_Volumes.try_emplace(ullVolumeSerial);
+        return bInserted ? Role::Build : Role::None;
+    }
+
+    // a snapshot walked before its volume is walked in full
+    auto it = m_Volumes.find(ullVolumeSerial);
+    if (it == end(m_Volumes) || !it->second.bComplete)
+        return Role::None;
+
+    baseline = it->second.pDigests;
+    return Role::Compare;
+}
+
+void MFTBaseline::EndWalk(ULONGLONG ullVolumeSerial, std::shared_ptr<const Digests> digests)
+{
+    Concurrency::critical_section::scoped_lock sl(m_cs);
+
+    if (digests == nullptr)
+    {
+        // another walk of this volume may build the baseline
+        m_Volumes.erase(ullVolumeSerial);
+        return;
+    }
+
+    auto& volume = m_Volumes[ullVolumeSerial];
+    volume.pDigests = std::move(digests);
+    volume.bComplete = true;
+}
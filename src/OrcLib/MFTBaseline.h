@@ -0,0 +1,77 @@
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+//
+// Copyright © 2011-2019 ANSSI. All Rights Reserved.
+//
+// Author(s): Jean Gautier (ANSSI)
+//
+#pragma once
+
+#include "OrcLib.h"
+
+#include "Location.h"
+
+#include <concrt.h>
+
+#include <map>
+#include <memory>
+#include <vector>
+
+#pragma managed(push, off)
+
+namespace Orc {
+
+// Digests (hash and LSN) of the FRS read by the walk of each live volume, shared by the walkers of a collection.
+// Walks of the shadow copies of a volume (same volume serial number) starting once its baseline is complete only call
+// back the records that differ from this baseline. A shadow copy never builds the baseline and the volume itself never
+// compares to it, whatever order the locations are walked in.
+// Only FRS are compared: data stored out of the FRS (non resident data or index buffers) of an unchanged record is
+// assumed to be unchanged as well.
+class ORCLIB_API MFTBaseline
+{
+public:
+    struct Digest
+    {
+        ULONGLONG ullHash = 0LL;  // 0 when the FRS was not read
+        LONGLONG llLSN = 0LL;
+
+        bool IsValid() const { return ullHash != 0LL; }
+        bool operator==(const Digest& other) const { return ullHash == other.ullHash && llLSN == other.llLSN; }
+    };
+
+    using Digests = std::vector<Digest>;  // indexed by segment number
+
+    enum class Role
+    {
+        None,  // the baseline of the volume is not available to this walk
+        Build,
+        Compare
+    };
+
+    static Digest GetDigest(const BYTE* pFRS, ULONG ulBytesPerFRS);
+
+    MFTBaseline() = default;
+    MFTBaseline(const MFTBaseline&) = delete;
+    MFTBaseline& operator=(const MFTBaseline&) = delete;
+
+    // The first walk of a volume that is not a snapshot builds its baseline, the walks of snapshots starting once it
+    // is complete compare to it
+    Role BeginWalk(ULONGLONG ullVolumeSerial, Location::Type locationType, std::shared_ptr<const Digests>& baseline);
+
+    // Publishes the digests of a walk that was building the baseline (nullptr if it did not complete)
+    void EndWalk(ULONGLONG ullVolumeSerial, std::shared_ptr<const Digests> digests);
+
+private:
+    struct Volume
+    {
+        bool bComplete = false;
+        std::shared_ptr<const Digests> pDigests;
+    };
+
+    Concurrency::critical_section m_cs;
+    std::map<ULONGLONG, Volume> m_Volumes;
+};
+
+}  // namespace Orc
+
+#pragma managed(pop)
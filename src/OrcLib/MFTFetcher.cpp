@@ -0,0 +1,256 @@
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+//
+// Copyright © 2011-2019 ANSSI. All Rights Reserved.
+//
+// Author(s): Jean Gautier (ANSSI)
+//
+#include "StdAfx.h"
+
+#include "MFTFetcher.h"
+#include "LogFileWriter.h"
+
+using namespace Orc;
+
+MFTFetcher::MFTFetcher(logger pLog, ULONG ulBytesPerFRS, LocateCall pLocate, ReadCall pRead)
+    : _L_(std::move(pLog))
+    , m_ulBytesPerFRS(ulBytesPerFRS)
+    , m_pLocate(std::move(pLocate))
+    , m_pRead(std::move(pRead))
+    , m_ReadBuffer(true)
+{
+}
+
+void MFTFetcher::SetCacheSize(DWORD dwCacheSize)
+{
+    m_dwCacheSize = dwCacheSize;
+
+    while (m_Cache.size() > m_dwCacheSize)
+    {
+        m_CacheIndex.erase(m_Cache.back().first);
+        m_Cache.pop_back();
+    }
+}
+
+const CBinaryBuffer* MFTFetcher::FindInCache(ULONGLONG ullSegmentNumber)
+{
+    auto it = m_CacheIndex.find(ullSegmentNumber);
+    if (it == end(m_CacheIndex))
+        return nullptr;
+
+    // most recently used entries are kept in front
+    m_Cache.splice(begin(m_Cache), m_Cache, it->second);
+    return &it->second->second;
+}
+
+void MFTFetcher::AddToCache(ULONGLONG ullSegmentNumber, const BYTE* pFRS)
+{
+    if (m_dwCacheSize == 0)
+        return;
+
+    auto it = m_CacheIndex.find(ullSegmentNumber);
+    if (it != end(m_CacheIndex))
+    {
+        m_Cache.splice(begin(m_Cache), m_Cache, it->second);
+    }
+    else
+    {
+        if (m_Cache.size() >= m_dwCacheSize)
+        {
+            // recycle the least recently used entry
+            m_CacheIndex.erase(m_Cache.back().first);
+            m_Cache.splice(begin(m_Cache), m_Cache, std::prev(end(m_Cache)));
+            m_Cache.front().first = ullSegmentNumber;
+        }
+        else
+        {
+            m_Cache.emplace_front(ullSegmentNumber, CBinaryBuffer());
+        }
+        m_CacheIndex[ullSegmentNumber] = begin(m_Cache);
+    }
+
+    auto& buffer = m_Cache.front().second;
+    if (!buffer.CheckCount(m_ulBytesPerFRS))
+    {
+        m_CacheIndex.erase(ullSegmentNumber);
+        m_Cache.pop_front();
+        return;
+    }
+    CopyMemory(buffer.GetData(), pFRS, m_ulBytesPerFRS);
+}
+
+HRESULT MFTFetcher::Deliver(
+    const MFT_SEGMENT_REFERENCE& frn,
+    const BYTE* pFRS,
+    MFTUtils::EnumMFTRecordCall& pCallBack,
+    bool& bDelivered)
+{
+    HRESULT hr = E_FAIL;
+
+    bDelivered = false;
+
+    PFILE_RECORD_SEGMENT_HEADER pHeader = (PFILE_RECORD_SEGMENT_HEADER)pFRS;
+
+    if ((pHeader->MultiSectorHeader.Signature[0] != 'F') || (pHeader->MultiSectorHeader.Signature[1] != 'I')
+        || (pHeader->MultiSectorHeader.Signature[2] != 'L') || (pHeader->MultiSectorHeader.Signature[3] != 'E'))
+    {
+        log::Verbose(
+            _L_,
+            L"Skipping... MultiSectorHeader.Signature is not FILE - \"%c%c%c%c\".\r\n",
+            pHeader->MultiSectorHeader.Signature[0],
+            pHeader->MultiSectorHeader.Signature[1],
+            pHeader->MultiSectorHeader.Signature[2],
+            pHeader->MultiSectorHeader.Signature[3]);
+        return S_OK;
+    }
+
+    MFT_SEGMENT_REFERENCE read_record_frn = {0};
+    read_record_frn.SegmentNumberHighPart = pHeader->SegmentNumberHighPart;
+    read_record_frn.SegmentNumberLowPart = pHeader->SegmentNumberLowPart;
+    read_record_frn.SequenceNumber = pHeader->SequenceNumber;
+
+    if (NtfsSegmentNumber(&read_record_frn) != NtfsSegmentNumber(&frn))
+    {
+        log::Verbose(
+            _L_,
+            L"Skipping... %I64X does not match the expected %I64X\r\n",
+            NtfsSegmentNumber(&read_record_frn),
+            NtfsSegmentNumber(&frn));
+        return S_OK;
+    }
+    if (read_record_frn.SequenceNumber != frn.SequenceNumber)
+    {
+        log::Verbose(
+            _L_,
+            L"Skipping... Sequence numbed %d does not match the expected %d\r\n",
+            read_record_frn.SequenceNumber,
+            frn.SequenceNumber);
+        return S_OK;
+    }
+
+    MFTUtils::SafeMFTSegmentNumber ullRecordIndex = NtfsSegmentNumber(&frn);
+    CBinaryBuffer record((LPBYTE)pFRS, m_ulBytesPerFRS);
+
+    bDelivered = true;
+
+    if (FAILED(hr = pCallBack(ullRecordIndex, record)))
+    {
+        if (hr == E_OUTOFMEMORY)
+        {
+            log::Error(_L_, hr, L"Add Record Callback failed, not enough memory to continue\r\n");
+            return hr;
+        }
+        else if (hr == HRESULT_FROM_WIN32(ERROR_NO_MORE_FILES))
+        {
+            log::Verbose(_L_, L"Add Record Callback asks for enumeration to stop...\r\n");
+            return hr;
+        }
+        log::Verbose(_L_, L"WARNING: Add Record Callback failed\r\n");
+    }
+    return S_OK;
+}
+
+HRESULT MFTFetcher::Fetch(std::vector<MFT_SEGMENT_REFERENCE>& frn, MFTUtils::EnumMFTRecordCall pCallBack)
+{
+    HRESULT hr = E_FAIL;
+
+    if (pCallBack == nullptr)
+        return E_POINTER;
+    if (frn.empty())
+        return S_OK;
+    if (m_ulBytesPerFRS == 0)
+        return E_INVALIDARG;
+
+    std::sort(begin(frn), end(frn), [](const MFT_SEGMENT_REFERENCE& left, const MFT_SEGMENT_REFERENCE& rigth) -> bool {
+        if (left.SegmentNumberHighPart != rigth.SegmentNumberHighPart)
+            return left.SegmentNumberHighPart < rigth.SegmentNumberHighPart;
+        return left.SegmentNumberLowPart < rigth.SegmentNumberLowPart;
+    });
+
+    // references that are not delivered (not located, not read, reused segments) are left in frn
+    std::vector<bool> delivered(frn.size(), false);
+    bool bDelivered = false;
+
+    size_t idx = 0;
+    while (idx < frn.size())
+    {
+        const ULONGLONG ullFirst = NtfsSegmentNumber(&frn[idx]);
+
+        if (auto pCached = FindInCache(ullFirst))
+        {
+            m_ullCacheHits++;
+            if (FAILED(hr = Deliver(frn[idx], pCached->GetData(), pCallBack, bDelivered)))
+                return hr;
+            delivered[idx] = bDelivered;
+            idx++;
+            continue;
+        }
+
+        ULONGLONG ullOffset = 0LL;
+        ULONGLONG ullContiguousFRS = 0LL;
+        if (!m_pLocate(ullFirst, ullOffset, ullContiguousFRS) || ullContiguousFRS == 0LL)
+        {
+            log::Verbose(_L_, L"Skipping... %I64X is not located in the MFT\r\n", ullFirst);
+            idx++;
+            continue;
+        }
+
+        // merge the following references as long as they are close enough and in the same extent
+        size_t last = idx;
+        ULONGLONG ullLast = ullFirst;
+        while (last + 1 < frn.size())
+        {
+            const ULONGLONG ullNext = NtfsSegmentNumber(&frn[last + 1]);
+
+            if (ullNext - ullLast > (ULONGLONG)m_dwGapThreshold + 1)
+                break;
+            if (ullNext - ullFirst >= ullContiguousFRS || ullNext - ullFirst >= MAX_FRS_PER_FETCH)
+                break;
+
+            last++;
+            ullLast = ullNext;
+        }
+
+        const ULONGLONG ullBytesToRead = (ullLast - ullFirst + 1) * m_ulBytesPerFRS;
+
+        if (!m_ReadBuffer.CheckCount(static_cast<size_t>(ullBytesToRead)))
+            return E_OUTOFMEMORY;
+
+        ULONGLONG ullBytesRead = 0LL;
+        m_ullReads++;
+        if (FAILED(hr = m_pRead(ullOffset, m_ReadBuffer, ullBytesToRead, ullBytesRead)))
+        {
+            log::Error(_L_, hr, L"Failed to read %I64d bytes from at position %I64d\r\n", ullBytesToRead, ullOffset);
+            idx = last + 1;
+            continue;
+        }
+
+        for (; idx <= last; idx++)
+        {
+            const ULONGLONG ullFRSOffset = (NtfsSegmentNumber(&frn[idx]) - ullFirst) * m_ulBytesPerFRS;
+
+            if (ullFRSOffset + m_ulBytesPerFRS > ullBytesRead)
+            {
+                log::Verbose(_L_, L"Skipping... %I64X could not be read\r\n", NtfsSegmentNumber(&frn[idx]));
+                continue;
+            }
+
+            const BYTE* pFRS = m_ReadBuffer.GetData() + ullFRSOffset;
+
+            AddToCache(NtfsSegmentNumber(&frn[idx]), pFRS);
+
+            if (FAILED(hr = Deliver(frn[idx], pFRS, pCallBack, bDelivered)))
+                return hr;
+            delivered[idx] = bDelivered;
+        }
+    }
+
+    size_t remaining = 0;
+    for (idx = 0; idx < frn.size(); idx++)
+    {
+        if (!delivered[idx])
+            frn[remaining++] = frn[idx];
+    }
+    frn.resize(remaining);
+    return S_OK;
+}
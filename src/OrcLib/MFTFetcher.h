@@ -0,0 +1,83 @@
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+//
+// Copyright © 2011-2019 ANSSI. All Rights Reserved.
+//
+// Author(s): Jean Gautier (ANSSI)
+//
+#pragma once
+
+#include "OrcLib.h"
+
+#include "MFTUtils.h"
+#include "BinaryBuffer.h"
+
+#include <functional>
+#include <list>
+#include <unordered_map>
+#include <vector>
+
+#pragma managed(push, off)
+
+namespace Orc {
+
+class LogFileWriter;
+
+// Fetches FRS by reference: neighbouring references are read at once and recently read FRS are kept in a LRU cache
+class ORCLIB_API MFTFetcher
+{
+public:
+    static constexpr DWORD DEFAULT_GAP_THRESHOLD = 16;
+    static constexpr DWORD DEFAULT_CACHE_SIZE = 256;
+    static constexpr DWORD MAX_FRS_PER_FETCH = 128;
+
+    // Returns the offset of a segment and the number of FRS that follow it contiguously (false if it cannot be read)
+    using LocateCall =
+        std::function<bool(ULONGLONG ullSegmentNumber, ULONGLONG& ullOffset, ULONGLONG& ullContiguousFRS)>;
+    using ReadCall = std::function<
+        HRESULT(ULONGLONG ullOffset, CBinaryBuffer& buffer, ULONGLONG ullBytesToRead, ULONGLONG& ullBytesRead)>;
+
+    MFTFetcher(logger pLog, ULONG ulBytesPerFRS, LocateCall pLocate, ReadCall pRead);
+
+    // Maximum number of unwanted FRS read to merge two wanted ones into a single read
+    void SetGapThreshold(DWORD dwGapThreshold) { m_dwGapThreshold = dwGapThreshold; }
+    // Number of FRS kept in cache (0 disables the cache)
+    void SetCacheSize(DWORD dwCacheSize);
+
+    // Delivered references are removed from frn, the ones that could not be found are left in it
+    HRESULT Fetch(std::vector<MFT_SEGMENT_REFERENCE>& frn, MFTUtils::EnumMFTRecordCall pCallBack);
+
+    ULONGLONG CacheHits() const { return m_ullCacheHits; }
+    ULONGLONG Reads() const { return m_ullReads; }
+
+private:
+    logger _L_;
+    ULONG m_ulBytesPerFRS = 0L;
+    LocateCall m_pLocate;
+    ReadCall m_pRead;
+
+    DWORD m_dwGapThreshold = DEFAULT_GAP_THRESHOLD;
+    DWORD m_dwCacheSize = DEFAULT_CACHE_SIZE;
+
+    using CacheEntry = std::pair<ULONGLONG, CBinaryBuffer>;
+    std::list<CacheEntry> m_Cache;
+    std::unordered_map<ULONGLONG, std::list<CacheEntry>::iterator> m_CacheIndex;
+
+    CBinaryBuffer m_ReadBuffer;
+
+    ULONGLONG m_ullCacheHits = 0LL;
+    ULONGLONG m_ullReads = 0LL;
+
+    const CBinaryBuffer* FindInCache(ULONGLONG ullSegmentNumber);
+    void AddToCache(ULONGLONG ullSegmentNumber, const BYTE* pFRS);
+
+    HRESULT Deliver(
+        const MFT_SEGMENT_REFERENCE& frn,
+        const BYTE* pFRS,
+        MFTUtils::EnumMFTRecordCall& pCallBack,
+        bool& bDelivered);
+};
+
+}  // namespace Orc
+
+#pragma managed(pop)
@@ -31,6 +31,42 @@ HRESULT MFTOffline::Initialize()
     return S_OK;
 }
 
+namespace {
+
+// Positional read: the handles share their file pointer with the handles they were duplicated from
+HRESULT ReadAt(HANDLE hFile, ULONGLONG ullOffset, CBinaryBuffer& buffer, ULONGLONG ullBytesToRead, ULONGLONG& ullBytesRead)
+{
+    ullBytesRead = 0LL;
+
+    if (ullBytesToRead > MAXDWORD)
+        return TYPE_E_SIZETOOBIG;
+
+    if (!buffer.CheckCount(static_cast<size_t>(ullBytesToRead)))
+        return E_OUTOFMEMORY;
+
+    OVERLAPPED overlapped;
+    ZeroMemory(&overlapped, sizeof(OVERLAPPED));
+
+    ULARGE_INTEGER offset;
+    offset.QuadPart = ullOffset;
+    overlapped.Offset = offset.LowPart;
+    overlapped.OffsetHigh = offset.HighPart;
+
+    DWORD dwBytesRead = 0L;
+    if (!ReadFile(hFile, buffer.GetData(), static_cast<DWORD>(ullBytesToRead), &dwBytesRead, &overlapped))
+    {
+        HRESULT hr = HRESULT_FROM_WIN32(GetLastError());
+        if (hr == HRESULT_FROM_WIN32(ERROR_HANDLE_EOF))
+            return S_OK;
+        return hr;
+    }
+
+    ullBytesRead = dwBytesRead;
+    return S_OK;
+}
+
+}  // namespace
+
 HRESULT MFTOffline::EnumMFTRecord(MFTUtils::EnumMFTRecordCall pCallBack)
 {
     HRESULT hr = E_FAIL;
@@ -38,72 +74,81 @@ HRESULT MFTOffline::EnumMFTRecord(MFTUtils::EnumMFTRecordCall pCallBack)
     if (pCallBack == NULL)
         return E_POINTER;
 
-    LARGE_INTEGER Start = {0};
     LARGE_INTEGER End = {0};
 
-    GetFileSizeEx(m_pVolReader->GetHandle(), &End);
-
-    if (INVALID_SET_FILE_POINTER
-        == SetFilePointer(m_pVolReader->GetHandle(), Start.LowPart, &Start.HighPart, FILE_BEGIN))
+    if (!GetFileSizeEx(m_pVolReader->GetHandle(), &End))
     {
         hr = HRESULT_FROM_WIN32(GetLastError());
-        log::Error(_L_, hr, L"Could not seek to offset %d in MFT file\r\n", Start.LowPart);
+        log::Error(_L_, hr, L"Could not get MFT file size\r\n");
         return hr;
     }
 
-    CBinaryBuffer buffer;
-    if (!buffer.SetCount(m_pVolReader->GetBytesPerFRS()))
-        return E_OUTOFMEMORY;
+    const ULONG ulBytesPerFRS = m_pVolReader->GetBytesPerFRS();
+    const HANDLE hMFT = m_pVolReader->GetHandle();
 
-    ZeroMemory(buffer.GetData(), m_pVolReader->GetBytesPerFRS());
+    MFTReadAhead readAhead(
+        _L_,
+        [hMFT](ULONGLONG ullOffset, CBinaryBuffer& buffer, ULONGLONG ullBytesToRead, ULONGLONG& ullBytesRead) {
+            return ReadAt(hMFT, ullOffset, buffer, ullBytesToRead, ullBytesRead);
+        },
+        ulBytesPerFRS,
+        m_dwFRSPerRead,
+        m_dwQueueDepth);
+
+    if (FAILED(hr = readAhead.AddExtent(0LL, End.QuadPart)))
+        return hr;
+
+    if (FAILED(hr = readAhead.Start()))
+        return hr;
 
-    ULONGLONG ullCurrentIndex = 0;
     ULONGLONG ullCurrentMftIndex = 0;
-    ULONGLONG ullLastIndex = (End.QuadPart - Start.QuadPart) / m_pVolReader->GetBytesPerFRS();
 
-    while (ullCurrentIndex < ullLastIndex)
+    while (auto chunk = readAhead.Next())
     {
-        DWORD dwBytesRead = 0;
-
-        if (!ReadFile(m_pVolReader->GetHandle(), buffer.GetData(), m_pVolReader->GetBytesPerFRS(), &dwBytesRead, NULL))
+        if (FAILED(hr = chunk->hr))
         {
-            hr = HRESULT_FROM_WIN32(GetLastError());
             log::Error(_L_, hr, L"Could not read in MFT file\r\n");
             return hr;
         }
 
-        if (dwBytesRead != m_pVolReader->GetBytesPerFRS())
+        for (ULONGLONG ullFRSOffset = 0LL; ullFRSOffset + ulBytesPerFRS <= chunk->BytesRead;
+             ullFRSOffset += ulBytesPerFRS)
         {
-            log::Verbose(_L_, L"Reached end of offline MFT\r\n");
-            return S_OK;
-        }
+            CBinaryBuffer buffer(chunk->Data.GetData() + ullFRSOffset, ulBytesPerFRS);
 
-        PFILE_RECORD_SEGMENT_HEADER pHeader = (PFILE_RECORD_SEGMENT_HEADER)buffer.GetData();
+            PFILE_RECORD_SEGMENT_HEADER pHeader = (PFILE_RECORD_SEGMENT_HEADER)buffer.GetData();
 
-        if ((pHeader->MultiSectorHeader.Signature[0] != 'F') || (pHeader->MultiSectorHeader.Signature[1] != 'I')
-            || (pHeader->MultiSectorHeader.Signature[2] != 'L') || (pHeader->MultiSectorHeader.Signature[3] != 'E'))
-        {
-            log::Verbose(
-                _L_,
-                L"Skipping... MultiSectorHeader.Signature is not FILE - \"%c%c%c%c\".\r\n",
-                pHeader->MultiSectorHeader.Signature[0],
-                pHeader->MultiSectorHeader.Signature[1],
-                pHeader->MultiSectorHeader.Signature[2],
-                pHeader->MultiSectorHeader.Signature[3]);
-            continue;
-        }
+            if ((pHeader->MultiSectorHeader.Signature[0] != 'F') || (pHeader->MultiSectorHeader.Signature[1] != 'I')
+                || (pHeader->MultiSectorHeader.Signature[2] != 'L')
+                || (pHeader->MultiSectorHeader.Signature[3] != 'E'))
+            {
+                log::Verbose(
+                    _L_,
+                    L"Skipping... MultiSectorHeader.Signature is not FILE - \"%c%c%c%c\".\r\n",
+                    pHeader->MultiSectorHeader.Signature[0],
+                    pHeader->MultiSectorHeader.Signature[1],
+                    pHeader->MultiSectorHeader.Signature[2],
+                    pHeader->MultiSectorHeader.Signature[3]);
+                continue;
+            }
 
-        if (FAILED(hr = pCallBack(ullCurrentMftIndex, buffer)))
-        {
-            if (hr == HRESULT_FROM_WIN32(ERROR_NO_MORE_FILES))
+            if (FAILED(hr = pCallBack(ullCurrentMftIndex, buffer)))
             {
-                log::Verbose(_L_, L"INFO: stopping enumeration\r\n");
-                return hr;
+                if (hr == HRESULT_FROM_WIN32(ERROR_NO_MORE_FILES))
+                {
+                    log::Verbose(_L_, L"INFO: stopping enumeration\r\n");
+                    return hr;
+                }
+                log::Verbose(_L_, L"WARNING: Add Record Callback failed\r\n");
             }
-            log::Verbose(_L_, L"WARNING: Add Record Callback failed\r\n");
+            ullCurrentMftIndex++;
+        }
+
+        if (chunk->BytesRead % ulBytesPerFRS)
+        {
+            log::Verbose(_L_, L"Reached end of offline MFT\r\n");
+            return S_OK;
         }
-        ullCurrentIndex++;
-        ullCurrentMftIndex++;
     }
 
     return S_OK;
@@ -111,119 +156,40 @@ HRESULT MFTOffline::EnumMFTRecord(MFTUtils::EnumMFTRecordCall pCallBack)
 
 HRESULT MFTOffline::FetchMFTRecord(std::vector<MFT_SEGMENT_REFERENCE>& frn, MFTUtils::EnumMFTRecordCall pCallBack)
 {
-    HRESULT hr = E_FAIL;
-
     if (pCallBack == nullptr)
         return E_POINTER;
     if (frn.empty())
         return S_OK;
 
-    std::sort(
-        begin(frn), end(frn), [](const MFT_SEGMENT_REFERENCE& leftRFN, const MFT_SEGMENT_REFERENCE& rigthRFN) -> bool {
-            if (leftRFN.SegmentNumberHighPart != rigthRFN.SegmentNumberHighPart)
-                return leftRFN.SegmentNumberHighPart < rigthRFN.SegmentNumberHighPart;
-            return leftRFN.SegmentNumberLowPart < rigthRFN.SegmentNumberLowPart;
-        });
-
-    ULONGLONG ullCurrentIndex = 0;
-    // go through each extent of mft and search for the files
-
-    ULONGLONG ullCorrection = 0LL;
-
-    ULONG ulBytesPerFRS = m_pVolReader->GetBytesPerFRS();
-
-    CBinaryBuffer localReadBuffer(true);
-
-    if (!localReadBuffer.CheckCount(ulBytesPerFRS))
-        return E_OUTOFMEMORY;
-
-    for (const auto& idx : frn)
+    if (m_pFetcher == nullptr)
     {
-        LARGE_INTEGER Index;
-
-        Index.LowPart = idx.SegmentNumberLowPart;
-        Index.HighPart = idx.SegmentNumberHighPart;
-
-        Index.QuadPart *= ulBytesPerFRS;
-
-        if (INVALID_SET_FILE_POINTER
-            == SetFilePointer(m_pFetchReader->GetHandle(), Index.LowPart, &Index.HighPart, FILE_BEGIN))
-        {
-            hr = HRESULT_FROM_WIN32(GetLastError());
-            log::Error(_L_, hr, L"Could not seek to offset %I64d in MFT file\r\n", Index.QuadPart);
-            continue;
-        }
-
-        DWORD dwBytesRead = 0LL;
-        if (!ReadFile(
-                m_pFetchReader->GetHandle(),
-                localReadBuffer.GetData(),
-                m_pFetchReader->GetBytesPerFRS(),
-                &dwBytesRead,
-                NULL))
-        {
-            hr = HRESULT_FROM_WIN32(GetLastError());
-            log::Error(_L_, hr, L"Could not read %d bytes in MFT file\r\n", m_pFetchReader->GetBytesPerFRS());
-            continue;
-        }
-
-        PFILE_RECORD_SEGMENT_HEADER pHeader = (PFILE_RECORD_SEGMENT_HEADER)localReadBuffer.GetData();
-
-        if ((pHeader->MultiSectorHeader.Signature[0] != 'F') || (pHeader->MultiSectorHeader.Signature[1] != 'I')
-            || (pHeader->MultiSectorHeader.Signature[2] != 'L') || (pHeader->MultiSectorHeader.Signature[3] != 'E'))
-        {
-            log::Verbose(
-                _L_,
-                L"Skipping... MultiSectorHeader.Signature is not FILE - \"%c%c%c%c\".\r\n",
-                pHeader->MultiSectorHeader.Signature[0],
-                pHeader->MultiSectorHeader.Signature[1],
-                pHeader->MultiSectorHeader.Signature[2],
-                pHeader->MultiSectorHeader.Signature[3]);
-            continue;
-        }
-
-        MFT_SEGMENT_REFERENCE read_record_frn = {0};
-        read_record_frn.SegmentNumberHighPart = pHeader->SegmentNumberHighPart;
-        read_record_frn.SegmentNumberLowPart = pHeader->SegmentNumberLowPart;
-        read_record_frn.SequenceNumber = pHeader->SequenceNumber;
-
-        if (NtfsSegmentNumber(&read_record_frn) != NtfsSegmentNumber(&idx))
-        {
-            log::Verbose(
-                _L_,
-                L"Skipping... %I64X does not match the expected %I64X\r\n",
-                NtfsSegmentNumber(&read_record_frn),
-                NtfsSegmentNumber(&idx));
-            continue;
-        }
-        if (read_record_frn.SequenceNumber != idx.SequenceNumber)
-        {
-            log::Verbose(
-                _L_,
-                L"Skipping... Sequence numbed %d does not match the expected %d\r\n",
-                read_record_frn.SequenceNumber,
-                idx.SequenceNumber);
-            continue;
-        }
-
-        MFTUtils::SafeMFTSegmentNumber safeFRN = (ULONGLONG)Index.QuadPart;
-        if (FAILED(hr = pCallBack(safeFRN, localReadBuffer)))
-        {
-            if (hr == E_OUTOFMEMORY)
-            {
-                log::Error(_L_, hr, L"Add Record Callback failed, not enough memory to continue\r\n");
-                return hr;
-            }
-            else if (hr == HRESULT_FROM_WIN32(ERROR_NO_MORE_FILES))
-            {
-                log::Verbose(_L_, L"Add Record Callback asks for enumeration to stop...\r\n");
-                return hr;
-            }
-            log::Verbose(_L_, L"WARNING: Add Record Callback failed\r\n");
-        }
+        const ULONG ulBytesPerFRS = m_pFetchReader->GetBytesPerFRS();
+        const HANDLE hMFT = m_pFetchReader->GetHandle();
+
+        m_pFetcher = std::make_unique<MFTFetcher>(
+            _L_,
+            ulBytesPerFRS,
+            [hMFT, ulBytesPerFRS](ULONGLONG ullSegmentNumber, ULONGLONG& ullOffset, ULONGLONG& ullContiguousFRS) {
+                LARGE_INTEGER FileSize = {0};
+                if (!GetFileSizeEx(hMFT, &FileSize))
+                    return false;
+
+                ullOffset = ullSegmentNumber * ulBytesPerFRS;
+                if (ullOffset >= (ULONGLONG)FileSize.QuadPart)
+                    return false;
+
+                ullContiguousFRS = ((ULONGLONG)FileSize.QuadPart - ullOffset) / ulBytesPerFRS;
+                return true;
+            },
+            [hMFT](ULONGLONG ullOffset, CBinaryBuffer& buffer, ULONGLONG ullBytesToRead, ULONGLONG& ullBytesRead) {
+                return ReadAt(hMFT, ullOffset, buffer, ullBytesToRead, ullBytesRead);
+            });
     }
 
-    return S_OK;
+    m_pFetcher->SetGapThreshold(m_dwFetchGapThreshold);
+    m_pFetcher->SetCacheSize(m_dwFetchCacheSize);
+
+    return m_pFetcher->Fetch(frn, pCallBack);
 }
 
 ULONG MFTOffline::GetMFTRecordCount() const
@@ -36,6 +36,7 @@ public:
 private:
     std::shared_ptr<OfflineMFTReader> m_pVolReader;
     std::shared_ptr<OfflineMFTReader> m_pFetchReader;
+    std::unique_ptr<MFTFetcher> m_pFetcher;
     logger _L_;
 
     MFTUtils::SafeMFTSegmentNumber m_RootUSN;
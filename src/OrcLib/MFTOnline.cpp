@@ -13,8 +13,6 @@
 
 using namespace Orc;
 
-static const auto DEFAULT_FRS_PER_READ = 64;
-
 MFTOnline::MFTOnline(logger pLog, std::shared_ptr<VolumeReader>& volReader)
     : m_pVolReader(volReader)
     , _L_(std::move(pLog))
@@ -292,97 +290,71 @@ HRESULT MFTOnline::EnumMFTRecord(MFTUtils::EnumMFTRecordCall pCallBack)
 
     ULONG ulBytesPerFRS = m_pVolReader->GetBytesPerFRS();
 
-    CBinaryBuffer localReadBuffer(true);
-
-    if (!localReadBuffer.CheckCount(ulBytesPerFRS * DEFAULT_FRS_PER_READ))
-        return E_OUTOFMEMORY;
-
-    ULONGLONG position = 0LL;
+    MFTReadAhead readAhead(
+        _L_,
+        [this](ULONGLONG ullOffset, CBinaryBuffer& buffer, ULONGLONG ullBytesToRead, ULONGLONG& ullBytesRead) {
+            return m_pVolReader->ReadAt(ullOffset, buffer, ullBytesToRead, ullBytesRead);
+        },
+        ulBytesPerFRS,
+        m_dwFRSPerRead,
+        m_dwQueueDepth);
 
-    for (auto iter = m_MFT0Info.ExtentsVector.begin(); iter != m_MFT0Info.ExtentsVector.end(); ++iter)
+    for (const auto& NRAE : m_MFT0Info.ExtentsVector)
     {
-        MFTUtils::NonResidentAttributeExtent& NRAE = *iter;
-
         if (NRAE.bZero)
             continue;
 
-        ULONGLONG end = NRAE.DiskOffset + NRAE.DataSize;
-        ULONGLONG extent_position = NRAE.DiskOffset;
-
-        ULONGLONG ullFRSCountInExtent = NRAE.DataSize / ulBytesPerFRS;
-        ULONGLONG ullFRSLeftToRead = ullFRSCountInExtent;
+        if (FAILED(hr = readAhead.AddExtent(NRAE.DiskOffset, NRAE.DataSize)))
+            return hr;
+    }
 
-        while (extent_position < end)
-        {
-            ULONGLONG ullFRSToRead = std::min<ULONGLONG>(ullFRSLeftToRead, DEFAULT_FRS_PER_READ);
+    if (FAILED(hr = readAhead.Start()))
+        return hr;
 
-            LARGE_INTEGER liBytesToRead;
-            liBytesToRead.QuadPart = ulBytesPerFRS * ullFRSToRead;
+    ULONGLONG position = 0LL;
 
-            if (liBytesToRead.HighPart > 0)
-                return TYPE_E_SIZETOOBIG;
+    while (auto chunk = readAhead.Next())
+    {
+        if (FAILED(hr = chunk->hr))
+            return hr;
 
-            if (!localReadBuffer.CheckCount(static_cast<size_t>(ulBytesPerFRS * ullFRSToRead)))
-                return E_OUTOFMEMORY;
+        if (chunk->BytesRead % ulBytesPerFRS > 0)
+        {
+            log::Warning(_L_, L"Failed to read only complete records at position %I64d\r\n", chunk->Offset);
+        }
 
-            ULONGLONG ullBytesRead = 0LL;
-            if (FAILED(
-                    hr = m_pVolReader->Read(
-                        extent_position, localReadBuffer, ulBytesPerFRS * ullFRSToRead, ullBytesRead)))
+        for (unsigned int i = 0; i < (chunk->BytesRead / ulBytesPerFRS); i++)
+        {
+            if (ullCurrentIndex * ulBytesPerFRS != position + (i * ulBytesPerFRS))
             {
-                log::Error(
-                    _L_,
-                    hr,
-                    L"Failed to read %I64d bytes from at position %I64d\r\n",
-                    extent_position,
-                    ulBytesPerFRS * ullFRSToRead);
-                return hr;
+                log::Warning(_L_, E_FAIL, L"Index is out of sequence\r\n");
             }
 
-            if (ullBytesRead % ulBytesPerFRS > 0)
-            {
-                log::Warning(
-                    _L_,
-                    hr,
-                    L"Failed to read only complete records\r\n",
-                    extent_position,
-                    ulBytesPerFRS * ullFRSToRead);
-            }
+            CBinaryBuffer tempFRS(chunk->Data.GetData() + i * ulBytesPerFRS, ulBytesPerFRS);
 
-            for (unsigned int i = 0; i < (ullBytesRead / ulBytesPerFRS); i++)
+            if (FAILED(hr = pCallBack(ullCurrentFRNIndex, tempFRS)))
             {
-                if (ullCurrentIndex * ulBytesPerFRS != position + (i * ulBytesPerFRS))
+                if (hr == E_OUTOFMEMORY)
                 {
-                    log::Warning(_L_, E_FAIL, L"Index is out of sequence\r\n");
+                    log::Error(_L_, hr, L"Add Record Callback failed, not enough memory to continue\r\n");
+                    return hr;
                 }
-
-                CBinaryBuffer tempFRS(localReadBuffer.GetData() + i * ulBytesPerFRS, ulBytesPerFRS);
-
-                if (FAILED(hr = pCallBack(ullCurrentFRNIndex, tempFRS)))
+                else if (hr == HRESULT_FROM_WIN32(ERROR_NO_MORE_FILES))
                 {
-                    if (hr == E_OUTOFMEMORY)
-                    {
-                        log::Error(_L_, hr, L"Add Record Callback failed, not enough memory to continue\r\n");
-                        return hr;
-                    }
-                    else if (hr == HRESULT_FROM_WIN32(ERROR_NO_MORE_FILES))
-                    {
-                        log::Verbose(_L_, L"Add Record Callback asks for enumeration to stop...\r\n");
-                        return hr;
-                    }
-                    log::Verbose(_L_, L"WARNING: Add Record Callback failed\r\n");
+                    log::Verbose(_L_, L"Add Record Callback asks for enumeration to stop...\r\n");
+                    return hr;
                 }
+                log::Verbose(_L_, L"WARNING: Add Record Callback failed\r\n");
+            }
 
-                if (ullCurrentIndex != ullCurrentFRNIndex)
-                {
-                    log::Verbose(_L_, L"Current index does not match current FRN index\r\n");
-                }
-                ullCurrentFRNIndex++;
-                ullCurrentIndex++;
+            if (ullCurrentIndex != ullCurrentFRNIndex)
+            {
+                log::Verbose(_L_, L"Current index does not match current FRN index\r\n");
             }
-            extent_position += ullBytesRead;
-            position += ullBytesRead;
+            ullCurrentFRNIndex++;
+            ullCurrentIndex++;
         }
+        position += chunk->BytesRead;
     }
 
     return S_OK;
@@ -390,137 +362,46 @@ HRESULT MFTOnline::EnumMFTRecord(MFTUtils::EnumMFTRecordCall pCallBack)
 
 HRESULT MFTOnline::FetchMFTRecord(std::vector<MFT_SEGMENT_REFERENCE>& frn, MFTUtils::EnumMFTRecordCall pCallBack)
 {
-    HRESULT hr = E_FAIL;
-
     if (pCallBack == nullptr)
         return E_POINTER;
     if (frn.empty())
         return S_OK;
 
-    std::sort(begin(frn), end(frn), [](const MFT_SEGMENT_REFERENCE& left, const MFT_SEGMENT_REFERENCE& rigth) -> bool {
-        if (left.SegmentNumberHighPart != rigth.SegmentNumberHighPart)
-            return left.SegmentNumberHighPart < rigth.SegmentNumberHighPart;
-        return left.SegmentNumberLowPart < rigth.SegmentNumberLowPart;
-    });
-
-    // go through each extent of mft and search for the files
-
-    ULONG ulBytesPerFRS = m_pVolReader->GetBytesPerFRS();
-
-    CBinaryBuffer localReadBuffer(true);
-
-    if (!localReadBuffer.CheckCount(ulBytesPerFRS))
-        return E_OUTOFMEMORY;
-
-    UINT frnIdx = 0;
-    ULONGLONG ullCurrentIndex = 0;
-
-    for (const auto& NRAE : m_MFT0Info.ExtentsVector)
+    if (m_pFetcher == nullptr)
     {
-        ULONGLONG ullEnd = ullCurrentIndex + NRAE.DataSize;
-
-        if (NRAE.bZero)
-            continue;
-
-        ULARGE_INTEGER current;
-        current.HighPart = frn[frnIdx].SegmentNumberHighPart;
-        current.LowPart = frn[frnIdx].SegmentNumberLowPart;
-
-        while (ullCurrentIndex <= (current.QuadPart * ulBytesPerFRS) && (current.QuadPart * ulBytesPerFRS) < ullEnd)
-        {
-            // this segment contains the first FRN
-            ULONGLONG ullVolumeOffset = NRAE.DiskOffset + ((current.QuadPart * ulBytesPerFRS) - ullCurrentIndex);
-
-            ULONGLONG ullBytesRead = 0LL;
-            if (FAILED(hr = m_pFetchReader->Read(ullVolumeOffset, localReadBuffer, ulBytesPerFRS, ullBytesRead)))
-            {
-                log::Error(
-                    _L_, hr, L"Failed to read %I64d bytes from at position %I64d\r\n", ullVolumeOffset, ulBytesPerFRS);
-                break;
-            }
+        const ULONG ulBytesPerFRS = m_pVolReader->GetBytesPerFRS();
 
-            PFILE_RECORD_SEGMENT_HEADER pHeader = (PFILE_RECORD_SEGMENT_HEADER)localReadBuffer.GetData();
-
-            if ((pHeader->MultiSectorHeader.Signature[0] != 'F') || (pHeader->MultiSectorHeader.Signature[1] != 'I')
-                || (pHeader->MultiSectorHeader.Signature[2] != 'L') || (pHeader->MultiSectorHeader.Signature[3] != 'E'))
-            {
-                log::Verbose(
-                    _L_,
-                    L"Skipping... MultiSectorHeader.Signature is not FILE - \"%c%c%c%c\".\r\n",
-                    pHeader->MultiSectorHeader.Signature[0],
-                    pHeader->MultiSectorHeader.Signature[1],
-                    pHeader->MultiSectorHeader.Signature[2],
-                    pHeader->MultiSectorHeader.Signature[3]);
-                frnIdx++;
-                if (frnIdx >= frn.size())
-                    break;
-                current.HighPart = frn[frnIdx].SegmentNumberHighPart;
-                current.LowPart = frn[frnIdx].SegmentNumberLowPart;
-            }
+        m_pFetcher = std::make_unique<MFTFetcher>(
+            _L_,
+            ulBytesPerFRS,
+            [this, ulBytesPerFRS](ULONGLONG ullSegmentNumber, ULONGLONG& ullOffset, ULONGLONG& ullContiguousFRS) {
+                ULONGLONG ullCurrentIndex = 0LL;
+                const ULONGLONG ullWanted = ullSegmentNumber * ulBytesPerFRS;
 
-            MFT_SEGMENT_REFERENCE read_record_frn = {0};
-            read_record_frn.SegmentNumberHighPart = pHeader->SegmentNumberHighPart;
-            read_record_frn.SegmentNumberLowPart = pHeader->SegmentNumberLowPart;
-            read_record_frn.SequenceNumber = pHeader->SequenceNumber;
+                for (const auto& NRAE : m_MFT0Info.ExtentsVector)
+                {
+                    ULONGLONG ullEnd = ullCurrentIndex + NRAE.DataSize;
 
-            if (NtfsSegmentNumber(&read_record_frn) != NtfsSegmentNumber(&frn[frnIdx]))
-            {
-                log::Verbose(
-                    _L_,
-                    L"Skipping... %I64X does not match the expected %I64X\r\n",
-                    NtfsSegmentNumber(&read_record_frn),
-                    NtfsSegmentNumber(&frn[frnIdx]));
-                frnIdx++;
-                if (frnIdx >= frn.size())
-                    break;
-                current.HighPart = frn[frnIdx].SegmentNumberHighPart;
-                current.LowPart = frn[frnIdx].SegmentNumberLowPart;
-                continue;
-            }
-            if (read_record_frn.SequenceNumber != frn[frnIdx].SequenceNumber)
-            {
-                log::Verbose(
-                    _L_,
-                    L"Skipping... Sequence numbed %d does not match the expected %d\r\n",
-                    read_record_frn.SequenceNumber,
-                    frn[frnIdx].SequenceNumber);
-                frnIdx++;
-                if (frnIdx >= frn.size())
-                    break;
-                current.HighPart = frn[frnIdx].SegmentNumberHighPart;
-                current.LowPart = frn[frnIdx].SegmentNumberLowPart;
-                continue;
-            }
+                    if (ullCurrentIndex <= ullWanted && ullWanted < ullEnd)
+                    {
+                        if (NRAE.bZero)
+                            return false;
 
-            if (FAILED(hr = pCallBack(current.QuadPart, localReadBuffer)))
-            {
-                if (hr == E_OUTOFMEMORY)
-                {
-                    log::Error(_L_, hr, L"Add Record Callback failed, not enough memory to continue\r\n");
-                    break;
-                }
-                else if (hr == HRESULT_FROM_WIN32(ERROR_NO_MORE_FILES))
-                {
-                    log::Verbose(_L_, L"Add Record Callback asks for enumeration to stop...\r\n");
-                    return hr;
+                        ullOffset = NRAE.DiskOffset + (ullWanted - ullCurrentIndex);
+                        ullContiguousFRS = (ullEnd - ullWanted) / ulBytesPerFRS;
+                        return true;
+                    }
+                    ullCurrentIndex = ullEnd;
                 }
-                log::Verbose(_L_, L"WARNING: Add Record Callback failed\r\n");
-            }
-            frnIdx++;
-            if (frnIdx >= frn.size())
-                break;
-            current.HighPart = frn[frnIdx].SegmentNumberHighPart;
-            current.LowPart = frn[frnIdx].SegmentNumberLowPart;
-        }
-        // this segment must be skipped
-        ullCurrentIndex = ullEnd;
-        if (frnIdx >= frn.size())
-            break;
-    }
-    if (frnIdx >= frn.size())
-    {
-        frn.clear();
+                return false;
+            },
+            [this](ULONGLONG ullOffset, CBinaryBuffer& buffer, ULONGLONG ullBytesToRead, ULONGLONG& ullBytesRead) {
+                return m_pFetchReader->ReadAt(ullOffset, buffer, ullBytesToRead, ullBytesRead);
+            });
     }
 
-    return S_OK;
+    m_pFetcher->SetGapThreshold(m_dwFetchGapThreshold);
+    m_pFetcher->SetCacheSize(m_dwFetchCacheSize);
+
+    return m_pFetcher->Fetch(frn, pCallBack);
 }
@@ -38,6 +38,7 @@ public:
 private:
     std::shared_ptr<VolumeReader> m_pVolReader;
     std::shared_ptr<VolumeReader> m_pFetchReader;
+    std::unique_ptr<MFTFetcher> m_pFetcher;
     logger _L_;
 
     HRESULT GetMFTExtents(const CBinaryBuffer& buffer);
@@ -0,0 +1,213 @@
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+//
+// Copyright © 2011-2019 ANSSI. All Rights Reserved.
+//
+// Author(s): Jean Gautier (ANSSI)
+//
+#include "StdAfx.h"
+
+#include "MFTReadAhead.h"
+#include "LogFileWriter.h"
+
+using namespace Orc;
+
+MFTReadAhead::MFTReadAhead(
+    logger pLog,
+    ReadCall pRead,
+    ULONG ulBytesPerFRS,
+    DWORD dwFRSPerRead,
+    DWORD dwQueueDepth)
+    : _L_(std::move(pLog))
+    , m_pRead(std::move(pRead))
+    , m_ulBytesPerFRS(ulBytesPerFRS)
+    , m_dwFRSPerRead(dwFRSPerRead ? dwFRSPerRead : DEFAULT_FRS_PER_READ)
+    , m_dwQueueDepth(dwQueueDepth ? dwQueueDepth : DEFAULT_QUEUE_DEPTH)
+    , m_Slots(dwQueueDepth ? dwQueueDepth : DEFAULT_QUEUE_DEPTH)
+    , m_bStop(false)
+{
+}
+
+HRESULT MFTReadAhead::AddExtent(ULONGLONG ullOffset, ULONGLONG ullSize)
+{
+    if (m_bStarted)
+        return E_UNEXPECTED;
+    if (m_ulBytesPerFRS == 0)
+        return E_INVALIDARG;
+
+    const ULONGLONG ullBytesPerRead = (ULONGLONG)m_ulBytesPerFRS * m_dwFRSPerRead;
+    if (ullBytesPerRead > MAXDWORD)
+        return TYPE_E_SIZETOOBIG;
+
+    // Only complete records are read
+    ULONGLONG ullLeft = ullSize - (ullSize % m_ulBytesPerFRS);
+
+    while (ullLeft > 0)
+    {
+        Request request;
+        request.Offset = ullOffset;
+        request.Size = std::min<ULONGLONG>(ullLeft, ullBytesPerRead);
+
+        m_Requests.push_back(request);
+
+        ullOffset += request.Size;
+        ullLeft -= request.Size;
+    }
+    return S_OK;
+}
+
+std::shared_ptr<MFTReadAhead::Chunk> MFTReadAhead::GetFreeChunk()
+{
+    {
+        Concurrency::critical_section::scoped_lock sl(m_FreeChunksCS);
+        if (!m_FreeChunks.empty())
+        {
+            auto retval = std::move(m_FreeChunks.back());
+            m_FreeChunks.pop_back();
+            return retval;
+        }
+    }
+    return std::make_shared<Chunk>();
+}
+
+void MFTReadAhead::ReleaseChunk(std::shared_ptr<Chunk>&& chunk)
+{
+    Concurrency::critical_section::scoped_lock sl(m_FreeChunksCS);
+    m_FreeChunks.push_back(std::move(chunk));
+}
+
+std::shared_ptr<MFTReadAhead::Chunk> MFTReadAhead::ReadRequest(const Request& request)
+{
+    auto chunk = GetFreeChunk();
+
+    chunk->Offset = request.Offset;
+    chunk->BytesRead = 0LL;
+
+    if (!chunk->Data.CheckCount(static_cast<size_t>(request.Size)))
+    {
+        chunk->hr = E_OUTOFMEMORY;
+        return chunk;
+    }
+
+    try
+    {
+        chunk->hr = m_pRead(request.Offset, chunk->Data, request.Size, chunk->BytesRead);
+    }
+    catch (...)
+    {
+        chunk->hr = E_UNEXPECTED;
+    }
+
+    if (FAILED(chunk->hr))
+    {
+        log::Error(
+            _L_, chunk->hr, L"Failed to read %I64d bytes at position %I64d\r\n", request.Size, request.Offset);
+    }
+    return chunk;
+}
+
+HRESULT MFTReadAhead::Start()
+{
+    // Extents are read once
+    if (m_bStarted || m_bDone)
+        return E_UNEXPECTED;
+
+    m_bStarted = true;
+
+    if (!IsAsync())
+        return S_OK;
+
+    m_Reader.run([this]() {
+        for (const auto& request : m_Requests)
+        {
+            m_Slots.Acquire();
+
+            if (m_bStop)
+                break;
+
+            auto chunk = ReadRequest(request);
+            const HRESULT hr = chunk->hr;
+
+            Concurrency::send(m_Ready, std::move(chunk));
+
+            if (FAILED(hr))
+                break;
+        }
+        Concurrency::send(m_Ready, std::shared_ptr<Chunk>());
+    });
+
+    return S_OK;
+}
+
+std::shared_ptr<MFTReadAhead::Chunk> MFTReadAhead::Next()
+{
+    if (m_Current)
+    {
+        ReleaseChunk(std::move(m_Current));
+        if (IsAsync())
+            m_Slots.Release();
+    }
+
+    if (!m_bStarted || m_bDone)
+        return nullptr;
+
+    std::shared_ptr<Chunk> chunk;
+
+    if (IsAsync())
+    {
+        chunk = Concurrency::receive(m_Ready);
+    }
+    else if (m_NextRequest < m_Requests.size())
+    {
+        chunk = ReadRequest(m_Requests[m_NextRequest++]);
+    }
+
+    if (!chunk)
+    {
+        m_bDone = true;
+        return nullptr;
+    }
+
+    m_Current = chunk;
+    return chunk;
+}
+
+void MFTReadAhead::Stop()
+{
+    if (!m_bStarted)
+        return;
+
+    m_bStop = true;
+
+    if (m_Current)
+    {
+        ReleaseChunk(std::move(m_Current));
+        if (IsAsync())
+            m_Slots.Release();
+    }
+
+    if (IsAsync())
+    {
+        // Give back each slot so that a reader waiting for one gets to see the stop request
+        while (!m_bDone)
+        {
+            auto chunk = Concurrency::receive(m_Ready);
+            if (!chunk)
+            {
+                m_bDone = true;
+                break;
+            }
+            ReleaseChunk(std::move(chunk));
+            m_Slots.Release();
+        }
+        m_Reader.wait();
+    }
+
+    m_bDone = true;
+    m_bStarted = false;
+}
+
+MFTReadAhead::~MFTReadAhead()
+{
+    Stop();
+}
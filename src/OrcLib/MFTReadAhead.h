@@ -0,0 +1,106 @@
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+//
+// Copyright © 2011-2019 ANSSI. All Rights Reserved.
+//
+// Author(s): Jean Gautier (ANSSI)
+//
+#pragma once
+
+#include "OrcLib.h"
+
+#include "BinaryBuffer.h"
+#include "Semaphore.h"
+
+#include <agents.h>
+#include <ppl.h>
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#pragma managed(push, off)
+
+namespace Orc {
+
+class LogFileWriter;
+
+// Reads a list of MFT extents in chunks of FRS, keeping up to "queue depth" chunks read ahead of the one being parsed
+class ORCLIB_API MFTReadAhead
+{
+public:
+    static constexpr DWORD DEFAULT_FRS_PER_READ = 64;
+    static constexpr DWORD DEFAULT_QUEUE_DEPTH = 2;
+
+    using ReadCall = std::function<
+        HRESULT(ULONGLONG ullOffset, CBinaryBuffer& buffer, ULONGLONG ullBytesToRead, ULONGLONG& ullBytesRead)>;
+
+    class Chunk
+    {
+    public:
+        ULONGLONG Offset = 0LL;  // offset of the chunk in the reader
+        ULONGLONG BytesRead = 0LL;  // number of bytes available in Data
+        HRESULT hr = E_FAIL;
+        CBinaryBuffer Data;
+
+        Chunk()
+            : Data(true)
+        {
+        }
+    };
+
+    MFTReadAhead(logger pLog, ReadCall pRead, ULONG ulBytesPerFRS, DWORD dwFRSPerRead, DWORD dwQueueDepth);
+
+    HRESULT AddExtent(ULONGLONG ullOffset, ULONGLONG ullSize);
+
+    HRESULT Start();
+
+    // Returns the next chunk read (in extent order), or nullptr when all extents were read
+    // The chunk returned is valid until the next call to Next() or Stop()
+    std::shared_ptr<Chunk> Next();
+
+    // Cancels outstanding reads and waits for the reading task to complete
+    void Stop();
+
+    ~MFTReadAhead();
+
+private:
+    struct Request
+    {
+        ULONGLONG Offset;
+        ULONGLONG Size;
+    };
+
+    logger _L_;
+    ReadCall m_pRead;
+
+    ULONG m_ulBytesPerFRS = 0L;
+    DWORD m_dwFRSPerRead = DEFAULT_FRS_PER_READ;
+    DWORD m_dwQueueDepth = DEFAULT_QUEUE_DEPTH;
+
+    std::vector<Request> m_Requests;
+    size_t m_NextRequest = 0L;
+
+    std::shared_ptr<Chunk> m_Current;
+    std::vector<std::shared_ptr<Chunk>> m_FreeChunks;
+    Concurrency::critical_section m_FreeChunksCS;
+
+    Semaphore m_Slots;
+    Concurrency::unbounded_buffer<std::shared_ptr<Chunk>> m_Ready;
+    Concurrency::task_group m_Reader;
+    std::atomic<bool> m_bStop;
+    bool m_bStarted = false;
+    bool m_bDone = false;
+
+    bool IsAsync() const { return m_dwQueueDepth > 1; }
+
+    std::shared_ptr<Chunk> GetFreeChunk();
+    void ReleaseChunk(std::shared_ptr<Chunk>&& chunk);
+
+    std::shared_ptr<Chunk> ReadRequest(const Request& request);
+};
+
+}  // namespace Orc
+
+#pragma managed(pop)
@@ -122,7 +122,7 @@ HRESULT MFTRecord::ParseRecord(
             {
                 AttributeListEntry ale(pNewAttr);
                 if (m_pAttributeList == nullptr)
-                    m_pAttributeList = make_shared<AttributeList>();
+                    m_pAttributeList = MakeAttribute<AttributeList>();
                 m_pAttributeList->m_AttList.push_back(ale);
 
                 bool bFound = false;
@@ -150,7 +150,7 @@ HRESULT MFTRecord::ParseRecord(
 
                 bool bFound = false;
                 if (m_pAttributeList == nullptr)
-                    m_pAttributeList = make_shared<AttributeList>();
+                    m_pAttributeList = MakeAttribute<AttributeList>();
 
                 for (auto& item : m_pAttributeList->m_AttList)
                 {
@@ -291,14 +291,14 @@ HRESULT MFTRecord::ParseAttribute(
             m_pStandardInformation =
                 (PSTANDARD_INFORMATION)((LPBYTE)pAttribute + pAttribute->Form.Resident.ValueOffset);
 
-            pNewAttr = make_shared<MftRecordAttribute>(pAttribute, this);
+            pNewAttr = MakeAttribute<MftRecordAttribute>(pAttribute, this);
         }
         break;
         case $ATTRIBUTE_LIST:
         {
             // Attribute List
             log::Verbose(pLog, L"\tAdding $ATTRIBUTE_LIST attribute\r\n");
-            std::shared_ptr<AttributeList> NewAttributeList = make_shared<AttributeList>(pAttribute, this);
+            std::shared_ptr<AttributeList> NewAttributeList = MakeAttribute<AttributeList>(pAttribute, this);
 
             if (SUCCEEDED(hr = NewAttributeList->ParseAttributeList(VolReader, m_FileReferenceNumber, this)))
             {
@@ -342,7 +342,7 @@ HRESULT MFTRecord::ParseAttribute(
                     });
                 m_ChildRecords.erase(new_end, end(m_ChildRecords));
                 m_ChildRecords.shrink_to_fit();
-                pNewAttr = std::make_shared<AttributeListAttribute>(pAttribute, this);
+                pNewAttr = MakeAttribute<AttributeListAttribute>(pAttribute, this);
             }
         }
         break;
@@ -368,31 +368,31 @@ HRESULT MFTRecord::ParseAttribute(
                 NtfsFullSegmentNumber(&(m_FileNames.back()->ParentDirectory)),
                 m_FileNames.back()->Flags);
 
-            pNewAttr = make_shared<MftRecordAttribute>(pAttribute, this);
+            pNewAttr = MakeAttribute<MftRecordAttribute>(pAttribute, this);
         }
         break;
         case $OBJECT_ID:
         {
             log::Verbose(pLog, L"\tAdding $OBJECT_ID attribute\r\n");
-            pNewAttr = make_shared<MftRecordAttribute>(pAttribute, this);
+            pNewAttr = MakeAttribute<MftRecordAttribute>(pAttribute, this);
         }
         break;
         case $SECURITY_DESCRIPTOR:
         {
             log::Verbose(pLog, L"\tAdding $SECURITY_DESCRIPTOR attribute\r\n");
-            pNewAttr = make_shared<MftRecordAttribute>(pAttribute, this);
+            pNewAttr = MakeAttribute<MftRecordAttribute>(pAttribute, this);
         }
         break;
         case $VOLUME_NAME:
         {
             log::Verbose(pLog, L"\tAdding $VOLUME_NAME attribute\r\n");
-            pNewAttr = make_shared<MftRecordAttribute>(pAttribute, this);
+            pNewAttr = MakeAttribute<MftRecordAttribute>(pAttribute, this);
         }
         break;
         case $VOLUME_INFORMATION:
         {
             log::Verbose(pLog, L"\tAdding $VOLUME_INFORMATION attribute\r\n");
-            pNewAttr = make_shared<MftRecordAttribute>(pAttribute, this);
+            pNewAttr = MakeAttribute<MftRecordAttribute>(pAttribute, this);
         }
         break;
         case $DATA:
@@ -403,7 +403,7 @@ HRESULT MFTRecord::ParseAttribute(
                 pAttribute->NameLength,
                 pAttribute->NameLength ? (WCHAR*)((BYTE*)pAttribute + pAttribute->NameOffset) : L"$DATA");
 
-            shared_ptr<DataAttribute> pNewDataAttr = make_shared<DataAttribute>(pAttribute, this);
+            shared_ptr<DataAttribute> pNewDataAttr = MakeAttribute<DataAttribute>(pAttribute, this);
             pNewAttr = pNewDataAttr;
 
             if (pNewAttr->m_LowestVcn == 0)
@@ -438,18 +438,18 @@ HRESULT MFTRecord::ParseAttribute(
                     m_bIsDirectory = true;
 
                     log::Verbose(pLog, L"\tAdding directory\r\n");
-                    pNewAttr = make_shared<IndexRootAttribute>(pAttribute, this);
+                    pNewAttr = MakeAttribute<IndexRootAttribute>(pAttribute, this);
                 }
                 else
                 {
                     log::Verbose(pLog, L"\tAdding $INDEX_ROOT attribute (whose name is NOT $I30)\r\n");
-                    pNewAttr = make_shared<IndexRootAttribute>(pAttribute, this);
+                    pNewAttr = MakeAttribute<IndexRootAttribute>(pAttribute, this);
                 }
             }
             else
             {
                 log::Verbose(pLog, L"\tAdding $INDEX_ROOT attribute (no name)\r\n");
-                pNewAttr = make_shared<IndexRootAttribute>(pAttribute, this);
+                pNewAttr = MakeAttribute<IndexRootAttribute>(pAttribute, this);
             }
 
             break;
@@ -465,21 +465,21 @@ HRESULT MFTRecord::ParseAttribute(
                 }
                 m_bIsDirectory = true;
 
-                pNewAttr = make_shared<IndexAllocationAttribute>(pAttribute, this);
+                pNewAttr = MakeAttribute<IndexAllocationAttribute>(pAttribute, this);
             }
             else
             {
                 log::Verbose(pLog, L"\tAdding $INDEX_ROOT attribute (whose name is NOT $I30)\r\n");
-                pNewAttr = make_shared<IndexAllocationAttribute>(pAttribute, this);
+                pNewAttr = MakeAttribute<IndexAllocationAttribute>(pAttribute, this);
             }
             log::Verbose(pLog, L"\tAdding $INDEX_ALLOCATION attribute\r\n");
-            pNewAttr = make_shared<IndexAllocationAttribute>(pAttribute, this);
+            pNewAttr = MakeAttribute<IndexAllocationAttribute>(pAttribute, this);
         }
         break;
         case $BITMAP:
         {
             log::Verbose(pLog, L"\tAdding $BITMAP attribute\r\n");
-            pNewAttr = make_shared<BitmapAttribute>(pAttribute, this);
+            pNewAttr = MakeAttribute<BitmapAttribute>(pAttribute, this);
         }
         break;
         case $REPARSE_POINT:
@@ -492,21 +492,21 @@ HRESULT MFTRecord::ParseAttribute(
             if (ReparsePointAttribute::IsJunction(flags))
             {
                 m_bIsJunction = true;
-                pNewAttr = make_shared<JunctionReparseAttribute>(pAttribute, this);
+                pNewAttr = MakeAttribute<JunctionReparseAttribute>(pAttribute, this);
             }
             else if (ReparsePointAttribute::IsSymbolicLink(flags))
             {
                 m_bIsSymLink = true;
-                pNewAttr = make_shared<SymlinkReparseAttribute>(pAttribute, this);
+                pNewAttr = MakeAttribute<SymlinkReparseAttribute>(pAttribute, this);
             }
             else if (ReparsePointAttribute::IsWindowsOverlayFile(flags))
             {
                 m_bIsOverlayFile = true;
-                pNewAttr = make_shared<WOFReparseAttribute>(pAttribute, this);
+                pNewAttr = MakeAttribute<WOFReparseAttribute>(pAttribute, this);
             }
             else
             {
-                pNewAttr = make_shared<ReparsePointAttribute>(pAttribute, this);
+                pNewAttr = MakeAttribute<ReparsePointAttribute>(pAttribute, this);
             }
         }
         break;
@@ -518,21 +518,21 @@ HRESULT MFTRecord::ParseAttribute(
             {
                 pEAInfo = (EA_INFORMATION*)(((BYTE*)pAttribute) + pAttribute->Form.Resident.ValueOffset);
             }
-            pNewAttr = make_shared<MftRecordAttribute>(pAttribute, this);
+            pNewAttr = MakeAttribute<MftRecordAttribute>(pAttribute, this);
         }
         break;
         case $EA:
         {
             log::Verbose(pLog, L"\tAdding $EA attribute\r\n");
 
-            pNewAttr = make_shared<ExtendedAttribute>(pAttribute, this);
+            pNewAttr = MakeAttribute<ExtendedAttribute>(pAttribute, this);
             m_bHasExtendedAttr = true;
         }
         break;
         case $LOGGED_UTILITY_STREAM:
         {
             log::Verbose(pLog, L"\tAdding $LOGGED_UTILITY_STREAM attribute\r\n");
-            pNewAttr = make_shared<MftRecordAttribute>(pAttribute, this);
+            pNewAttr = MakeAttribute<MftRecordAttribute>(pAttribute, this);
         }
         break;
         case $END:
@@ -544,7 +544,7 @@ HRESULT MFTRecord::ParseAttribute(
         default:
         {
             log::Warning(pLog, S_OK, L"Unknown attribute 0x%lx\r\n", pAttribute->TypeCode);
-            pNewAttr = make_shared<MftRecordAttribute>(pAttribute, this);
+            pNewAttr = MakeAttribute<MftRecordAttribute>(pAttribute, this);
         }
     }
     return S_OK;
@@ -779,7 +779,7 @@ HRESULT MFTRecord::EnumData(
             else
             {
                 ULONGLONG ullBytesRead = 0LL;
-                if (FAILED(hr = VolReader->Read(iter->ullDiskBasedOffset, buffer, iter->ullSize, ullBytesRead)))
+                if (FAILED(hr = VolReader->ReadAt(iter->ullDiskBasedOffset, buffer, iter->ullSize, ullBytesRead)))
                     return hr;
             }
             if (FAILED(hr = pCallBack(ullBufferBasedOffset, buffer)))
@@ -846,7 +846,7 @@ HRESULT MFTRecord::EnumData(
             else
             {
                 ULONGLONG ullBytesRead = 0LL;
-                if (FAILED(hr = VolReader->Read(iter->ullDiskBasedOffset, buffer, iter->ullSize, ullBytesRead)))
+                if (FAILED(hr = VolReader->ReadAt(iter->ullDiskBasedOffset, buffer, iter->ullSize, ullBytesRead)))
                     return hr;
             }
             if (FAILED(hr = pCallBack(ullBufferBasedOffset, buffer)))
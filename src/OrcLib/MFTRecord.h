@@ -17,6 +17,7 @@
 #include "NtfsDataStructures.h"
 
 #include "VolumeReader.h"
+#include "ArenaStorage.h"
 
 #include <vector>
 
@@ -36,6 +37,10 @@ class ORCLIB_API MFTRecord
     friend class AttributeList;
 
 public:
+    using FileNameVector = std::vector<PFILE_NAME, ArenaStorage::Allocator<PFILE_NAME>>;
+    using DataAttributeVector =
+        std::vector<std::shared_ptr<DataAttribute>, ArenaStorage::Allocator<std::shared_ptr<DataAttribute>>>;
+
     const std::vector<std::pair<MFTUtils::SafeMFTSegmentNumber, MFTRecord*>>& GetChildRecords() const
     {
         return m_ChildRecords;
@@ -79,14 +84,14 @@ public:
         return NtfsUnsafeSegmentNumber(&m_FileReferenceNumber);
     }
 
-    const std::vector<PFILE_NAME>& GetFileNames() const { return m_FileNames; };
+    const FileNameVector& GetFileNames() const { return m_FileNames; };
     const std::vector<AttributeListEntry>& GetAttributeList() const { return m_pAttributeList->m_AttList; };
 
     USHORT GetAttributeIndex(const std::shared_ptr<MftRecordAttribute>& attr) const;
     USHORT GetFileNameIndex(const PFILE_NAME pFileName) const;
     USHORT GetDataIndex(const std::shared_ptr<DataAttribute>& pDataAttr) const;
 
-    const std::vector<std::shared_ptr<DataAttribute>>& GetDataAttributes() const { return m_DataAttrList; };
+    const DataAttributeVector& GetDataAttributes() const { return m_DataAttrList; };
     const std::shared_ptr<DataAttribute> GetDataAttribute(LPCWSTR szAttrName);
 
     const std::shared_ptr<IndexAllocationAttribute> GetIndexAllocationAttribute(LPCWSTR szAttrName) const;
@@ -142,6 +147,7 @@ public:
         m_bHasNamedDataAttr = false;
         m_bHasExtendedAttr = false;
         m_pBaseFileRecord = NULL;
+        m_pArena = nullptr;
     }
 
 private:
@@ -161,8 +167,8 @@ private:
     FILE_REFERENCE m_FileReferenceNumber;
 
     // Interpreted	attributes
-    std::vector<PFILE_NAME> m_FileNames;
-    std::vector<std::shared_ptr<DataAttribute>> m_DataAttrList;
+    FileNameVector m_FileNames;
+    DataAttributeVector m_DataAttrList;
     std::shared_ptr<AttributeList> m_pAttributeList;
 
     std::vector<std::pair<MFTUtils::SafeMFTSegmentNumber, MFTRecord*>> m_ChildRecords;
@@ -173,6 +179,25 @@ private:
 
     MFTRecord* m_pBaseFileRecord = NULL;
 
+    // When set, attributes and the file name and data attribute lists are allocated from the walk's arena instead of
+    // the process heap
+    ArenaStorage* m_pArena = nullptr;
+
+    void SetArena(ArenaStorage* pArena)
+    {
+        m_pArena = pArena;
+        m_FileNames = FileNameVector(ArenaStorage::Allocator<PFILE_NAME>(pArena));
+        m_DataAttrList = DataAttributeVector(ArenaStorage::Allocator<std::shared_ptr<DataAttribute>>(pArena));
+    }
+
+    template <class _Attr, class... _Args>
+    std::shared_ptr<_Attr> MakeAttribute(_Args&&... args)
+    {
+        if (m_pArena != nullptr)
+            return std::allocate_shared<_Attr>(ArenaStorage::Allocator<_Attr>(m_pArena), std::forward<_Args>(args)...);
+        return std::make_shared<_Attr>(std::forward<_Args>(args)...);
+    }
+
     PFILE_NAME GetMain_PFILE_NAME() const;
 
     HRESULT ParseAttribute(
@@ -466,7 +466,7 @@ HRESULT MFTRecordFileInfo::WriteADS(ITableOutput& output)
         return E_POINTER;
     }
 
-    const vector<shared_ptr<DataAttribute>>& dataattrs = m_pMFTRecord->GetDataAttributes();
+    const auto& dataattrs = m_pMFTRecord->GetDataAttributes();
 
     if (dataattrs.size())
     {
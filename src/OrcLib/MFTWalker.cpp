@@ -20,6 +20,12 @@
 #include "MFTOffline.h"
 
 #include "OrcException.h"
+#include "Semaphore.h"
+
+#include <agents.h>
+#include <ppl.h>
+
+#include <atomic>
 
 #include <boost/scope_exit.hpp>
 
@@ -29,25 +35,30 @@ using namespace Orc;
 // Number of items in the VirtualStore
 constexpr auto SEGMENT_MAX_NUMBER = (0x10000);
 
-HCRYPTPROV MFTRecord::g_hProv = NULL;
+// Number of FRS handed over to the parsing workers at once by the pipelined walker
+constexpr auto FRS_PER_BATCH = 1024;
+
+namespace {
 
-MFTWalker::MFTFileNameWrapper::MFTFileNameWrapper(const PFILE_NAME pFileName)
+// Segment number of a file reference (without its sequence number)
+constexpr ULONGLONG SegmentIndex(MFTUtils::SafeMFTSegmentNumber ullReference)
 {
-    _ASSERT(pFileName != NULL);
-    const size_t size = sizeof(FILE_NAME) + (pFileName->FileNameLength * sizeof(WCHAR));
-    m_pFileName = (PFILE_NAME)malloc(size);
-    if (m_pFileName == NULL)
-        throw std::exception("Out of memory");
-    CopyMemory(m_pFileName, pFileName, size);
-    m_InLocation = boost::indeterminate;
+    return ullReference & 0x0000FFFFFFFFFFFFULL;
 }
 
+}  // namespace
+
+HCRYPTPROV MFTRecord::g_hProv = NULL;
+
 HRESULT MFTWalker::Initialize(const shared_ptr<Location>& loc, bool bIncludeNoInUse)
 {
     HRESULT hr = E_FAIL;
 
     m_bIncludeNotInUse = bIncludeNoInUse;
+    m_LocationType = loc->GetType();
     m_pVolReader = loc->GetReader();
+    m_pVolRandomReader = m_pVolReader;
+    m_pCachedReader.reset();
 
     if (m_pVolReader == nullptr)
         return E_OUTOFMEMORY;
@@ -68,12 +79,20 @@ HRESULT MFTWalker::Initialize(const shared_ptr<Location>& loc, bool bIncludeNoIn
     }
     else
     {
-        m_pMFT = std::make_unique<MFTOnline>(_L_, m_pVolReader);
+        if (m_cbReadCache > 0)
+        {
+            m_pCachedReader = std::make_shared<CachedVolumeReader>(_L_, m_pVolReader, m_cbReadCache);
+            m_pVolRandomReader = m_pCachedReader;
+        }
+        m_pMFT = std::make_unique<MFTOnline>(_L_, m_pVolRandomReader);
     }
 
     if (FAILED(m_pMFT->Initialize()))
         return hr;
 
+    m_pMFT->SetReadAhead(m_dwFRSPerRead, m_dwReadQueueDepth);
+    m_pMFT->SetFetchOptions(m_dwFetchGapThreshold, m_dwFetchCacheSize);
+
     if (!loc->GetSubDirs().empty())
     {
         auto& SpecificLocations = loc->GetSubDirs();
@@ -115,49 +134,6 @@ HRESULT MFTWalker::Initialize(const shared_ptr<Location>& loc, bool bIncludeNoIn
     return S_OK;
 }
 
-HRESULT MFTWalker::ExtendNameBuffer(WCHAR** pCurrent)
-{
-    WCHAR* pNewBuf = NULL;
-
-    pNewBuf = (WCHAR*)HeapAlloc(GetProcessHeap(), 0L, m_dwFullNameBufferLen + m_pVolReader->MaxComponentLength());
-    if (!pNewBuf)
-        return E_OUTOFMEMORY;
-
-    if (m_pFullNameBuffer)
-    {
-#ifdef DEBUG
-        wmemset(pNewBuf, L'#', (m_dwFullNameBufferLen + m_pVolReader->MaxComponentLength()) / sizeof(WCHAR));
-        pNewBuf[(m_dwFullNameBufferLen + m_pVolReader->MaxComponentLength()) / sizeof(WCHAR) - 1] = 0;
-#endif
-        memcpy_s(
-            pNewBuf + (m_pVolReader->MaxComponentLength() / sizeof(WCHAR)) - 1,
-            m_dwFullNameBufferLen + m_pVolReader->MaxComponentLength(),
-            m_pFullNameBuffer,
-            m_dwFullNameBufferLen);
-    }
-
-    if (pCurrent)
-    {
-        DWORD dwIndex = (DWORD)(*pCurrent - m_pFullNameBuffer);
-
-        *pCurrent = pNewBuf + (m_pVolReader->MaxComponentLength() / sizeof(WCHAR)) - 1;
-        *pCurrent += dwIndex;
-        if (*pCurrent >= (pNewBuf + (m_dwFullNameBufferLen + m_pVolReader->MaxComponentLength()) / sizeof(WCHAR)))
-        {
-            HeapFree(GetProcessHeap(), 0L, pNewBuf);
-            return E_FAIL;
-        }
-    }
-
-    if (m_pFullNameBuffer)
-        HeapFree(GetProcessHeap(), 0L, m_pFullNameBuffer);
-
-    m_pFullNameBuffer = pNewBuf;
-    m_dwFullNameBufferLen += m_pVolReader->MaxComponentLength();
-
-    return S_OK;
-}
-
 HRESULT MFTWalker::UpdateAttributeList(MFTRecord* pRecord)
 {
     HRESULT hr = E_FAIL;
@@ -247,8 +223,6 @@ bool MFTWalker::IsInLocation(PFILE_NAME pFileName)
     if (m_Locations.empty())
         return true;
 
-    boost::logic::tribool bInLocation = boost::indeterminate;
-
     MFTUtils::SafeMFTSegmentNumber ulLastSegmentNumber = NtfsFullSegmentNumber(&(pFileName->ParentDirectory));
     auto it = m_DirectoryNames.find(ulLastSegmentNumber);
 
@@ -259,12 +233,12 @@ bool MFTWalker::IsInLocation(PFILE_NAME pFileName)
     }
     else
     {
-        if (it->second.m_InLocation)
+        if (it->second.InLocation)
         {
             // Direct parent is in location, return true!
             return true;
         }
-        else if (!it->second.m_InLocation)
+        else if (!it->second.InLocation)
         {
             // if direct parent is determined and false then, Record is not in location!
             return false;
@@ -274,315 +248,191 @@ bool MFTWalker::IsInLocation(PFILE_NAME pFileName)
             // direct parent is indeterminate... need to determinate!
             bool bNameInLocation = false;
             GetFullNameAndIfInLocation(pFileName, nullptr, nullptr, &bNameInLocation);
-            it->second.m_InLocation = bNameInLocation;  // result saved for future queries
+            it->second.InLocation = bNameInLocation;  // result saved for future queries
             return bNameInLocation;
         }
     }
 }
 
-const WCHAR* MFTWalker::GetFullNameAndIfInLocation(
-    PFILE_NAME pFileName,
-    const std::shared_ptr<DataAttribute>& pDataAttr,
-    DWORD* pdwLen,
-    bool* pbInSpecificLocation)
+void MFTWalker::InsertDirectoryName(MFTUtils::SafeMFTSegmentNumber ullDirectory, const PFILE_NAME pFileName)
 {
-    WCHAR* pCurrent = NULL;
+    if (m_DirectoryNames.find(ullDirectory) != end(m_DirectoryNames))
+        return;
 
-    if (m_Locations.empty() && pbInSpecificLocation != nullptr)
-        *pbInSpecificLocation = true;
+    DirectoryEntry entry;
+    entry.ParentDirectory = pFileName->ParentDirectory;
+    entry.NameLength = pFileName->FileNameLength;
 
-    if (m_pFullNameBuffer == NULL)
-    {
-        m_dwFullNameBufferLen = msl::utilities::SafeInt(m_pVolReader->MaxComponentLength()) * 2;
-        m_pFullNameBuffer = (WCHAR*)HeapAlloc(GetProcessHeap(), 0L, m_dwFullNameBufferLen);
-        if (!m_pFullNameBuffer)
-            return NULL;
-    }
-#ifdef DEBUG
-    wmemset(m_pFullNameBuffer, L'_', m_dwFullNameBufferLen / sizeof(WCHAR));
-    m_pFullNameBuffer[(m_pVolReader->MaxComponentLength() / sizeof(WCHAR)) - 1] = 0;
-#endif
+    // The name is appended to the pool to be looked up and dropped if the pool already has it
+    const PooledName candidate {static_cast<DWORD>(m_DirectoryNamePool.size()), entry.NameLength};
+    m_DirectoryNamePool.append(pFileName->FileName, pFileName->FileNameLength);
 
-    DWORD dwCount = 0;
-    DWORD dwBaseNameCount = 0;
+    const auto [itName, bInserted] = m_DirectoryNameIndex.insert(candidate);
+    if (!bInserted)
+        m_DirectoryNamePool.resize(candidate.Offset);
 
-    // Doing trailing \0
-    if (dwCount > m_dwFullNameBufferLen)
-    {
-        if (FAILED(ExtendNameBuffer(&pCurrent)))
-            return NULL;
-    }
-    _ASSERT(dwCount < m_dwFullNameBufferLen);
-    {
-        dwCount += sizeof(WCHAR);
+    entry.NameOffset = itName->Offset;
+    m_DirectoryNames.emplace(ullDirectory, std::move(entry));
+}
 
-        if (dwCount > m_dwFullNameBufferLen)
-        {
-            if (FAILED(ExtendNameBuffer(&pCurrent)))
-                return NULL;
-        }
-        _ASSERT(dwCount <= m_dwFullNameBufferLen);
+bool MFTWalker::AppendDirectoryPrefix(MFTUtils::SafeMFTSegmentNumber ullDirectory, std::wstring& strPath)
+{
+    const auto ullRoot = m_pMFT->GetUSNRoot();
 
-        pCurrent = m_pFullNameBuffer + (m_dwFullNameBufferLen / sizeof(WCHAR)) - 1;
-        _ASSERT(pCurrent >= m_pFullNameBuffer);
-        *pCurrent = 0;
-    }
+    // Walk up the tree until the root, an already resolved directory or a missing one
+    m_DirectoryChain.clear();
 
-    // Doing Stream name
-    if (pDataAttr != NULL)
-    {
-        PATTRIBUTE_RECORD_HEADER pHeader = pDataAttr->Header();
+    MFTUtils::SafeMFTSegmentNumber ullCurrent = ullDirectory;
+    const DirectoryEntry* pResolved = nullptr;
+    bool bReachedRoot = false;
 
-        if (pHeader->NameLength)
+    while (true)
+    {
+        auto it = m_DirectoryNames.find(ullCurrent);
+        if (it == end(m_DirectoryNames))
         {
-            // Stream has a name, we have to add it
-            {
-                dwCount += pHeader->NameLength * sizeof(WCHAR);
-                dwBaseNameCount += pHeader->NameLength;
-
-                if (dwCount > m_dwFullNameBufferLen)
-                {
-                    if (FAILED(ExtendNameBuffer(&pCurrent)))
-                        return NULL;
-                }
-                _ASSERT(dwCount <= m_dwFullNameBufferLen);
-
-                pCurrent -= pHeader->NameLength;
-                _ASSERT(pCurrent >= m_pFullNameBuffer);
-
-                memcpy_s(
-                    pCurrent, dwCount, ((BYTE*)pHeader) + pHeader->NameOffset, pHeader->NameLength * sizeof(WCHAR));
-            }
+            bReachedRoot = ullCurrent == ullRoot;
+            break;
+        }
+        if (it->second.IsResolved())
+        {
+            pResolved = &it->second;
+            bReachedRoot = true;
+            break;
+        }
+        if (m_DirectoryChain.size() > m_DirectoryNames.size())
+        {
+            log::Verbose(_L_, L"Loop detected in the parents of directory %.16I64X\r\n", ullDirectory);
+            break;
+        }
 
-            // adding colon
-            {
-                dwCount += 1 * sizeof(WCHAR);
-                dwBaseNameCount += 1;
+        m_DirectoryChain.push_back(&it->second);
 
-                if (dwCount > m_dwFullNameBufferLen)
-                {
-                    if (FAILED(ExtendNameBuffer(&pCurrent)))
-                        return NULL;
-                }
-                _ASSERT(dwCount <= m_dwFullNameBufferLen);
+        ullCurrent = NtfsFullSegmentNumber(&it->second.ParentDirectory);
+        if (ullCurrent == ullRoot)
+        {
+            bReachedRoot = true;
+            break;
+        }
+    }
 
-                pCurrent -= 1;
-                _ASSERT(pCurrent >= m_pFullNameBuffer);
+    const auto prefixStart = strPath.size();
 
-                *pCurrent = L':';
-            }
-        }
+    if (pResolved != nullptr)
+    {
+        // the usual case: one lookup and one append
+        strPath.append(m_DirectoryPrefixPool, pResolved->PrefixOffset, pResolved->PrefixLength);
+    }
+    else if (bReachedRoot)
+    {
+        strPath.push_back(L'\\');
+    }
+    else
+    {
+        // Parent folder was _not_ found, inserting "place holder"
+        WCHAR szPlaceHolder[24];
+        swprintf_s(szPlaceHolder, L"\\__%.16I64X__\\", ullCurrent);
+        strPath.append(szPlaceHolder);
     }
 
-    // Doing base file name
-    PFILE_NAME pCurFileName = pFileName;
-    if (pCurFileName != nullptr)
+    for (auto it = m_DirectoryChain.rbegin(); it != m_DirectoryChain.rend(); ++it)
     {
-        dwCount += pCurFileName->FileNameLength * sizeof(WCHAR);
-        dwBaseNameCount += pCurFileName->FileNameLength;
+        DirectoryEntry& entry = **it;
 
-        if (dwCount > m_dwFullNameBufferLen)
+        if (!(entry.NameLength == 1 && m_DirectoryNamePool[entry.NameOffset] == L'.'))
         {
-            if (FAILED(ExtendNameBuffer(&pCurrent)))
-                return NULL;
+            strPath.append(m_DirectoryNamePool, entry.NameOffset, entry.NameLength);
+            strPath.push_back(L'\\');
         }
-        _ASSERT(dwCount <= m_dwFullNameBufferLen);
 
-        pCurrent -= pCurFileName->FileNameLength;
-        _ASSERT(pCurrent >= m_pFullNameBuffer);
-        memcpy_s(pCurrent, dwCount, pCurFileName->FileName, pCurFileName->FileNameLength * sizeof(WCHAR));
+        // Only prefixes leading to the root are kept, a missing parent could show up later
+        if (bReachedRoot)
+        {
+            entry.PrefixOffset = static_cast<DWORD>(m_DirectoryPrefixPool.size());
+            entry.PrefixLength = static_cast<DWORD>(strPath.size() - prefixStart);
+            m_DirectoryPrefixPool.append(strPath, prefixStart, entry.PrefixLength);
+        }
     }
-    else
-    {
-        const WCHAR szNullFileName[] = L"<NoName>";
-        const DWORD dwNullFileName = (DWORD)wcslen(szNullFileName);
+    return bReachedRoot;
+}
 
-        dwCount += dwNullFileName * sizeof(WCHAR);
-        dwBaseNameCount += dwNullFileName;
+const WCHAR* MFTWalker::GetFullNameAndIfInLocation(
+    PFILE_NAME pFileName,
+    const std::shared_ptr<DataAttribute>& pDataAttr,
+    DWORD* pdwLen,
+    bool* pbInSpecificLocation)
+{
+    if (m_Locations.empty() && pbInSpecificLocation != nullptr)
+        *pbInSpecificLocation = true;
 
-        if (dwCount > m_dwFullNameBufferLen)
-        {
-            if (FAILED(ExtendNameBuffer(&pCurrent)))
-                return NULL;
-        }
-        _ASSERT(dwCount <= m_dwFullNameBufferLen);
+    m_FullName.clear();
+
+    bool bReachedRoot = false;
+    auto pDirectParent = end(m_DirectoryNames);
+
+    // Doing parent directories and base file name
+    if (pFileName != nullptr)
+    {
+        pDirectParent = m_DirectoryNames.find(NtfsFullSegmentNumber(&(pFileName->ParentDirectory)));
+        bReachedRoot = AppendDirectoryPrefix(NtfsFullSegmentNumber(&(pFileName->ParentDirectory)), m_FullName);
 
-        pCurrent -= dwNullFileName;
-        _ASSERT(pCurrent >= m_pFullNameBuffer);
-        memcpy_s(pCurrent, dwCount, szNullFileName, dwNullFileName * sizeof(WCHAR));
+        m_FullName.append(pFileName->FileName, pFileName->FileNameLength);
+    }
+    else
+    {
+        m_FullName.append(L"<NoName>");
 
         // Entries with lost parents are
         if (pbInSpecificLocation != nullptr)
             *pbInSpecificLocation = m_Locations.empty() ? true : false;
-
-        if (pdwLen)
-            *pdwLen = dwCount;
-        return pCurrent;
     }
 
-    MFTUtils::SafeMFTSegmentNumber ulLastSegmentNumber = NtfsFullSegmentNumber(&(pCurFileName->ParentDirectory));
-
-    auto pParentPair = m_DirectoryNames.find(NtfsFullSegmentNumber(&(pCurFileName->ParentDirectory)));
-    auto pDirectParent = pParentPair;
-
-    while (pParentPair != end(m_DirectoryNames))
+    // Doing Stream name
+    if (pDataAttr != NULL)
     {
-        PFILE_NAME pParentName = pParentPair->second.FileName();
-
-        if (pParentName == NULL)
-        {
-            log::Verbose(
-                (_L_),
-                L"Could not determine main parent file name for %.*s\r\n",
-                pCurFileName->FileNameLength,
-                pCurFileName->FileName);
-            break;
-        }
+        PATTRIBUTE_RECORD_HEADER pHeader = pDataAttr->Header();
 
-        if (!(pParentName->FileNameLength == 1 && *pParentName->FileName == L'.'))
+        if (pHeader->NameLength)
         {
-            // Adding \\ (i.e. one backslash)
-            {
-                dwCount += sizeof(WCHAR);
-                if (dwCount > m_dwFullNameBufferLen)
-                {
-                    if (FAILED(ExtendNameBuffer(&pCurrent)))
-                        return NULL;
-                }
-                _ASSERT(dwCount <= m_dwFullNameBufferLen);
-
-                pCurrent--;
-                _ASSERT(pCurrent >= m_pFullNameBuffer);
-
-                *pCurrent = L'\\';
-            }
-
-            // Adding parent file name
-            {
-                dwCount += pParentName->FileNameLength * sizeof(WCHAR);
-                if (dwCount > m_dwFullNameBufferLen)
-                {
-                    if (FAILED(ExtendNameBuffer(&pCurrent)))
-                        return NULL;
-                }
-                _ASSERT(dwCount <= m_dwFullNameBufferLen);
-
-                pCurrent -= pParentName->FileNameLength;
-                _ASSERT(pCurrent >= m_pFullNameBuffer);
-
-                memcpy_s(pCurrent, dwCount, pParentName->FileName, pParentName->FileNameLength * sizeof(WCHAR));
-            }
+            // Stream has a name, we have to add it
+            m_FullName.push_back(L':');
+            m_FullName.append((WCHAR*)(((BYTE*)pHeader) + pHeader->NameOffset), pHeader->NameLength);
         }
-        ulLastSegmentNumber = NtfsFullSegmentNumber(&(pParentName->ParentDirectory));
-        pParentPair = m_DirectoryNames.find(NtfsFullSegmentNumber(&(pParentName->ParentDirectory)));
-
-        if (ulLastSegmentNumber == m_pMFT->GetUSNRoot())
-            break;
     }
 
-    if (ulLastSegmentNumber == m_pMFT->GetUSNRoot())
+    if (bReachedRoot && pDirectParent != end(m_DirectoryNames))
     {
-        // Adding \\ (i.e. one backslash)
+        // Looking for presence in specific locations
+        if (!m_Locations.empty() && boost::logic::indeterminate(pDirectParent->second.InLocation))
         {
-            dwCount += sizeof(WCHAR);
-            if (dwCount > m_dwFullNameBufferLen)
-            {
-                if (FAILED(ExtendNameBuffer(&pCurrent)))
-                    return NULL;
-            }
-            _ASSERT(dwCount <= m_dwFullNameBufferLen);
-
-            pCurrent--;
-            _ASSERT(pCurrent >= m_pFullNameBuffer);
-
-            *pCurrent = L'\\';
+            pDirectParent->second.InLocation =
+                std::any_of(begin(m_Locations), end(m_Locations), [this](const wstring& item) {
+                    return !_wcsnicmp(m_FullName.c_str(), item.c_str(), item.size());
+                });
         }
-
-        if (pDirectParent != end(m_DirectoryNames))
+        if (pbInSpecificLocation != nullptr)
         {
-            // Looking for presence in specific locations
-            if (!m_Locations.empty() && boost::logic::indeterminate(pDirectParent->second.m_InLocation))
-            {
-                pDirectParent->second.m_InLocation = std::any_of(
-                    begin(m_Locations), end(m_Locations), [pCurrent, pbInSpecificLocation](const wstring& item) {
-                        return !_wcsnicmp(pCurrent, item.c_str(), item.size());
-                    });
-            }
-            if (pbInSpecificLocation != nullptr)
+            if (m_Locations.empty())
+                *pbInSpecificLocation = true;
+            else
             {
-                if (m_Locations.empty())
+                if (pDirectParent->second.InLocation)
                     *pbInSpecificLocation = true;
+                else if (!pDirectParent->second.InLocation)
+                    *pbInSpecificLocation = false;
                 else
                 {
-                    if (pDirectParent->second.m_InLocation)
-                        *pbInSpecificLocation = true;
-                    else if (!pDirectParent->second.m_InLocation)
-                        *pbInSpecificLocation = false;
-                    else
-                    {
-                        log::Error(_L_, E_FAIL, L"Failed to determine if in location for path %s\r\n", pCurrent);
-                        *pbInSpecificLocation = false;
-                    }
+                    log::Error(
+                        _L_, E_FAIL, L"Failed to determine if in location for path %s\r\n", m_FullName.c_str());
+                    *pbInSpecificLocation = false;
                 }
             }
         }
-
-        // And we're done :-)
-        if (pdwLen)
-            *pdwLen = dwCount;
-        return pCurrent;
     }
-    else
-    {
-        // Parent folder was _not_ found, inserting "place holder"
-        // Adding \\ (i.e. one backslash)
-
-        {
-            dwCount += sizeof(WCHAR);
-            if (dwCount > m_dwFullNameBufferLen)
-            {
-                if (FAILED(ExtendNameBuffer(&pCurrent)))
-                    return NULL;
-            }
-            _ASSERT(dwCount <= m_dwFullNameBufferLen);
-
-            pCurrent--;
-            _ASSERT(pCurrent >= m_pFullNameBuffer);
-            *pCurrent = L'\\';
-        }
-
-        {
-            dwCount += sizeof(WCHAR) * 20;
-            if (dwCount > m_dwFullNameBufferLen)
-            {
-                if (FAILED(ExtendNameBuffer(&pCurrent)))
-                    return NULL;
-            }
-            _ASSERT(dwCount <= m_dwFullNameBufferLen);
-
-            pCurrent -= 20;
-            swprintf_s(pCurrent, 21, L"__%.16I64X__", ulLastSegmentNumber);
-            pCurrent[20] = L'\\';
-        }
-
-        {
-            dwCount += sizeof(WCHAR);
-            if (dwCount > m_dwFullNameBufferLen)
-            {
-                if (FAILED(ExtendNameBuffer(&pCurrent)))
-                    return NULL;
-            }
-            _ASSERT(dwCount <= m_dwFullNameBufferLen);
-
-            pCurrent--;
-            _ASSERT(pCurrent >= m_pFullNameBuffer);
-            *pCurrent = L'\\';
-        }
 
-        if (pdwLen)
-            *pdwLen = dwCount;
-        return pCurrent;
-    }
+    if (pdwLen)
+        *pdwLen = static_cast<DWORD>((m_FullName.size() + 1) * sizeof(WCHAR));
+    return m_FullName.c_str();
 }
 
 bool MFTWalker::AreAttributesComplete(const MFTRecord* pBaseRecord, std::vector<MFT_SEGMENT_REFERENCE>& missingRecords)
@@ -715,37 +565,38 @@ bool MFTWalker::IsRecordComplete(
                 break;
             }
 
-            auto pParentName = pParentPair->second.FileName();
+            auto pParentEntry = &pParentPair->second;
 
-            while (pParentName != nullptr)
+            // a resolved directory has all its parents
+            while (pParentEntry != nullptr && !pParentEntry->IsResolved())
             {
                 MFTUtils::UnSafeMFTSegmentNumber UnSafeSegmentNumber =
-                    NtfsSegmentNumber(&(pParentName->ParentDirectory));
-                ULONGLONG SafeSegmentNumber = NtfsFullSegmentNumber(&(pParentName->ParentDirectory));
+                    NtfsSegmentNumber(&(pParentEntry->ParentDirectory));
+                ULONGLONG SafeSegmentNumber = NtfsFullSegmentNumber(&(pParentEntry->ParentDirectory));
                 if (SafeSegmentNumber == m_pMFT->GetUSNRoot() || UnSafeSegmentNumber == 0)
                     break;
 
                 const auto& pOtherParentPair =
-                    m_DirectoryNames.find(NtfsFullSegmentNumber(&(pParentName->ParentDirectory)));
+                    m_DirectoryNames.find(NtfsFullSegmentNumber(&(pParentEntry->ParentDirectory)));
                 if (pOtherParentPair == end(m_DirectoryNames))
                 {
                     log::Debug(
                         _L_,
                         L"Record %.16I64X: Incomplete due to missing file name parent record %.16I64X\r\n",
                         NtfsFullSegmentNumber(&pRecord->GetFileReferenceNumber()),
-                        pParentName->ParentDirectory);
+                        pParentEntry->ParentDirectory);
 
-                    auto pParent = m_MFTMap.find(NtfsFullSegmentNumber(&(pParentName->ParentDirectory)));
+                    auto pParent = m_MFTMap.find(NtfsFullSegmentNumber(&(pParentEntry->ParentDirectory)));
                     if (pParent == end(m_MFTMap))
                     {
-                        missingRecords.push_back(pParentName->ParentDirectory);
+                        missingRecords.push_back(pParentEntry->ParentDirectory);
                     }
                     bIsComplete = false;
-                    pParentName = nullptr;
+                    pParentEntry = nullptr;
                 }
                 else
                 {
-                    pParentName = pOtherParentPair->second.FileName();
+                    pParentEntry = &pOtherParentPair->second;
                 }
             }
         }
@@ -803,7 +654,7 @@ HRESULT MFTWalker::ParseI30AndCallback(MFTRecord* pRecord)
     std::shared_ptr<IndexRootAttribute> pIR;
     std::shared_ptr<BitmapAttribute> pBM;
 
-    if (FAILED(hr = pRecord->GetIndexAttributes(m_pVolReader, L"$I30", pIR, pIA, pBM)))
+    if (FAILED(hr = pRecord->GetIndexAttributes(m_pVolRandomReader, L"$I30", pIR, pIA, pBM)))
     {
         log::Error(_L_, hr, L"Failed to find $I30 attributes\r\n");
         return hr;
@@ -827,7 +678,7 @@ HRESULT MFTWalker::ParseI30AndCallback(MFTRecord* pRecord)
     if (pIA != nullptr && m_Callbacks.I30Callback != nullptr)
     {
         ULONGLONG ToRead = 0ULL;
-        if (FAILED(hr = pIA->DataSize(m_pVolReader, ToRead)))
+        if (FAILED(hr = pIA->DataSize(m_pVolRandomReader, ToRead)))
         {
             log::Error(_L_, hr, L"Failed to determine $INDEX_ALLOCATION size\r\n");
             return hr;
@@ -837,7 +688,7 @@ HRESULT MFTWalker::ParseI30AndCallback(MFTRecord* pRecord)
 
         if (FAILED(
                 hr = pRecord->EnumData(
-                    m_pVolReader,
+                    m_pVolRandomReader,
                     pIA,
                     0ULL,
                     ToRead,
@@ -945,7 +796,7 @@ HRESULT MFTWalker::Parse$SecureAndCallback(MFTRecord* pRecord)
         return hr;
     }
 
-    auto pSDSStream = pSDSAttr->GetDataStream(_L_, m_pVolReader);
+    auto pSDSStream = pSDSAttr->GetDataStream(_L_, m_pVolRandomReader);
     if (!pSDSStream)
     {
         log::Error(
@@ -981,7 +832,7 @@ HRESULT MFTWalker::Parse$SecureAndCallback(MFTRecord* pRecord)
     std::shared_ptr<IndexAllocationAttribute> pIA;
     std::shared_ptr<IndexRootAttribute> pIR;
     std::shared_ptr<BitmapAttribute> pBM;
-    if (FAILED(hr = pRecord->GetIndexAttributes(m_pVolReader, L"$SII", pIR, pIA, pBM)))
+    if (FAILED(hr = pRecord->GetIndexAttributes(m_pVolRandomReader, L"$SII", pIR, pIA, pBM)))
     {
         log::Error(_L_, hr, L"Failed to find $SII attributes\r\n");
         return hr;
@@ -1001,7 +852,7 @@ HRESULT MFTWalker::Parse$SecureAndCallback(MFTRecord* pRecord)
     if (pIA != nullptr)
     {
         ULONGLONG ToRead = 0ULL;
-        if (FAILED(hr = pIA->DataSize(m_pVolReader, ToRead)))
+        if (FAILED(hr = pIA->DataSize(m_pVolRandomReader, ToRead)))
         {
             log::Error(_L_, hr, L"Failed to determine $INDEX_ALLOCATION size\r\n");
             return hr;
@@ -1011,7 +862,7 @@ HRESULT MFTWalker::Parse$SecureAndCallback(MFTRecord* pRecord)
 
         if (FAILED(
                 hr = pRecord->EnumData(
-                    m_pVolReader,
+                    m_pVolRandomReader,
                     pIA,
                     0ULL,
                     ToRead,
@@ -1210,6 +1061,163 @@ HRESULT MFTWalker::FullCallCallbackForRecord(MFTRecord* pRecord, bool& bFreeReco
     return hr;
 }
 
+HRESULT MFTWalker::CallCallbackForRecord(MFTRecord* pRecord, bool& bFreeRecord)
+{
+    if (NtfsSegmentNumber(&pRecord->m_pRecord->BaseFileRecordSegment) > 0 || pRecord->HasCallbackBeenCalled()
+        || !IsRecordUnchanged(pRecord))
+        return m_pCallbackCall(this, pRecord, bFreeRecord);
+
+    // this record was already called back by the baseline walk of this volume
+    m_dwWalkedItems++;
+    m_dwUnchangedRecords++;
+
+    pRecord->CallbackCalled();
+    pRecord->CleanCachedData();
+
+    bFreeRecord = true;
+
+    if (m_Callbacks.ProgressCallback)
+        return m_Callbacks.ProgressCallback((DWORD)((m_dwWalkedItems * 100) / m_ulMFTRecordCount));
+    return S_OK;
+}
+
+void MFTWalker::BeginBaselineWalk()
+{
+    m_BaselineRole = MFTBaseline::Role::None;
+    m_pDigests.reset();
+    m_pBaselineDigests.reset();
+    m_UnchangedDirectories.clear();
+    m_dwUnchangedRecords = 0L;
+
+    const ULONGLONG ullSerial = m_pVolReader->VolumeSerialNumber();
+
+    if (m_pBaseline == nullptr || ullSerial == 0LL || m_ulMFTRecordCount == 0)
+        return;
+
+    m_BaselineRole = m_pBaseline->BeginWalk(ullSerial, m_LocationType, m_pBaselineDigests);
+
+    switch (m_BaselineRole)
+    {
+        case MFTBaseline::Role::Build:
+            log::Verbose(_L_, L"Building the MFT baseline of volume %.16I64X\r\n", ullSerial);
+            break;
+        case MFTBaseline::Role::Compare:
+            log::Verbose(
+                _L_, L"Only records differing from the MFT baseline of volume %.16I64X are called back\r\n", ullSerial);
+            break;
+        default:
+            log::Verbose(
+                _L_, L"MFT baseline of volume %.16I64X is not available to this walk, full walk\r\n", ullSerial);
+            return;
+    }
+
+    m_pDigests = std::make_shared<MFTBaseline::Digests>(m_ulMFTRecordCount);
+}
+
+void MFTWalker::EndBaselineWalk(bool bComplete)
+{
+    if (m_BaselineRole == MFTBaseline::Role::Build)
+        m_pBaseline->EndWalk(m_pVolReader->VolumeSerialNumber(), bComplete ? m_pDigests : nullptr);
+
+    m_BaselineRole = MFTBaseline::Role::None;
+    m_pDigests.reset();
+    m_pBaselineDigests.reset();
+}
+
+void MFTWalker::AddDigest(const MFT_SEGMENT_REFERENCE& reference, const CBinaryBuffer& Data)
+{
+    const ULONGLONG ullSegment = SegmentIndex(NtfsFullSegmentNumber(&reference));
+
+    // the MFT of a live volume may have grown since the walk started
+    if (ullSegment >= m_pDigests->size() || Data.GetCount() < m_pVolReader->GetBytesPerFRS())
+        return;
+
+    (*m_pDigests)[ullSegment] = MFTBaseline::GetDigest(Data.GetData(), m_pVolReader->GetBytesPerFRS());
+}
+
+bool MFTWalker::IsSegmentUnchanged(MFTUtils::SafeMFTSegmentNumber ullReference) const
+{
+    const ULONGLONG ullSegment = SegmentIndex(ullReference);
+
+    if (ullSegment >= m_pDigests->size() || ullSegment >= m_pBaselineDigests->size())
+        return false;
+
+    const auto& digest = (*m_pDigests)[ullSegment];
+    return digest.IsValid() && digest == (*m_pBaselineDigests)[ullSegment];
+}
+
+bool MFTWalker::IsDirectoryUnchanged(MFTUtils::SafeMFTSegmentNumber ullDirectory)
+{
+    const auto ullRoot = m_pMFT->GetUSNRoot();
+
+    // a path is unchanged when none of its directories changed (up to the root or a directory already checked)
+    std::vector<MFTUtils::SafeMFTSegmentNumber> chain;
+    bool bUnchanged = true;
+
+    MFTUtils::SafeMFTSegmentNumber ullCurrent = ullDirectory;
+    while (true)
+    {
+        if (auto it = m_UnchangedDirectories.find(ullCurrent); it != end(m_UnchangedDirectories))
+        {
+            bUnchanged = it->second;
+            break;
+        }
+
+        chain.push_back(ullCurrent);
+
+        if (!IsSegmentUnchanged(ullCurrent))
+        {
+            bUnchanged = false;
+            break;
+        }
+
+        if (ullCurrent == ullRoot)
+            break;
+
+        auto it = m_DirectoryNames.find(ullCurrent);
+        if (it == end(m_DirectoryNames) || chain.size() > m_DirectoryNames.size())
+        {
+            // missing parent or loop
+            bUnchanged = false;
+            break;
+        }
+
+        ullCurrent = NtfsFullSegmentNumber(&it->second.ParentDirectory);
+    }
+
+    for (auto ull : chain)
+        m_UnchangedDirectories[ull] = bUnchanged;
+
+    return bUnchanged;
+}
+
+bool MFTWalker::IsRecordUnchanged(MFTRecord* pRecord)
+{
+    if (m_BaselineRole != MFTBaseline::Role::Compare)
+        return false;
+
+    if (!IsSegmentUnchanged(NtfsFullSegmentNumber(&pRecord->m_FileReferenceNumber)))
+        return false;
+
+    if (pRecord->m_pAttributeList && pRecord->m_pAttributeList->IsPresent())
+    {
+        for (const auto& attr : pRecord->m_pAttributeList->m_AttList)
+        {
+            if (attr.m_pListEntry != nullptr
+                && !IsSegmentUnchanged(NtfsFullSegmentNumber(&attr.m_pListEntry->SegmentReference)))
+                return false;
+        }
+    }
+
+    for (const auto& name : pRecord->m_FileNames)
+    {
+        if (!IsDirectoryUnchanged(NtfsFullSegmentNumber(&name->ParentDirectory)))
+            return false;
+    }
+
+    return true;
+}
+
 HRESULT MFTWalker::WalkRecords(bool bIsFinalWalk)
 {
     HRESULT hr = E_FAIL;
@@ -1256,7 +1264,7 @@ HRESULT MFTWalker::WalkRecords(bool bIsFinalWalk)
 
             if (FAILED(
                     hr = pRecord->ParseRecord(
-                        _L_, m_pVolReader, pRecord->m_pRecord, m_pVolReader->GetBytesPerFRS(), pBaseRecord)))
+                        _L_, m_pVolRandomReader, pRecord->m_pRecord, m_pVolReader->GetBytesPerFRS(), pBaseRecord)))
             {
                 log::Error(_L_, hr, L"Failed to parse record even if every record is now loaded...\r\n");
             }
@@ -1286,7 +1294,7 @@ HRESULT MFTWalker::WalkRecords(bool bIsFinalWalk)
                     log::Debug(_L_, L"Failed to parse $Secure %.16I64X\r\n", RefNumber);
                 }
             }
-            if (FAILED(hr = m_pCallbackCall(this, pRecord, bFreeRecord)))
+            if (FAILED(hr = CallCallbackForRecord(pRecord, bFreeRecord)))
             {
                 if (hr == HRESULT_FROM_WIN32(ERROR_NO_MORE_FILES))
                 {
@@ -1357,8 +1365,7 @@ HRESULT MFTWalker::AddDirectoryName(MFTRecord* pRecord)
         // simple case, record is not a child and a directory... let's add it!
         PFILE_NAME pFileName = pRecord->GetMain_PFILE_NAME();
         if (pFileName != NULL)
-            m_DirectoryNames.insert(pair<MFTUtils::SafeMFTSegmentNumber, MFTFileNameWrapper>(
-                NtfsFullSegmentNumber(&pRecord->m_FileReferenceNumber), MFTFileNameWrapper(pFileName)));
+            InsertDirectoryName(NtfsFullSegmentNumber(&pRecord->m_FileReferenceNumber), pFileName);
         else
         {
             log::Debug(
@@ -1377,9 +1384,8 @@ HRESULT MFTWalker::AddDirectoryName(MFTRecord* pRecord)
             // it's not... we need to add it!
             PFILE_NAME pFileName = pRecord->m_pBaseFileRecord->GetMain_PFILE_NAME();
             if (pFileName != NULL)
-                m_DirectoryNames.insert(pair<MFTUtils::SafeMFTSegmentNumber, MFTFileNameWrapper>(
-                    NtfsFullSegmentNumber(&pRecord->m_pBaseFileRecord->m_FileReferenceNumber),
-                    MFTFileNameWrapper(pFileName)));
+                InsertDirectoryName(
+                    NtfsFullSegmentNumber(&pRecord->m_pBaseFileRecord->m_FileReferenceNumber), pFileName);
             else
             {
                 log::Debug(
@@ -1393,7 +1399,11 @@ HRESULT MFTWalker::AddDirectoryName(MFTRecord* pRecord)
 }
 
 HRESULT
-MFTWalker::AddRecord(MFTUtils::SafeMFTSegmentNumber& ullRecordIndex, CBinaryBuffer& Data, MFTRecord*& pAddedRecord)
+MFTWalker::AddRecord(
+    MFTUtils::SafeMFTSegmentNumber& ullRecordIndex,
+    CBinaryBuffer& Data,
+    MFTRecord*& pAddedRecord,
+    MFTRecord* pPreParsedRecord)
 {
     HRESULT hr = E_FAIL;
 
@@ -1437,6 +1447,9 @@ MFTWalker::AddRecord(MFTUtils::SafeMFTSegmentNumber& ullRecordIndex, CBinaryBuff
 
         MFTUtils::SafeMFTSegmentNumber SafeFRN = NtfsFullSegmentNumber(&SafeReference);
 
+        if (m_pDigests != nullptr)
+            AddDigest(SafeReference, Data);
+
         const auto pIter = m_MFTMap.find(SafeFRN);
 
         if (pIter != end(m_MFTMap) && pIter->second == nullptr)
@@ -1446,12 +1459,23 @@ MFTWalker::AddRecord(MFTUtils::SafeMFTSegmentNumber& ullRecordIndex, CBinaryBuff
         }
 
         MFTRecord* pRecord = nullptr;
-        if (pIter == end(m_MFTMap))
+        if (pIter == end(m_MFTMap) && pPreParsedRecord != nullptr)
         {
-            if (m_SegmentStore.AllocatedCells() >= m_CellStoreLastWalk + m_CellStoreThreshold)
+            // record was copied and parsed by the pipelined walker, it only needs to be merged
+            if (LiveCells() >= m_CellStoreLastWalk + m_CellStoreThreshold)
             {
                 WalkRecords(false);
-                m_CellStoreLastWalk = m_SegmentStore.AllocatedCells();
+                m_CellStoreLastWalk = LiveCells();
+            }
+            m_PendingCells--;
+            pRecord = pPreParsedRecord;
+        }
+        else if (pIter == end(m_MFTMap))
+        {
+            if (LiveCells() >= m_CellStoreLastWalk + m_CellStoreThreshold)
+            {
+                WalkRecords(false);
+                m_CellStoreLastWalk = LiveCells();
             }
 
             LPVOID pBuf = m_SegmentStore.GetNewCell();
@@ -1473,6 +1497,9 @@ MFTWalker::AddRecord(MFTUtils::SafeMFTSegmentNumber& ullRecordIndex, CBinaryBuff
                 }
             }
 
+            if (m_bUseArena)
+                pRecord->SetArena(&m_AttributeArena);
+
             pRecord->m_pRecord = (PFILE_RECORD_SEGMENT_HEADER)(((BYTE*)pRecord) + sizeof(MFTRecord));
 
             memcpy_s(
@@ -1526,8 +1553,16 @@ MFTWalker::AddRecord(MFTUtils::SafeMFTSegmentNumber& ullRecordIndex, CBinaryBuff
                 }
             }
 
-            hr = pRecord->ParseRecord(
-                _L_, m_pVolReader, pRecord->m_pRecord, m_pVolReader->GetBytesPerFRS(), pBaseRecord);
+            if (pPreParsedRecord != nullptr)
+            {
+                // base record already parsed by the pipelined walker
+                hr = S_OK;
+            }
+            else
+            {
+                hr = pRecord->ParseRecord(
+                    _L_, m_pVolRandomReader, pRecord->m_pRecord, m_pVolReader->GetBytesPerFRS(), pBaseRecord);
+            }
 
             if (hr == S_FALSE)
             {
@@ -1592,7 +1627,7 @@ MFTWalker::AddRecord(MFTUtils::SafeMFTSegmentNumber& ullRecordIndex, CBinaryBuff
                                     {
                                         hr = pHostRecord->ParseRecord(
                                             _L_,
-                                            m_pVolReader,
+                                            m_pVolRandomReader,
                                             pHostRecord->m_pRecord,
                                             m_pVolReader->GetBytesPerFRS(),
                                             pRecord);
@@ -1677,7 +1712,10 @@ MFTWalker::AddRecord(MFTUtils::SafeMFTSegmentNumber& ullRecordIndex, CBinaryBuff
     return S_OK;
 }
 
-HRESULT MFTWalker::AddRecordCallback(MFTUtils::SafeMFTSegmentNumber& ullRecordIndex, CBinaryBuffer& Data)
+HRESULT MFTWalker::AddRecordCallback(
+    MFTUtils::SafeMFTSegmentNumber& ullRecordIndex,
+    CBinaryBuffer& Data,
+    MFTRecord* pPreParsedRecord)
 {
     HRESULT hr = E_FAIL;
 
@@ -1686,7 +1724,7 @@ HRESULT MFTWalker::AddRecordCallback(MFTUtils::SafeMFTSegmentNumber& ullRecordIn
 
         MFTRecord* pRecord = nullptr;
 
-        if (FAILED(hr = AddRecord(ullRecordIndex, Data, pRecord)))
+        if (FAILED(hr = AddRecord(ullRecordIndex, Data, pRecord, pPreParsedRecord)))
         {
             log::Error(_L_, hr, L"Failed to add record %I64d\r\n", ullRecordIndex);
             return hr;
@@ -1828,7 +1866,7 @@ HRESULT MFTWalker::AddRecordCallback(MFTUtils::SafeMFTSegmentNumber& ullRecordIn
 
             bool bFreeRecord = false;
 
-            if (FAILED(hr = m_pCallbackCall(this, pRecord, bFreeRecord)))
+            if (FAILED(hr = CallCallbackForRecord(pRecord, bFreeRecord)))
             {
                 if (hr == HRESULT_FROM_WIN32(ERROR_NO_MORE_FILES))
                 {
@@ -1871,6 +1909,318 @@ HRESULT MFTWalker::AddRecordCallback(MFTUtils::SafeMFTSegmentNumber& ullRecordIn
     return S_OK;
 }
 
+class MFTWalker::FRSBatch
+{
+public:
+    class Entry
+    {
+    public:
+        MFTUtils::SafeMFTSegmentNumber RecordIndex = 0LL;
+        MFTRecord* pRecord = nullptr;  // pre-parsed copy, nullptr when the FRS must go through the serial path
+        HRESULT hr = E_FAIL;
+    };
+
+    FRSBatch(ULONG ulBytesPerFRS)
+        : m_ulBytesPerFRS(ulBytesPerFRS)
+    {
+        m_Entries.reserve(FRS_PER_BATCH);
+    }
+
+    HRESULT Append(MFTUtils::SafeMFTSegmentNumber ullRecordIndex, const CBinaryBuffer& Data)
+    {
+        if (Data.GetCount() < m_ulBytesPerFRS)
+            return HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+
+        if (!m_Data.CheckCount(static_cast<size_t>(m_ulBytesPerFRS) * FRS_PER_BATCH))
+            return E_OUTOFMEMORY;
+
+        CopyMemory(m_Data.GetData() + m_Entries.size() * m_ulBytesPerFRS, Data.GetData(), m_ulBytesPerFRS);
+
+        Entry entry;
+        entry.RecordIndex = ullRecordIndex;
+        m_Entries.push_back(entry);
+        return S_OK;
+    }
+
+    bool IsFull() const { return m_Entries.size() >= FRS_PER_BATCH; }
+    bool IsEmpty() const { return m_Entries.empty(); }
+
+    size_t Count() const { return m_Entries.size(); }
+    Entry& operator[](size_t idx) { return m_Entries[idx]; }
+
+    CBinaryBuffer FRS(size_t idx) { return CBinaryBuffer(m_Data.GetData() + idx * m_ulBytesPerFRS, m_ulBytesPerFRS); }
+
+private:
+    ULONG m_ulBytesPerFRS;
+    CBinaryBuffer m_Data;
+    std::vector<Entry> m_Entries;
+};
+
+HRESULT MFTWalker::PrepareBatch(FRSBatch& batch)
+{
+    // HeapStorage is not serialized: cells for the records the workers will parse are allocated on the merging
+    // thread. Only in use (or resurrected) base records not yet known to the walker are eligible, every other FRS
+    // (child records, already fetched records, invalid signatures) is left to the serial path in MergeBatch.
+    const ULONG ulBytesPerFRS = m_pVolReader->GetBytesPerFRS();
+
+    for (size_t i = 0; i < batch.Count(); i++)
+    {
+        auto& entry = batch[i];
+        auto FRS = batch.FRS(i);
+
+        PFILE_RECORD_SEGMENT_HEADER pHeader = (PFILE_RECORD_SEGMENT_HEADER)FRS.GetData();
+
+        if ((pHeader->MultiSectorHeader.Signature[0] != 'F') || (pHeader->MultiSectorHeader.Signature[1] != 'I')
+            || (pHeader->MultiSectorHeader.Signature[2] != 'L') || (pHeader->MultiSectorHeader.Signature[3] != 'E'))
+            continue;
+
+        if (!m_bIncludeNotInUse && !(pHeader->Flags & FILE_RECORD_SEGMENT_IN_USE))
+            continue;
+
+        if (0 != NtfsSegmentNumber(&(pHeader->BaseFileRecordSegment)))
+            continue;
+
+        MFT_SEGMENT_REFERENCE SafeReference;
+
+        if (pHeader->MultiSectorHeader.UpdateSequenceArrayOffset == 0x2A && pHeader->FirstAttributeOffset == 0x30)
+        {
+            ULARGE_INTEGER FRN {0};
+            FRN.QuadPart = entry.RecordIndex;
+            SafeReference.SegmentNumberLowPart = FRN.LowPart;
+            SafeReference.SegmentNumberHighPart = static_cast<USHORT>(FRN.HighPart);
+            SafeReference.SequenceNumber = pHeader->SequenceNumber;
+        }
+        else
+        {
+            SafeReference.SegmentNumberHighPart = pHeader->SegmentNumberHighPart;
+            SafeReference.SegmentNumberLowPart = pHeader->SegmentNumberLowPart;
+            SafeReference.SequenceNumber = pHeader->SequenceNumber;
+        }
+
+        if (m_MFTMap.find(NtfsFullSegmentNumber(&SafeReference)) != end(m_MFTMap))
+            continue;
+
+        LPVOID pBuf = m_SegmentStore.GetNewCell();
+        if (pBuf == nullptr)
+            continue;  // the serial path will deal with the memory pressure
+
+        MFTRecord* pRecord = new (pBuf) MFTRecord;
+        m_PendingCells++;
+
+        if (m_bUseArena)
+            pRecord->SetArena(&m_AttributeArena);
+
+        pRecord->m_pRecord = (PFILE_RECORD_SEGMENT_HEADER)(((BYTE*)pRecord) + sizeof(MFTRecord));
+        memcpy_s((LPBYTE)pRecord->m_pRecord, ulBytesPerFRS, FRS.GetData(), ulBytesPerFRS);
+        pRecord->m_FileReferenceNumber = SafeReference;
+
+        entry.pRecord = pRecord;
+        entry.hr = E_PENDING;
+    }
+    return S_OK;
+}
+
+void MFTWalker::PreParseBatch(FRSBatch& batch, size_t first, size_t last)
+{
+    const ULONG ulBytesPerFRS = m_pVolReader->GetBytesPerFRS();
+
+    for (size_t i = first; i < last; i++)
+    {
+        auto& entry = batch[i];
+
+        if (entry.pRecord == nullptr)
+            continue;
+
+        try
+        {
+            // a base record does not depend on any other record to be parsed
+            // workers share m_pVolRandomReader with the serial path: the read cache is sharded and locked
+            entry.hr =
+                entry.pRecord->ParseRecord(_L_, m_pVolRandomReader, entry.pRecord->m_pRecord, ulBytesPerFRS, nullptr);
+        }
+        catch (...)
+        {
+            entry.hr = E_UNEXPECTED;
+        }
+    }
+}
+
+void MFTWalker::DiscardBatch(FRSBatch& batch)
+{
+    for (size_t i = 0; i < batch.Count(); i++)
+    {
+        auto& entry = batch[i];
+
+        if (entry.pRecord != nullptr)
+        {
+            entry.pRecord->~MFTRecord();
+            m_SegmentStore.FreeCell(entry.pRecord);
+            m_PendingCells--;
+            entry.pRecord = nullptr;
+        }
+    }
+}
+
+HRESULT MFTWalker::MergeBatch(FRSBatch& batch)
+{
+    HRESULT hr = S_OK;
+
+    for (size_t i = 0; i < batch.Count(); i++)
+    {
+        auto& entry = batch[i];
+        auto FRS = batch.FRS(i);
+
+        MFTRecord* pPreParsed = entry.pRecord;
+        entry.pRecord = nullptr;
+
+        if (pPreParsed != nullptr
+            && (entry.hr != S_OK || m_MFTMap.find(pPreParsed->GetSafeMFTSegmentNumber()) != end(m_MFTMap)))
+        {
+            // Either the record was fetched by an earlier record of the walk, or parsing did not go smoothly:
+            // the serial path (and its diagnostics) deals with the raw FRS still held by the batch
+            pPreParsed->~MFTRecord();
+            m_SegmentStore.FreeCell(pPreParsed);
+            m_PendingCells--;
+            pPreParsed = nullptr;
+        }
+
+        if (FAILED(hr = AddRecordCallback(entry.RecordIndex, FRS, pPreParsed)))
+        {
+            if (hr == E_OUTOFMEMORY || hr == HRESULT_FROM_WIN32(ERROR_NO_MORE_FILES))
+            {
+                for (size_t j = i + 1; j < batch.Count(); j++)
+                {
+                    auto& left = batch[j];
+                    if (left.pRecord != nullptr)
+                    {
+                        left.pRecord->~MFTRecord();
+                        m_SegmentStore.FreeCell(left.pRecord);
+                        m_PendingCells--;
+                        left.pRecord = nullptr;
+                    }
+                }
+                return hr;
+            }
+        }
+    }
+    return S_OK;
+}
+
+HRESULT MFTWalker::PipelinedWalk()
+{
+    HRESULT hr = E_FAIL;
+
+    const ULONG ulBytesPerFRS = m_pVolReader->GetBytesPerFRS();
+
+    // at most two batches per worker are waiting to be parsed or merged
+    Concurrency::unbounded_buffer<std::shared_ptr<FRSBatch>> readBatches;
+    Semaphore inFlight(m_dwParseThreads * 2);
+
+    std::atomic<bool> bStop(false);
+    Concurrency::task_group reader;
+    reader.run([this, &readBatches, &inFlight, &bStop, ulBytesPerFRS]() {
+        auto batch = std::make_shared<FRSBatch>(ulBytesPerFRS);
+
+        // as in the serial walker, enumeration errors are not fatal: what was read so far is walked
+        m_pMFT->EnumMFTRecord(
+            [this, &batch, &readBatches, &inFlight, &bStop, ulBytesPerFRS](
+                MFTUtils::SafeMFTSegmentNumber& ullRecordIndex, CBinaryBuffer& Data) -> HRESULT {
+                if (bStop)
+                    return HRESULT_FROM_WIN32(ERROR_NO_MORE_FILES);
+
+                HRESULT hr = E_FAIL;
+                if (FAILED(hr = batch->Append(ullRecordIndex, Data)))
+                    return hr;
+
+                // keep the enumerator's index in sync the same way AddRecord does in the serial walker
+                PFILE_RECORD_SEGMENT_HEADER pHeader = (PFILE_RECORD_SEGMENT_HEADER)Data.GetData();
+                if ((pHeader->MultiSectorHeader.Signature[0] == 'F') && (pHeader->MultiSectorHeader.Signature[1] == 'I')
+                    && (pHeader->MultiSectorHeader.Signature[2] == 'L')
+                    && (pHeader->MultiSectorHeader.Signature[3] == 'E')
+                    && !(pHeader->MultiSectorHeader.UpdateSequenceArrayOffset == 0x2A
+                         && pHeader->FirstAttributeOffset == 0x30)
+                    && ullRecordIndex != pHeader->SegmentNumberLowPart)
+                {
+                    ullRecordIndex = pHeader->SegmentNumberLowPart;
+                }
+
+                if (batch->IsFull())
+                {
+                    inFlight.Acquire();
+                    Concurrency::send(readBatches, batch);
+                    batch = std::make_shared<FRSBatch>(ulBytesPerFRS);
+                }
+                return S_OK;
+            });
+
+        if (!batch->IsEmpty())
+        {
+            inFlight.Acquire();
+            Concurrency::send(readBatches, batch);
+        }
+        // end of enumeration
+        Concurrency::send(readBatches, std::shared_ptr<FRSBatch>());
+    });
+
+    std::shared_ptr<FRSBatch> parsed;
+    bool bReaderDone = false;
+
+    while (!bReaderDone || parsed)
+    {
+        std::shared_ptr<FRSBatch> batch;
+
+        if (!bReaderDone)
+        {
+            batch = Concurrency::receive(readBatches);
+            if (batch == nullptr)
+                bReaderDone = true;
+        }
+
+        Concurrency::task_group workers;
+
+        if (batch != nullptr && !bStop)
+        {
+            PrepareBatch(*batch);
+
+            const size_t chunk = (batch->Count() + m_dwParseThreads - 1) / m_dwParseThreads;
+            for (size_t first = 0; first < batch->Count(); first += chunk)
+            {
+                const size_t last = std::min(first + chunk, batch->Count());
+                workers.run([this, batch, first, last]() { PreParseBatch(*batch, first, last); });
+            }
+        }
+
+        // while the workers parse this batch, the previous one is merged in order
+        if (parsed != nullptr)
+        {
+            if (bStop)
+                DiscardBatch(*parsed);
+            else if (FAILED(hr = MergeBatch(*parsed)))
+            {
+                if (hr == E_OUTOFMEMORY || hr == HRESULT_FROM_WIN32(ERROR_NO_MORE_FILES))
+                    bStop = true;
+            }
+            inFlight.Release();
+        }
+
+        workers.wait();
+
+        if (batch != nullptr && bStop)
+        {
+            DiscardBatch(*batch);
+            inFlight.Release();
+            batch.reset();
+        }
+        parsed = std::move(batch);
+    }
+
+    reader.wait();
+
+    if (hr == HRESULT_FROM_WIN32(ERROR_NO_MORE_FILES))
+        return hr;
+    return S_OK;
+}
+
 HRESULT MFTWalker::Walk(const Callbacks& Callbacks)
 {
     HRESULT hr = E_FAIL;
@@ -1880,7 +2230,13 @@ HRESULT MFTWalker::Walk(const Callbacks& Callbacks)
 
     m_ulMFTRecordCount = GetMFTRecordCount();
 
-    if (m_ulMFTRecordCount > 0)
+    BeginBaselineWalk();
+
+    if (m_ulMFTRecordCount > 0 && m_dwParseThreads > 1)
+    {
+        hr = PipelinedWalk();
+    }
+    else if (m_ulMFTRecordCount > 0)
     {
         hr = m_pMFT->EnumMFTRecord(
             [this](MFTUtils::SafeMFTSegmentNumber& ullRecordIndex, CBinaryBuffer& Data) -> HRESULT {
@@ -1890,10 +2246,16 @@ HRESULT MFTWalker::Walk(const Callbacks& Callbacks)
 
     if (hr == HRESULT_FROM_WIN32(ERROR_NO_MORE_FILES))
     {
+        EndBaselineWalk(false);
         return hr;  // no more enumeration nor walking...
     }
 
-    return WalkRecords(true);
+    const bool bEnumerated = SUCCEEDED(hr);
+
+    hr = WalkRecords(true);
+
+    EndBaselineWalk(bEnumerated && hr == S_OK);
+    return hr;
 }
 
 ULONG MFTWalker::GetMFTRecordCount() const
@@ -1913,6 +2275,21 @@ HRESULT MFTWalker::Statistics(const WCHAR* szMsg)
 
     log::Verbose(_L_, L"\tMap Count: %d\r\n", m_MFTMap.size());
 
+    if (m_BaselineRole == MFTBaseline::Role::Compare)
+        log::Verbose(_L_, L"\tUnchanged records: %d\r\n", m_dwUnchangedRecords);
+
+    if (m_pCachedReader != nullptr)
+    {
+        const auto stats = m_pCachedReader->GetStatistics();
+        log::Verbose(
+            _L_,
+            L"\tRead cache: %I64d hits, %I64d misses, %I64d bypassed reads, %Iu KB cached\r\n",
+            stats.Hits,
+            stats.Misses,
+            stats.Bypassed,
+            stats.BytesCached / 1024);
+    }
+
     DWORD dwDeletedDirCount = 0;
     DWORD dwDeletedNotParsedCount = 0;
     DWORD dwDeletedIncompleteCount = 0;
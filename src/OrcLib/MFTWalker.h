@@ -10,13 +10,16 @@
 #include "NtfsDataStructures.h"
 
 #include "VolumeReader.h"
+#include "CachedVolumeReader.h"
 
 #include "HeapStorage.h"
+#include "ArenaStorage.h"
 
 #include "Location.h"
 
 #include "MFTRecord.h"
 #include "MFTUtils.h"
+#include "MFTBaseline.h"
 #include "IMFT.h"
 
 #include "CaseInsensitive.h"
@@ -26,6 +29,7 @@
 #include <map>
 #include <unordered_map>
 #include <unordered_set>
+#include <string_view>
 #include <boost/logic/tribool.hpp>
 
 #pragma managed(push, off)
@@ -121,6 +125,35 @@ public:
 
     HRESULT Walk(const Callbacks& pCallbacks);
 
+    // Number of threads used to fixup and parse FRS (0 or 1 means the serial walker is used)
+    void SetParseThreads(DWORD dwParseThreads) { m_dwParseThreads = dwParseThreads; }
+    DWORD GetParseThreads() const { return m_dwParseThreads; }
+
+    // Number of FRS per read and number of reads queued ahead while enumerating the MFT (0 means default)
+    void SetReadAhead(DWORD dwFRSPerRead, DWORD dwQueueDepth)
+    {
+        m_dwFRSPerRead = dwFRSPerRead;
+        m_dwReadQueueDepth = dwQueueDepth;
+    }
+
+    // Maximum number of unwanted FRS read to merge two fetched records and number of fetched FRS kept in cache
+    void SetFetchOptions(DWORD dwGapThreshold, DWORD dwCacheSize)
+    {
+        m_dwFetchGapThreshold = dwGapThreshold;
+        m_dwFetchCacheSize = dwCacheSize;
+    }
+
+    // Cache the clusters read to parse the MFT, its indexes and attribute lists within cbBudget bytes (0 disables it)
+    void SetReadCache(size_t cbBudget) { m_cbReadCache = cbBudget; }
+
+    // Allocate the attributes of the records from a per walk arena (default) or one by one from the process heap
+    void SetUseArena(bool bUseArena) { m_bUseArena = bUseArena; }
+
+    // Walks sharing a baseline skip the callbacks of the records identical to the ones of the first walk of the
+    // same volume (the FRS, its extension records and the directories up to the root are unchanged)
+    void SetBaseline(std::shared_ptr<MFTBaseline> pBaseline) { m_pBaseline = std::move(pBaseline); }
+    DWORD GetUnchangedRecordCount() const { return m_dwUnchangedRecords; }
+
     ULONG GetMFTRecordCount() const;
     HRESULT Statistics(const WCHAR* szMsg);
 
@@ -128,37 +161,77 @@ public:
 
 private:
     HeapStorage m_SegmentStore;
+    ArenaStorage m_AttributeArena;
+    bool m_bUseArena = true;
     size_t m_CellStoreLastWalk = 0L;
     size_t m_CellStoreThreshold = 50 * 1024;
 
+    // Cells allocated for records pre-parsed by the pipelined walker and not yet merged into m_MFTMap
+    size_t m_PendingCells = 0L;
+    size_t LiveCells() { return m_SegmentStore.AllocatedCells() - m_PendingCells; }
+
+    DWORD m_dwParseThreads = 0L;
+    DWORD m_dwFRSPerRead = 0L;
+    DWORD m_dwReadQueueDepth = 0L;
+    DWORD m_dwFetchGapThreshold = MFTFetcher::DEFAULT_GAP_THRESHOLD;
+    DWORD m_dwFetchCacheSize = MFTFetcher::DEFAULT_CACHE_SIZE;
+
+    std::shared_ptr<MFTBaseline> m_pBaseline;
+    Location::Type m_LocationType = Location::Type::Undetermined;
+    MFTBaseline::Role m_BaselineRole = MFTBaseline::Role::None;
+    std::shared_ptr<MFTBaseline::Digests> m_pDigests;  // digests of the FRS read by this walk
+    std::shared_ptr<const MFTBaseline::Digests> m_pBaselineDigests;
+    std::unordered_map<MFTUtils::SafeMFTSegmentNumber, bool> m_UnchangedDirectories;
+    DWORD m_dwUnchangedRecords = 0L;
+
     std::unordered_map<MFTUtils::SafeMFTSegmentNumber, MFTRecord*> m_MFTMap;
 
-    class ORCLIB_API MFTFileNameWrapper
+    // Directory tree index: parent reference and name of each directory. Names are stored once in
+    // m_DirectoryNamePool, directories sharing a name share its copy. Once the parent chain of a directory reaches
+    // the root, the path prefix of its entries is kept in m_DirectoryPrefixPool and built from its parent's prefix
+    struct DirectoryEntry
     {
-    public:
-        PFILE_NAME m_pFileName;
-        boost::logic::tribool m_InLocation;
+        MFT_SEGMENT_REFERENCE ParentDirectory;
+        DWORD NameOffset = 0L;
+        DWORD NameLength = 0L;
+        DWORD PrefixOffset = 0L;
+        DWORD PrefixLength = 0L;  // 0 while not resolved, a resolved prefix at least holds "\"
+        boost::logic::tribool InLocation = boost::indeterminate;
+
+        bool IsResolved() const { return PrefixLength > 0; }
+    };
 
-        MFTFileNameWrapper(const MFTFileNameWrapper& pFileName)
-            : m_InLocation(boost::indeterminate)
+    struct PooledName
+    {
+        DWORD Offset;
+        DWORD Length;
+    };
+    struct PooledNameHash
+    {
+        const std::wstring* pPool;
+        size_t operator()(const PooledName& name) const
         {
-            if (pFileName.m_pFileName != nullptr)
-                throw std::exception("Invalid MFTFileNameWrapper construction");
-            m_pFileName = nullptr;
-        };
-        MFTFileNameWrapper(const PFILE_NAME pFileName);
-        MFTFileNameWrapper(MFTFileNameWrapper&& Other) noexcept
+            return std::hash<std::wstring_view>()(std::wstring_view(pPool->data() + name.Offset, name.Length));
+        }
+    };
+    struct PooledNameEqual
+    {
+        const std::wstring* pPool;
+        bool operator()(const PooledName& left, const PooledName& right) const
         {
-            m_pFileName = Other.m_pFileName;
-            Other.m_pFileName = nullptr;
-            m_InLocation = Other.m_InLocation;
+            return left.Length == right.Length
+                && !wmemcmp(pPool->data() + left.Offset, pPool->data() + right.Offset, left.Length);
         }
-        ~MFTFileNameWrapper() { free(m_pFileName); };
-
-        PFILE_NAME FileName() const { return m_pFileName; };
     };
 
-    std::unordered_map<MFTUtils::SafeMFTSegmentNumber, MFTFileNameWrapper> m_DirectoryNames;
+    std::unordered_map<MFTUtils::SafeMFTSegmentNumber, DirectoryEntry> m_DirectoryNames;
+    std::wstring m_DirectoryNamePool;
+    std::unordered_set<PooledName, PooledNameHash, PooledNameEqual> m_DirectoryNameIndex {
+        0,
+        PooledNameHash {&m_DirectoryNamePool},
+        PooledNameEqual {&m_DirectoryNamePool}};
+    std::wstring m_DirectoryPrefixPool;
+    std::vector<DirectoryEntry*> m_DirectoryChain;
     std::unordered_set<std::wstring, CaseInsensitiveUnordered> m_Locations;
 
     bool m_bIncludeNotInUse = false;
@@ -168,7 +241,12 @@ private:
     logger _L_;
 
     std::shared_ptr<VolumeReader> m_pVolReader;
+
+    // reader of records, indexes and attribute lists, also used by the pre-parsing workers:
+    // m_pVolReader or its cache (callbacks get m_pVolReader)
     std::shared_ptr<VolumeReader> m_pVolRandomReader;
+    std::shared_ptr<CachedVolumeReader> m_pCachedReader;
+    size_t m_cbReadCache = 0L;
 
     std::unique_ptr<IMFT> m_pMFT;
 
@@ -178,6 +256,7 @@ private:
     Callbacks m_Callbacks;
 
     HRESULT SetCallbacks(const Callbacks& pCallbacks);
+    HRESULT CallCallbackForRecord(MFTRecord* pRecord, bool& bFreeRecord);
     HRESULT FullCallCallbackForRecord(MFTRecord* pRecord, bool& bFreeRecord);
     HRESULT SimpleCallCallbackForRecord(MFTRecord* pRecord, bool& bFreeRecord);
 
@@ -185,10 +264,7 @@ private:
 
     DWORD m_dwWalkedItems = 0L;
 
-    WCHAR* m_pFullNameBuffer = nullptr;
-    DWORD m_dwFullNameBufferLen = 0LU;
-
-    HRESULT ExtendNameBuffer(WCHAR** pCurrent);
+    std::wstring m_FullName;
 
     HRESULT UpdateAttributeList(MFTRecord* pRecord);
 
@@ -201,10 +277,35 @@ private:
 
     HRESULT DeleteRecord(MFTRecord* pRecord);
 
-    HRESULT AddDirectoryName(MFTRecord* pRecord);
+    void BeginBaselineWalk();
+    void EndBaselineWalk(bool bComplete);
+    void AddDigest(const MFT_SEGMENT_REFERENCE& reference, const CBinaryBuffer& Data);
+    bool IsSegmentUnchanged(MFTUtils::SafeMFTSegmentNumber ullReference) const;
+    bool IsDirectoryUnchanged(MFTUtils::SafeMFTSegmentNumber ullDirectory);
+    bool IsRecordUnchanged(MFTRecord* pRecord);
 
-    HRESULT AddRecord(MFTUtils::SafeMFTSegmentNumber& ullRecordIndex, CBinaryBuffer& Data, MFTRecord*& pRecord);
-    HRESULT AddRecordCallback(MFTUtils::SafeMFTSegmentNumber& ullRecordIndex, CBinaryBuffer& Data);
+    HRESULT AddDirectoryName(MFTRecord* pRecord);
+    void InsertDirectoryName(MFTUtils::SafeMFTSegmentNumber ullDirectory, const PFILE_NAME pFileName);
+    bool AppendDirectoryPrefix(MFTUtils::SafeMFTSegmentNumber ullDirectory, std::wstring& strPath);
+
+    HRESULT AddRecord(
+        MFTUtils::SafeMFTSegmentNumber& ullRecordIndex,
+        CBinaryBuffer& Data,
+        MFTRecord*& pRecord,
+        MFTRecord* pPreParsedRecord = nullptr);
+    HRESULT AddRecordCallback(
+        MFTUtils::SafeMFTSegmentNumber& ullRecordIndex,
+        CBinaryBuffer& Data,
+        MFTRecord* pPreParsedRecord = nullptr);
+
+    // Pipelined walk: one reader, N parsing workers and an ordered merge into the serial callback path
+    class FRSBatch;
+
+    HRESULT PipelinedWalk();
+    HRESULT PrepareBatch(FRSBatch& batch);
+    void PreParseBatch(FRSBatch& batch, size_t first, size_t last);
+    HRESULT MergeBatch(FRSBatch& batch);
+    void DiscardBatch(FRSBatch& batch);
 
     HRESULT ParseI30AndCallback(MFTRecord* pRecord);
 
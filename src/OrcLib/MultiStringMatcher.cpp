@@ -0,0 +1,129 @@
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+//
+// Copyright © 2011-2019 ANSSI. All Rights Reserved.
+//
+// Author(s): Jean Gautier (ANSSI)
+//
+#include "StdAfx.h"
+
+#include "MultiStringMatcher.h"
+
+#include <queue>
+
+using namespace Orc;
+
+namespace {
+
+WCHAR FoldCase(WCHAR wc)
+{
+    if (wc >= L'A' && wc <= L'Z')
+        return wc - L'A' + L'a';
+    return wc;
+}
+
+}  // namespace
+
+HRESULT MultiStringMatcher::AddPattern(const std::wstring& strPattern, DWORD dwPatternId)
+{
+    if (strPattern.empty())
+        return E_INVALIDARG;
+
+    for (auto wc : strPattern)
+    {
+        if (wc == L'\0' || wc >= m_Classes.size())
+            return E_INVALIDARG;
+    }
+
+    m_Patterns.emplace_back(strPattern, dwPatternId);
+    m_Transitions.clear();
+    return S_OK;
+}
+
+HRESULT MultiStringMatcher::Compile()
+{
+    m_Classes.fill(0);
+    m_dwClassCount = 1;
+    m_Transitions.clear();
+    m_Outputs.clear();
+
+    if (m_Patterns.empty())
+        return S_OK;
+
+    for (const auto& pattern : m_Patterns)
+    {
+        for (auto wc : pattern.first)
+        {
+            const WCHAR folded = FoldCase(wc);
+            if (m_Classes[folded] != 0)
+                continue;
+
+            const BYTE cls = static_cast<BYTE>(m_dwClassCount++);
+            m_Classes[folded] = cls;
+            if (folded >= L'a' && folded <= L'z')
+                m_Classes[folded - L'a' + L'A'] = cls;
+        }
+    }
+
+    // Trie of the patterns, a 0 transition means "no child" as nothing goes back to the root in a trie
+    m_Transitions.assign(m_dwClassCount, 0L);
+    m_Outputs.resize(1);
+
+    for (const auto& pattern : m_Patterns)
+    {
+        DWORD dwState = 0L;
+        for (auto wc : pattern.first)
+        {
+            const BYTE cls = m_Classes[wc];
+            DWORD dwNext = m_Transitions[dwState * m_dwClassCount + cls];
+            if (dwNext == 0L)
+            {
+                dwNext = static_cast<DWORD>(m_Outputs.size());
+                m_Transitions[dwState * m_dwClassCount + cls] = dwNext;
+                m_Transitions.resize(m_Transitions.size() + m_dwClassCount, 0L);
+                m_Outputs.emplace_back();
+            }
+            dwState = dwNext;
+        }
+        m_Outputs[dwState].push_back(pattern.second);
+    }
+
+    // Breadth first, each missing transition is replaced by the one of the failure state
+    // and each state inherits the patterns of its failure state
+    std::vector<DWORD> failure(m_Outputs.size(), 0L);
+    std::queue<DWORD> states;
+
+    for (DWORD cls = 1; cls < m_dwClassCount; cls++)
+    {
+        if (auto dwChild = m_Transitions[cls])
+            states.push(dwChild);
+    }
+
+    while (!states.empty())
+    {
+        const DWORD dwState = states.front();
+        states.pop();
+
+        const DWORD dwFailure = failure[dwState];
+
+        for (DWORD cls = 1; cls < m_dwClassCount; cls++)
+        {
+            DWORD& dwChild = m_Transitions[dwState * m_dwClassCount + cls];
+            const DWORD dwFailureChild = m_Transitions[dwFailure * m_dwClassCount + cls];
+
+            if (dwChild == 0L)
+            {
+                dwChild = dwFailureChild;
+                continue;
+            }
+
+            failure[dwChild] = dwFailureChild;
+            const auto& inherited = m_Outputs[dwFailureChild];
+            m_Outputs[dwChild].insert(end(m_Outputs[dwChild]), begin(inherited), end(inherited));
+
+            states.push(dwChild);
+        }
+    }
+
+    return S_OK;
+}
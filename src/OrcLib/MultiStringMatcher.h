@@ -0,0 +1,69 @@
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+//
+// Copyright © 2011-2019 ANSSI. All Rights Reserved.
+//
+// Author(s): Jean Gautier (ANSSI)
+//
+#pragma once
+
+#include "OrcLib.h"
+
+#include <array>
+#include <string>
+#include <vector>
+
+#pragma managed(push, off)
+
+namespace Orc {
+
+// Finds all the patterns occurring in a string in a single pass (Aho-Corasick automaton)
+// Patterns are ASCII literals compared case insensitively, any other character of the searched string only
+// resets the automaton.
+class ORCLIB_API MultiStringMatcher
+{
+public:
+    MultiStringMatcher() = default;
+
+    // Non ASCII or empty patterns are refused (E_INVALIDARG). Compile must be called once patterns are added.
+    HRESULT AddPattern(const std::wstring& strPattern, DWORD dwPatternId);
+
+    HRESULT Compile();
+
+    bool IsEmpty() const { return m_Patterns.empty(); }
+    bool IsCompiled() const { return !m_Transitions.empty(); }
+
+    // Sets found[id] for each pattern occurring in szString, found must be large enough for every pattern id
+    void Search(const WCHAR* szString, size_t cchString, std::vector<BYTE>& found) const
+    {
+        if (m_Transitions.empty())
+            return;
+
+        DWORD dwState = 0L;
+        for (size_t i = 0; i < cchString; i++)
+        {
+            const WCHAR wc = szString[i];
+            const BYTE cls = wc < m_Classes.size() ? m_Classes[wc] : 0;
+
+            dwState = m_Transitions[dwState * m_dwClassCount + cls];
+
+            for (auto dwId : m_Outputs[dwState])
+                found[dwId] = 1;
+        }
+    }
+
+private:
+    std::vector<std::pair<std::wstring, DWORD>> m_Patterns;
+
+    // each ASCII character is mapped to a class (0 for characters absent from every pattern)
+    std::array<BYTE, 128> m_Classes = {0};
+    DWORD m_dwClassCount = 0L;
+
+    // state x class transitions, every state has its complete transition row (failure links are resolved)
+    std::vector<DWORD> m_Transitions;
+    std::vector<std::vector<DWORD>> m_Outputs;
+};
+
+}  // namespace Orc
+
+#pragma managed(pop)
@@ -40,6 +40,7 @@ HRESULT NTFSStream::Close()
 {
     m_pVolReader.reset();
     m_DataSegments.clear();
+    m_SegmentEnds.clear();
     m_CurrentPosition = 0;
     m_DataSize = 0;
     m_CurrentSegmentOffset = 0LL;
@@ -70,6 +71,7 @@ HRESULT NTFSStream::OpenStream(
         if (FAILED(hr = pDataAttr->DataSize(m_pVolReader, m_DataSize)))
             return hr;
     }
+    ComputeSegmentEnds();
     return S_OK;
 }
 
@@ -80,15 +82,53 @@ HRESULT NTFSStream::OpenAllocatedDataStream(
     HRESULT hr = OpenStream(pReader, pDataAttr);
 
     m_bAllocatedData = true;
+    ComputeSegmentEnds();
 
     return hr;
 }
 
+void NTFSStream::ComputeSegmentEnds()
+{
+    m_SegmentEnds.clear();
+    m_SegmentEnds.reserve(m_DataSegments.size());
+
+    ULONGLONG ullEnd = 0LL;
+    for (const auto& segment : m_DataSegments)
+    {
+        ullEnd += SegmentSize(segment);
+        m_SegmentEnds.push_back(ullEnd);
+    }
+}
+
+/*
+    NTFSStream::MoveTo
+
+    Moves the current position to ullPosition, locating its segment with a binary search
+*/
+void NTFSStream::MoveTo(ULONGLONG ullPosition)
+{
+    m_CurrentPosition = ullPosition;
+
+    // first segment ending after the position, empty segments are skipped
+    auto it = std::upper_bound(begin(m_SegmentEnds), end(m_SegmentEnds), ullPosition);
+
+    m_CurrentSegmentIndex = std::distance(begin(m_SegmentEnds), it);
+    if (it == end(m_SegmentEnds))
+    {
+        m_CurrentSegmentOffset = 0LL;
+        return;
+    }
+    m_CurrentSegmentOffset = ullPosition - (m_CurrentSegmentIndex > 0 ? m_SegmentEnds[m_CurrentSegmentIndex - 1] : 0LL);
+}
+
 /*
     NTFSStream::Read
 
     Reads data from the stream
 
+    Sparse and invalid parts are zeroed, the others are gathered in one vectored read: segments adjacent on disk
+    are coalesced into a single piece
+
     Parameters:
         pReadBuffer     -   Pointer to buffer which receives the data
         cbBytes         -   Number of bytes to read from stream
@@ -110,45 +150,112 @@ HRESULT NTFSStream::Read(
     if (m_CurrentSegmentIndex >= m_DataSegments.size())
         return S_OK;
 
-    if (m_CurrentSegmentOffset
-        >= (m_bAllocatedData ? m_DataSegments[m_CurrentSegmentIndex].ullAllocatedSize
-                             : m_DataSegments[m_CurrentSegmentIndex].ullSize))
-    {
-        m_CurrentSegmentIndex++;  // We have reached the end of the segment, moving to the next
-        m_CurrentSegmentOffset = 0LL;
-    }
+    const auto pBuffer = static_cast<BYTE*>(pReadBuffer);
+    ULONGLONG ullGathered = 0LL;
 
-    if (m_CurrentSegmentIndex >= m_DataSegments.size())
-        return S_OK;
+    m_Requests.clear();
 
-    ULONGLONG ullToRead = std::min(
-        cbBytes,
-        (m_bAllocatedData ? m_DataSegments[m_CurrentSegmentIndex].ullAllocatedSize
-                          : m_DataSegments[m_CurrentSegmentIndex].ullSize)
-            - m_CurrentSegmentOffset);
+    auto index = m_CurrentSegmentIndex;
+    auto ullSegmentOffset = m_CurrentSegmentOffset;
 
-    CBinaryBuffer buffer((PBYTE)pReadBuffer, static_cast<size_t>(cbBytes));
-    ULONGLONG ullBytesRead = 0LL;
-
-    if (m_DataSegments[m_CurrentSegmentIndex].bUnallocated || !m_DataSegments[m_CurrentSegmentIndex].bValidData)
+    while (ullGathered < cbBytes && index < m_DataSegments.size())
     {
-        ZeroMemory(buffer.GetData(), static_cast<size_t>(ullToRead));
-        ullBytesRead = ullToRead;
+        const auto& segment = m_DataSegments[index];
+        const ULONGLONG ullSegmentSize = SegmentSize(segment);
+
+        if (ullSegmentOffset >= ullSegmentSize)
+        {
+            index++;  // We have reached the end of the segment, moving to the next
+            ullSegmentOffset = 0LL;
+            continue;
+        }
+
+        const ULONGLONG ullToRead = std::min(cbBytes - ullGathered, ullSegmentSize - ullSegmentOffset);
+
+        if (segment.bUnallocated || !segment.bValidData)
+        {
+            ZeroMemory(pBuffer + ullGathered, static_cast<size_t>(ullToRead));
+        }
+        else
+        {
+            const ULONGLONG ullDiskOffset = segment.ullDiskBasedOffset + ullSegmentOffset;
+
+            if (!m_Requests.empty() && m_Requests.back().Offset + m_Requests.back().Size == ullDiskOffset
+                && m_Requests.back().Data + m_Requests.back().Size == pBuffer + ullGathered)
+            {
+                m_Requests.back().Size += ullToRead;
+            }
+            else
+            {
+                VolumeReader::ReadRequest request;
+                request.Offset = ullDiskOffset;
+                request.Data = pBuffer + ullGathered;
+                request.Size = ullToRead;
+                m_Requests.push_back(request);
+            }
+        }
+
+        ullGathered += ullToRead;
+        ullSegmentOffset += ullToRead;
     }
-    else
+
+    if (!m_Requests.empty())
     {
-        if (FAILED(
-                hr = m_pVolReader->Read(
-                    m_DataSegments[m_CurrentSegmentIndex].ullDiskBasedOffset + m_CurrentSegmentOffset,
-                    buffer,
-                    ullToRead,
-                    ullBytesRead)))
+        if (FAILED(hr = m_pVolReader->ReadAt(m_Requests.data(), m_Requests.size())))
             return hr;
+
+        // a piece read short (end of the volume) ends what was read
+        for (const auto& request : m_Requests)
+        {
+            if (request.Read < request.Size)
+            {
+                ullGathered = std::min<ULONGLONG>(ullGathered, (request.Data - pBuffer) + request.Read);
+                break;
+            }
+        }
     }
-    m_CurrentSegmentOffset += ullBytesRead;
-    m_CurrentPosition += ullBytesRead;
+
+    MoveTo(m_CurrentPosition + ullGathered);
+
     if (pullBytesRead != nullptr)
-        *pullBytesRead = ullBytesRead;
+        *pullBytesRead = ullGathered;
+    return S_OK;
+}
+
+HRESULT NTFSStream::GetDataRanges(std::vector<DataRange>& ranges)
+{
+    ranges.clear();
+
+    // allocated data (raw compression units) is read past the data size
+    if (m_bAllocatedData)
+        return E_NOTIMPL;
+
+    for (size_t i = 0; i < m_DataSegments.size(); i++)
+    {
+        const auto& segment = m_DataSegments[i];
+
+        const ULONGLONG ullStart = i > 0 ? m_SegmentEnds[i - 1] : 0LL;
+        if (ullStart >= m_DataSize)
+            break;
+
+        const ULONGLONG ullEnd = std::min(m_SegmentEnds[i], m_DataSize);
+        const bool bHole = segment.bUnallocated || !segment.bValidData;
+
+        if (ullEnd == ullStart)
+            continue;
+
+        if (!ranges.empty() && ranges.back().bHole == bHole)
+        {
+            ranges.back().Length += ullEnd - ullStart;
+            continue;
+        }
+
+        DataRange range;
+        range.Offset = ullStart;
+        range.Length = ullEnd - ullStart;
+        range.bHole = bHole;
+        ranges.push_back(range);
+    }
     return S_OK;
 }
 
@@ -193,41 +300,6 @@ NTFSStream::SetFilePointer(__in LONGLONG DistanceToMove, __in DWORD dwMoveMethod
 
             if (ullNewFilePointer > m_DataSize)
                 return E_INVALIDARG;
-
-            if (m_CurrentSegmentIndex >= m_DataSegments.size())
-            {
-                m_CurrentSegmentIndex--;
-            }
-
-            if (DistanceToMove > 0)
-            {
-                for (size_t i = m_CurrentSegmentIndex; i < m_DataSegments.size(); i++)
-                {
-                    if (ullNewFilePointer >= m_DataSegments[i].ullFileBasedOffset
-                        && ullNewFilePointer < (m_DataSegments[i].ullFileBasedOffset + m_DataSegments[i].ullSize))
-                    {
-                        m_CurrentSegmentIndex = i;
-                        m_CurrentPosition = ullNewFilePointer;
-                        m_CurrentSegmentOffset = ullNewFilePointer - m_DataSegments[i].ullFileBasedOffset;
-                        break;
-                    }
-                }
-            }
-            else if (DistanceToMove < 0)
-            {
-                for (int32_t i = static_cast<int32_t>(m_CurrentSegmentIndex); i > 0; i--)
-                {
-                    if (ullNewFilePointer >= m_DataSegments[i].ullFileBasedOffset
-                        && ullNewFilePointer < (m_DataSegments[i].ullFileBasedOffset + m_DataSegments[i].ullSize))
-                    {
-                        m_CurrentSegmentIndex = i;
-                        m_CurrentPosition = ullNewFilePointer;
-                        m_CurrentSegmentOffset = ullNewFilePointer - m_DataSegments[i].ullFileBasedOffset;
-                        break;
-                    }
-                }
-            }
-
             break;
         case FILE_END:
             if (DistanceToMove > 0)
@@ -235,58 +307,13 @@ NTFSStream::SetFilePointer(__in LONGLONG DistanceToMove, __in DWORD dwMoveMethod
                 log::Error(_L_, E_INVALIDARG, L"Cannot move past the end of the file (%I64d)\r\n", DistanceToMove);
                 return E_INVALIDARG;
             }
+            if (static_cast<ULONGLONG>(-DistanceToMove) > m_DataSize)
+                return E_INVALIDARG;
 
             ullNewFilePointer = m_DataSize + DistanceToMove;
-            {
-                ULONGLONG ullCurrentPosition = m_DataSize;
-                m_CurrentSegmentIndex = m_DataSegments.size() - 1;
-                for (auto iter = m_DataSegments.crbegin(); iter != m_DataSegments.crend(); ++iter)
-                {
-                    if (ullNewFilePointer <= ullCurrentPosition
-                        && ullNewFilePointer >= ullCurrentPosition - iter->ullSize)
-                    {
-                        // This is the one segment
-                        m_CurrentSegmentOffset = ullCurrentPosition - ullNewFilePointer;
-                        break;
-                    }
-                    ullCurrentPosition -= m_DataSegments[m_CurrentSegmentIndex].ullSize;
-                    m_CurrentSegmentIndex--;
-                }
-            }
             break;
         case FILE_BEGIN:
             ullNewFilePointer = DistanceToMove;
-            m_CurrentSegmentOffset = 0LL;
-            m_CurrentSegmentIndex = 0LL;
-
-            if (ullNewFilePointer > 0LL && ullNewFilePointer <= m_DataSize)
-            {
-                ULONGLONG ullCurrentPosition = 0LL;
-                for (auto iter = begin(m_DataSegments); iter != end(m_DataSegments); ++iter)
-                {
-                    if (ullNewFilePointer >= ullCurrentPosition
-                        && ullNewFilePointer <= ullCurrentPosition + iter->ullSize)
-                    {
-                        // This is the one segment
-                        m_CurrentSegmentOffset = ullNewFilePointer - ullCurrentPosition;
-                        break;
-                    }
-                    ullCurrentPosition += m_DataSegments[m_CurrentSegmentIndex].ullSize;
-                    m_CurrentSegmentIndex++;
-                }
-            }
-            else if (ullNewFilePointer > m_DataSize && !m_DataSegments.empty())
-            {
-                m_CurrentPosition = m_DataSize;
-                m_CurrentSegmentIndex = m_DataSegments.size() - 1;
-            }
-            else
-            {
-                m_CurrentPosition = 0LL;
-                if (pCurrPointer)
-                    *pCurrPointer = m_CurrentPosition;
-                return S_OK;
-            }
             break;
         default:
             return E_INVALIDARG;
@@ -295,7 +322,7 @@ NTFSStream::SetFilePointer(__in LONGLONG DistanceToMove, __in DWORD dwMoveMethod
     //
     // Clip the pointer to [0, datasize]
     //
-    m_CurrentPosition = std::min(m_DataSize, ullNewFilePointer);
+    MoveTo(std::min(m_DataSize, ullNewFilePointer));
     if (pCurrPointer)
         *pCurrPointer = m_CurrentPosition;
     return S_OK;
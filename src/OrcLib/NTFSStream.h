@@ -53,6 +53,7 @@ public:
 
     const std::vector<MFTUtils::DataSegment> DataSegments() const { return m_DataSegments; }
 
+    // Fills pBuffer across as many data segments as needed, physically adjacent segments being read at once
     STDMETHOD(Read)
     (__out_bcount_part(cbBytesToRead, *pcbBytesRead) PVOID pBuffer,
      __in ULONGLONG cbBytesToRead,
@@ -64,6 +65,9 @@ public:
     STDMETHOD(SetFilePointer)
     (__in LONGLONG DistanceToMove, __in DWORD dwMoveMethod, __out_opt PULONG64 pCurrPointer);
 
+    // Sparse runs and runs past the valid data length are holes
+    STDMETHOD(GetDataRanges)(std::vector<DataRange>& ranges);
+
     STDMETHOD_(ULONG64, GetSize)() { return m_DataSize; }
     STDMETHOD(SetSize)(ULONG64) { return E_NOTIMPL; }
     STDMETHOD(Close)();
@@ -71,6 +75,7 @@ public:
 private:
     std::shared_ptr<VolumeReader> m_pVolReader;
     std::vector<MFTUtils::DataSegment> m_DataSegments;
+    std::vector<ULONGLONG> m_SegmentEnds;  // Stream offset of the end of each segment, to seek by binary search
 
     ULONGLONG m_DataSize;  // Size of all data in stream
     ULONGLONG m_CurrentPosition;  // Current position in stream;
@@ -79,6 +84,16 @@ private:
     std::vector<MFTUtils::DataSegment>::size_type m_CurrentSegmentIndex;  // Current segment index
 
     bool m_bAllocatedData;
+
+    std::vector<VolumeReader::ReadRequest> m_Requests;
+
+    ULONGLONG SegmentSize(const MFTUtils::DataSegment& segment) const
+    {
+        return m_bAllocatedData ? segment.ullAllocatedSize : segment.ullSize;
+    }
+
+    void ComputeSegmentEnds();
+    void MoveTo(ULONGLONG ullPosition);
 };
 
 }  // namespace Orc
@@ -0,0 +1,498 @@
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+//
+// Copyright © 2011-2019 ANSSI. All Rights Reserved.
+//
+// Author(s): Jean Gautier (ANSSI)
+//
+#include "stdafx.h"
+
+#include "NativeHash.h"
+
+#include <array>
+
+#if defined(_M_IX86) || defined(_M_X64)
+#    include <immintrin.h>
+#endif
+
+using namespace Orc;
+
+namespace {
+
+constexpr size_t BLOCK_SIZE = 64;
+
+using Compress = void (*)(uint32_t* pState, const BYTE* pBlocks, size_t nBlocks);
+
+inline uint32_t RotateLeft(uint32_t x, int n)
+{
+    return (x << n) | (x >> (32 - n));
+}
+
+inline uint32_t RotateRight(uint32_t x, int n)
+{
+    return (x >> n) | (x << (32 - n));
+}
+
+inline uint32_t LoadBigEndian(const BYTE* p)
+{
+    return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | uint32_t(p[3]);
+}
+
+inline uint32_t LoadLittleEndian(const BYTE* p)
+{
+    return uint32_t(p[0]) | (uint32_t(p[1]) << 8) | (uint32_t(p[2]) << 16) | (uint32_t(p[3]) << 24);
+}
+
+//
+// MD5 (RFC 1321)
+//
+
+const uint32_t MD5_INIT[4] = {0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476};
+
+const uint32_t MD5_K[64] = {
+    0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee, 0xf57c0faf, 0x4787c62a, 0xa8304613, 0xfd469501,
+    0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be, 0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821,
+    0xf61e2562, 0xc040b340, 0x265e5a51, 0xe9b6c7aa, 0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
+    0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed, 0xa9e3e905, 0xfcefa3f8, 0x676f02d9, 0x8d2a4c8a,
+    0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c, 0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70,
+    0x289b7ec6, 0xeaa127fa, 0xd4ef3085, 0x04881d05, 0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
+    0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039, 0x655b59c3, 0x8f0ccc92, 0xffeff47d, 0x85845dd1,
+    0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1, 0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391};
+
+const int MD5_SHIFTS[4][4] = {{7, 12, 17, 22}, {5, 9, 14, 20}, {4, 11, 16, 23}, {6, 10, 15, 21}};
+
+void CompressMD5Scalar(uint32_t* pState, const BYTE* pBlocks, size_t nBlocks)
+{
+    for (; nBlocks > 0; nBlocks--, pBlocks += BLOCK_SIZE)
+    {
+        uint32_t m[16];
+        for (int i = 0; i < 16; i++)
+            m[i] = LoadLittleEndian(pBlocks + i * 4);
+
+        uint32_t a = pState[0], b = pState[1], c = pState[2], d = pState[3];
+
+        // one loop per round function, for the compiler to unroll
+        auto Step = [&a, &b, &c, &d, &m](uint32_t f, int i, int g) {
+            const uint32_t rotated = RotateLeft(a + f + MD5_K[i] + m[g], MD5_SHIFTS[i / 16][i % 4]);
+            a = d;
+            d = c;
+            c = b;
+            b += rotated;
+        };
+
+        for (int i = 0; i < 16; i++)
+            Step((b & c) | (~b & d), i, i);
+        for (int i = 16; i < 32; i++)
+            Step((d & b) | (~d & c), i, (5 * i + 1) % 16);
+        for (int i = 32; i < 48; i++)
+            Step(b ^ c ^ d, i, (3 * i + 5) % 16);
+        for (int i = 48; i < 64; i++)
+            Step(c ^ (b | ~d), i, (7 * i) % 16);
+
+        pState[0] += a;
+        pState[1] += b;
+        pState[2] += c;
+        pState[3] += d;
+    }
+}
+
+//
+// SHA1 (FIPS 180-4)
+//
+
+const uint32_t SHA1_INIT[5] = {0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0};
+
+void CompressSHA1Scalar(uint32_t* pState, const BYTE* pBlocks, size_t nBlocks)
+{
+    for (; nBlocks > 0; nBlocks--, pBlocks += BLOCK_SIZE)
+    {
+        uint32_t w[80];
+        for (int i = 0; i < 16; i++)
+            w[i] = LoadBigEndian(pBlocks + i * 4);
+        for (int i = 16; i < 80; i++)
+            w[i] = RotateLeft(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+
+        uint32_t a = pState[0], b = pState[1], c = pState[2], d = pState[3], e = pState[4];
+
+        auto Step = [&a, &b, &c, &d, &e](uint32_t f, uint32_t k, uint32_t w) {
+            const uint32_t temp = RotateLeft(a, 5) + f + e + k + w;
+            e = d;
+            d = c;
+            c = RotateLeft(b, 30);
+            b = a;
+            a = temp;
+        };
+
+        for (int i = 0; i < 20; i++)
+            Step((b & c) | (~b & d), 0x5a827999, w[i]);
+        for (int i = 20; i < 40; i++)
+            Step(b ^ c ^ d, 0x6ed9eba1, w[i]);
+        for (int i = 40; i < 60; i++)
+            Step((b & c) | (b & d) | (c & d), 0x8f1bbcdc, w[i]);
+        for (int i = 60; i < 80; i++)
+            Step(b ^ c ^ d, 0xca62c1d6, w[i]);
+
+        pState[0] += a;
+        pState[1] += b;
+        pState[2] += c;
+        pState[3] += d;
+        pState[4] += e;
+    }
+}
+
+//
+// SHA256 (FIPS 180-4)
+//
+
+const uint32_t SHA256_INIT[8] =
+    {0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+
+alignas(16) const uint32_t SHA256_K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+
+void CompressSHA256Scalar(uint32_t* pState, const BYTE* pBlocks, size_t nBlocks)
+{
+    for (; nBlocks > 0; nBlocks--, pBlocks += BLOCK_SIZE)
+    {
+        uint32_t w[64];
+        for (int i = 0; i < 16; i++)
+            w[i] = LoadBigEndian(pBlocks + i * 4);
+        for (int i = 16; i < 64; i++)
+        {
+            const uint32_t s0 = RotateRight(w[i - 15], 7) ^ RotateRight(w[i - 15], 18) ^ (w[i - 15] >> 3);
+            const uint32_t s1 = RotateRight(w[i - 2], 17) ^ RotateRight(w[i - 2], 19) ^ (w[i - 2] >> 10);
+            w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+        }
+
+        uint32_t a = pState[0], b = pState[1], c = pState[2], d = pState[3];
+        uint32_t e = pState[4], f = pState[5], g = pState[6], h = pState[7];
+
+        for (int i = 0; i < 64; i++)
+        {
+            const uint32_t S1 = RotateRight(e, 6) ^ RotateRight(e, 11) ^ RotateRight(e, 25);
+            const uint32_t ch = (e & f) ^ (~e & g);
+            const uint32_t temp1 = h + S1 + ch + SHA256_K[i] + w[i];
+            const uint32_t S0 = RotateRight(a, 2) ^ RotateRight(a, 13) ^ RotateRight(a, 22);
+            const uint32_t maj = (a & b) ^ (a & c) ^ (b & c);
+            const uint32_t temp2 = S0 + maj;
+
+            h = g;
+            g = f;
+            f = e;
+            e = d + temp1;
+            d = c;
+            c = b;
+            b = a;
+            a = temp1 + temp2;
+        }
+
+        pState[0] += a;
+        pState[1] += b;
+        pState[2] += c;
+        pState[3] += d;
+        pState[4] += e;
+        pState[5] += f;
+        pState[6] += g;
+        pState[7] += h;
+    }
+}
+
+#if defined(_M_IX86) || defined(_M_X64)
+
+bool IsSHANISupported()
+{
+    static const bool bSupported = []() {
+        int info[4] = {0};
+
+        __cpuid(info, 0);
+        if (info[0] < 7)
+            return false;
+
+        // SSSE3 and SSE4.1 shuffle and blend the state, then the SHA extensions
+        __cpuid(info, 1);
+        if ((info[2] & (1 << 9)) == 0 || (info[2] & (1 << 19)) == 0)
+            return false;
+
+        __cpuidex(info, 7, 0);
+        return (info[1] & (1 << 29)) != 0;
+    }();
+    return bSupported;
+}
+
+// Steps of 4 rounds, unrolled through the template so that the message words stay in registers and the round
+// function of sha1rnds4 is an immediate. The schedule of the words of step i + 1 is completed by step i.
+template <int i>
+inline void SHA1Step(__m128i& abcd, __m128i& e0, __m128i& e1, __m128i (&msg)[4])
+{
+    __m128i& eIn = (i % 2) == 0 ? e0 : e1;
+    __m128i& eOut = (i % 2) == 0 ? e1 : e0;
+    const __m128i& current = msg[i % 4];
+
+    if constexpr (i == 0)
+        eIn = _mm_add_epi32(eIn, current);
+    else
+        eIn = _mm_sha1nexte_epu32(eIn, current);
+
+    eOut = abcd;
+
+    if constexpr (i >= 3 && i <= 18)
+        msg[(i + 1) % 4] = _mm_sha1msg2_epu32(msg[(i + 1) % 4], current);
+
+    abcd = _mm_sha1rnds4_epu32(abcd, eIn, i / 5);
+
+    if constexpr (i >= 1 && i <= 16)
+        msg[(i + 3) % 4] = _mm_sha1msg1_epu32(msg[(i + 3) % 4], current);
+    if constexpr (i >= 2 && i <= 17)
+        msg[(i + 2) % 4] = _mm_xor_si128(msg[(i + 2) % 4], current);
+
+    if constexpr (i < 19)
+        SHA1Step<i + 1>(abcd, e0, e1, msg);
+}
+
+void CompressSHA1SHANI(uint32_t* pState, const BYTE* pBlocks, size_t nBlocks)
+{
+    const __m128i mask = _mm_set_epi64x(0x0001020304050607LL, 0x08090a0b0c0d0e0fLL);
+
+    __m128i abcd = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(pState)), 0x1B);
+    __m128i e0 = _mm_set_epi32(pState[4], 0, 0, 0);
+
+    for (; nBlocks > 0; nBlocks--, pBlocks += BLOCK_SIZE)
+    {
+        const __m128i abcdSave = abcd;
+        const __m128i eSave = e0;
+
+        __m128i msg[4];
+        for (int i = 0; i < 4; i++)
+            msg[i] = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(pBlocks + i * 16)), mask);
+
+        __m128i e1 = _mm_setzero_si128();
+        SHA1Step<0>(abcd, e0, e1, msg);
+
+        e0 = _mm_sha1nexte_epu32(e0, eSave);
+        abcd = _mm_add_epi32(abcd, abcdSave);
+    }
+
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(pState), _mm_shuffle_epi32(abcd, 0x1B));
+    pState[4] = _mm_extract_epi32(e0, 3);
+}
+
+template <int i>
+inline void SHA256Step(__m128i& state0, __m128i& state1, __m128i (&msg)[4])
+{
+    const __m128i& current = msg[i % 4];
+
+    __m128i words = _mm_add_epi32(current, _mm_load_si128(reinterpret_cast<const __m128i*>(SHA256_K + i * 4)));
+    state1 = _mm_sha256rnds2_epu32(state1, state0, words);
+
+    if constexpr (i >= 3 && i <= 14)
+    {
+        __m128i& next = msg[(i + 1) % 4];
+        next = _mm_add_epi32(next, _mm_alignr_epi8(current, msg[(i + 3) % 4], 4));
+        next = _mm_sha256msg2_epu32(next, current);
+    }
+
+    words = _mm_shuffle_epi32(words, 0x0E);
+    state0 = _mm_sha256rnds2_epu32(state0, state1, words);
+
+    if constexpr (i >= 1 && i <= 12)
+        msg[(i + 3) % 4] = _mm_sha256msg1_epu32(msg[(i + 3) % 4], current);
+
+    if constexpr (i < 15)
+        SHA256Step<i + 1>(state0, state1, msg);
+}
+
+void CompressSHA256SHANI(uint32_t* pState, const BYTE* pBlocks, size_t nBlocks)
+{
+    const __m128i mask = _mm_set_epi64x(0x0c0d0e0f08090a0bLL, 0x0405060700010203LL);
+
+    // the state is kept as ABEF and CDGH
+    __m128i tmp = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(pState)), 0xB1);
+    __m128i state1 = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(pState + 4)), 0x1B);
+    __m128i state0 = _mm_alignr_epi8(tmp, state1, 8);
+    state1 = _mm_blend_epi16(state1, tmp, 0xF0);
+
+    for (; nBlocks > 0; nBlocks--, pBlocks += BLOCK_SIZE)
+    {
+        const __m128i abefSave = state0;
+        const __m128i cdghSave = state1;
+
+        __m128i msg[4];
+        for (int i = 0; i < 4; i++)
+            msg[i] = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(pBlocks + i * 16)), mask);
+
+        SHA256Step<0>(state0, state1, msg);
+
+        state0 = _mm_add_epi32(state0, abefSave);
+        state1 = _mm_add_epi32(state1, cdghSave);
+    }
+
+    tmp = _mm_shuffle_epi32(state0, 0x1B);
+    state1 = _mm_shuffle_epi32(state1, 0xB1);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(pState), _mm_blend_epi16(tmp, state1, 0xF0));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(pState + 4), _mm_alignr_epi8(state1, tmp, 8));
+}
+
+#endif
+
+// Merkle–Damgård construction over 64 bytes blocks, the three algorithms differ by their state, their compression
+// function and the byte order of their length and digest
+template <size_t StateWords, bool bBigEndian>
+class BlockHash : public NativeHash
+{
+public:
+    BlockHash(const uint32_t (&init)[StateWords], Compress compress)
+        : m_Compress(compress)
+    {
+        std::copy(std::begin(init), std::end(init), std::begin(m_State));
+    }
+
+    void Update(const BYTE* pData, size_t cbData) override
+    {
+        m_ullLength += cbData;
+
+        if (m_cbBlock > 0)
+        {
+            const size_t cbCopy = std::min(BLOCK_SIZE - m_cbBlock, cbData);
+            std::copy(pData, pData + cbCopy, m_Block.data() + m_cbBlock);
+            m_cbBlock += cbCopy;
+            pData += cbCopy;
+            cbData -= cbCopy;
+
+            if (m_cbBlock < BLOCK_SIZE)
+                return;
+
+            m_Compress(m_State.data(), m_Block.data(), 1);
+            m_cbBlock = 0;
+        }
+
+        if (cbData >= BLOCK_SIZE)
+        {
+            m_Compress(m_State.data(), pData, cbData / BLOCK_SIZE);
+            pData += cbData - (cbData % BLOCK_SIZE);
+            cbData %= BLOCK_SIZE;
+        }
+
+        std::copy(pData, pData + cbData, m_Block.data());
+        m_cbBlock = cbData;
+    }
+
+    void GetDigest(BYTE* pDigest) const override
+    {
+        auto state = m_State;
+
+        // 0x80, zeroes, then the length in bits in the last 8 bytes of the last block
+        std::array<BYTE, 2 * BLOCK_SIZE> padding = {0};
+        std::copy(m_Block.data(), m_Block.data() + m_cbBlock, padding.data());
+        padding[m_cbBlock] = 0x80;
+
+        const size_t cbPadded = m_cbBlock + 1 + 8 <= BLOCK_SIZE ? BLOCK_SIZE : 2 * BLOCK_SIZE;
+        const ULONGLONG ullBits = m_ullLength * 8;
+        for (size_t i = 0; i < 8; i++)
+        {
+            const BYTE b = static_cast<BYTE>(ullBits >> (i * 8));
+            if (bBigEndian)
+                padding[cbPadded - 1 - i] = b;
+            else
+                padding[cbPadded - 8 + i] = b;
+        }
+
+        m_Compress(state.data(), padding.data(), cbPadded / BLOCK_SIZE);
+
+        for (size_t i = 0; i < StateWords; i++)
+        {
+            for (size_t j = 0; j < 4; j++)
+            {
+                pDigest[i * 4 + j] =
+                    static_cast<BYTE>(bBigEndian ? state[i] >> (24 - j * 8) : state[i] >> (j * 8));
+            }
+        }
+    }
+
+    DWORD GetDigestSize() const override { return StateWords * sizeof(uint32_t); }
+
+private:
+    Compress m_Compress;
+    std::array<uint32_t, StateWords> m_State;
+    std::array<BYTE, BLOCK_SIZE> m_Block;
+    size_t m_cbBlock = 0L;
+    ULONGLONG m_ullLength = 0LL;
+};
+
+// nullptr when the kernel is not supported, MD5 has no SHANI kernel and is scalar for all kernels
+Compress GetCompress(Compress scalar, Compress shani, NativeHash::Kernel kernel)
+{
+    switch (kernel)
+    {
+        case NativeHash::Kernel::Scalar:
+            return scalar;
+        case NativeHash::Kernel::SHANI:
+            if (shani == nullptr)
+                return scalar;
+            return NativeHash::IsKernelSupported(kernel) ? shani : nullptr;
+        case NativeHash::Kernel::Auto:
+            if (shani != nullptr && NativeHash::IsKernelSupported(NativeHash::Kernel::SHANI))
+                return shani;
+            return scalar;
+        default:
+            return nullptr;
+    }
+}
+
+#if defined(_M_IX86) || defined(_M_X64)
+const Compress g_SHA1SHANI = CompressSHA1SHANI;
+const Compress g_SHA256SHANI = CompressSHA256SHANI;
+#else
+const Compress g_SHA1SHANI = nullptr;
+const Compress g_SHA256SHANI = nullptr;
+#endif
+
+}  // namespace
+
+bool NativeHash::IsKernelSupported(Kernel kernel)
+{
+    switch (kernel)
+    {
+        case Kernel::Auto:
+        case Kernel::Scalar:
+            return true;
+        case Kernel::SHANI:
+#if defined(_M_IX86) || defined(_M_X64)
+            return IsSHANISupported();
+#else
+            return false;
+#endif
+        default:
+            return false;
+    }
+}
+
+std::unique_ptr<NativeHash> NativeHash::MakeMD5(Kernel kernel)
+{
+    auto compress = GetCompress(CompressMD5Scalar, nullptr, kernel);
+    if (compress == nullptr)
+        return nullptr;
+    return std::make_unique<BlockHash<4, false>>(MD5_INIT, compress);
+}
+
+std::unique_ptr<NativeHash> NativeHash::MakeSHA1(Kernel kernel)
+{
+    auto compress = GetCompress(CompressSHA1Scalar, g_SHA1SHANI, kernel);
+    if (compress == nullptr)
+        return nullptr;
+    return std::make_unique<BlockHash<5, true>>(SHA1_INIT, compress);
+}
+
+std::unique_ptr<NativeHash> NativeHash::MakeSHA256(Kernel kernel)
+{
+    auto compress = GetCompress(CompressSHA256Scalar, g_SHA256SHANI, kernel);
+    if (compress == nullptr)
+        return nullptr;
+    return std::make_unique<BlockHash<8, true>>(SHA256_INIT, compress);
+}
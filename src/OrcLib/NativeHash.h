@@ -0,0 +1,49 @@
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+//
+// Copyright © 2011-2019 ANSSI. All Rights Reserved.
+//
+// Author(s): Jean Gautier (ANSSI)
+//
+#pragma once
+
+#include "OrcLib.h"
+
+#include <memory>
+
+#pragma managed(push, off)
+
+namespace Orc {
+
+// In-tree MD5, SHA1 and SHA256 (CryptoHashStream's native backend)
+// SHA1 and SHA256 blocks are compressed with the SHA extensions when the processor has them. MD5 has no such
+// instructions and its rounds are serially dependent, it is always scalar.
+class ORCLIB_API NativeHash
+{
+public:
+    enum class Kernel
+    {
+        Auto,  // the fastest kernel supported
+        Scalar,
+        SHANI
+    };
+
+    static bool IsKernelSupported(Kernel kernel);
+
+    // nullptr when the kernel is not supported
+    static std::unique_ptr<NativeHash> MakeMD5(Kernel kernel = Kernel::Auto);
+    static std::unique_ptr<NativeHash> MakeSHA1(Kernel kernel = Kernel::Auto);
+    static std::unique_ptr<NativeHash> MakeSHA256(Kernel kernel = Kernel::Auto);
+
+    virtual void Update(const BYTE* pData, size_t cbData) = 0;
+
+    // Digest of the data hashed so far, more data can be hashed afterwards
+    virtual void GetDigest(BYTE* pDigest) const = 0;
+    virtual DWORD GetDigestSize() const = 0;
+
+    virtual ~NativeHash() {}
+};
+
+}  // namespace Orc
+
+#pragma managed(pop)
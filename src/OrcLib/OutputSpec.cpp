@@ -354,6 +354,38 @@ HRESULT OutputSpec::Configure(
     {
         Password = item.SubItems[CONFIG_OUTPUT_PASSWORD];
     }
+
+    BatchSize = 0L;
+    if (HasValue(item, CONFIG_OUTPUT_BATCHSIZE))
+    {
+        if (FAILED(hr = GetIntegerFromArg(item.SubItems[CONFIG_OUTPUT_BATCHSIZE].c_str(), BatchSize))
+            || BatchSize == 0L)
+        {
+            log::Error(
+                pLog,
+                E_INVALIDARG,
+                L"Invalid batch size for output in config file: %s\r\n",
+                item.SubItems[CONFIG_OUTPUT_BATCHSIZE].c_str());
+            return E_INVALIDARG;
+        }
+    }
+
+    RowGroupSize = 0LL;
+    if (HasValue(item, CONFIG_OUTPUT_ROWGROUPSIZE))
+    {
+        LARGE_INTEGER size;
+        if (FAILED(hr = GetFileSizeFromArg(item.SubItems[CONFIG_OUTPUT_ROWGROUPSIZE].c_str(), size))
+            || size.QuadPart <= 0LL)
+        {
+            log::Error(
+                pLog,
+                E_INVALIDARG,
+                L"Invalid row group size for output in config file: %s\r\n",
+                item.SubItems[CONFIG_OUTPUT_ROWGROUPSIZE].c_str());
+            return E_INVALIDARG;
+        }
+        RowGroupSize = size.QuadPart;
+    }
     return S_OK;
 }
 
@@ -155,6 +155,8 @@ public:
     LPCWSTR szSeparator = L",";
     LPCWSTR szQuote = L"\"";
     DWORD XOR = 0L;
+    DWORD BatchSize = 0L;  // rows per batch of columnar table files (Parquet, ORC), 0 for the writer's default
+    ULONGLONG RowGroupSize = 0LL;  // bytes per row group (Parquet) or stripe (ORC), 0 for the writer's default
 
     OutputSpec() noexcept = default;
     OutputSpec(OutputSpec&&) noexcept = default;
@@ -2268,7 +2268,7 @@ HRESULT RegFind::Find(
     if (location != nullptr)
     {
         RegistryHive Hive(_L_);
-        hr = Hive.LoadHive(*location);
+        hr = Hive.LoadHive(location);
         if (hr != S_OK)
         {
             log::Error(_L_, hr, L"RegFind::Find : can't load hive.\r\n");
@@ -8,9 +8,17 @@
 #include "stdafx.h"
 #include "LogFileWriter.h"
 #include "RegistryWalker.h"
+#include "FileStream.h"
 
 using namespace Orc;
 
+namespace {
+
+// hbins are multiples of 4kb, hives that are not mapped are read by pages of this size
+constexpr ULONG64 HIVE_PAGE_SIZE = 0x1000;
+
+}  // namespace
+
 RegistryValue::RegistryValue(
     std::string&& ValueName,
     const RegistryKey* const ParentKey,
@@ -229,72 +237,247 @@ bool RegistryHive::IsHiveComplete() const
     return m_bIsComplete;
 }
 
-HRESULT RegistryHive::LoadHive(ByteStream& HiveStream)
+HRESULT RegistryHive::LoadHive(const std::shared_ptr<ByteStream>& pHiveStream)
 {
 
     HRESULT hr = E_FAIL;
 
-    if ((hr = HiveStream.IsOpen()) != S_OK)
+    if (pHiveStream == nullptr)
+    {
+        log::Error(_L_, hr = E_POINTER, L"[-] No hive stream to load.\r\n");
+        return hr;
+    }
+    if ((hr = pHiveStream->IsOpen()) != S_OK)
     {
         log::Error(_L_, hr, L"[-] Hive stream seems to be closed.\r\n");
         return hr;
     }
-    if ((hr = HiveStream.CanRead()) != S_OK)
+    if ((hr = pHiveStream->CanRead()) != S_OK)
     {
         log::Error(_L_, hr, L"[-] Can't read hive stream.\r\n");
         return hr;
     }
 
+    // only the hbins the walk touches are read: hive files are mapped, other streams (NTFS, archives...) are read
+    // page by page as cells are reached, streams that cannot seek are read at once
+    auto pFileStream = std::dynamic_pointer_cast<FileStream>(pHiveStream);
+    if (pFileStream == nullptr || FAILED(hr = MapHive(*pFileStream)))
+    {
+        if (pFileStream != nullptr)
+            log::Verbose(_L_, L"[*] Failed to map hive file, reading it (hr=0x%lx)\r\n", hr);
+
+        if (pHiveStream->CanSeek() == S_OK)
+            hr = PageHive(pHiveStream);
+        else
+            hr = ReadHive(*pHiveStream);
+
+        if (FAILED(hr))
+            return hr;
+    }
+
+    if ((hr = ParseHiveHeader()) != S_OK)
+    {
+        ReleaseHive();
+        log::Error(_L_, hr, L"[-] Error during hive header parsing.\r\n");
+        return hr;
+    }
+
+    if ((hr = ParseHBinHeader()) != S_OK)
+    {
+        ReleaseHive();
+        log::Error(_L_, hr, L"[-] Error during hive hbin header parsing.\r\n");
+        return hr;
+    }
+    return S_OK;
+}
+
+HRESULT RegistryHive::MapHive(FileStream& HiveStream)
+{
+    HANDLE hFile = HiveStream.GetHandle();
+    if (hFile == INVALID_HANDLE_VALUE)
+        return E_HANDLE;
+
     ULONG64 ulSize = HiveStream.GetSize();
+    if (ulSize == 0 || ulSize > MAXSIZE_T)
+        return E_INVALIDARG;
+
+    // pages of a remote file that fail to load would raise in page errors in the middle of the walk
+    FILE_REMOTE_PROTOCOL_INFO remoteInfo;
+    if (GetFileInformationByHandleEx(hFile, FileRemoteProtocolInfo, &remoteInfo, sizeof(remoteInfo)))
+        return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+
+    HANDLE hMapping = CreateFileMapping(hFile, NULL, PAGE_READONLY, 0L, 0L, NULL);
+    if (hMapping == NULL)
+        return HRESULT_FROM_WIN32(GetLastError());
+
+    // the view keeps the section alive
+    auto pView = MapViewOfFile(hMapping, FILE_MAP_READ, 0L, 0L, 0L);
+    auto dwError = GetLastError();
+    CloseHandle(hMapping);
+
+    if (pView == nullptr)
+        return HRESULT_FROM_WIN32(dwError);
+
+    m_pHiveBuffer = static_cast<BYTE*>(pView);
+    m_ulHiveBufferSize = ulSize;
+    m_bHiveBufferIsMapped = true;
+    return S_OK;
+}
+
+HRESULT RegistryHive::AllocateHive(ULONG64 ulSize)
+{
+    HRESULT hr = E_FAIL;
+
     if (ulSize == 0)
     {
         log::Error(_L_, hr = E_FAIL, L"[-] Hive size is 0.\r\n");
         return hr;
     }
+    if (ulSize > MAXSIZE_T)
+    {
+        log::Error(_L_, hr = E_OUTOFMEMORY, L"[-] Hive is too large to be read.\r\n");
+        return hr;
+    }
 
-    m_pHiveBuffer = (BYTE*)malloc((size_t)ulSize);
+    m_pHiveBuffer = (BYTE*)calloc(1, (size_t)ulSize);
     if (m_pHiveBuffer == NULL)
     {
         log::Error(_L_, hr = E_OUTOFMEMORY, L"[-] Not enough memory to read hive.\r\n");
         return hr;
     }
     m_ulHiveBufferSize = ulSize;
+    m_bHiveBufferIsMapped = false;
+    return S_OK;
+}
+
+HRESULT RegistryHive::PageHive(const std::shared_ptr<ByteStream>& pHiveStream)
+{
+    HRESULT hr = E_FAIL;
+
+    if (FAILED(hr = AllocateHive(pHiveStream->GetSize())))
+        return hr;
+
+    m_pHiveStream = pHiveStream;
+    m_LoadedPages.assign((size_t)((m_ulHiveBufferSize + HIVE_PAGE_SIZE - 1) / HIVE_PAGE_SIZE), false);
+    m_hrLoad = S_OK;
+
+    // headers are parsed straight from the buffer
+    LoadPages(0LL, 0x1000 + sizeof(HBINHeader));
+    if (FAILED(hr = m_hrLoad))
+    {
+        ReleaseHive();
+        return hr;
+    }
+    return S_OK;
+}
+
+void RegistryHive::LoadCell(const BYTE* pCell) const
+{
+    if (pCell < m_pHiveBuffer)
+        return;
+
+    const ULONG64 ulOffset = pCell - m_pHiveBuffer;
+    if (ulOffset + sizeof(BlockHeader) > m_ulHiveBufferSize)
+        return;
+
+    LoadPages(ulOffset, sizeof(BlockHeader));
+
+    // allocated cells have a negative size, free ones a positive one
+    const LONGLONG llSize = (int)((const BlockHeader*)pCell)->BlockSize;
+    const ULONG64 ulSize = llSize < 0 ? -llSize : llSize;
+
+    LoadPages(ulOffset, std::min(ulSize, m_ulHiveBufferSize - ulOffset));
+}
+
+void RegistryHive::LoadPages(ULONG64 ulOffset, ULONG64 ulLength) const
+{
+    const size_t ulEndPage =
+        (size_t)std::min<ULONG64>((ulOffset + ulLength + HIVE_PAGE_SIZE - 1) / HIVE_PAGE_SIZE, m_LoadedPages.size());
+
+    size_t ulPage = (size_t)(ulOffset / HIVE_PAGE_SIZE);
+    while (ulPage < ulEndPage)
+    {
+        if (m_LoadedPages[ulPage])
+        {
+            ulPage++;
+            continue;
+        }
+
+        // consecutive pages not read yet are read at once
+        size_t ulRunEnd = ulPage + 1;
+        while (ulRunEnd < ulEndPage && !m_LoadedPages[ulRunEnd])
+            ulRunEnd++;
+
+        const ULONG64 ulStart = ulPage * HIVE_PAGE_SIZE;
+        const ULONG64 ulEnd = std::min<ULONG64>(ulRunEnd * HIVE_PAGE_SIZE, m_ulHiveBufferSize);
+
+        HRESULT hr = m_pHiveStream->SetFilePointer((LONGLONG)ulStart, FILE_BEGIN, nullptr);
+
+        ULONG64 ulRead = ulStart;
+        while (SUCCEEDED(hr) && ulRead < ulEnd)
+        {
+            ULONG64 ulTmp = 0LL;
+            hr = m_pHiveStream->Read((PVOID)(m_pHiveBuffer + ulRead), ulEnd - ulRead, &ulTmp);
+            if (SUCCEEDED(hr) && ulTmp == 0)
+                hr = HRESULT_FROM_WIN32(ERROR_HANDLE_EOF);
+            ulRead += ulTmp;
+        }
+
+        if (FAILED(hr))
+        {
+            // the pages are left zeroed: the cells they hold fail their checks and are skipped by the walk
+            ZeroMemory(m_pHiveBuffer + ulRead, (size_t)(ulEnd - ulRead));
+            log::Error(_L_, hr, L"[-] Hive %s : failed to read offset 0x%I64x.\r\n", m_strHiveName.c_str(), ulRead);
+            if (SUCCEEDED(m_hrLoad))
+                m_hrLoad = hr;
+        }
+
+        std::fill(m_LoadedPages.begin() + ulPage, m_LoadedPages.begin() + ulRunEnd, true);
+        ulPage = ulRunEnd;
+    }
+}
+
+HRESULT RegistryHive::ReadHive(ByteStream& HiveStream)
+{
+    HRESULT hr = E_FAIL;
+
+    if (FAILED(hr = AllocateHive(HiveStream.GetSize())))
+        return hr;
 
     ULONG64 ulRead = 0LL;
     ULONG64 ulTmp = 0LL;
-    while (ulRead != ulSize)
+    while (ulRead != m_ulHiveBufferSize)
     {
 
-        hr = HiveStream.Read((PVOID)(m_pHiveBuffer + ulRead), ulSize - ulRead, &ulTmp);
+        hr = HiveStream.Read((PVOID)(m_pHiveBuffer + ulRead), m_ulHiveBufferSize - ulRead, &ulTmp);
 
         if (ulTmp == 0)
         {
             log::Error(_L_, hr, L"[-] Read error, aborting read operation.\r\n");
-            free(m_pHiveBuffer);
-            m_pHiveBuffer = nullptr;
-            m_ulHiveBufferSize = 0LL;
+            ReleaseHive();
             return hr;
         }
         ulRead += ulTmp;
     }
-    if ((hr = ParseHiveHeader()) != S_OK)
-    {
-        free(m_pHiveBuffer);
-        m_pHiveBuffer = nullptr;
-        m_ulHiveBufferSize = 0L;
-        log::Error(_L_, hr, L"[-] Error during hive header parsing.\r\n");
-        return hr;
-    }
+    return S_OK;
+}
 
-    if ((hr = ParseHBinHeader()) != S_OK)
+void RegistryHive::ReleaseHive()
+{
+    if (m_pHiveBuffer != nullptr)
     {
-        free(m_pHiveBuffer);
-        m_pHiveBuffer = nullptr;
-        m_ulHiveBufferSize = 0;
-        log::Error(_L_, hr, L"[-] Error during hive hbin header parsing.\r\n");
-        return hr;
+        if (m_bHiveBufferIsMapped)
+            UnmapViewOfFile(m_pHiveBuffer);
+        else
+            free(m_pHiveBuffer);
     }
-    return S_OK;
+    m_pHiveBuffer = nullptr;
+    m_ulHiveBufferSize = 0LL;
+    m_bHiveBufferIsMapped = false;
+
+    m_pHiveStream.reset();
+    m_LoadedPages.clear();
+    m_hrLoad = S_OK;
 }
 
 HRESULT RegistryHive::CheckBlockHeader(const BlockHeader* const pBlockHeader) const
@@ -1218,5 +1401,11 @@ HRESULT RegistryHive::Walk(
         // call key callback
         RegistryKeyCallBack(CurrentKey);
     }
+
+    if (FAILED(m_hrLoad))
+    {
+        SetHiveIsNotComplete();
+        log::Verbose(_L_, L"[*] Hive %s : some hbins could not be read.\r\n", m_strHiveName.c_str());
+    }
     return S_OK;
 }
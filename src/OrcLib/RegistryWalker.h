@@ -12,6 +12,7 @@
 #include <string>
 #include <functional>
 #include <algorithm>
+#include <memory>
 
 #include "ByteStream.h"
 
@@ -20,6 +21,7 @@
 namespace Orc {
 
 class LogFileWriter;
+class FileStream;
 
 #pragma pack(push)
 #pragma pack(8)
@@ -272,6 +274,13 @@ class ORCLIB_API RegistryHive
 private:
     BYTE* m_pHiveBuffer;
     ULONG64 m_ulHiveBufferSize;
+    bool m_bHiveBufferIsMapped = false;  // m_pHiveBuffer is a read only view of the hive file, not a copy
+
+    // when the hive is neither mapped nor read at once, its pages are read as the walk reaches them
+    // pages are never released before the hive: keys and values point into them
+    std::shared_ptr<ByteStream> m_pHiveStream;
+    mutable std::vector<bool> m_LoadedPages;
+    mutable HRESULT m_hrLoad = S_OK;
 
     FILETIME* m_pLastModificationTime;
     DWORD m_dwRootKeyOffset;
@@ -285,7 +294,13 @@ private:
 
     logger _L_;
 
-    BYTE* FixOffset(DWORD offset) const { return (m_pHiveBuffer + (int)offset + 0x1000); };
+    BYTE* FixOffset(DWORD offset) const
+    {
+        BYTE* pCell = m_pHiveBuffer + (int)offset + 0x1000;
+        if (m_pHiveStream != nullptr)
+            LoadCell(pCell);
+        return pCell;
+    };
 
     bool IsOffsetValid(DWORD dwOffset) const
     {
@@ -306,6 +321,15 @@ private:
         RegistryKey* const ParentKey,
         DWORD* pSubKeyCount);
 
+    HRESULT MapHive(FileStream& HiveStream);
+    HRESULT PageHive(const std::shared_ptr<ByteStream>& pHiveStream);
+    HRESULT ReadHive(ByteStream& HiveStream);
+    HRESULT AllocateHive(ULONG64 ulSize);
+    void ReleaseHive();
+
+    void LoadCell(const BYTE* pCell) const;
+    void LoadPages(ULONG64 ulOffset, ULONG64 ulLength) const;
+
     HRESULT ParseHiveHeader();
     HRESULT ParseHBinHeader();
 
@@ -330,17 +354,13 @@ public:
     RegistryHive(logger pLog, const std::wstring& HiveName);
     RegistryHive(logger pLog);
 
-    HRESULT LoadHive(ByteStream& HiveStream);
+    HRESULT LoadHive(const std::shared_ptr<ByteStream>& pHiveStream);
     HRESULT Walk(
         std::function<void(const RegistryKey* const)> RegistryKeyCallBack,
         std::function<void(const RegistryValue* const)> RegistryValueCallback);
     bool IsHiveComplete() const;
 
-    ~RegistryHive()
-    {
-        if (m_pHiveBuffer != nullptr)
-            free(m_pHiveBuffer);
-    };
+    ~RegistryHive() { ReleaseHive(); };
 };
 
 class ORCLIB_API RegistryKey
@@ -796,7 +796,7 @@ HRESULT SqlImportAgent::ImportHiveData(ImportItem& input)
 
     RegistryHive regwalker(_L_);
 
-    if (FAILED(hr = regwalker.LoadHive(*pStream)))
+    if (FAILED(hr = regwalker.LoadHive(pStream)))
     {
         log::Error(_L_, hr, L"Failed to load hive %s\r\n", input.name.c_str());
         return hr;
@@ -12,6 +12,10 @@
 
 #include "WideAnsi.h"
 
+#if defined(_M_IX86) || defined(_M_X64)
+#    include <immintrin.h>
+#endif
+
 using namespace std;
 using namespace Orc;
 
@@ -279,6 +283,205 @@ static bool isAscii[0x100] =
                 false,
                 false};
 
+namespace {
+
+// Offsets where no string nor string push can start (neither printable ascii nor the C6/C7 mov opcodes)
+// extract nothing: the scanners skip them in bulk and measure printable ascii runs in one pass.
+struct Scanner
+{
+    // First offset in [offset, limit) where a string may start, limit if none
+    size_t (*FindCandidate)(const BYTE* pData, size_t offset, size_t limit);
+    // Number of consecutive printable ascii characters from pData[offset], stopping at cbData
+    size_t (*AsciiRunLength)(const BYTE* pData, size_t offset, size_t cbData);
+};
+
+inline bool IsCandidate(BYTE b)
+{
+    return isAscii[b] || b == 0xC6 || b == 0xC7;
+}
+
+size_t FindCandidateScalar(const BYTE* pData, size_t offset, size_t limit)
+{
+    while (offset < limit && !IsCandidate(pData[offset]))
+        offset++;
+    return offset;
+}
+
+size_t AsciiRunLengthScalar(const BYTE* pData, size_t offset, size_t cbData)
+{
+    size_t i = offset;
+    while (i < cbData && isAscii[pData[i]])
+        i++;
+    return i - offset;
+}
+
+const Scanner g_ScalarScanner = {FindCandidateScalar, AsciiRunLengthScalar};
+
+#if defined(_M_IX86) || defined(_M_X64)
+
+// Bytes of isAscii: 0x20 <= b <= 0x7E is (b - 0x20) < 0x5F unsigned, compared as signed once biased by 0x80
+inline __m128i AsciiMask(__m128i bytes)
+{
+    const __m128i biased = _mm_xor_si128(_mm_sub_epi8(bytes, _mm_set1_epi8(0x20)), _mm_set1_epi8((char)0x80));
+    __m128i mask = _mm_cmplt_epi8(biased, _mm_set1_epi8((char)(0x5F ^ 0x80)));
+    mask = _mm_or_si128(mask, _mm_cmpeq_epi8(bytes, _mm_set1_epi8(0x09)));
+    mask = _mm_or_si128(mask, _mm_cmpeq_epi8(bytes, _mm_set1_epi8(0x0A)));
+    return _mm_or_si128(mask, _mm_cmpeq_epi8(bytes, _mm_set1_epi8(0x0D)));
+}
+
+size_t FindCandidateSSE2(const BYTE* pData, size_t offset, size_t limit)
+{
+    while (offset + sizeof(__m128i) <= limit)
+    {
+        const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pData + offset));
+        __m128i mask = AsciiMask(bytes);
+        mask = _mm_or_si128(mask, _mm_cmpeq_epi8(bytes, _mm_set1_epi8((char)0xC6)));
+        mask = _mm_or_si128(mask, _mm_cmpeq_epi8(bytes, _mm_set1_epi8((char)0xC7)));
+
+        unsigned long index = 0;
+        if (_BitScanForward(&index, _mm_movemask_epi8(mask)))
+            return offset + index;
+        offset += sizeof(__m128i);
+    }
+    return FindCandidateScalar(pData, offset, limit);
+}
+
+size_t AsciiRunLengthSSE2(const BYTE* pData, size_t offset, size_t cbData)
+{
+    size_t i = offset;
+    while (i + sizeof(__m128i) <= cbData)
+    {
+        const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pData + i));
+
+        unsigned long index = 0;
+        if (_BitScanForward(&index, ~_mm_movemask_epi8(AsciiMask(bytes)) & 0xFFFF))
+            return i + index - offset;
+        i += sizeof(__m128i);
+    }
+    return i - offset + AsciiRunLengthScalar(pData, i, cbData);
+}
+
+const Scanner g_SSE2Scanner = {FindCandidateSSE2, AsciiRunLengthSSE2};
+
+// AVX2 instructions are only executed once IsAVX2Supported() vouched for them
+inline __m256i AsciiMask(__m256i bytes)
+{
+    const __m256i biased =
+        _mm256_xor_si256(_mm256_sub_epi8(bytes, _mm256_set1_epi8(0x20)), _mm256_set1_epi8((char)0x80));
+    __m256i mask = _mm256_cmpgt_epi8(_mm256_set1_epi8((char)(0x5F ^ 0x80)), biased);
+    mask = _mm256_or_si256(mask, _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8(0x09)));
+    mask = _mm256_or_si256(mask, _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8(0x0A)));
+    return _mm256_or_si256(mask, _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8(0x0D)));
+}
+
+size_t FindCandidateAVX2(const BYTE* pData, size_t offset, size_t limit)
+{
+    while (offset + sizeof(__m256i) <= limit)
+    {
+        const __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pData + offset));
+        __m256i mask = AsciiMask(bytes);
+        mask = _mm256_or_si256(mask, _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8((char)0xC6)));
+        mask = _mm256_or_si256(mask, _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8((char)0xC7)));
+
+        unsigned long index = 0;
+        if (_BitScanForward(&index, static_cast<unsigned long>(_mm256_movemask_epi8(mask))))
+            return offset + index;
+        offset += sizeof(__m256i);
+    }
+    return FindCandidateSSE2(pData, offset, limit);
+}
+
+size_t AsciiRunLengthAVX2(const BYTE* pData, size_t offset, size_t cbData)
+{
+    size_t i = offset;
+    while (i + sizeof(__m256i) <= cbData)
+    {
+        const __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pData + i));
+
+        unsigned long index = 0;
+        if (_BitScanForward(&index, ~static_cast<unsigned long>(_mm256_movemask_epi8(AsciiMask(bytes)))))
+            return i + index - offset;
+        i += sizeof(__m256i);
+    }
+    return i - offset + AsciiRunLengthSSE2(pData, i, cbData);
+}
+
+const Scanner g_AVX2Scanner = {FindCandidateAVX2, AsciiRunLengthAVX2};
+
+bool IsSSE2Supported()
+{
+    return IsProcessorFeaturePresent(PF_XMMI64_INSTRUCTIONS_AVAILABLE) != FALSE;
+}
+
+bool IsAVX2Supported()
+{
+    static const bool bSupported = []() {
+        int info[4] = {0};
+
+        __cpuid(info, 0);
+        if (info[0] < 7)
+            return false;
+
+        // AVX and OSXSAVE, then the OS must save the YMM registers on context switches
+        __cpuid(info, 1);
+        if ((info[2] & (1 << 27)) == 0 || (info[2] & (1 << 28)) == 0)
+            return false;
+        if ((_xgetbv(0) & 0x6) != 0x6)
+            return false;
+
+        __cpuidex(info, 7, 0);
+        return (info[1] & (1 << 5)) != 0;
+    }();
+    return bSupported;
+}
+
+#endif
+
+const Scanner* GetScanner(StringsStream::ScanMethod method)
+{
+    switch (method)
+    {
+        case StringsStream::ScanMethod::Scalar:
+            return &g_ScalarScanner;
+#if defined(_M_IX86) || defined(_M_X64)
+        case StringsStream::ScanMethod::SSE2:
+            return IsSSE2Supported() ? &g_SSE2Scanner : nullptr;
+        case StringsStream::ScanMethod::AVX2:
+            return IsAVX2Supported() ? &g_AVX2Scanner : nullptr;
+        case StringsStream::ScanMethod::Auto:
+            if (IsAVX2Supported())
+                return &g_AVX2Scanner;
+            if (IsSSE2Supported())
+                return &g_SSE2Scanner;
+            return &g_ScalarScanner;
+#else
+        case StringsStream::ScanMethod::Auto:
+            return &g_ScalarScanner;
+#endif
+        default:
+            return nullptr;
+    }
+}
+
+}  // namespace
+
+HRESULT StringsStream::IsScanMethodSupported(ScanMethod method)
+{
+    if (method == ScanMethod::EachOffset)
+        return S_OK;
+    return GetScanner(method) != nullptr ? S_OK : HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+}
+
+HRESULT StringsStream::SetScanMethod(ScanMethod method)
+{
+    HRESULT hr = E_FAIL;
+    if (FAILED(hr = IsScanMethodSupported(method)))
+        return hr;
+
+    m_ScanMethod = method;
+    return S_OK;
+}
+
 HRESULT StringsStream::OpenForStrings(const shared_ptr<ByteStream>& pChained, size_t minChars, size_t maxChars)
 {
     if (pChained == NULL)
@@ -599,40 +802,89 @@ size_t StringsStream::extractString(
     return 0;
 }
 
+// Tries to extract a string at offset, returns the next offset to try
+size_t StringsStream::processOffset(const CBinaryBuffer& aBuffer, size_t offset)
+{
+    ExtractType extractType;
+    UTF16Type stringType = TYPE_UNDETERMINED;
+    size_t cchPreviouslyExtracted = m_cchExtracted;
+    size_t cbProcessed = extractString(aBuffer, offset, extractType, stringType);
+
+    if ((m_cchExtracted - cchPreviouslyExtracted) >= m_minChars)
+    {
+        m_Strings.CheckCount(m_cchExtracted + 2);
+        m_Strings.Get<UCHAR>(m_cchExtracted) = '\r';
+        m_Strings.Get<UCHAR>(m_cchExtracted + 1) = '\n';
+        m_cchExtracted += 2;
+        return offset + cbProcessed;
+    }
+
+    m_cchExtracted = cchPreviouslyExtracted;
+    return offset + 1;
+}
+
+// Same as processOffset for an ascii string of cchRun characters already measured at offset
+size_t StringsStream::appendAsciiRun(const CBinaryBuffer& aBuffer, size_t offset, size_t cchRun)
+{
+    // m_Strings grows exactly as extractString would make it grow, its size bounds the unicode strings
+    m_Strings.CheckCount(m_cchExtracted + cchRun);
+
+    if (cchRun < m_minChars)
+    {
+        // shorter runs starting within this one fail as well, only its last character may start a unicode string
+        return offset + (cchRun > 1 ? cchRun - 1 : 1);
+    }
+
+    memcpy((LPBYTE)m_Strings.GetData() + m_cchExtracted, aBuffer.GetData() + offset, cchRun);
+    m_cchExtracted += cchRun;
+
+    m_Strings.CheckCount(m_cchExtracted + 2);
+    m_Strings.Get<UCHAR>(m_cchExtracted) = '\r';
+    m_Strings.Get<UCHAR>(m_cchExtracted + 1) = '\n';
+    m_cchExtracted += 2;
+    return offset + cchRun;
+}
+
 HRESULT StringsStream::processBuffer(const CBinaryBuffer& aBuffer, CBinaryBuffer& strings)
 {
     // Process the contents of the specified file, and build the list of strings
     strings.CheckCount(MAX_STRING_SIZE + 1);
     m_cchExtracted = 0;
 
+    const size_t cbData = aBuffer.GetCount();
     size_t offset = 0;
-    ExtractType extractType;
-    while (offset + m_minChars < aBuffer.GetCount())
+
+    // scanners read the byte following a candidate, extractString assumes the same
+    const Scanner* pScanner = m_minChars > 1 ? GetScanner(m_ScanMethod) : nullptr;
+    if (pScanner == nullptr)
     {
-        // Process this offset
-        UTF16Type stringType = TYPE_UNDETERMINED;
-        size_t cchPreviouslyExtracted = m_cchExtracted;
-        size_t cbProcessed = extractString(aBuffer, offset, extractType, stringType);
+        while (offset + m_minChars < cbData)
+            offset = processOffset(aBuffer, offset);
+        return S_OK;
+    }
 
-        if ((m_cchExtracted - cchPreviouslyExtracted) >= m_minChars)
-        {
-            // Do something
-            m_Strings.CheckCount(m_cchExtracted + 2);
-            m_Strings.Get<UCHAR>(m_cchExtracted) = '\r';
-            m_Strings.Get<UCHAR>(m_cchExtracted + 1) = '\n';
-            m_cchExtracted += 2;
-            // Advance the offset
-            offset += cbProcessed;
-        }
+    const BYTE* pData = aBuffer.GetData();
+    while (offset + m_minChars < cbData)
+    {
+        // every skipped offset would have made this very request
+        if (!m_Strings.CheckCount(m_cchExtracted + MAX_STRING_SIZE))
+            return E_OUTOFMEMORY;
+
+        offset = pScanner->FindCandidate(pData, offset, cbData - m_minChars);
+        if (offset + m_minChars >= cbData)
+            break;
+
+        const BYTE b0 = pData[offset];
+        const BYTE b1 = pData[offset + 1];
+
+        // unicode strings and string pushes are left to extractString
+        if (!isAscii[b0] || b1 == 0 || (b0 == 0x66 && b1 == 0xC7))
+            offset = processOffset(aBuffer, offset);
         else
-        {
-            // Advance the offset by 1
-            m_cchExtracted = cchPreviouslyExtracted;
-            offset += 1;
-        }
+            offset = appendAsciiRun(aBuffer, offset, pScanner->AsciiRunLength(pData, offset, cbData));
     }
 
-    return true;
+    return S_OK;
 }
 
 HRESULT StringsStream::Read(
@@ -38,6 +38,21 @@ public:
         TYPE_UNICODE
     } UTF16Type;
 
+    // How offsets where a string may start are looked for. Each method extracts the very same strings:
+    // Auto picks the widest vector instructions supported by the processor,
+    // EachOffset tries to extract a string at every single offset of the buffer (as strings.exe does)
+    enum class ScanMethod
+    {
+        Auto,
+        EachOffset,
+        Scalar,
+        SSE2,
+        AVX2
+    };
+
+    // Fails with ERROR_NOT_SUPPORTED when the processor lacks the instructions the method needs
+    static HRESULT IsScanMethodSupported(ScanMethod method);
+
 private:
     CBinaryBuffer m_Strings;
     size_t m_cchExtracted;
@@ -45,9 +60,14 @@ private:
     size_t m_minChars;
     size_t m_maxChars;
 
+    ScanMethod m_ScanMethod = ScanMethod::Auto;
+
     size_t extractImmediate(const CBinaryBuffer& aBuffer, UTF16Type& stringType);
     size_t extractString(const CBinaryBuffer& aBuffer, size_t offset, ExtractType& extractType, UTF16Type& stringType);
 
+    size_t processOffset(const CBinaryBuffer& aBuffer, size_t offset);
+    size_t appendAsciiRun(const CBinaryBuffer& aBuffer, size_t offset, size_t cchRun);
+
     HRESULT processBuffer(const CBinaryBuffer& aBuffer, CBinaryBuffer& strings);
 
 public:
@@ -85,6 +105,9 @@ public:
     STDMETHOD(OpenForStrings)
     (const std::shared_ptr<ByteStream>& pChainedStream, size_t minChars, size_t maxChars);
 
+    HRESULT SetScanMethod(ScanMethod method);
+    ScanMethod GetScanMethod() const { return m_ScanMethod; }
+
     STDMETHOD(Read)
     (__out_bcount_part(cbBytes, *pcbBytesRead) PVOID pReadBuffer,
      __in ULONGLONG cbBytes,
@@ -54,6 +54,26 @@ enum ColumnType
     FlagsType
 };
 
+// Encoding and compression hints of a column, for the columnar table files (Parquet, ORC)
+// Default leaves the choice to the writer, a hint a format cannot apply is ignored.
+// ORC encodes all its string columns alike: dictionaries are enabled when most of them hint Dictionary.
+enum class ColumnEncoding
+{
+    Default,
+    Dictionary,  // few distinct values (computer name, volume ID, extension...)
+    Plain  // mostly distinct values (full path, FRN, USN...)
+};
+
+enum class ColumnCompression
+{
+    Default,
+    None,
+    Snappy,
+    GZip,
+    LZ4,
+    ZStd
+};
+
 class EnumValue
 {
 public:
@@ -109,6 +129,8 @@ public:
         std::swap(bAllowsNullValues, other.bAllowsNullValues);
         std::swap(EnumValues, other.EnumValues);
         std::swap(FlagsValues, other.FlagsValues);
+        std::swap(Encoding, other.Encoding);
+        std::swap(Compression, other.Compression);
     }
 
     Column(const Column& other) = default;
@@ -127,6 +149,9 @@ public:
 
     std::optional<std::vector<EnumValue>> EnumValues;
     std::optional<std::vector<FlagValue>> FlagsValues;
+
+    ColumnEncoding Encoding = ColumnEncoding::Default;
+    ColumnCompression Compression = ColumnCompression::Default;
 };
 
 class Schema
@@ -0,0 +1,91 @@
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+//
+// Copyright © 2011-2019 ANSSI. All Rights Reserved.
+//
+// Author(s): Jean Gautier (ANSSI)
+//
+
+#include "stdafx.h"
+
+#include "TableOutputBackgroundFlush.h"
+
+#include "OrcException.h"
+
+using namespace Orc;
+
+Orc::TableOutput::BackgroundFlush::BackgroundFlush(logger pLog, DWORD dwInFlight)
+    : _L_(std::move(pLog))
+    , m_Slots(dwInFlight > 0 ? dwInFlight : 1)
+{
+}
+
+Orc::TableOutput::BackgroundFlush::~BackgroundFlush()
+{
+    Wait();
+}
+
+HRESULT Orc::TableOutput::BackgroundFlush::Post(WriteFn write)
+{
+    if (auto hr = m_hrWrite.load(); FAILED(hr))
+        return hr;
+
+    // back-pressure: the producer waits here while dwInFlight writes are pending
+    m_Slots.Acquire();
+
+    if (!m_bRunning)
+    {
+        m_bRunning = true;
+        m_Writer.run([this]() { Run(); });
+    }
+
+    Concurrency::send(m_Writes, std::make_shared<WriteFn>(std::move(write)));
+    return S_OK;
+}
+
+HRESULT Orc::TableOutput::BackgroundFlush::Wait()
+{
+    if (m_bRunning)
+    {
+        // end of the posted writes, the writer task is started again by the next Post
+        Concurrency::send(m_Writes, std::shared_ptr<WriteFn>());
+        m_Writer.wait();
+        m_bRunning = false;
+    }
+    return m_hrWrite;
+}
+
+void Orc::TableOutput::BackgroundFlush::Run()
+{
+    while (auto write = Concurrency::receive(m_Writes))
+    {
+        if (SUCCEEDED(m_hrWrite.load()))
+        {
+            HRESULT hr = E_FAIL;
+            try
+            {
+                hr = (*write)();
+            }
+            catch (const Orc::Exception& e)
+            {
+                e.PrintMessage(_L_);
+                hr = e.GetHRESULT();
+            }
+            catch (const std::exception& e)
+            {
+                log::Error(_L_, E_FAIL, L"Table output write threw exception \"%S\"\r\n", e.what());
+                hr = E_FAIL;
+            }
+
+            if (FAILED(hr))
+            {
+                log::Error(_L_, hr, L"Failed to write table output in the background\r\n");
+                m_hrWrite = hr;
+            }
+        }
+
+        // the buffers held by the write are released before the producer can post another one
+        write.reset();
+        m_Slots.Release();
+    }
+}
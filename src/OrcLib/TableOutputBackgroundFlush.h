@@ -0,0 +1,61 @@
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+//
+// Copyright © 2011-2019 ANSSI. All Rights Reserved.
+//
+// Author(s): Jean Gautier (ANSSI)
+//
+#pragma once
+
+#include "OrcLib.h"
+
+#include "Semaphore.h"
+
+#include <agents.h>
+#include <ppl.h>
+
+#include <atomic>
+#include <functional>
+#include <memory>
+
+#pragma managed(push, off)
+
+namespace Orc::TableOutput {
+
+// Runs the writes of a table writer (a full buffer, a row batch...) on a background task, in the order they are posted
+// The producer keeps filling its next buffer while the previous ones are encoded and written to the output stream.
+// At most dwInFlight writes are pending at once: Post blocks until one of them completes.
+// Once a write fails, the writes still pending are dropped and the failure is returned by the next Post or Wait.
+class BackgroundFlush
+{
+public:
+    using WriteFn = std::function<HRESULT()>;
+
+    BackgroundFlush(logger pLog, DWORD dwInFlight);
+    ~BackgroundFlush();
+
+    BackgroundFlush(const BackgroundFlush&) = delete;
+    BackgroundFlush& operator=(const BackgroundFlush&) = delete;
+
+    // Must not be called concurrently with Wait (writers call both under their own lock)
+    HRESULT Post(WriteFn write);
+
+    // Returns once every posted write completed (or was dropped)
+    HRESULT Wait();
+
+    HRESULT GetWriteError() const { return m_hrWrite; }
+
+private:
+    void Run();
+
+    logger _L_;
+    Semaphore m_Slots;
+    Concurrency::unbounded_buffer<std::shared_ptr<WriteFn>> m_Writes;
+    Concurrency::task_group m_Writer;
+    bool m_bRunning = false;
+    std::atomic<HRESULT> m_hrWrite = S_OK;
+};
+
+}  // namespace Orc::TableOutput
+
+#pragma managed(pop)
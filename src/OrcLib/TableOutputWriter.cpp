@@ -36,6 +36,13 @@ using namespace boost;
 using namespace Orc;
 using namespace Orc::TableOutput;
 
+namespace {
+
+// table files are written by a background task while the next buffer (or batch) is filled
+constexpr DWORD IN_FLIGHT_BUFFERS = 2L;
+
+}  // namespace
+
 std::shared_ptr<IWriter> Orc::TableOutput::GetWriter(const logger& pLog, const OutputSpec& out)
 {
     HRESULT hr = E_FAIL;
@@ -58,6 +65,7 @@ std::shared_ptr<IWriter> Orc::TableOutput::GetWriter(const logger& pLog, const O
             options->bBOM = true;
             options->Delimiter = out.szSeparator;
             options->StringDelimiter = out.szQuote;
+            options->dwInFlightBuffers = IN_FLIGHT_BUFFERS;
 
             auto retval = CSV::Writer::MakeNew(pLog, std::move(options));
 
@@ -87,7 +95,12 @@ std::shared_ptr<IWriter> Orc::TableOutput::GetWriter(const logger& pLog, const O
         case OutputSpec::Kind::Parquet:
         case OutputSpec::Kind::TableFile | OutputSpec::Kind::Parquet:
         {
-            auto options = std::make_unique<TableOutput::Options>();
+            auto options = std::make_unique<TableOutput::Parquet::Options>();
+            options->InFlightBatches = IN_FLIGHT_BUFFERS;
+            if (out.BatchSize > 0L)
+                options->BatchSize = out.BatchSize;
+            if (out.RowGroupSize > 0LL)
+                options->RowGroupSize = out.RowGroupSize;
 
             auto pWriter = GetParquetWriter(pLog, std::move(options));
 
@@ -116,7 +129,12 @@ std::shared_ptr<IWriter> Orc::TableOutput::GetWriter(const logger& pLog, const O
         case OutputSpec::Kind::ORC:
         case OutputSpec::Kind::TableFile | OutputSpec::Kind::ORC:
         {
-            auto options = std::make_unique<TableOutput::Options>();
+            auto options = std::make_unique<TableOutput::ApacheOrc::Options>();
+            options->InFlightBatches = IN_FLIGHT_BUFFERS;
+            if (out.BatchSize > 0L)
+                options->BatchSize = out.BatchSize;
+            if (out.RowGroupSize > 0LL)
+                options->RowGroupSize = out.RowGroupSize;
 
             auto pWriter = GetApacheOrcnWriter(pLog, std::move(options));
 
@@ -495,6 +513,40 @@ Orc::TableOutput::GetColumnsFromConfig(const logger& pLog, const LPCWSTR szTable
             {
                 aCol->Format = format;
             }
+            if (const auto& encoding = column.SubItems[CONFIG_SCHEMA_COLUMN_ENCODING])
+            {
+                if (equalCaseInsensitive((const std::wstring&)encoding, L"dictionary"sv))
+                    aCol->Encoding = TableOutput::ColumnEncoding::Dictionary;
+                else if (equalCaseInsensitive((const std::wstring&)encoding, L"plain"sv))
+                    aCol->Encoding = TableOutput::ColumnEncoding::Plain;
+                else
+                    log::Error(
+                        pLog,
+                        E_INVALIDARG,
+                        L"Invalid encoding \"%s\" for column %s (ignored)\r\n",
+                        encoding.c_str(),
+                        aCol->ColumnName.c_str());
+            }
+            if (const auto& compression = column.SubItems[CONFIG_SCHEMA_COLUMN_COMPRESSION])
+            {
+                if (equalCaseInsensitive((const std::wstring&)compression, L"none"sv))
+                    aCol->Compression = TableOutput::ColumnCompression::None;
+                else if (equalCaseInsensitive((const std::wstring&)compression, L"snappy"sv))
+                    aCol->Compression = TableOutput::ColumnCompression::Snappy;
+                else if (equalCaseInsensitive((const std::wstring&)compression, L"gzip"sv))
+                    aCol->Compression = TableOutput::ColumnCompression::GZip;
+                else if (equalCaseInsensitive((const std::wstring&)compression, L"lz4"sv))
+                    aCol->Compression = TableOutput::ColumnCompression::LZ4;
+                else if (equalCaseInsensitive((const std::wstring&)compression, L"zstd"sv))
+                    aCol->Compression = TableOutput::ColumnCompression::ZStd;
+                else
+                    log::Error(
+                        pLog,
+                        E_INVALIDARG,
+                        L"Invalid compression \"%s\" for column %s (ignored)\r\n",
+                        compression.c_str(),
+                        aCol->ColumnName.c_str());
+            }
 
             try
             {
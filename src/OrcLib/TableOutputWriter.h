@@ -72,6 +72,7 @@ struct Options : Orc::TableOutput::Options
     std::wstring StringDelimiter = L"\""s;
     std::wstring EndOfLine = L"\r\n"s;
     std::wstring BoolChars = L"YN"s;
+    DWORD dwInFlightBuffers = 0L;  // when not 0, full buffers are written by a background task (at most this many)
 };
 }  // namespace CSV
 
@@ -79,6 +80,8 @@ namespace Parquet {
 struct Options : Orc::TableOutput::Options
 {
     std::optional<DWORD> BatchSize;
+    std::optional<DWORD> InFlightBatches;  // full batches are written by a background task (at most this many)
+    std::optional<ULONGLONG> RowGroupSize;  // in bytes: a batch is flushed as a row group once its data reaches it
 };
 }  // namespace Parquet
 
@@ -92,6 +95,8 @@ namespace ApacheOrc {
 struct Options : Orc::TableOutput::Options
 {
     std::optional<DWORD> BatchSize;
+    std::optional<DWORD> InFlightBatches;  // full batches are written by a background task (at most this many)
+    std::optional<ULONGLONG> RowGroupSize;  // stripe size, in bytes
     std::optional<std::pair<std::wstring, std::vector<BYTE>>> TimeZone;
 };
 }  // namespace OptRowColumn
@@ -8,6 +8,7 @@
 #include "StdAfx.h"
 
 #include "USNJournalWalkerOffline.h"
+#include "ByteStream.h"
 #include "FileFind.h"
 #include "MountedVolumeReader.h"
 
@@ -15,13 +16,209 @@
 
 #include <cmath>
 
-#include <boost/scope_exit.hpp>
+#include <ppl.h>
+
+#if defined(_M_IX86) || defined(_M_X64)
+#    include <immintrin.h>
+#endif
 
 using namespace Orc;
 
 static const auto ROOT_USN = 0x0005000000000005LL;
 
-DWORD USNJournalWalkerOffline::m_BufferSize = 0x10000;
+namespace {
+
+// Records have a 255 characters name at most, a chunk is read this much past its end so that the records which start
+// in it are complete
+constexpr ULONGLONG MAX_USN_RECORD_SIZE = 0x1000;
+
+using USN_RECORD_V2 = USNJournalWalkerBase::USN_RECORD_V2;
+using USN_RECORD_V3 = USNJournalWalkerBase::USN_RECORD_V3;
+
+struct JournalChunk
+{
+    ULONGLONG ullBegin = 0LL;
+    ULONGLONG ullEnd = 0LL;
+    ULONGLONG ullWindowEnd = 0LL;  // data is read up to here for the records which straddle the chunk's end
+    bool bFirstOfRange = false;
+};
+
+struct ParsedChunk
+{
+    ULONGLONG ullBegin = 0LL;  // where parsing started
+    ULONGLONG ullNext = 0LL;  // where the records of the next chunk start
+    bool bStop = false;
+    std::vector<BYTE> Records;  // version 2 records
+};
+
+struct ChunkBatch
+{
+    size_t First = 0L;
+    size_t Count = 0L;
+    CBinaryBuffer Data;
+    std::vector<ULONGLONG> Read;
+    std::vector<ParsedChunk> Parsed;
+};
+
+bool IsSupportedVersion(WORD wMajorVersion)
+{
+    return wMajorVersion >= 2 && wMajorVersion <= 4;
+}
+
+BYTE* SkipZeroes(BYTE* pCurrent, BYTE* pEnd)
+{
+#if defined(_M_IX86) || defined(_M_X64)
+    const __m128i zero = _mm_setzero_si128();
+
+    // whole zero pages (the journal's gaps) are skipped 64 bytes at a time
+    while (pEnd - pCurrent >= 64)
+    {
+        const __m128i block = _mm_or_si128(
+            _mm_or_si128(
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(pCurrent)),
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(pCurrent + 16))),
+            _mm_or_si128(
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(pCurrent + 32)),
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(pCurrent + 48))));
+
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(block, zero)) != 0xFFFF)
+            break;
+        pCurrent += 64;
+    }
+
+    while (pEnd - pCurrent >= 16)
+    {
+        const int mask =
+            _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(pCurrent)), zero));
+
+        if (mask != 0xFFFF)
+        {
+            unsigned long index = 0;
+            _BitScanForward(&index, ~mask & 0xFFFF);
+            return pCurrent + index;
+        }
+        pCurrent += 16;
+    }
+#endif
+
+    while (pCurrent < pEnd && *pCurrent == 0)
+        ++pCurrent;
+
+    return pCurrent;
+}
+
+// Appends a version 2 or 3 record as a version 2 record, the layout of USN_RECORD.
+// Version 4 records (range tracking) and records with an inconsistent name are skipped.
+bool AppendAsV2Record(const BYTE* pRecord, std::vector<BYTE>& records)
+{
+    const auto pHeader = reinterpret_cast<const USN_RECORD_V2*>(pRecord);
+    const DWORD cbHeader = FIELD_OFFSET(USN_RECORD_V2, FileName);
+
+    USN_RECORD_V2 record;
+    ZeroMemory(&record, sizeof(record));
+
+    switch (pHeader->MajorVersion)
+    {
+        case 2:
+            if (pHeader->RecordLength < cbHeader)
+                return false;
+            CopyMemory(&record, pRecord, cbHeader);
+            break;
+        case 3:
+        {
+            const auto pV3 = reinterpret_cast<const USN_RECORD_V3*>(pRecord);
+            if (pV3->RecordLength < FIELD_OFFSET(USN_RECORD_V3, FileName))
+                return false;
+
+            // NTFS file references are the low 64 bits of the 128 bits identifiers
+            CopyMemory(&record.FileReferenceNumber, pV3->FileReferenceNumber, sizeof(DWORDLONG));
+            CopyMemory(&record.ParentFileReferenceNumber, pV3->ParentFileReferenceNumber, sizeof(DWORDLONG));
+            record.MinorVersion = pV3->MinorVersion;
+            record.Usn = pV3->Usn;
+            record.TimeStamp = pV3->TimeStamp;
+            record.Reason = pV3->Reason;
+            record.SourceInfo = pV3->SourceInfo;
+            record.SecurityId = pV3->SecurityId;
+            record.FileAttributes = pV3->FileAttributes;
+            record.FileNameLength = pV3->FileNameLength;
+            record.FileNameOffset = pV3->FileNameOffset;
+            break;
+        }
+        default:
+            return false;
+    }
+
+    if (static_cast<DWORD>(record.FileNameOffset) + record.FileNameLength > pHeader->RecordLength)
+        return false;
+
+    const BYTE* pFileName = pRecord + record.FileNameOffset;
+
+    record.MajorVersion = 2;
+    record.FileNameOffset = static_cast<WORD>(cbHeader);
+    record.RecordLength = (cbHeader + record.FileNameLength + 7) & ~7;
+
+    const size_t position = records.size();
+    records.resize(position + record.RecordLength, 0);
+    CopyMemory(records.data() + position, &record, cbHeader);
+    CopyMemory(records.data() + position + cbHeader, pFileName, record.FileNameLength);
+    return true;
+}
+
+// Parses the records which start in [ullBegin, ullEnd), pWindow holds cbWindow bytes of the journal from ullWindow
+void ParseChunk(
+    BYTE* pWindow,
+    ULONGLONG ullWindow,
+    ULONGLONG cbWindow,
+    ULONGLONG ullBegin,
+    ULONGLONG ullEnd,
+    ParsedChunk& chunk)
+{
+    chunk.ullBegin = ullBegin;
+    chunk.bStop = false;
+    chunk.Records.clear();
+
+    BYTE* pCurrent = pWindow + (ullBegin - ullWindow);
+    BYTE* pLimit = pWindow + std::min(ullEnd - ullWindow, cbWindow);
+    BYTE* pEnd = pWindow + cbWindow;
+
+    while (pCurrent < pLimit)
+    {
+        BYTE* pRecord = nullptr;
+        ULONG64 adjustmentOffset = 0;
+        bool shouldReadAnotherChunk = false, shouldStop = false;
+
+        if (S_OK
+            != USNJournalWalkerOffline::FindNextUSNRecord(
+                pCurrent, pEnd, &pRecord, shouldReadAnotherChunk, adjustmentOffset, shouldStop))
+        {
+            if (shouldStop)
+            {
+                chunk.bStop = true;
+                chunk.ullNext = ullWindow + (pCurrent - pWindow);
+            }
+            else
+            {
+                chunk.ullNext = std::max(ullEnd, ullWindow + cbWindow - adjustmentOffset);
+            }
+            return;
+        }
+
+        if (pRecord >= pLimit)
+        {
+            chunk.ullNext = ullWindow + (pRecord - pWindow);
+            return;
+        }
+
+        AppendAsV2Record(pRecord, chunk.Records);
+        pCurrent = pRecord + reinterpret_cast<USN_RECORD*>(pRecord)->RecordLength;
+    }
+
+    chunk.ullNext = ullWindow + (pCurrent - pWindow);
+}
+
+}  // namespace
+
+DWORD USNJournalWalkerOffline::m_BufferSize = 0x100000;
 
 USNJournalWalkerOffline::USNJournalWalkerOffline(logger pLog)
     : _L_(pLog)
@@ -175,95 +372,166 @@ HRESULT USNJournalWalkerOffline::ReadJournal(const IUSNJournalWalker::Callbacks&
 {
     HRESULT hr = E_FAIL;
 
-    if (m_USNJournal)
+    if (!m_USNJournal)
+        return hr;
+
+    if (S_OK != m_USNJournal->CanRead())
+        return S_OK;
+
+    // $J is mostly a sparse hole in front of the live records, only its allocated ranges are read
+    std::vector<ByteStream::DataRange> ranges;
+    if (S_OK != m_USNJournal->GetDataRanges(ranges))
+    {
+        ranges.clear();
+        ranges.push_back({0LL, m_USNJournal->GetSize(), false});
+    }
+
+    std::vector<JournalChunk> chunks;
+    for (const auto& range : ranges)
+    {
+        if (range.bHole)
+            continue;
+
+        const ULONGLONG ullRangeEnd = range.Offset + range.Length;
+        for (ULONGLONG ullBegin = range.Offset; ullBegin < ullRangeEnd; ullBegin += m_BufferSize)
+        {
+            JournalChunk chunk;
+            chunk.ullBegin = ullBegin;
+            chunk.ullEnd = std::min<ULONGLONG>(ullBegin + m_BufferSize, ullRangeEnd);
+            chunk.ullWindowEnd = std::min<ULONGLONG>(chunk.ullEnd + MAX_USN_RECORD_SIZE, ullRangeEnd);
+            chunk.bFirstOfRange = ullBegin == range.Offset;
+            chunks.push_back(chunk);
+        }
+    }
+
+    if (chunks.empty())
+        return S_OK;
+
+    // Chunks are read on this thread (streams are not thread safe) and parsed in batches on the workers while the next
+    // batch is read. Records are merged in journal order on this thread, where names are resolved.
+    const size_t cbWindow = m_BufferSize + static_cast<size_t>(MAX_USN_RECORD_SIZE);
+    const size_t cChunksPerBatch = std::max<size_t>(1, Concurrency::GetProcessorCount());
+
+    ChunkBatch batches[2];
+    for (auto& batch : batches)
     {
-        ULONGLONG numBytesReturned = 0;
-        LPVOID pChunk = HeapAlloc(GetProcessHeap(), 0, m_BufferSize);
-        if (pChunk == nullptr)
+        if (!batch.Data.SetCount(cbWindow * std::min(cChunksPerBatch, chunks.size())))
             return E_OUTOFMEMORY;
+        batch.Read.resize(cChunksPerBatch);
+        batch.Parsed.resize(cChunksPerBatch);
+    }
+
+    auto ReadBatch = [&](ChunkBatch& batch, size_t first) -> HRESULT {
+        HRESULT hrRead = E_FAIL;
 
-        BOOST_SCOPE_EXIT(&pChunk) { HeapFree(GetProcessHeap(), 0, pChunk); }
-        BOOST_SCOPE_EXIT_END;
+        batch.First = first;
+        batch.Count = std::min(cChunksPerBatch, chunks.size() - first);
 
-        if (S_OK == m_USNJournal->CanRead())
+        for (size_t i = 0; i < batch.Count; i++)
         {
-            ULONG64 size = m_USNJournal->GetSize();
-            ULONG64 offset = 0;
-            bool shouldStop = false;
+            const auto& chunk = chunks[first + i];
+
+            if (FAILED(hrRead = m_USNJournal->SetFilePointer(chunk.ullBegin, FILE_BEGIN, NULL)))
+                return hrRead;
+
+            if (FAILED(
+                    hrRead = m_USNJournal->Read(
+                        batch.Data.GetData() + i * cbWindow, chunk.ullWindowEnd - chunk.ullBegin, &batch.Read[i])))
+                return hrRead;
+        }
+        return S_OK;
+    };
+
+    if (FAILED(hr = ReadBatch(batches[0], 0)))
+    {
+        log::Error(_L_, hr, L"Failed to read USN journal at offset %I64d\r\n", chunks.front().ullBegin);
+        return hr;
+    }
 
-            while (!shouldStop && offset < size)
+    ULONGLONG ullExpected = 0LL;
+    bool shouldStop = false;
+
+    for (size_t current = 0; !shouldStop; current ^= 1)
+    {
+        ChunkBatch& batch = batches[current];
+        ChunkBatch& next = batches[current ^ 1];
+
+        Concurrency::task_group parsers;
+        parsers.run([&chunks, &batch, cbWindow]() {
+            Concurrency::parallel_for(size_t(0), batch.Count, [&chunks, &batch, cbWindow](size_t i) {
+                const auto& chunk = chunks[batch.First + i];
+                ParseChunk(
+                    batch.Data.GetData() + i * cbWindow,
+                    chunk.ullBegin,
+                    batch.Read[i],
+                    chunk.ullBegin,
+                    chunk.ullEnd,
+                    batch.Parsed[i]);
+            });
+        });
+
+        const size_t nextFirst = batch.First + batch.Count;
+        HRESULT hrNext = S_OK;
+        if (nextFirst < chunks.size())
+            hrNext = ReadBatch(next, nextFirst);
+        else
+            next.Count = 0;
+
+        parsers.wait();
+
+        for (size_t i = 0; i < batch.Count && !shouldStop; i++)
+        {
+            const auto& chunk = chunks[batch.First + i];
+            auto& parsed = batch.Parsed[i];
+
+            if (chunk.bFirstOfRange)
+                ullExpected = chunk.ullBegin;
+
+            if (parsed.ullBegin != ullExpected)
             {
-                if (FAILED(hr = m_USNJournal->SetFilePointer(offset, FILE_BEGIN, NULL)))
-                    return hr;
+                // the previous chunk's last record (or zeroes) spilled into this chunk, it is parsed again from there
+                if (ullExpected >= chunk.ullEnd)
+                    continue;
+
+                ParseChunk(
+                    batch.Data.GetData() + i * cbWindow,
+                    chunk.ullBegin,
+                    batch.Read[i],
+                    std::max(ullExpected, chunk.ullBegin),
+                    chunk.ullEnd,
+                    parsed);
+            }
 
-                if (S_OK
-                    != m_USNJournal->Read(pChunk, std::min<ULONGLONG>(m_BufferSize, size - offset), &numBytesReturned))
-                {
-                    return hr;
-                }
+            for (size_t offset = 0; offset < parsed.Records.size();)
+            {
+                auto pRecord = reinterpret_cast<USN_RECORD*>(parsed.Records.data() + offset);
+                offset += pRecord->RecordLength;
 
-                BYTE* pCurrentChunkPosition = reinterpret_cast<BYTE*>(pChunk);
-                BYTE* pEndChunkPosition = reinterpret_cast<BYTE*>(pChunk) + numBytesReturned;
-                USN_RECORD* nextUSNRecord = nullptr;
-                ULONG64 adjustmentOffset = 0;
-                bool shouldReadAnotherChunk = false;
-
-                if (S_OK
-                    != FindNextUSNRecord(
-                        pCurrentChunkPosition,
-                        pEndChunkPosition,
-                        (BYTE**)&nextUSNRecord,
-                        shouldReadAnotherChunk,
-                        adjustmentOffset,
-                        shouldStop))
-                {
-                    if (shouldStop)
-                    {
-                        break;
-                    }
-                }
-                else
+                bool bInSpecificLocation = false;
+                WCHAR* pFullName = GetFullNameAndIfInLocation(pRecord, NULL, &bInSpecificLocation);
+
+                if (pFullName && bInSpecificLocation)
                 {
-                    // parse all the entries we just got
-                    while (!shouldReadAnotherChunk && nextUSNRecord != nullptr)
-                    {
-                        pCurrentChunkPosition = reinterpret_cast<BYTE*>(nextUSNRecord);
-                        bool bInSpecificLocation = false;
-                        WCHAR* pFullName = GetFullNameAndIfInLocation(nextUSNRecord, NULL, &bInSpecificLocation);
-
-                        if (pFullName && bInSpecificLocation)
-                        {
-                            pCallbacks.RecordCallback(m_VolReader, pFullName, nextUSNRecord);
-                            m_dwWalkedItems++;
-                        }
-
-                        pCurrentChunkPosition += nextUSNRecord->RecordLength;
-
-                        if (S_OK
-                            != FindNextUSNRecord(
-                                pCurrentChunkPosition,
-                                pEndChunkPosition,
-                                (BYTE**)&nextUSNRecord,
-                                shouldReadAnotherChunk,
-                                adjustmentOffset,
-                                shouldStop))
-                        {
-                            if (shouldStop)
-                            {
-                                break;
-                            }
-                        }
-                    }
+                    pCallbacks.RecordCallback(m_VolReader, pFullName, pRecord);
+                    m_dwWalkedItems++;
                 }
-
-                offset += (numBytesReturned - adjustmentOffset);
             }
+
+            shouldStop = parsed.bStop;
+            ullExpected = parsed.ullNext;
         }
 
-        hr = S_OK;
+        if (FAILED(hrNext))
+        {
+            log::Error(_L_, hrNext, L"Failed to read USN journal at offset %I64d\r\n", chunks[nextFirst].ullBegin);
+            return hrNext;
+        }
+
+        if (next.Count == 0)
+            break;
     }
 
-    return hr;
+    return S_OK;
 }
 
 void USNJournalWalkerOffline::FillUSNRecord(USN_RECORD& record, MFTRecord* pElt, const PFILE_NAME pFileName)
@@ -305,13 +573,9 @@ HRESULT USNJournalWalkerOffline::FindNextUSNRecord(
 
     // ensure we are not in a gap between 2 records
     ULONG offset = 0;
-    if (*(DWORD*)(pCurrentChunkPosition) == 0)
+    if (pCurrentChunkPosition + sizeof(DWORD) <= pEndChunkPosition && *(DWORD*)(pCurrentChunkPosition) == 0)
     {
-        while ((__int64)pCurrentChunkPosition + offset < (__int64)pEndChunkPosition
-               && (*(pCurrentChunkPosition + offset) == 0))
-        {
-            ++offset;
-        }
+        offset = static_cast<ULONG>(SkipZeroes(pCurrentChunkPosition, pEndChunkPosition) - pCurrentChunkPosition);
     }
 
     // I add 8 here in to ensure that we have at least 8 bytes to check that it's a valid record
@@ -325,9 +589,10 @@ HRESULT USNJournalWalkerOffline::FindNextUSNRecord(
     if (offset > 0)
     {
         // need to adjust offset to match the start of the USN_RECORD structure because of a gap
-        for (int i = 4; i >= 1; i--)
+        // (the low bytes of the record length may be zeroes)
+        for (ULONG i = 4; i >= 1; i--)
         {
-            if (*((WORD*)(pCurrentChunkPosition + offset + i)) == 0x2)  // TODO : handle version 3
+            if (offset >= 4 - i && IsSupportedVersion(*((WORD*)(pCurrentChunkPosition + offset + i))))
             {
                 offset -= (4 - i);
                 break;
@@ -338,7 +603,7 @@ HRESULT USNJournalWalkerOffline::FindNextUSNRecord(
     USN_RECORD* usnRecord = reinterpret_cast<USN_RECORD*>(pCurrentChunkPosition + offset);
 
     // check we have a right version number
-    if (usnRecord->MajorVersion != 2)  // TODO : handle version 3
+    if (!IsSupportedVersion(usnRecord->MajorVersion) || usnRecord->RecordLength < 8)
     {
         shouldStop = true;
         return E_FAIL;
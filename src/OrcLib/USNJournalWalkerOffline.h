@@ -35,11 +35,13 @@ public:
     // from IUSNJournalWalker
     virtual HRESULT Initialize(const std::shared_ptr<Location>& loc);
     virtual HRESULT EnumJournal(const IUSNJournalWalker::Callbacks& pCallbacks);
+    // Records are passed to the callbacks with the layout of a version 2 record whatever their version
     virtual HRESULT ReadJournal(const IUSNJournalWalker::Callbacks& pCallbacks);
 
     // static functions
     static void FillUSNRecord(USN_RECORD& record, MFTRecord* pElt, const PFILE_NAME pFileName);
 
+    // Skips the zeroes between records, versions 2, 3 and 4 records are found
     static HRESULT FindNextUSNRecord(
         BYTE* pChunk,
         BYTE* pMaxChunkPosition,
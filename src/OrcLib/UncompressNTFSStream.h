@@ -26,6 +26,8 @@ public:
     UncompressNTFSStream(logger pLog);
     virtual ~UncompressNTFSStream(void);
 
+    void Accept(ByteStreamVisitor& visitor) override { return visitor.Visit(*this); };
+
     STDMETHOD(IsOpen)()
     {
         if (m_pChainedStream == NULL)
@@ -21,6 +21,21 @@ VolumeReader::VolumeReader(logger pLog, const WCHAR* szSnapshotName)
     wcscpy_s(m_szLocation, MAX_PATH, szSnapshotName);
 }
 
+HRESULT VolumeReader::ReadAt(ReadRequest* pRequests, size_t nRequests)
+{
+    HRESULT hr = E_FAIL;
+
+    for (size_t i = 0; i < nRequests; i++)
+    {
+        auto& request = pRequests[i];
+        CBinaryBuffer buffer(request.Data, static_cast<size_t>(request.Size));
+
+        if (FAILED(hr = ReadAt(request.Offset, buffer, request.Size, request.Read)))
+            return hr;
+    }
+    return S_OK;
+}
+
 HRESULT VolumeReader::ParseBootSector(const CBinaryBuffer& buffer)
 {
     if (FSVBR::FSType::UNKNOWN != m_fsType)
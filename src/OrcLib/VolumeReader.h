@@ -52,6 +52,27 @@ public:
     virtual HRESULT Read(ULONGLONG offset, CBinaryBuffer& data, ULONGLONG ullBytesToRead, ULONGLONG& ullBytesRead) = 0;
     virtual HRESULT Read(CBinaryBuffer& data, ULONGLONG ullBytesToRead, ULONGLONG& ullBytesRead) = 0;
 
+    // Positional read: neither uses nor moves the position set by Seek. Readers implementing it allow several threads
+    // to read at the same time, the others serialize it through Read.
+    // Up to ullBytesToRead bytes are read at the start of data, which grows to hold them when it owns its memory.
+    virtual HRESULT ReadAt(ULONGLONG offset, CBinaryBuffer& data, ULONGLONG ullBytesToRead, ULONGLONG& ullBytesRead)
+    {
+        return Read(offset, data, ullBytesToRead, ullBytesRead);
+    }
+
+    // One piece of a vectored positional read: up to Size bytes at Offset into Data, Read receives the count read
+    struct ReadRequest
+    {
+        ULONGLONG Offset = 0LL;
+        BYTE* Data = nullptr;
+        ULONGLONG Size = 0LL;
+        ULONGLONG Read = 0LL;
+    };
+
+    // Positional reads of independent pieces, issued together by readers allowing concurrent reads.
+    // Stops at the first failure. Pieces read short (end of the volume) do not stop the others.
+    virtual HRESULT ReadAt(ReadRequest* pRequests, size_t nRequests);
+
     const CBinaryBuffer& GetBootSector() const { return m_BoostSector; }
 
     virtual std::shared_ptr<VolumeReader> ReOpen(DWORD dwDesiredAccess, DWORD dwShareMode, DWORD dwFlags) PURE;
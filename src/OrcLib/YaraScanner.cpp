@@ -10,7 +10,6 @@
 #include "EmbeddedResource.h"
 #include "MemoryStream.h"
 #include "FileStream.h"
-#include "FileMappingStream.h"
 
 #include "WideAnsi.h"
 #include "ParameterCheck.h"
@@ -22,9 +21,69 @@
 #include "yara.h"
 
 #include <boost/algorithm/string.hpp>
+#include <boost/scope_exit.hpp>
+
+#include <ppl.h>
 
 using namespace Orc;
 
+namespace {
+
+// True when [ullOffset, ullOffset + ullLength) lies within one of the holes of a stream
+bool IsInHole(const std::vector<ByteStream::DataRange>& ranges, ULONGLONG ullOffset, ULONGLONG ullLength)
+{
+    auto it = std::upper_bound(
+        begin(ranges), end(ranges), ullOffset, [](ULONGLONG offset, const ByteStream::DataRange& range) {
+            return offset < range.Offset;
+        });
+    if (it == begin(ranges))
+        return false;
+
+    --it;
+    return it->bHole && ullOffset + ullLength <= it->Offset + it->Length;
+}
+
+// Reads from the current position until the buffer is full or the end of the stream is reached
+HRESULT ReadBlock(const std::shared_ptr<ByteStream>& stream, CBinaryBuffer& buffer, ULONG& bytesRead)
+{
+    HRESULT hr = S_OK;
+    ULONGLONG leftToRead = buffer.GetCount();
+
+    bytesRead = 0L;
+    while (leftToRead > 0)
+    {
+        ULONGLONG ullBytesRead = 0LL;
+        if (FAILED(hr = stream->Read(buffer.GetP<BYTE>(bytesRead), (UINT)leftToRead, &ullBytesRead)))
+            return hr;
+
+        if (ullBytesRead == 0)
+            break;
+
+        bytesRead += static_cast<ULONG>(ullBytesRead);
+        leftToRead -= ullBytesRead;
+    }
+    return S_OK;
+}
+
+// A block of a stream and its overlap with the previous block, as scanned by one batch of a parallel block scan
+struct ParallelBlock
+{
+    CBinaryBuffer Buffer{true};
+    const CBinaryBuffer* Data = nullptr;  // either the buffer or the zeroes of a hole
+    ULONG Bytes = 0L;
+    bool bScan = false;
+    HRESULT hr = S_OK;
+    MatchingRuleCollection Rules;
+
+    CBinaryBuffer Overlap{true};
+    ULONG OverlapBytes = 0L;
+    bool bScanOverlap = false;
+    HRESULT hrOverlap = S_OK;
+    MatchingRuleCollection OverlapRules;
+};
+
+}  // namespace
+
 Orc::YaraConfig Orc::YaraConfig::Get(const logger& pLog, const ConfigItem& item)
 {
     HRESULT hr = E_FAIL;
@@ -295,6 +354,8 @@ std::vector<std::string> Orc::YaraScanner::GetRulesSpec(const logger& pLog, LPCW
 
 YR_RULES* Orc::YaraScanner::GetRules()
 {
+    Concurrency::critical_section::scoped_lock lock(m_RulesLock);
+
     if (m_pRules)
         return m_pRules;
 
@@ -427,21 +488,33 @@ HRESULT Orc::YaraScanner::Scan(const LPCWSTR& szFileName, MatchingRuleCollection
 
 HRESULT Orc::YaraScanner::Scan(const CBinaryBuffer& buffer, ULONG bytesToScan, MatchingRuleCollection& matchingRules)
 {
-    if (bytesToScan == 0)
+    return ScanMemory(buffer.GetP<const uint8_t>(), bytesToScan, matchingRules);
+}
+
+HRESULT Orc::YaraScanner::ScanMemory(const uint8_t* pData, size_t cbData, MatchingRuleCollection& matchingRules)
+{
+    if (cbData == 0)
         return S_OK;
 
     YR_RULES* pRules = GetRules();
 
     auto scan_details = std::make_pair(this, &matchingRules);
 
-    switch (m_yara->yr_rules_scan_mem(
+    Semaphore::ScopedLock slot(m_ScanSlots);
+
+    return ScanResult(m_yara->yr_rules_scan_mem(
         pRules,
-        buffer.GetP<const uint8_t>(),
-        bytesToScan,
+        pData,
+        cbData,
         0,
         scan_callback,
         &scan_details,
-        (int)std::chrono::seconds(m_config.timeOut()).count()))
+        (int)std::chrono::seconds(m_config.timeOut()).count()));
+}
+
+HRESULT Orc::YaraScanner::ScanResult(int result)
+{
+    switch (result)
     {
         case ERROR_SUCCESS:
             return S_OK;
@@ -499,112 +572,97 @@ HRESULT Orc::YaraScanner::Scan(const std::shared_ptr<ByteStream>& stream, Matchi
     }
 }
 
-HRESULT Orc::YaraScanner::ScanFrom(
+HRESULT Orc::YaraScanner::ScanFileMapping(
     const std::shared_ptr<ByteStream>& stream,
-    DWORD dwMoveMethod,
-    ULONGLONG pos,
-    CBinaryBuffer& buffer,
     MatchingRuleCollection& matchingRules,
     ULONG& bytesScanned)
 {
     HRESULT hr = E_FAIL;
 
-    if (FAILED(hr = stream->SetFilePointer(pos, dwMoveMethod, NULL)))
+    // regular files are mapped read only: pages are read from the file and nothing is committed
+    if (auto fileStream = std::dynamic_pointer_cast<FileStream>(stream);
+        fileStream && fileStream->GetHandle() != INVALID_HANDLE_VALUE)
     {
-        log::Error(_L_, hr, L"Failed to move inside stream for yara scan\r\n");
-        return hr;
-    }
+        MatchingRuleCollection mappedRules;
+        if (SUCCEEDED(hr = ScanMappedFile(fileStream->GetHandle(), stream->GetSize(), mappedRules)))
+        {
+            matchingRules.insert(end(matchingRules), begin(mappedRules), end(mappedRules));
+            bytesScanned = static_cast<ULONG>(std::min<ULONGLONG>(stream->GetSize(), MAXULONG));
+            return S_OK;
+        }
+        if (hr == HRESULT_FROM_WIN32(ERROR_TIMEOUT))
+            return hr;
 
-    ULONGLONG leftToRead = buffer.GetCount();
-    ULONGLONG bytesRead = 0L;
+        log::Verbose(_L_, L"Failed to scan a read only mapping of the file, reading it instead (hr=0x%lx)\r\n", hr);
+    }
 
-    while (leftToRead > 0)
+    // other streams (files of images, of volumes...) cannot be mapped: they are read into a single view so that
+    // filesize, module data and offsets are the same as for a mapped file
+    if (stream->GetSize() <= MAX_STREAM_VIEW)
     {
-        ULONGLONG ullBytesRead = 0LL;
-        if (FAILED(
-                hr = stream->Read(buffer.GetP<BYTE>(static_cast<size_t>(bytesRead)), (UINT)leftToRead, &ullBytesRead)))
-        {
-            log::Error(_L_, hr, L"Failed to read %d bytes from stream for yara scan\r\n", buffer.GetCount());
-            break;
-        }
+        Semaphore::ScopedLock slot(m_StreamViewSlots);
 
-        if (ullBytesRead == 0)
-            break;
+        if (FAILED(hr = stream->SetFilePointer(0LL, FILE_BEGIN, nullptr)))
+            return hr;
 
-        bytesRead += ullBytesRead;
-        leftToRead -= ullBytesRead;
+        auto [hrView, memstream] = GetMemoryStream(stream);
+        if (FAILED(hr = hrView))
+            return hr;
+        if (!memstream)
+            return E_FAIL;
+
+        // the view does not take the buffer: a memory stream scanned this way is left untouched
+        const auto view = memstream->GetConstBuffer();
+        const auto cbView = static_cast<size_t>(std::min<ULONGLONG>(view.GetCount(), stream->GetSize()));
+
+        if (FAILED(hr = ScanMemory(view.GetP<const uint8_t>(), cbView, matchingRules)))
+            return hr;
+
+        bytesScanned = static_cast<ULONG>(cbView);
+        return S_OK;
     }
 
-    if (FAILED(hr = Scan(buffer, static_cast<ULONG>(bytesRead), matchingRules)))
+    log::Warning(
+        _L_,
+        L"Stream too large to be scanned at once (size:%I64d), scanning it by blocks: filesize, modules and offsets "
+        L"apply to each block\r\n",
+        stream->GetSize());
+
+    if (FAILED(hr = Scan(stream, m_config.blockSize(), m_config.overlapSize(), matchingRules)))
     {
-        log::Error(_L_, hr, L"Yara scan failed\r\n");
-        bytesScanned = 0L;
+        log::Error(_L_, hr, L"Failed to scan stream content by blocks (size:%I64d)\r\n", stream->GetSize());
         return hr;
     }
-    bytesScanned = static_cast<ULONG>(bytesRead);
+
+    bytesScanned = static_cast<ULONG>(std::min<ULONGLONG>(stream->GetSize(), MAXULONG));
     return S_OK;
 }
 
-HRESULT Orc::YaraScanner::ScanFileMapping(
-    const std::shared_ptr<ByteStream>& stream,
-    MatchingRuleCollection& matchingRules,
-    ULONG& bytesScanned)
+HRESULT Orc::YaraScanner::ScanMappedFile(HANDLE hFile, ULONGLONG ullSize, MatchingRuleCollection& matchingRules)
 {
-    auto fmstream = std::make_shared<FileMappingStream>(_L_);
-    if (!fmstream)
-        return E_POINTER;
+    if (ullSize == 0LL || ullSize > MAXSIZE_T)
+        return E_INVALIDARG;
 
-    HRESULT hr = fmstream->Open(INVALID_HANDLE_VALUE, PAGE_READWRITE, stream->GetSize(), L"YaraScan");
-    if (FAILED(hr))
-    {
-        log::Error(_L_, hr, L"Failed to create pagefile backed filemapping (size:%I64d)\r\n", stream->GetSize());
-        return hr;
-    }
+    // pages of a remote file that fail to load would raise in page errors in the middle of the scan
+    FILE_REMOTE_PROTOCOL_INFO remoteInfo;
+    if (GetFileInformationByHandleEx(hFile, FileRemoteProtocolInfo, &remoteInfo, sizeof(remoteInfo)))
+        return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
 
-    ULONGLONG ullBytesCopied = 0LL;
-    if (FAILED(hr = stream->CopyTo(fmstream, &ullBytesCopied)))
-    {
-        log::Error(
-            _L_,
-            hr,
-            L"Failed to copy file into file mapping (size:%I64d, copied:%I64d)\r\n",
-            stream->GetSize(),
-            ullBytesCopied);
-        return hr;
-    }
+    HANDLE hMapping = CreateFileMapping(hFile, NULL, PAGE_READONLY, 0L, 0L, NULL);
+    if (hMapping == NULL)
+        return HRESULT_FROM_WIN32(GetLastError());
 
-    if (ullBytesCopied != stream->GetSize())
-    {
-        log::Error(
-            _L_,
-            hr,
-            L"Failed to copy all file content into file mapping (size:%I64d, copied:%I64d)\r\n",
-            stream->GetSize(),
-            ullBytesCopied);
-        return hr;
-    }
+    BOOST_SCOPE_EXIT(&hMapping) { CloseHandle(hMapping); }
+    BOOST_SCOPE_EXIT_END;
 
-    auto buffer = fmstream->GetMappedData();
+    auto pView = static_cast<const uint8_t*>(MapViewOfFile(hMapping, FILE_MAP_READ, 0L, 0L, 0L));
+    if (pView == nullptr)
+        return HRESULT_FROM_WIN32(GetLastError());
 
-    if (buffer.GetCount() == ullBytesCopied)  // all good
-    {
-        if (FAILED(hr = Scan(buffer, matchingRules)))
-        {
-            log::Error(_L_, hr, L"Failed to scan file content in file mapping\r\n", stream->GetSize(), ullBytesCopied);
-            return hr;
-        }
-    }
-    else
-    {
-        log::Error(
-            _L_,
-            hr = HRESULT_FROM_WIN32(ERROR_INVALID_DATA),
-            L"Failed to scan file content in file mapping\r\n",
-            stream->GetSize(),
-            ullBytesCopied);
-        return hr;
-    }
-    return S_OK;
+    BOOST_SCOPE_EXIT(&pView) { UnmapViewOfFile(pView); }
+    BOOST_SCOPE_EXIT_END;
+
+    return ScanMemory(pView, static_cast<size_t>(ullSize), matchingRules);
 }
 
 HRESULT Orc::YaraScanner::Scan(
@@ -624,71 +682,218 @@ HRESULT Orc::YaraScanner::Scan(
     if (FAILED(hr = stream->SetFilePointer(0, FILE_BEGIN, NULL)))
         return hr;
 
-    CBinaryBuffer buffer(true);
-    buffer.SetCount(blockSize);
+    // rules are compiled before the worker threads need them
+    if (GetRules() == nullptr)
+        return E_UNEXPECTED;
 
-    CBinaryBuffer overlap(true);
-    overlap.SetCount(overlapSize);
+    const size_t batchSize = std::max<size_t>(
+        1,
+        std::min<size_t>(
+            {Concurrency::GetProcessorCount(),
+             static_cast<size_t>(MAX_CONCURRENT_SCANS),
+             static_cast<size_t>(PARALLEL_SCAN_MEMORY / blockSize)}));
 
-    bool scanOverlapFlag = false;
-    UINT overlapCurrentSize = 0L;
-    UINT sizeToCopy = 0L;
-    UINT posInBuffer = 0L;
+    std::vector<ParallelBlock> blocks(batchSize);
+    for (auto& block : blocks)
+    {
+        if (!block.Buffer.SetCount(blockSize) || !block.Overlap.SetCount(overlapSize))
+            return E_OUTOFMEMORY;
+    }
 
-    while (ullBytesScanned < ullBytesToScan)
+    // end of the last block read, scanned with the beginning of the next one
+    const ULONG halfOverlap = overlapSize / 2;
+    CBinaryBuffer tail;
+    if (!tail.SetCount(std::max<ULONG>(halfOverlap, 1)))
+        return E_OUTOFMEMORY;
+    ULONG tailBytes = 0L;
+    bool bPreviousBlock = false;
+
+    // Full blocks within holes of the stream are all zeroes and would all match the same rules: they are not read
+    // and only the first one is scanned. Their overlaps with the blocks around them are still scanned.
+    std::vector<ByteStream::DataRange> ranges;
+    if (stream->GetDataRanges(ranges) != S_OK)
+        ranges.clear();
+
+    CBinaryBuffer zeroes(true);
+    bool bZeroBlockScanned = false;
+
+    bool bEndOfStream = false;
+    while (!bEndOfStream && ullBytesScanned < ullBytesToScan)
     {
-        ULONG bytes = 0L;
-        if (FAILED(hr = ScanFrom(stream, FILE_CURRENT, 0LL, buffer, matchingRules, bytes)))
+        size_t count = 0;
+        for (; count < batchSize && ullBytesScanned < ullBytesToScan; count++)
         {
-            log::Error(_L_, hr, L"Stream yara scan failed\r\n");
-            return hr;
-        }
-        if (bytes == 0)  // we have reached a (portentially unexpected) end of file
-            return S_OK;
+            auto& block = blocks[count];
+            block.Rules.clear();
+            block.OverlapRules.clear();
+            block.hr = block.hrOverlap = S_OK;
 
-        // Saving beginning of block in end of overlap buffer
-        sizeToCopy = std::min(bytes, overlapSize / 2);
-        if (auto err = memcpy_s(overlap.GetP<BYTE>(overlapCurrentSize), sizeToCopy, buffer.GetP<BYTE>(), sizeToCopy))
-        {
-            log::Error(_L_, E_INVALIDARG, L"Error executing memcpy_s.\r\n");
-        }
-        overlapCurrentSize += sizeToCopy;
+            if (ullBytesToScan - ullBytesScanned >= blockSize && IsInHole(ranges, ullBytesScanned, blockSize))
+            {
+                if (FAILED(hr = stream->SetFilePointer(ullBytesScanned + blockSize, FILE_BEGIN, NULL)))
+                    return hr;
+
+                if (zeroes.GetCount() == 0)
+                {
+                    if (!zeroes.SetCount(blockSize))
+                        return E_OUTOFMEMORY;
+                    ZeroMemory(zeroes.GetData(), blockSize);
+                }
+
+                block.Data = &zeroes;
+                block.Bytes = blockSize;
+                block.bScan = !bZeroBlockScanned;
+                bZeroBlockScanned = true;
+            }
+            else
+            {
+                // what could be read before a failure is still scanned
+                if (FAILED(hr = ReadBlock(stream, block.Buffer, block.Bytes)))
+                    log::Error(_L_, hr, L"Failed to read %d bytes from stream for yara scan\r\n", blockSize);
+                block.Data = &block.Buffer;
+                block.bScan = true;
+            }
 
-        // Scan overlap (but not the first time)
-        if (scanOverlapFlag == true)
-        {
-            if (FAILED(hr = Scan(overlap, overlapCurrentSize, matchingRules)))
+            if (block.Bytes == 0)  // we have reached a (portentially unexpected) end of file
             {
-                log::Error(_L_, hr, L"Stream yara overlap scan failed\r\n");
-                return hr;
+                bEndOfStream = true;
+                break;
             }
-            overlapCurrentSize = 0L;
-        }
-        else
-        {
-            scanOverlapFlag = true;
+
+            // overlap is the end of the previous block followed by the beginning of this one
+            block.bScanOverlap = bPreviousBlock;
+            if (bPreviousBlock)
+            {
+                const ULONG headBytes = std::min(block.Bytes, halfOverlap);
+                CopyMemory(block.Overlap.GetData(), tail.GetData(), tailBytes);
+                CopyMemory(block.Overlap.GetP<BYTE>(tailBytes), block.Data->GetData(), headBytes);
+                block.OverlapBytes = tailBytes + headBytes;
+            }
+
+            tailBytes = std::min(block.Bytes, halfOverlap);
+            CopyMemory(tail.GetData(), block.Data->GetP<BYTE>(block.Bytes - tailBytes), tailBytes);
+            bPreviousBlock = true;
+
+            ullBytesScanned += block.Bytes;
         }
 
-        // Saving end of block in beginning of overlap buffer
-        // Useless if bytes <= blocksize
-        if (bytes < overlapSize / 2)
+        Concurrency::parallel_for(size_t(0), count * 2, [this, &blocks](size_t i) {
+            auto& block = blocks[i / 2];
+            if (i % 2 == 0)
+            {
+                if (block.bScan)
+                    block.hr = Scan(*block.Data, block.Bytes, block.Rules);
+            }
+            else if (block.bScanOverlap)
+                block.hrOverlap = Scan(block.Overlap, block.OverlapBytes, block.OverlapRules);
+        });
+
+        // each block's matches, then its overlap's, as a scan of the blocks one after the other would find them
+        for (size_t i = 0; i < count; i++)
         {
-            sizeToCopy = bytes;
-            posInBuffer = 0;
+            auto& block = blocks[i];
+            if (FAILED(block.hr))
+            {
+                log::Error(_L_, block.hr, L"Stream yara scan failed\r\n");
+                return block.hr;
+            }
+            if (FAILED(block.hrOverlap))
+            {
+                log::Error(_L_, block.hrOverlap, L"Stream yara overlap scan failed\r\n");
+                return block.hrOverlap;
+            }
+            matchingRules.insert(end(matchingRules), begin(block.Rules), end(block.Rules));
+            matchingRules.insert(end(matchingRules), begin(block.OverlapRules), end(block.OverlapRules));
         }
-        else
+    }
+
+    return S_OK;
+}
+
+HRESULT Orc::YaraScanner::Scan(
+    const std::vector<std::shared_ptr<ByteStream>>& streams,
+    std::vector<MatchingRuleCollection>& matchingRules)
+{
+    if (GetRules() == nullptr)
+        return E_UNEXPECTED;
+
+    matchingRules.clear();
+    matchingRules.resize(streams.size());
+
+    std::vector<HRESULT> results(streams.size(), S_OK);
+
+    Concurrency::parallel_for(size_t(0), streams.size(), [this, &streams, &matchingRules, &results](size_t i) {
+        if (streams[i] == nullptr)
+            results[i] = E_POINTER;
+        else if (SUCCEEDED(results[i] = streams[i]->SetFilePointer(0LL, FILE_BEGIN, NULL)))
+            results[i] = Scan(streams[i], matchingRules[i]);
+    });
+
+    HRESULT hr = S_OK;
+    for (size_t i = 0; i < streams.size(); i++)
+    {
+        if (FAILED(results[i]))
         {
-            sizeToCopy = overlapSize / 2;
-            posInBuffer = bytes - sizeToCopy;
+            log::Error(_L_, results[i], L"Failed to yara scan stream %Iu of %Iu\r\n", i, streams.size());
+            if (SUCCEEDED(hr))
+                hr = results[i];
         }
-        if (auto err = memcpy_s(overlap.GetP<BYTE>(), sizeToCopy, buffer.GetP<BYTE>(posInBuffer), sizeToCopy))
+    }
+    return hr;
+}
+
+HRESULT Orc::YaraScanner::ScanOverlap(
+    const CBinaryBuffer& block,
+    ULONG bytes,
+    BlockScanState& state,
+    MatchingRuleCollection& matchingRules)
+{
+    HRESULT hr = E_FAIL;
+
+    const ULONG overlapSize = state.OverlapSize;
+    CBinaryBuffer& overlap = state.Overlap;
+
+    // Saving beginning of block in end of overlap buffer
+    UINT sizeToCopy = std::min(bytes, overlapSize / 2);
+    UINT posInBuffer = 0L;
+    if (auto err = memcpy_s(overlap.GetP<BYTE>(state.OverlapCurrentSize), sizeToCopy, block.GetP<BYTE>(), sizeToCopy))
+    {
+        log::Error(_L_, E_INVALIDARG, L"Error executing memcpy_s.\r\n");
+    }
+    state.OverlapCurrentSize += sizeToCopy;
+
+    // Scan overlap (but not the first time)
+    if (state.ScanOverlapFlag == true)
+    {
+        if (FAILED(hr = Scan(overlap, state.OverlapCurrentSize, matchingRules)))
         {
-            log::Error(_L_, E_INVALIDARG, L"Error executing memcpy_s.\r\n");
+            log::Error(_L_, hr, L"Stream yara overlap scan failed\r\n");
+            return hr;
         }
-        overlapCurrentSize = sizeToCopy;
+        state.OverlapCurrentSize = 0L;
+    }
+    else
+    {
+        state.ScanOverlapFlag = true;
+    }
 
-        ullBytesScanned += bytes;
+    // Saving end of block in beginning of overlap buffer
+    // Useless if bytes <= blocksize
+    if (bytes < overlapSize / 2)
+    {
+        sizeToCopy = bytes;
+        posInBuffer = 0;
+    }
+    else
+    {
+        sizeToCopy = overlapSize / 2;
+        posInBuffer = bytes - sizeToCopy;
+    }
+    if (auto err = memcpy_s(overlap.GetP<BYTE>(), sizeToCopy, block.GetP<BYTE>(posInBuffer), sizeToCopy))
+    {
+        log::Error(_L_, E_INVALIDARG, L"Error executing memcpy_s.\r\n");
     }
+    state.OverlapCurrentSize = sizeToCopy;
 
     return S_OK;
 }
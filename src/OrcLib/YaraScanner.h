@@ -8,6 +8,11 @@
 #pragma once
 
 #include "YaraStaticExtension.h"
+#include "Semaphore.h"
+
+#include "yara/limits.h"
+
+#include <concrt.h>
 
 #include <chrono>
 #include <optional>
@@ -26,6 +31,9 @@ using namespace std::chrono_literals;
 
 class YaraScanner;
 
+// Blocks: streams larger than a block are scanned block by block, each overlap between two blocks being scanned too
+// FileMapping: files are mapped and scanned at once, other streams (files of images or volumes...) are read into
+// memory and scanned at once up to YaraScanner::MAX_STREAM_VIEW bytes, larger ones are scanned as with Blocks
 enum class YaraScanMethod
 {
     Blocks,
@@ -110,9 +118,19 @@ private:
     std::optional<YaraScanMethod> _scanMethod;
 };
 
+// Rules are compiled once and shared by all the scans: a scanner can be used from several threads at once, each scan
+// taking one of yara's scan slots for its duration. Rules must not be enabled or disabled while scans are running.
 class YaraScanner
 {
 public:
+    // yara tracks the state of each running scan in a slot of the compiled rules
+    static constexpr LONG MAX_CONCURRENT_SCANS = YR_MAX_THREADS;
+    // Memory of the blocks read ahead and scanned concurrently by a block scan
+    static constexpr ULONGLONG PARALLEL_SCAN_MEMORY = 256 * 1024 * 1024;
+    // Largest stream that cannot be mapped read into memory to be scanned at once, and how many are held at once
+    static constexpr ULONGLONG MAX_STREAM_VIEW = PARALLEL_SCAN_MEMORY;
+    static constexpr LONG MAX_CONCURRENT_STREAM_VIEWS = 2;
+
     YaraScanner(logger pLog)
         : _L_(std::move(pLog))
     {
@@ -132,12 +150,41 @@ public:
 
     HRESULT SetTimeOut(const TimeOut& timeout);
 
+    const YaraConfig& Config() const { return m_config; }
+
+    // State of a stream scanned block after block: the end of a block and the beginning of the next one are also
+    // scanned together so that matches across block boundaries are not missed
+    struct BlockScanState
+    {
+        BlockScanState(ULONG overlapSize)
+            : Overlap(true)
+            , OverlapSize(overlapSize)
+        {
+            Overlap.SetCount(overlapSize);
+        }
+
+        CBinaryBuffer Overlap;
+        ULONG OverlapSize = 0L;
+        UINT OverlapCurrentSize = 0L;
+        bool ScanOverlapFlag = false;
+    };
+
+    // Scans the overlap of a block with the previous one, the block itself is scanned by the caller
+    // Blocks must come in order and all be full except the last one
+    HRESULT ScanOverlap(
+        const CBinaryBuffer& block,
+        ULONG bytes,
+        BlockScanState& state,
+        MatchingRuleCollection& matchingRules);
+
     HRESULT Scan(const CBinaryBuffer& buffer, ULONG bytesToScan, MatchingRuleCollection& matchingRules);
     HRESULT Scan(const CBinaryBuffer& buffer, MatchingRuleCollection& matchingRules)
     {
         return Scan(buffer, (ULONG)buffer.GetCount(), matchingRules);
     }
     HRESULT Scan(const std::shared_ptr<ByteStream>& stream, MatchingRuleCollection& matchingRules);
+    // Blocks are read in order by the calling thread and scanned, together with their overlaps, by batches on the
+    // worker threads. Matching rules are reported in the same order as when the blocks are scanned one by one.
     HRESULT Scan(
         const std::shared_ptr<ByteStream>& stream,
         ULONG blockSize,
@@ -145,6 +192,12 @@ public:
         MatchingRuleCollection& matchingRules);
     HRESULT Scan(const LPCWSTR& szFileName, MatchingRuleCollection& matchingRules);
 
+    // Scans the streams concurrently, matchingRules[i] receives the rules matched in streams[i]
+    // The streams are scanned by the worker threads as they become available, each stream by one thread at a time
+    HRESULT Scan(
+        const std::vector<std::shared_ptr<ByteStream>>& streams,
+        std::vector<MatchingRuleCollection>& matchingRules);
+
     std::pair<HRESULT, MatchingRuleCollection> Scan(const CBinaryBuffer& buffer, ULONG bytesToScan)
     {
         MatchingRuleCollection matchingRules;
@@ -203,17 +256,16 @@ private:
     static inline size_t read(void* ptr, size_t size, size_t count, void* user_data);
     static inline size_t write(const void* ptr, size_t size, size_t count, void* user_data);
 
-    HRESULT ScanFrom(
-        const std::shared_ptr<ByteStream>& stream,
-        DWORD dwMoveMethod,
-        ULONGLONG pos,
-        CBinaryBuffer& buffer,
-        MatchingRuleCollection& matchingRules,
-        ULONG& bytesScanned);
+    HRESULT ScanMemory(const uint8_t* pData, size_t cbData, MatchingRuleCollection& matchingRules);
+    HRESULT ScanResult(int result);
+
+    // Scans the whole stream at once without copying it when it is a regular file, mapped read only
+    // Other streams are read into memory and scanned at once up to MAX_STREAM_VIEW, as with the Blocks method above
     HRESULT ScanFileMapping(
         const std::shared_ptr<ByteStream>& stream,
         MatchingRuleCollection& matchingRules,
         ULONG& bytesScanned);
+    HRESULT ScanMappedFile(HANDLE hFile, ULONGLONG ullSize, MatchingRuleCollection& matchingRules);
 
     std::pair<HRESULT, std::shared_ptr<MemoryStream>> GetMemoryStream(const std::shared_ptr<ByteStream>& byteStream);
     std::unique_ptr<YR_STREAM> GetYaraStream(const std::shared_ptr<ByteStream>& byteStream);
@@ -226,7 +278,10 @@ private:
     YaraConfig m_config;
 
     YR_COMPILER* m_pCompiler = nullptr;
+    Concurrency::critical_section m_RulesLock;
     YR_RULES* m_pRules = nullptr;
+    Semaphore m_ScanSlots{MAX_CONCURRENT_SCANS};
+    Semaphore m_StreamViewSlots{MAX_CONCURRENT_STREAM_VIEWS};
     ULONG m_ErrorCount = 0;
     ULONG m_WarningCount = 0;
 };
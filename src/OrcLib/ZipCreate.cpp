@@ -25,6 +25,10 @@
 #include "TemporaryStream.h"
 #include "CryptoHashStream.h"
 #include "XORStream.h"
+#include "PipeStream.h"
+#include "MemoryStream.h"
+#include "ByteStreamVisitor.h"
+#include "ZipStreamWriter.h"
 #include "InByteStreamWrapper.h"
 #include "OutByteStreamWrapper.h"
 
@@ -73,6 +77,29 @@ void StoreFileHashes(Archive::ArchiveItems& items, bool releaseInputStreams, Orc
     }
 }
 
+class PendingStreamVisitor : public Orc::ByteStreamVisitor
+{
+public:
+    void Visit(PipeStream& stream) override { m_bPending = !stream.DataIsAvailable(); }
+    void Visit(MemoryStream& stream) override { m_bPending = stream.GetSize() == 0; }
+
+    bool IsPending() const { return m_bPending; }
+
+private:
+    bool m_bPending = false;
+};
+
+// Same rule as ArchiveUpdateCallback: pipes without data and empty memory streams wait for a later flush
+bool IsPending(const Archive::ArchiveItem& item)
+{
+    if (item.Stream == nullptr)
+        return false;
+
+    PendingStreamVisitor visitor;
+    item.Stream->Accept(visitor);
+    return visitor.IsPending();
+}
+
 }  // namespace
 
 ZipCreate::ZipCreate(logger pLog, bool bComputeHash, DWORD XORPattern)
@@ -191,10 +218,112 @@ HRESULT ZipCreate::SetCompressionLevel(__in const std::wstring& strLevel)
     return S_OK;
 }
 
+STDMETHODIMP ZipCreate::Internal_AppendQueue(bool bFinal)
+{
+    HRESULT hr = E_FAIL;
+
+    if (m_StreamWriter == nullptr)
+    {
+        m_StreamWriter =
+            std::make_unique<ZipStreamWriter>(_L_, m_ArchiveStream, static_cast<UINT>(m_CompressionLevel));
+    }
+
+    ArchiveItems queued;
+    {
+        concurrency::critical_section::scoped_lock sl(m_cs);
+        std::swap(queued, m_Queue);
+    }
+
+    ArchiveItems added;
+    ArchiveItems deferred;
+
+    for (auto& item : queued)
+    {
+        if (!bFinal && IsPending(item))
+        {
+            deferred.push_back(std::move(item));
+            continue;
+        }
+
+        if (item.Stream == nullptr)
+        {
+            log::Error(_L_, E_POINTER, L"Failed to archive %s (no stream)\r\n", item.NameInArchive.c_str());
+            continue;
+        }
+
+        item.currentStatus = ArchiveItem::Status::Processing;
+
+        const auto entries = m_StreamWriter->GetEntryCount();
+        if (FAILED(hr = m_StreamWriter->AddEntry(item.NameInArchive, item.Stream)))
+        {
+            if (m_StreamWriter->GetEntryCount() == entries)
+            {
+                log::Error(
+                    _L_, hr, L"Failed to append %s to %s\r\n", item.NameInArchive.c_str(), m_ArchiveName.c_str());
+                return hr;
+            }
+            // the entry holds what could be read before the error
+            log::Error(_L_, hr, L"Failed to archive %s\r\n", item.NameInArchive.c_str());
+        }
+        else
+        {
+            log::Verbose(_L_, L"INFO: Archive of %s succeed\r\n", item.NameInArchive.c_str());
+        }
+
+        item.Index = static_cast<UINT>(m_StreamWriter->GetEntryCount() - 1);
+        item.currentStatus = ArchiveItem::Status::Done;
+        added.push_back(std::move(item));
+    }
+
+    if (!deferred.empty())
+    {
+        concurrency::critical_section::scoped_lock sl(m_cs);
+        m_Queue.insert(begin(m_Queue), make_move_iterator(begin(deferred)), make_move_iterator(end(deferred)));
+    }
+
+    const bool kReleaseInputStreams = true;
+    StoreFileHashes(added, kReleaseInputStreams, _L_);
+
+    m_Items.reserve(m_Items.size() + added.size());
+    for (auto& item : added)
+    {
+        m_Indexes[item.Index] = m_Items.size();
+        m_Items.push_back(std::move(item));
+
+        if (m_Callback)
+            m_Callback(m_Items.back());
+    }
+
+    if (bFinal)
+    {
+        for (const auto& item : m_Queue)
+        {
+            log::Warning(
+                _L_,
+                S_OK,
+                L"Queued item %s was not included in archive (Size=%I64d bytes)\r\n",
+                item.NameInArchive.c_str(),
+                item.Stream != nullptr ? item.Stream->GetSize() : 0LL);
+        }
+
+        if (FAILED(hr = m_StreamWriter->Close()))
+        {
+            log::Error(_L_, hr, L"Failed to complete %s\r\n", m_ArchiveName.c_str());
+            return hr;
+        }
+    }
+    return S_OK;
+}
+
 STDMETHODIMP ZipCreate::Internal_FlushQueue(bool bFinal)
 {
     HRESULT hr = E_FAIL;
 
+    // Appending avoids rewriting the whole archive at each flush, 7zip's update rewrites it (7z format and encrypted
+    // zip archives)
+    if (m_FormatGUID == CLSID_CFormatZip && m_Password.empty())
+        return Internal_AppendQueue(bFinal);
+
     const auto pZipLib = ZipLibrary::GetZipLibrary(_L_);
     if (pZipLib == nullptr)
     {
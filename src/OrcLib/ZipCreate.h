@@ -21,6 +21,7 @@ namespace Orc {
 
 class ZipLibrary;
 class TemporaryStream;
+class ZipStreamWriter;
 
 class ORCLIB_API ZipCreate : public ArchiveCreate
 {
@@ -62,11 +63,15 @@ private:
     GUID m_FormatGUID;
     CompressionLevel m_CompressionLevel;
 
+    // Zip archives without password are written front to back, entries are appended as they are flushed
+    std::unique_ptr<ZipStreamWriter> m_StreamWriter;
+
     ZipCreate(logger pLo, bool bComputeHash = false, DWORD XORPattern = 0x00000000);
 
     STDMETHOD(SetCompressionLevel)(const CComPtr<IOutArchive>& pArchiver, CompressionLevel level);
 
     STDMETHOD(Internal_FlushQueue)(bool bFinal);
+    STDMETHOD(Internal_AppendQueue)(bool bFinal);
 };
 
 }  // namespace Orc
@@ -64,9 +64,11 @@ STDMETHODIMP ZipExtract::Extract(
         return E_FAIL;
     }
 
+    const GUID formatGUID = m_Format == ArchiveFormat::Zip ? CLSID_CFormatZip : CLSID_CFormat7z;
+
     CComPtr<IInArchive> archive;
 
-    if (FAILED(hr = pZipLib->CreateObject(&CLSID_CFormat7z, &IID_IInArchive, reinterpret_cast<void**>(&archive))))
+    if (FAILED(hr = pZipLib->CreateObject(&formatGUID, &IID_IInArchive, reinterpret_cast<void**>(&archive))))
     {
         log::Error(_L_, hr, L"Failed to create archive reader\r\n");
         return hr;
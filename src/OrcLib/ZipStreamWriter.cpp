@@ -0,0 +1,579 @@
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+//
+// Copyright © 2011-2019 ANSSI. All Rights Reserved.
+//
+// Author(s): Jean Gautier (ANSSI)
+//
+#include "stdafx.h"
+
+#include <7zip/7zip.h>
+#include "ZipStreamWriter.h"
+
+#include "7zip/ICoder.h"
+#include "7zip/IStream.h"
+
+#include "ByteStream.h"
+#include "ByteStreamVisitor.h"
+#include "CryptoHashStream.h"
+#include "FileStream.h"
+#include "FuzzyHashStream.h"
+#include "MemoryStream.h"
+#include "NTFSStream.h"
+#include "ResourceStream.h"
+#include "TemporaryStream.h"
+#include "UncompressNTFSStream.h"
+#include "XORStream.h"
+#include "ZipLibrary.h"
+#include "PropVariant.h"
+#include "WideAnsi.h"
+
+#include <array>
+
+using namespace lib7z;
+
+using namespace Orc;
+
+namespace {
+
+// 7-Zip's deflate encoder: codec class ids are the 7-Zip prefix, the encoder marker and the method id (04 01 08)
+const GUID CLSID_DeflateEncoder = {0x23170F69, 0x40C1, 0x2791, {0x08, 0x01, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00}};
+
+constexpr DWORD LOCAL_HEADER_SIGNATURE = 0x04034b50;
+constexpr DWORD DATA_DESCRIPTOR_SIGNATURE = 0x08074b50;
+constexpr DWORD CENTRAL_HEADER_SIGNATURE = 0x02014b50;
+constexpr DWORD ZIP64_END_SIGNATURE = 0x06064b50;
+constexpr DWORD ZIP64_LOCATOR_SIGNATURE = 0x07064b50;
+constexpr DWORD END_SIGNATURE = 0x06054b50;
+
+constexpr WORD ZIP64_EXTRA_ID = 0x0001;
+
+constexpr WORD VERSION_DEFAULT = 20;
+constexpr WORD VERSION_ZIP64 = 45;
+
+constexpr WORD FLAG_DATA_DESCRIPTOR = 0x0008;
+constexpr WORD FLAG_UTF8 = 0x0800;
+
+constexpr WORD METHOD_STORED = 0;
+constexpr WORD METHOD_DEFLATED = 8;
+
+// Entries larger than this may not fit in 32 bits sizes once compressed (deflate can slightly expand its input)
+constexpr ULONGLONG ZIP64_ENTRY_THRESHOLD = 0xFF000000LL;
+
+constexpr size_t STORE_BUFFER_SIZE = 1024 * 1024;
+
+// Tells whether the size of a stream is the number of bytes it will actually deliver
+// Pipes, and streams this writer does not know, may deliver more than they announce: their entries always use zip64
+// sizes in their data descriptor
+class ReliableSizeVisitor : public ByteStreamVisitor
+{
+public:
+    bool IsReliable() const { return m_bReliable; }
+
+    void Visit(ByteStream& element) override { m_bReliable = false; }
+    void Visit(FileStream& element) override { m_bReliable = true; }
+    void Visit(TemporaryStream& element) override { m_bReliable = true; }
+    void Visit(MemoryStream& element) override { m_bReliable = true; }
+    void Visit(ResourceStream& element) override { m_bReliable = true; }
+    void Visit(NTFSStream& element) override { m_bReliable = true; }
+    void Visit(UncompressNTFSStream& element) override { m_bReliable = true; }
+    void Visit(CryptoHashStream& element) override { VisitChained(element); }
+    void Visit(FuzzyHashStream& element) override { VisitChained(element); }
+    void Visit(XORStream& element) override { VisitChained(element); }
+
+private:
+    bool m_bReliable = false;
+
+    void VisitChained(ChainingStream& element)
+    {
+        m_bReliable = false;
+        if (element.GetChainedStream() != nullptr)
+            element.GetChainedStream()->Accept(*this);
+    }
+};
+
+template <typename T>
+void Put(std::vector<BYTE>& bytes, T value)
+{
+    for (size_t i = 0; i < sizeof(T); i++)
+        bytes.push_back(static_cast<BYTE>(static_cast<ULONGLONG>(value) >> (8 * i)));
+}
+
+void Put(std::vector<BYTE>& bytes, const std::string& str)
+{
+    bytes.insert(end(bytes), begin(str), end(str));
+}
+
+DWORD Low32(ULONGLONG value)
+{
+    return value >= 0xFFFFFFFF ? 0xFFFFFFFF : static_cast<DWORD>(value);
+}
+
+// CRC-32 (IEEE 802.3) of zip entries, eight bytes at a time
+class CRC32
+{
+public:
+    void Update(const BYTE* pData, size_t cbData)
+    {
+        const auto& table = Table();
+        DWORD crc = m_crc;
+
+        for (; cbData >= 8; pData += 8, cbData -= 8)
+        {
+            const DWORD low = crc
+                ^ (pData[0] | (pData[1] << 8) | (pData[2] << 16) | (static_cast<DWORD>(pData[3]) << 24));
+            crc = table[7][low & 0xFF] ^ table[6][(low >> 8) & 0xFF] ^ table[5][(low >> 16) & 0xFF]
+                ^ table[4][low >> 24] ^ table[3][pData[4]] ^ table[2][pData[5]] ^ table[1][pData[6]]
+                ^ table[0][pData[7]];
+        }
+        for (; cbData > 0; pData++, cbData--)
+            crc = table[0][(crc ^ *pData) & 0xFF] ^ (crc >> 8);
+
+        m_crc = crc;
+    }
+
+    DWORD Value() const { return ~m_crc; }
+
+private:
+    DWORD m_crc = 0xFFFFFFFF;
+
+    using CRCTable = std::array<std::array<DWORD, 256>, 8>;
+
+    static const CRCTable& Table()
+    {
+        static const CRCTable table = []() {
+            CRCTable t;
+            for (DWORD i = 0; i < 256; i++)
+            {
+                DWORD crc = i;
+                for (int bit = 0; bit < 8; bit++)
+                    crc = (crc >> 1) ^ (crc & 1 ? 0xEDB88320 : 0);
+                t[0][i] = crc;
+            }
+            for (DWORD i = 0; i < 256; i++)
+                for (size_t slice = 1; slice < t.size(); slice++)
+                    t[slice][i] = (t[slice - 1][i] >> 8) ^ t[0][t[slice - 1][i] & 0xFF];
+            return t;
+        }();
+        return table;
+    }
+};
+
+// Input of the deflate encoder: computes the CRC of what it reads
+// A read error ends the input (the encoder then completes a valid deflate stream), the error is kept for the caller
+class CRCInStream : public ISequentialInStream
+{
+public:
+    CRCInStream(const std::shared_ptr<ByteStream>& pInput)
+        : m_refCount(0)
+        , m_pInput(pInput)
+    {
+    }
+
+    STDMETHOD(QueryInterface)(REFIID iid, void** ppvObject)
+    {
+        if (iid == __uuidof(IUnknown) || iid == IID_ISequentialInStream)
+        {
+            *ppvObject = static_cast<ISequentialInStream*>(this);
+            AddRef();
+            return S_OK;
+        }
+        return E_NOINTERFACE;
+    }
+    STDMETHOD_(ULONG, AddRef)() { return static_cast<ULONG>(InterlockedIncrement(&m_refCount)); }
+    STDMETHOD_(ULONG, Release)()
+    {
+        ULONG res = static_cast<ULONG>(InterlockedDecrement(&m_refCount));
+        if (res == 0)
+            delete this;
+        return res;
+    }
+
+    STDMETHOD(Read)(void* data, UInt32 size, UInt32* processedSize)
+    {
+        ULONGLONG ullRead = 0LL;
+        if (FAILED(m_hr))
+            size = 0;
+        else if (size > 0 && FAILED(m_hr = m_pInput->Read(data, size, &ullRead)))
+            ullRead = 0LL;
+
+        m_CRC.Update(static_cast<const BYTE*>(data), static_cast<size_t>(ullRead));
+        m_ullBytesRead += ullRead;
+
+        if (processedSize != nullptr)
+            *processedSize = static_cast<UInt32>(ullRead);
+        return S_OK;
+    }
+
+    DWORD CRC() const { return m_CRC.Value(); }
+    ULONGLONG BytesRead() const { return m_ullBytesRead; }
+    HRESULT ReadError() const { return m_hr; }
+
+private:
+    long m_refCount;
+    std::shared_ptr<ByteStream> m_pInput;
+    CRC32 m_CRC;
+    ULONGLONG m_ullBytesRead = 0LL;
+    HRESULT m_hr = S_OK;
+};
+
+// Output of the deflate encoder: counts what is written to the archive
+class CountingOutStream : public ISequentialOutStream
+{
+public:
+    CountingOutStream(const std::shared_ptr<ByteStream>& pOutput)
+        : m_refCount(0)
+        , m_pOutput(pOutput)
+    {
+    }
+
+    STDMETHOD(QueryInterface)(REFIID iid, void** ppvObject)
+    {
+        if (iid == __uuidof(IUnknown) || iid == IID_ISequentialOutStream)
+        {
+            *ppvObject = static_cast<ISequentialOutStream*>(this);
+            AddRef();
+            return S_OK;
+        }
+        return E_NOINTERFACE;
+    }
+    STDMETHOD_(ULONG, AddRef)() { return static_cast<ULONG>(InterlockedIncrement(&m_refCount)); }
+    STDMETHOD_(ULONG, Release)()
+    {
+        ULONG res = static_cast<ULONG>(InterlockedDecrement(&m_refCount));
+        if (res == 0)
+            delete this;
+        return res;
+    }
+
+    STDMETHOD(Write)(const void* data, UInt32 size, UInt32* processedSize)
+    {
+        HRESULT hr = S_OK;
+        ULONGLONG ullWritten = 0LL;
+        if (size > 0 && FAILED(hr = m_pOutput->Write(const_cast<void*>(data), size, &ullWritten)))
+            return hr;
+
+        m_ullBytesWritten += ullWritten;
+        if (processedSize != nullptr)
+            *processedSize = static_cast<UInt32>(ullWritten);
+        return S_OK;
+    }
+
+    ULONGLONG BytesWritten() const { return m_ullBytesWritten; }
+
+private:
+    long m_refCount;
+    std::shared_ptr<ByteStream> m_pOutput;
+    ULONGLONG m_ullBytesWritten = 0LL;
+};
+
+}  // namespace
+
+ZipStreamWriter::ZipStreamWriter(logger pLog, std::shared_ptr<ByteStream> pOutput, UINT uiLevel)
+    : _L_(std::move(pLog))
+    , m_pOutput(std::move(pOutput))
+    , m_uiLevel(uiLevel)
+{
+}
+
+HRESULT ZipStreamWriter::Write(const std::vector<BYTE>& bytes)
+{
+    HRESULT hr = E_FAIL;
+
+    ULONGLONG ullWritten = 0LL;
+    if (FAILED(hr = m_pOutput->Write((const PVOID)bytes.data(), bytes.size(), &ullWritten)))
+    {
+        log::Error(_L_, hr, L"Failed to write %Iu bytes to zip archive\r\n", bytes.size());
+        return hr;
+    }
+    if (ullWritten != bytes.size())
+    {
+        log::Error(_L_, hr = HRESULT_FROM_WIN32(ERROR_WRITE_FAULT), L"Incomplete write to zip archive\r\n");
+        return hr;
+    }
+
+    m_ullOffset += ullWritten;
+    return S_OK;
+}
+
+HRESULT ZipStreamWriter::AddEntry(const std::wstring& strName, const std::shared_ptr<ByteStream>& pInput)
+{
+    HRESULT hr = E_FAIL;
+
+    if (m_bClosed)
+        return E_NOT_VALID_STATE;
+    if (pInput == nullptr)
+        return E_POINTER;
+
+    Entry entry;
+
+    std::wstring strZipName(strName);
+    std::replace(begin(strZipName), end(strZipName), L'\\', L'/');
+    if (FAILED(hr = WideToAnsi(_L_, strZipName, entry.Name)))
+        return hr;
+    if (entry.Name.size() > MAXWORD)
+        return HRESULT_FROM_WIN32(ERROR_FILENAME_EXCED_RANGE);
+
+    entry.Method = m_uiLevel == 0 ? METHOD_STORED : METHOD_DEFLATED;
+    entry.Offset = m_ullOffset;
+
+    ReliableSizeVisitor sizeVisitor;
+    pInput->Accept(sizeVisitor);
+    entry.bZip64 = !sizeVisitor.IsReliable() || pInput->GetSize() >= ZIP64_ENTRY_THRESHOLD;
+
+    FILETIME now, local;
+    GetSystemTimeAsFileTime(&now);
+    FileTimeToLocalFileTime(&now, &local);
+    FileTimeToDosDateTime(&local, &entry.Date, &entry.Time);
+
+    // sizes and CRC are zero in the local header, they follow the data in the data descriptor
+    std::vector<BYTE> header;
+    Put<DWORD>(header, LOCAL_HEADER_SIGNATURE);
+    Put<WORD>(header, entry.bZip64 ? VERSION_ZIP64 : VERSION_DEFAULT);
+    Put<WORD>(header, FLAG_DATA_DESCRIPTOR | FLAG_UTF8);
+    Put<WORD>(header, entry.Method);
+    Put<WORD>(header, entry.Time);
+    Put<WORD>(header, entry.Date);
+    Put<DWORD>(header, 0L);
+    Put<DWORD>(header, entry.bZip64 ? 0xFFFFFFFF : 0L);
+    Put<DWORD>(header, entry.bZip64 ? 0xFFFFFFFF : 0L);
+    Put<WORD>(header, static_cast<WORD>(entry.Name.size()));
+    Put<WORD>(header, entry.bZip64 ? 20 : 0);
+    Put(header, entry.Name);
+    if (entry.bZip64)
+    {
+        Put<WORD>(header, ZIP64_EXTRA_ID);
+        Put<WORD>(header, 16);
+        Put<ULONGLONG>(header, 0LL);
+        Put<ULONGLONG>(header, 0LL);
+    }
+
+    if (FAILED(hr = Write(header)))
+        return hr;
+
+    HRESULT hrRead = S_OK;
+    if (FAILED(hr = entry.Method == METHOD_STORED ? Store(pInput, entry, hrRead) : Deflate(pInput, entry, hrRead)))
+        return hr;
+
+    if (!entry.bZip64 && (entry.Size >= 0xFFFFFFFF || entry.CompressedSize >= 0xFFFFFFFF))
+    {
+        log::Error(
+            _L_,
+            hr = HRESULT_FROM_WIN32(ERROR_FILE_TOO_LARGE),
+            L"Zip entry %s is larger than its stream announced (%I64d bytes)\r\n",
+            strName.c_str(),
+            entry.Size);
+        return hr;
+    }
+
+    std::vector<BYTE> descriptor;
+    Put<DWORD>(descriptor, DATA_DESCRIPTOR_SIGNATURE);
+    Put<DWORD>(descriptor, entry.CRC);
+    if (entry.bZip64)
+    {
+        Put<ULONGLONG>(descriptor, entry.CompressedSize);
+        Put<ULONGLONG>(descriptor, entry.Size);
+    }
+    else
+    {
+        Put<DWORD>(descriptor, static_cast<DWORD>(entry.CompressedSize));
+        Put<DWORD>(descriptor, static_cast<DWORD>(entry.Size));
+    }
+
+    if (FAILED(hr = Write(descriptor)))
+        return hr;
+
+    m_Entries.push_back(std::move(entry));
+
+    if (FAILED(hrRead))
+    {
+        log::Error(_L_, hrRead, L"Failed to read %s, its zip entry is truncated\r\n", strName.c_str());
+        return hrRead;
+    }
+    return S_OK;
+}
+
+HRESULT ZipStreamWriter::Store(const std::shared_ptr<ByteStream>& pInput, Entry& entry, HRESULT& hrRead)
+{
+    HRESULT hr = E_FAIL;
+
+    std::vector<BYTE> buffer(STORE_BUFFER_SIZE);
+    CRC32 crc;
+
+    for (;;)
+    {
+        ULONGLONG ullRead = 0LL;
+        if (FAILED(hrRead = pInput->Read(buffer.data(), buffer.size(), &ullRead)) || ullRead == 0LL)
+            break;
+
+        crc.Update(buffer.data(), static_cast<size_t>(ullRead));
+
+        ULONGLONG ullWritten = 0LL;
+        if (FAILED(hr = m_pOutput->Write(buffer.data(), ullRead, &ullWritten)))
+        {
+            log::Error(_L_, hr, L"Failed to write %I64d bytes to zip archive\r\n", ullRead);
+            return hr;
+        }
+        if (ullWritten != ullRead)
+        {
+            log::Error(_L_, hr = HRESULT_FROM_WIN32(ERROR_WRITE_FAULT), L"Incomplete write to zip archive\r\n");
+            return hr;
+        }
+
+        m_ullOffset += ullWritten;
+        entry.Size += ullRead;
+    }
+
+    entry.CompressedSize = entry.Size;
+    entry.CRC = crc.Value();
+    return S_OK;
+}
+
+HRESULT ZipStreamWriter::Deflate(const std::shared_ptr<ByteStream>& pInput, Entry& entry, HRESULT& hrRead)
+{
+    HRESULT hr = E_FAIL;
+
+    const auto pZipLib = ZipLibrary::GetZipLibrary(_L_);
+    if (pZipLib == nullptr)
+    {
+        log::Error(_L_, E_FAIL, L"FAILED to load 7zip.dll\r\n");
+        return E_FAIL;
+    }
+
+    CComPtr<ICompressCoder> pEncoder;
+    if (FAILED(
+            hr = pZipLib->CreateObject(
+                &CLSID_DeflateEncoder, &IID_ICompressCoder, reinterpret_cast<void**>(&pEncoder))))
+    {
+        log::Error(_L_, hr, L"Failed to create deflate encoder\r\n");
+        return hr;
+    }
+
+    CComQIPtr<ICompressSetCoderProperties, &IID_ICompressSetCoderProperties> pProperties(pEncoder);
+    if (pProperties != nullptr)
+    {
+        const PROPID propID = NCoderPropID::kLevel;
+        CPropVariant level = static_cast<UInt32>(m_uiLevel);
+        if (FAILED(hr = pProperties->SetCoderProperties(&propID, &level, 1)))
+            log::Warning(_L_, hr, L"Failed to set deflate compression level %d\r\n", m_uiLevel);
+    }
+
+    CComPtr<CRCInStream> pIn = new CRCInStream(pInput);
+    CComPtr<CountingOutStream> pOut = new CountingOutStream(m_pOutput);
+
+    hr = pEncoder->Code(pIn, pOut, nullptr, nullptr, nullptr);
+
+    m_ullOffset += pOut->BytesWritten();
+    entry.Size = pIn->BytesRead();
+    entry.CompressedSize = pOut->BytesWritten();
+    entry.CRC = pIn->CRC();
+    hrRead = pIn->ReadError();
+
+    if (hr != S_OK)
+    {
+        log::Error(_L_, hr, L"Failed to deflate zip entry\r\n");
+        return FAILED(hr) ? hr : E_FAIL;
+    }
+    return S_OK;
+}
+
+HRESULT ZipStreamWriter::Close()
+{
+    HRESULT hr = E_FAIL;
+
+    if (m_bClosed)
+        return S_OK;
+    m_bClosed = true;
+
+    const ULONGLONG ullDirectoryOffset = m_ullOffset;
+
+    std::vector<BYTE> directory;
+    for (const auto& entry : m_Entries)
+    {
+        const bool bZip64Size = entry.Size >= 0xFFFFFFFF || entry.CompressedSize >= 0xFFFFFFFF;
+        const bool bZip64Offset = entry.Offset >= 0xFFFFFFFF;
+
+        std::vector<BYTE> extra;
+        if (bZip64Size || bZip64Offset)
+        {
+            Put<WORD>(extra, ZIP64_EXTRA_ID);
+            Put<WORD>(extra, static_cast<WORD>((bZip64Size ? 16 : 0) + (bZip64Offset ? 8 : 0)));
+            if (bZip64Size)
+            {
+                Put<ULONGLONG>(extra, entry.Size);
+                Put<ULONGLONG>(extra, entry.CompressedSize);
+            }
+            if (bZip64Offset)
+                Put<ULONGLONG>(extra, entry.Offset);
+        }
+
+        const WORD version = entry.bZip64 || !extra.empty() ? VERSION_ZIP64 : VERSION_DEFAULT;
+
+        Put<DWORD>(directory, CENTRAL_HEADER_SIGNATURE);
+        Put<WORD>(directory, VERSION_ZIP64);  // made by, MS-DOS attributes
+        Put<WORD>(directory, version);
+        Put<WORD>(directory, FLAG_DATA_DESCRIPTOR | FLAG_UTF8);
+        Put<WORD>(directory, entry.Method);
+        Put<WORD>(directory, entry.Time);
+        Put<WORD>(directory, entry.Date);
+        Put<DWORD>(directory, entry.CRC);
+        Put<DWORD>(directory, bZip64Size ? 0xFFFFFFFF : static_cast<DWORD>(entry.CompressedSize));
+        Put<DWORD>(directory, bZip64Size ? 0xFFFFFFFF : static_cast<DWORD>(entry.Size));
+        Put<WORD>(directory, static_cast<WORD>(entry.Name.size()));
+        Put<WORD>(directory, static_cast<WORD>(extra.size()));
+        Put<WORD>(directory, 0);  // comment
+        Put<WORD>(directory, 0);  // disk
+        Put<WORD>(directory, 0);  // internal attributes
+        Put<DWORD>(directory, FILE_ATTRIBUTE_NORMAL);
+        Put<DWORD>(directory, bZip64Offset ? 0xFFFFFFFF : static_cast<DWORD>(entry.Offset));
+        Put(directory, entry.Name);
+        directory.insert(end(directory), begin(extra), end(extra));
+
+        if (directory.size() >= STORE_BUFFER_SIZE)
+        {
+            if (FAILED(hr = Write(directory)))
+                return hr;
+            directory.clear();
+        }
+    }
+
+    if (FAILED(hr = Write(directory)))
+        return hr;
+    directory.clear();
+
+    const ULONGLONG ullDirectorySize = m_ullOffset - ullDirectoryOffset;
+    const ULONGLONG ullEntries = m_Entries.size();
+
+    std::vector<BYTE> trailer;
+    if (ullEntries >= 0xFFFF || ullDirectoryOffset >= 0xFFFFFFFF || ullDirectorySize >= 0xFFFFFFFF)
+    {
+        const ULONGLONG ullZip64EndOffset = m_ullOffset;
+
+        Put<DWORD>(trailer, ZIP64_END_SIGNATURE);
+        Put<ULONGLONG>(trailer, 44LL);  // size of the remaining record
+        Put<WORD>(trailer, VERSION_ZIP64);
+        Put<WORD>(trailer, VERSION_ZIP64);
+        Put<DWORD>(trailer, 0L);  // disk
+        Put<DWORD>(trailer, 0L);  // disk of the central directory
+        Put<ULONGLONG>(trailer, ullEntries);
+        Put<ULONGLONG>(trailer, ullEntries);
+        Put<ULONGLONG>(trailer, ullDirectorySize);
+        Put<ULONGLONG>(trailer, ullDirectoryOffset);
+
+        Put<DWORD>(trailer, ZIP64_LOCATOR_SIGNATURE);
+        Put<DWORD>(trailer, 0L);
+        Put<ULONGLONG>(trailer, ullZip64EndOffset);
+        Put<DWORD>(trailer, 1L);  // disks
+    }
+
+    Put<DWORD>(trailer, END_SIGNATURE);
+    Put<WORD>(trailer, 0);
+    Put<WORD>(trailer, 0);
+    Put<WORD>(trailer, static_cast<WORD>(std::min<ULONGLONG>(ullEntries, 0xFFFF)));
+    Put<WORD>(trailer, static_cast<WORD>(std::min<ULONGLONG>(ullEntries, 0xFFFF)));
+    Put<DWORD>(trailer, Low32(ullDirectorySize));
+    Put<DWORD>(trailer, Low32(ullDirectoryOffset));
+    Put<WORD>(trailer, 0);  // comment
+
+    return Write(trailer);
+}
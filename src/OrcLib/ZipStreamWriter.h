@@ -0,0 +1,73 @@
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+//
+// Copyright © 2011-2019 ANSSI. All Rights Reserved.
+//
+// Author(s): Jean Gautier (ANSSI)
+//
+#pragma once
+
+#include "OrcLib.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#pragma managed(push, off)
+
+namespace Orc {
+
+class ByteStream;
+
+// Writes a zip archive front to back, entries are never read back nor rewritten
+// Each entry is appended with its local header, its data and a data descriptor (sizes and CRC are only known once the
+// data is compressed), the central directory is written once when the archive is closed. Zip64 records are used when
+// sizes, offsets or the number of entries do not fit in the original fields, and for the data descriptor of entries
+// whose input cannot tell its size beforehand (pipes, unknown streams).
+class ZipStreamWriter
+{
+public:
+    // Level 0 stores entries, other levels are deflate compression levels
+    ZipStreamWriter(logger pLog, std::shared_ptr<ByteStream> pOutput, UINT uiLevel);
+
+    // Appends an entry with the content of the input stream, from its current position to its end
+    // When the input fails to be read, the entry is completed with the data read so far (the archive remains valid)
+    // and the read error is returned. Other errors leave the archive unusable.
+    HRESULT AddEntry(const std::wstring& strName, const std::shared_ptr<ByteStream>& pInput);
+
+    // Writes the central directory, no entry can be added afterwards
+    HRESULT Close();
+
+    size_t GetEntryCount() const { return m_Entries.size(); }
+    ULONGLONG GetArchiveSize() const { return m_ullOffset; }
+
+private:
+    struct Entry
+    {
+        std::string Name;  // UTF-8
+        WORD Method = 0;
+        WORD Time = 0;
+        WORD Date = 0;
+        DWORD CRC = 0L;
+        ULONGLONG Size = 0LL;
+        ULONGLONG CompressedSize = 0LL;
+        ULONGLONG Offset = 0LL;
+        bool bZip64 = false;  // the local header has a zip64 extra field and the data descriptor 64 bits sizes
+    };
+
+    logger _L_;
+    std::shared_ptr<ByteStream> m_pOutput;
+    UINT m_uiLevel;
+
+    ULONGLONG m_ullOffset = 0LL;
+    std::vector<Entry> m_Entries;
+    bool m_bClosed = false;
+
+    HRESULT Write(const std::vector<BYTE>& bytes);
+    HRESULT Store(const std::shared_ptr<ByteStream>& pInput, Entry& entry, HRESULT& hrRead);
+    HRESULT Deflate(const std::shared_ptr<ByteStream>& pInput, Entry& entry, HRESULT& hrRead);
+};
+
+}  // namespace Orc
+
+#pragma managed(pop)
@@ -26,6 +26,30 @@ using namespace Orc;
 
 namespace fs = std::filesystem;
 
+namespace {
+
+// the size of the batch is only estimated every so many rows, against Options::RowGroupSize
+constexpr DWORD ROW_GROUP_SIZE_CHECK = 1024L;
+
+parquet::Compression::type GetParquetCompression(TableOutput::ColumnCompression compression)
+{
+    switch (compression)
+    {
+        case TableOutput::ColumnCompression::None:
+            return parquet::Compression::UNCOMPRESSED;
+        case TableOutput::ColumnCompression::Snappy:
+            return parquet::Compression::SNAPPY;
+        case TableOutput::ColumnCompression::LZ4:
+            return parquet::Compression::LZ4;
+        case TableOutput::ColumnCompression::ZStd:
+            return parquet::Compression::ZSTD;
+        default:
+            return parquet::Compression::GZIP;
+    }
+}
+
+}  // namespace
+
 class Orc::TableOutput::Parquet::WriterTermination : public TerminationHandler
 {
 public:
@@ -71,6 +95,10 @@ Orc::TableOutput::Parquet::Writer::Writer(logger pLog, std::unique_ptr<Options>&
     : _L_(std::move(pLog))
     , m_Options(std::move(options))
 {
+    if (m_Options && m_Options->InFlightBatches.value_or(0L) > 0)
+    {
+        m_pBackgroundFlush = std::make_unique<BackgroundFlush>(_L_, m_Options->InFlightBatches.value());
+    }
 }
 
 Orc::TableOutput::Parquet::Writer::Builders Orc::TableOutput::Parquet::Writer::GetBuilders()
@@ -217,11 +245,15 @@ STDMETHODIMP Orc::TableOutput::Parquet::Writer::SetSchema(const TableOutput::Sch
 
     parquet::WriterProperties::Builder props_builder;
     props_builder.data_pagesize(4096 * 1024);
-    props_builder.max_row_group_length(10000);
+    if (m_Options && m_Options->RowGroupSize.has_value())
+    {
+        // each batch is written as a single row group, the batch is flushed once it reaches RowGroupSize bytes
+        props_builder.max_row_group_length(std::numeric_limits<int64_t>::max());
+    }
+    else
+        props_builder.max_row_group_length(10000);
     props_builder.compression(parquet::Compression::GZIP);
 
-    m_parquetProps = props_builder.build();
-
     std::vector<std::shared_ptr<arrow::Field>> schema_definition;
     schema_definition.reserve(columns.size());
 
@@ -236,6 +268,20 @@ STDMETHODIMP Orc::TableOutput::Parquet::Writer::SetSchema(const TableOutput::Sch
             break;
         }
 
+        switch (column->Encoding)
+        {
+            case ColumnEncoding::Dictionary:
+                props_builder.enable_dictionary(strName);
+                break;
+            case ColumnEncoding::Plain:
+                props_builder.disable_dictionary(strName);
+                break;
+            default:
+                break;
+        }
+        if (column->Compression != ColumnCompression::Default)
+            props_builder.compression(strName, GetParquetCompression(column->Compression));
+
         switch (column->Type)
         {
             case Nothing:
@@ -333,6 +379,7 @@ STDMETHODIMP Orc::TableOutput::Parquet::Writer::SetSchema(const TableOutput::Sch
                 return E_FAIL;
         }
     }
+    m_parquetProps = props_builder.build();
     m_arrowSchema = std::make_shared<arrow::Schema>(schema_definition);
     m_arrowBuilders = GetBuilders();
     return S_OK;
@@ -367,6 +414,13 @@ Orc::TableOutput::Parquet::Writer::WriteToStream(const std::shared_ptr<ByteStrea
 {
     HRESULT hr = E_FAIL;
 
+    if (m_pBackgroundFlush)
+    {
+        // pending batches are written by the current m_arrowWriter
+        if (FAILED(hr = m_pBackgroundFlush->Wait()))
+            return hr;
+    }
+
     if (m_pByteStream && m_bCloseStream)
     {
         m_pByteStream->Close();
@@ -403,6 +457,23 @@ STDMETHODIMP Orc::TableOutput::Parquet::Writer::Flush()
 
     log::Verbose(_L_, L"Orc::TableOutput::Parquet::Writer::Flush");
 
+    HRESULT hr = FlushBatch();
+
+    if (m_pBackgroundFlush)
+    {
+        if (auto hrWait = m_pBackgroundFlush->Wait(); SUCCEEDED(hr))
+            hr = hrWait;
+    }
+    return hr;
+}
+
+HRESULT Orc::TableOutput::Parquet::Writer::FlushBatch()
+{
+    ScopedLock sl(m_cs);
+
+    if (m_arrowWriter == nullptr)
+        return S_OK;
+
     std::vector<std::shared_ptr<arrow::Array>> arrays;
     arrays.reserve(m_arrowBuilders.size());
 
@@ -419,23 +490,31 @@ STDMETHODIMP Orc::TableOutput::Parquet::Writer::Flush()
             builder);
     }
 
-    auto table = arrow::Table::Make(m_arrowSchema, arrays);
-    if (!table)
-    {
-        log::Error(_L_, E_FAIL, L"Failed to create arrow table (to flush)\r\n");
-        return E_FAIL;
-    }
+    m_arrowBuilders = GetBuilders();
+    m_dwBatchRowCount = 0L;
 
-    auto status = m_arrowWriter->WriteTable(*table, table->num_rows());
-    if (!status.ok())
-    {
-        log::Error(_L_, E_FAIL, L"Failed to write arrow table (%S)\r\n", status.ToString().c_str());
-        return E_FAIL;
-    }
+    // the arrays are immutable once finished: they are encoded and written while the next batch is built
+    auto write = [pLog = _L_, pSchema = m_arrowSchema, arrays = std::move(arrays), pWriter = m_arrowWriter.get()]() {
+        auto table = arrow::Table::Make(pSchema, arrays);
+        if (!table)
+        {
+            log::Error(pLog, E_FAIL, L"Failed to create arrow table (to flush)\r\n");
+            return E_FAIL;
+        }
 
-    m_arrowBuilders = GetBuilders();
+        auto status = pWriter->WriteTable(*table, table->num_rows());
+        if (!status.ok())
+        {
+            log::Error(pLog, E_FAIL, L"Failed to write arrow table (%S)\r\n", status.ToString().c_str());
+            return E_FAIL;
+        }
+        return S_OK;
+    };
 
-    return S_OK;
+    if (m_pBackgroundFlush)
+        return m_pBackgroundFlush->Post(std::move(write));
+
+    return write();
 }
 
 STDMETHODIMP Orc::TableOutput::Parquet::Writer::Close()
@@ -453,6 +532,18 @@ STDMETHODIMP Orc::TableOutput::Parquet::Writer::Close()
         Robustness::RemoveTerminationHandler(m_pTermination);
         m_pTermination = nullptr;
     }
+
+    if (m_arrowWriter)
+    {
+        // the footer is written here rather than when the writer is destroyed, where its failure would go unnoticed
+        auto status = m_arrowWriter->Close();
+        m_arrowWriter.reset();
+        if (!status.ok())
+        {
+            log::Error(_L_, E_FAIL, L"Failed to close parquet file (%S)\r\n", status.ToString().c_str());
+            return E_FAIL;
+        }
+    }
     return S_OK;
 }
 
@@ -544,13 +635,48 @@ HRESULT Orc::TableOutput::Parquet::Writer::WriteEndOfLine()
         if (m_dwBatchRowCount >= m_Options->BatchSize.value())
         {
             log::Verbose(_L_, L"Batch is full --> Flush() (%d rows)", m_dwBatchRowCount);
-            if (auto hr = Flush(); FAILED(hr))
+            if (auto hr = FlushBatch(); FAILED(hr))
+                return hr;
+        }
+    }
+
+    if (m_Options && m_Options->RowGroupSize.has_value() && (m_dwBatchRowCount % ROW_GROUP_SIZE_CHECK) == 0)
+    {
+        if (auto ullBatchBytes = GetBatchBytes(); ullBatchBytes >= m_Options->RowGroupSize.value())
+        {
+            log::Verbose(
+                _L_, L"Row group is full --> Flush() (%d rows, %I64d bytes)", m_dwBatchRowCount, ullBatchBytes);
+            if (auto hr = FlushBatch(); FAILED(hr))
                 return hr;
         }
     }
     return S_OK;
 }
 
+ULONGLONG Orc::TableOutput::Parquet::Writer::GetBatchBytes() const
+{
+    ULONGLONG retval = 0LL;
+
+    for (const auto& builder : m_arrowBuilders)
+    {
+        std::visit(
+            [&retval](auto&& arg) {
+                using T = typename std::decay_t<decltype(arg)>::element_type;
+                if constexpr (std::is_base_of_v<arrow::BinaryBuilder, T>)
+                {
+                    // values and their offsets
+                    retval += arg->value_data_length() + arg->length() * sizeof(int32_t);
+                }
+                else if (auto type = dynamic_cast<const arrow::FixedWidthType*>(arg->type().get()))
+                {
+                    retval += (arg->length() * type->bit_width() + 7) / 8;
+                }
+            },
+            builder);
+    }
+    return retval;
+}
+
 STDMETHODIMP Orc::TableOutput::Parquet::Writer::WriteString(const std::wstring& strString)
 {
     std::visit(
@@ -12,6 +12,7 @@
 #include "ByteStream.h"
 
 #include "TableOutputWriter.h"
+#include "TableOutputBackgroundFlush.h"
 #include "OutputSpec.h"
 #include "CriticalSection.h"
 
@@ -172,6 +173,9 @@ private:
     bool m_bCloseStream = true;
     std::unique_ptr<parquet::arrow::FileWriter> m_arrowWriter;
 
+    // With Options::InFlightBatches, the finished arrays are written to m_arrowWriter by a background task
+    std::unique_ptr<BackgroundFlush> m_pBackgroundFlush;
+
     using ColumnBuilder = std::variant<
         std::unique_ptr<arrow::NullBuilder>,
         std::unique_ptr<arrow::UInt8Builder>,
@@ -196,6 +200,12 @@ private:
 
     Builders GetBuilders();
 
+    // Writes the rows of the builders, or hands them to the background writer, and starts a new batch
+    HRESULT FlushBatch();
+
+    // Estimated size of the encoded rows of the builders, in bytes
+    ULONGLONG GetBatchBytes() const;
+
     HRESULT AddColumnAndCheckNumbers();
 
     template <arrow::TimeUnit::type timeUnit = arrow::TimeUnit::MICRO>
@@ -13,6 +13,7 @@
 #include "TableOutputWriter.h"
 
 #include "FileStream.h"
+#include "MemoryStream.h"
 #include "ParameterCheck.h"
 #include "Temporary.h"
 #include "FileStream.h"
@@ -24,6 +25,9 @@
 
 #include "orc/OrcFile.hh"
 
+#include <chrono>
+#include <functional>
+
 #include "UnitTestHelper.h"
 
 using namespace Microsoft::VisualStudio::CppUnitTestFramework;
@@ -33,12 +37,144 @@ using namespace Orc;
 using namespace Orc::Test;
 
 namespace Orc::Test::ApacheOrc {
+
+// Memory stream whose writes fail once it would hold more than a given number of bytes
+class FailingStream : public MemoryStream
+{
+public:
+    FailingStream(logger pLog, ULONGLONG ullFailAfter)
+        : MemoryStream(std::move(pLog))
+        , m_ullFailAfter(ullFailAfter)
+    {
+    }
+
+    STDMETHOD(Write)(const PVOID pWriteBuffer, ULONGLONG cbBytesToWrite, PULONGLONG pcbBytesWritten)
+    {
+        if (GetSize() + cbBytesToWrite > m_ullFailAfter)
+            return HRESULT_FROM_WIN32(ERROR_DISK_FULL);
+        return MemoryStream::Write(pWriteBuffer, cbBytesToWrite, pcbBytesWritten);
+    }
+
+private:
+    ULONGLONG m_ullFailAfter;
+};
+
 TEST_CLASS(OrcWriter)
 {
 private:
     logger _L_;
     UnitTestHelper helper;
 
+    // Writes rows of varied values (some missing) in batches of 1000 rows, returns what Close returned
+    HRESULT WriteRows(
+        const std::shared_ptr<ByteStream>& stream,
+        std::optional<DWORD> inFlightBatches,
+        std::optional<ULONGLONG> stripeSize,
+        UINT rowCount)
+    {
+        using namespace std::string_view_literals;
+        using namespace Orc::TableOutput;
+
+        auto options = std::make_unique<TableOutput::ApacheOrc::Options>();
+        options->BatchSize = 1000;
+        options->InFlightBatches = inFlightBatches;
+        options->RowGroupSize = stripeSize;
+
+        auto stream_writer = Orc::TableOutput::GetApacheOrcnWriter(_L_, std::move(options));
+        Assert::IsTrue((bool)stream_writer, L"Failed to instantiate orc writer");
+
+        Schema schema {{ColumnType::UInt32Type, L"Index"sv},
+                       {ColumnType::UTF16Type, L"Name"sv},
+                       {ColumnType::UTF8Type, L"Extension"sv},
+                       {ColumnType::BoolType, L"IsEven"sv},
+                       {ColumnType::TimeStampType, L"Date"sv},
+                       {ColumnType::UInt64Type, L"Size"sv}};
+        Assert::IsTrue(SUCCEEDED(stream_writer->SetSchema(schema)), L"Failed to set orc Schema");
+        Assert::IsTrue(SUCCEEDED(stream_writer->WriteToStream(stream, false)), L"Failed to write to orc stream");
+
+        auto& output = *stream_writer;
+
+        HRESULT hr = S_OK;
+        for (UINT i = 0; i < rowCount && SUCCEEDED(hr); i++)
+        {
+            output.WriteInteger((DWORD)i);
+            if (i % 7 == 0)
+                output.WriteNothing();
+            else
+                output.WriteFormated(L"file_{}.txt", i);
+            output.WriteString(i % 3 ? "dll" : "exe");
+            output.WriteBool(i % 2 == 0);
+            output.WriteFileTime(132500000000000000LL + i * 10000019LL);
+            if (i % 5 == 0)
+                output.WriteNothing();
+            else
+                output.WriteInteger((ULONGLONG)i * 4096);
+
+            hr = output.WriteEndOfLine();
+        }
+
+        return stream_writer->Close();
+    }
+
+    // Orc writer of the given schema writing to a file, in batches of dwBatchSize rows
+    auto CreateWriter(
+        const TableOutput::Schema& schema,
+        const std::wstring& strPath,
+        DWORD dwBatchSize,
+        std::optional<DWORD> inFlightBatches)
+    {
+        auto options = std::make_unique<TableOutput::ApacheOrc::Options>();
+        options->BatchSize = dwBatchSize;
+        options->InFlightBatches = inFlightBatches;
+
+        auto stream_writer = Orc::TableOutput::GetApacheOrcnWriter(_L_, std::move(options));
+        Assert::IsTrue((bool)stream_writer, L"Failed to instantiate orc writer");
+        Assert::IsTrue(SUCCEEDED(stream_writer->SetSchema(schema)), L"Failed to set orc Schema");
+        Assert::IsTrue(SUCCEEDED(stream_writer->WriteToFile(strPath.c_str())), L"Failed to write to orc file");
+        return stream_writer;
+    }
+
+    // Reads back every row of an orc file, onRow gets the batch holding the row, its index in the batch and in the file
+    UINT ReadRows(
+        const std::wstring& strPath,
+        const std::function<void(const orc::StructVectorBatch&, uint64_t, UINT)>& onRow)
+    {
+        std::string strAnsiPath;
+        Assert::IsTrue(SUCCEEDED(WideToAnsi(_L_, strPath, strAnsiPath)));
+
+        auto reader = orc::createReader(orc::readLocalFile(strAnsiPath), orc::ReaderOptions());
+        auto rowReader = reader->createRowReader(orc::RowReaderOptions());
+        auto batch = rowReader->createRowBatch(1024);
+
+        UINT row = 0;
+        while (rowReader->next(*batch))
+        {
+            const auto& root = dynamic_cast<const orc::StructVectorBatch&>(*batch);
+            for (uint64_t i = 0; i < root.numElements; i++)
+                onRow(root, i, row++);
+        }
+        return row;
+    }
+
+    static bool IsNull(const orc::ColumnVectorBatch* column, uint64_t row)
+    {
+        return column->hasNulls && !column->notNull[row];
+    }
+
+    static std::string GetString(const orc::ColumnVectorBatch* column, uint64_t row)
+    {
+        const auto strings = dynamic_cast<const orc::StringVectorBatch*>(column);
+        Assert::IsNotNull(strings);
+        return std::string(strings->data[row], strings->length[row]);
+    }
+
+    static int64_t GetLong(const orc::ColumnVectorBatch* column, uint64_t row)
+    {
+        const auto longs = dynamic_cast<const orc::LongVectorBatch*>(column);
+        Assert::IsNotNull(longs);
+        return longs->data[row];
+    }
+
 public:
     TEST_METHOD_INITIALIZE(Initialize)
     {
@@ -131,6 +267,286 @@ public:
         stream_writer->Close();
     }
 
+    TEST_METHOD(BackgroundFlush)
+    {
+        // full batches are added by a background task and reused once added, the file must not change
+        auto direct = std::make_shared<MemoryStream>(_L_);
+        Assert::IsTrue(SUCCEEDED(direct->OpenForReadWrite()));
+        Assert::IsTrue(SUCCEEDED(WriteRows(direct, std::nullopt, std::nullopt, 20500)));
+
+        auto background = std::make_shared<MemoryStream>(_L_);
+        Assert::IsTrue(SUCCEEDED(background->OpenForReadWrite()));
+        Assert::IsTrue(SUCCEEDED(WriteRows(background, 2, std::nullopt, 20500)));
+
+        const auto directBytes = direct->GetConstBuffer();
+        const auto backgroundBytes = background->GetConstBuffer();
+        Assert::IsTrue(directBytes.GetCount() > 0);
+        Assert::AreEqual(directBytes.GetCount(), backgroundBytes.GetCount());
+        Assert::IsTrue(memcmp(directBytes.GetData(), backgroundBytes.GetData(), directBytes.GetCount()) == 0);
+    }
+
+    TEST_METHOD(BackgroundFlushError)
+    {
+        // small stripes are written while batches are added: the background writes fail, Close returns the error
+        auto stream = std::make_shared<FailingStream>(_L_, 16 * 1024);
+        Assert::IsTrue(SUCCEEDED(stream->OpenForReadWrite()));
+        Assert::AreEqual(HRESULT_FROM_WIN32(ERROR_DISK_FULL), WriteRows(stream, 2, 64 * 1024, 100000));
+
+        // without background writes, the error is also returned by Close
+        stream = std::make_shared<FailingStream>(_L_, 16 * 1024);
+        Assert::IsTrue(SUCCEEDED(stream->OpenForReadWrite()));
+        Assert::AreEqual(HRESULT_FROM_WIN32(ERROR_DISK_FULL), WriteRows(stream, std::nullopt, std::nullopt, 20500));
+    }
+
+    TEST_METHOD(NonAsciiStrings)
+    {
+        using namespace std::string_view_literals;
+        using namespace Orc::TableOutput;
+
+        // latin, CJK and a character out of the BMP (surrogate pair in UTF-16)
+        const std::wstring strWide = L"caf\u00e9 \u65e5\u672c \U0001F600";
+        const std::string strUtf8 = "caf\xc3\xa9 \xe6\x97\xa5\xe6\x9c\xac \xf0\x9f\x98\x80";
+
+        Schema schema {{ColumnType::UTF16Type, L"Wide"sv}, {ColumnType::UTF8Type, L"Narrow"sv}};
+        const auto strPath = GetFilePath(L"%TEMP%\\testNonAscii.orc"s);
+        {
+            auto stream_writer = CreateWriter(schema, strPath, 1024, std::nullopt);
+            auto& output = *stream_writer;
+
+            for (UINT i = 0; i < 3; i++)
+            {
+                output.WriteString(strWide);
+                output.WriteString(strUtf8);
+                output.WriteEndOfLine();
+            }
+            output.WriteFormated(L"{}-{}", strWide, 42);
+            output.WriteFormated("{}-{}", strUtf8, 42);
+            output.WriteEndOfLine();
+
+            Assert::IsTrue(SUCCEEDED(stream_writer->Close()), L"Failed to close orc writer");
+        }
+
+        auto rows = ReadRows(strPath, [&](const orc::StructVectorBatch& root, uint64_t i, UINT row) {
+            const auto expected = row < 3 ? strUtf8 : strUtf8 + "-42";
+            Assert::IsTrue(expected == GetString(root.fields[0], i), L"UTF-16 strings must be stored as UTF-8");
+            Assert::IsTrue(expected == GetString(root.fields[1], i), L"UTF-8 strings must be stored unchanged");
+        });
+        Assert::AreEqual(4U, rows);
+    }
+
+    TEST_METHOD(TimeStamps)
+    {
+        using namespace std::string_view_literals;
+        using namespace Orc::TableOutput;
+
+        // 2020-09-13 12:26:40 UTC
+        const time_t expected = 1600000000;
+
+        tm tmStamp = {};
+        tmStamp.tm_year = 2020 - 1900;
+        tmStamp.tm_mon = 8;
+        tmStamp.tm_mday = 13;
+        tmStamp.tm_hour = 12;
+        tmStamp.tm_min = 26;
+        tmStamp.tm_sec = 40;
+
+        ULARGE_INTEGER uli;
+        uli.QuadPart = (expected + 11644473600LL) * 10000000LL;
+        FILETIME ft;
+        ft.dwHighDateTime = uli.HighPart;
+        ft.dwLowDateTime = uli.LowPart;
+
+        Schema schema {{ColumnType::TimeStampType, L"FromTimeT"sv},
+                       {ColumnType::TimeStampType, L"FromTm"sv},
+                       {ColumnType::TimeStampType, L"FromFileTime"sv}};
+        const auto strPath = GetFilePath(L"%TEMP%\\testTimeStamps.orc"s);
+        {
+            auto stream_writer = CreateWriter(schema, strPath, 1024, std::nullopt);
+            auto& output = *stream_writer;
+
+            for (UINT i = 0; i < 10; i++)
+            {
+                output.WriteTimeStamp(expected + i);
+                tm tmRow = tmStamp;
+                tmRow.tm_sec += i;
+                output.WriteTimeStamp(tmRow);
+                output.WriteFileTime(static_cast<LONGLONG>(uli.QuadPart + i * 10000000ULL));
+                output.WriteEndOfLine();
+            }
+            Assert::IsTrue(SUCCEEDED(stream_writer->Close()), L"Failed to close orc writer");
+        }
+
+        auto rows = ReadRows(strPath, [&](const orc::StructVectorBatch& root, uint64_t i, UINT row) {
+            for (const auto column : root.fields)
+            {
+                const auto timeStamps = dynamic_cast<const orc::TimestampVectorBatch*>(column);
+                Assert::IsNotNull(timeStamps);
+                Assert::IsFalse(IsNull(timeStamps, i));
+                Assert::AreEqual(static_cast<int64_t>(expected + row), timeStamps->data[i]);
+                Assert::AreEqual(static_cast<int64_t>(0), timeStamps->nanoseconds[i]);
+            }
+        });
+        Assert::AreEqual(10U, rows);
+    }
+
+    TEST_METHOD(NullsInReusedBatches)
+    {
+        using namespace std::string_view_literals;
+        using namespace Orc::TableOutput;
+
+        // batches of 2 rows alternate between all null and all set: every value is written into a row that was
+        // null in the batch previously added, once the batch is reset and reused
+        Schema schema {{ColumnType::UInt32Type, L"Index"sv},
+                       {ColumnType::UTF8Type, L"Name"sv},
+                       {ColumnType::UInt64Type, L"Size"sv}};
+        auto IsNullRow = [](UINT row) { return (row / 2) % 2 == 0; };
+
+        for (std::optional<DWORD> inFlightBatches : {std::optional<DWORD>(), std::optional<DWORD>(2)})
+        {
+            const auto strPath = GetFilePath(L"%TEMP%\\testReusedBatches.orc"s);
+            {
+                auto stream_writer = CreateWriter(schema, strPath, 2, inFlightBatches);
+                auto& output = *stream_writer;
+
+                for (UINT i = 0; i < 64; i++)
+                {
+                    output.WriteInteger((DWORD)i);
+                    if (IsNullRow(i))
+                    {
+                        output.WriteNothing();
+                        output.WriteNothing();
+                    }
+                    else
+                    {
+                        output.WriteFormated("name_{}", i);
+                        output.WriteInteger((ULONGLONG)i * 4096);
+                    }
+                    output.WriteEndOfLine();
+                }
+                Assert::IsTrue(SUCCEEDED(stream_writer->Close()), L"Failed to close orc writer");
+            }
+
+            auto rows = ReadRows(strPath, [&](const orc::StructVectorBatch& root, uint64_t i, UINT row) {
+                Assert::IsFalse(IsNull(root.fields[0], i));
+                Assert::AreEqual(static_cast<int64_t>(row), GetLong(root.fields[0], i));
+
+                Assert::AreEqual(IsNullRow(row), IsNull(root.fields[1], i));
+                Assert::AreEqual(IsNullRow(row), IsNull(root.fields[2], i));
+                if (!IsNullRow(row))
+                {
+                    Assert::IsTrue(fmt::format("name_{}", row) == GetString(root.fields[1], i));
+                    Assert::AreEqual(static_cast<int64_t>(row) * 4096, GetLong(root.fields[2], i));
+                }
+            });
+            Assert::AreEqual(64U, rows);
+        }
+    }
+
+    TEST_METHOD(StringsLargerThanArenaBlock)
+    {
+        using namespace std::string_view_literals;
+        using namespace Orc::TableOutput;
+
+        // the batch arena allocates blocks of 1MB: larger strings get a block of their own, between small strings
+        // that keep on filling the regular blocks, and the blocks are reused by the next batches
+        const size_t cbLarge = 3 * 1024 * 1024 + 17;
+        auto Expected = [&](UINT row) {
+            if (row % 3 == 1)
+                return std::string(cbLarge + row, static_cast<char>('a' + row % 26));
+            return fmt::format("small_{}", row);
+        };
+
+        Schema schema {{ColumnType::UTF8Type, L"Narrow"sv}, {ColumnType::UTF16Type, L"Wide"sv}};
+        const auto strPath = GetFilePath(L"%TEMP%\\testLargeStrings.orc"s);
+        {
+            auto stream_writer = CreateWriter(schema, strPath, 4, 2);
+            auto& output = *stream_writer;
+
+            for (UINT i = 0; i < 12; i++)
+            {
+                const auto strValue = Expected(i);
+                output.WriteString(strValue);
+                output.WriteString(std::wstring(strValue.begin(), strValue.end()));
+                output.WriteEndOfLine();
+            }
+            Assert::IsTrue(SUCCEEDED(stream_writer->Close()), L"Failed to close orc writer");
+        }
+
+        auto rows = ReadRows(strPath, [&](const orc::StructVectorBatch& root, uint64_t i, UINT row) {
+            const auto expected = Expected(row);
+            Assert::IsTrue(expected == GetString(root.fields[0], i));
+            Assert::IsTrue(expected == GetString(root.fields[1], i));
+        });
+        Assert::AreEqual(12U, rows);
+    }
+
+    BEGIN_TEST_METHOD_ATTRIBUTE(WriterBenchmark)
+    TEST_METHOD_ATTRIBUTE(L"TestCategory", L"Benchmark")
+    END_TEST_METHOD_ATTRIBUTE()
+    TEST_METHOD(WriterBenchmark)
+    {
+        using namespace std::string_literals;
+        using namespace std::string_view_literals;
+        using namespace Orc::TableOutput;
+
+        Schema schema {{ColumnType::UInt32Type, L"FieldOne"sv},
+                       {ColumnType::UTF16Type, L"FieldTwo"sv},
+                       {ColumnType::UInt64Type, L"FieldThree"sv},
+                       {ColumnType::UTF8Type, L"FieldFour"sv},
+                       {ColumnType::BoolType, L"FieldFive"sv},
+                       {ColumnType::TimeStampType, L"FieldSix"sv},
+                       {ColumnType::UTF16Type, L"FieldSeven"sv}};
+
+        const UINT rowCount = 1000000;
+        const auto strPath = GetFilePath(L"%TEMP%\\benchmark.orc"s);
+
+        auto Benchmark = [&](DWORD dwBatchSize, std::optional<DWORD> inFlightBatches) {
+            auto options = std::make_unique<TableOutput::ApacheOrc::Options>();
+            options->BatchSize = dwBatchSize;
+            options->InFlightBatches = inFlightBatches;
+
+            auto stream_writer = Orc::TableOutput::GetApacheOrcnWriter(_L_, std::move(options));
+            Assert::IsTrue((bool)stream_writer, L"Failed to instantiate orc writer");
+            Assert::IsTrue(SUCCEEDED(stream_writer->SetSchema(schema)), L"Failed to set orc Schema");
+            Assert::IsTrue(SUCCEEDED(stream_writer->WriteToFile(strPath.c_str())), L"Failed to write to orc stream");
+
+            auto& output = *stream_writer;
+            FILETIME now;
+            GetSystemTimeAsFileTime(&now);
+
+            auto start = std::chrono::high_resolution_clock::now();
+            for (UINT i = 0; i < rowCount; i++)
+            {
+                output.WriteInteger((DWORD)i);
+                output.WriteString(L"This is a wide string");
+                output.WriteInteger((DWORDLONG)i * 2);
+                output.WriteString("This is a string");
+                output.WriteBool(i % 2);
+                output.WriteFileTime(now);
+                output.WriteString(L"\\Windows\\System32\\drivers\\etc\\hosts");
+
+                output.WriteEndOfLine();
+            }
+            Assert::IsTrue(SUCCEEDED(stream_writer->Close()), L"Failed to close orc writer");
+            auto elapsed = std::chrono::high_resolution_clock::now() - start;
+
+            const auto ms = std::max<long long>(
+                1LL, std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count());
+            log::Info(
+                _L_,
+                L"Orc writer, %d rows per batch, %d batches in flight: %I64d ms, %I64d cells/s\r\n",
+                dwBatchSize,
+                inFlightBatches.value_or(0),
+                ms,
+                (static_cast<long long>(rowCount) * schema.size() * 1000LL) / ms);
+        };
+
+        Benchmark(1204, std::nullopt);
+        Benchmark(1204, 2);
+        Benchmark(16384, std::nullopt);
+        Benchmark(16384, 2);
+    }
+
     void WriteSimpleData(const std::unique_ptr<orc::OutputStream>& output)
     {
         using namespace orc;
@@ -0,0 +1,368 @@
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+//
+// Copyright © 2011-2019 ANSSI. All Rights Reserved.
+//
+// Author(s): Jean Gautier (ANSSI)
+//
+#include "stdafx.h"
+
+#include "LogFileWriter.h"
+#include "FileFind.h"
+#include "Location.h"
+#include "LocationSet.h"
+#include "FileStream.h"
+#include "Temporary.h"
+
+#include <set>
+#include <string_view>
+#include <tuple>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace Orc;
+using namespace Orc::Test;
+
+namespace Orc::Test {
+TEST_CLASS(FileFindTest)
+{
+private:
+    logger _L_;
+    UnitTestHelper helper;
+
+public:
+    TEST_METHOD_INITIALIZE(Initialize)
+    {
+        _L_ = std::make_shared<LogFileWriter>();
+        helper.InitLogFileWriter(_L_);
+    }
+
+    TEST_METHOD_CLEANUP(Finalize)
+    {
+        for (const auto& image : m_Images)
+            DeleteFile(image.c_str());
+        m_Images.clear();
+
+        helper.FinalizeLogFileWriter(_L_);
+    }
+
+    TEST_METHOD(FileFindWildcardLiteralTest)
+    {
+        // no literal piece
+        Assert::IsTrue(FileFind::WildcardLiteral(L"*").empty());
+        Assert::IsTrue(FileFind::WildcardLiteral(L"*.*").empty());
+        Assert::IsTrue(FileFind::WildcardLiteral(L"?*?").empty());
+        Assert::IsTrue(FileFind::WildcardLiteral(L"notepad.exe;calc.exe").empty());
+
+        // the longest piece, the first one of the same length
+        Assert::IsTrue(FileFind::WildcardLiteral(L"notepad.exe") == L"notepad");
+        Assert::IsTrue(FileFind::WildcardLiteral(L"*pad*.exe") == L"pad");
+        Assert::IsTrue(FileFind::WildcardLiteral(L"n?tepad.exe") == L"tepad");
+        Assert::IsTrue(FileFind::WildcardLiteral(L"*.evtx") == L"evtx");
+
+        // case is kept, non ASCII characters split pieces
+        Assert::IsTrue(FileFind::WildcardLiteral(L"NOTEPAD.*") == L"NOTEPAD");
+        Assert::IsTrue(FileFind::WildcardLiteral(L"café*.txt") == L"caf");
+    }
+
+    TEST_METHOD(FileFindRegexLiteralTest)
+    {
+        // no literal piece
+        Assert::IsTrue(FileFind::RegexLiteral(L".*").empty());
+        Assert::IsTrue(FileFind::RegexLiteral(L"[a-z]+\\d*").empty());
+        Assert::IsTrue(FileFind::RegexLiteral(L"notepad\\.exe|calc\\.exe").empty());
+        Assert::IsTrue(FileFind::RegexLiteral(L"(notepad|calc)").empty());
+        Assert::IsTrue(FileFind::RegexLiteral(L"a*").empty());
+
+        // escaped characters are literal, character classes are not
+        Assert::IsTrue(FileFind::RegexLiteral(L"^notepad\\.exe$") == L"notepad.exe");
+        Assert::IsTrue(FileFind::RegexLiteral(L"^[a-z]+pad\\d*\\.exe$") == L".exe");
+        Assert::IsTrue(FileFind::RegexLiteral(L"\\x41note") == L"note");
+
+        // groups and optional characters are left out, alternations inside groups are fine
+        Assert::IsTrue(FileFind::RegexLiteral(L"note(pad)?\\.exe") == L"note");
+        Assert::IsTrue(FileFind::RegexLiteral(L"(note|word)pad\\.exe") == L"pad.exe");
+        Assert::IsTrue(FileFind::RegexLiteral(L"notepa?d") == L"notep");
+        Assert::IsTrue(FileFind::RegexLiteral(L"x{2}yz") == L"yz");
+        Assert::IsTrue(FileFind::RegexLiteral(L"no+tepad") == L"tepad");
+
+        // case is kept
+        Assert::IsTrue(FileFind::RegexLiteral(L"NOTEPAD\\.EXE") == L"NOTEPAD.EXE");
+    }
+
+    TEST_METHOD(FileFindCandidateTermsTest)
+    {
+        const auto image = ExtractImage();
+
+        FileFind finder(_L_, false);
+
+        // the literal of each of those terms is "notepad" (in any case), or none at all
+        auto wildcard = std::make_shared<FileFind::SearchTerm>(L"NOTEPAD.*");
+        Assert::IsTrue(S_OK == finder.AddTerm(wildcard));
+
+        auto regex = std::make_shared<FileFind::SearchTerm>();
+        regex->Required = FileFind::SearchTerm::Criteria::NAME_REGEX;
+        regex->FileName = L"NotePad\\.EXE";
+        regex->FileNameRegEx.assign(regex->FileName, std::regex_constants::icase);
+        Assert::IsTrue(S_OK == finder.AddTerm(regex));
+
+        auto alternation = std::make_shared<FileFind::SearchTerm>();
+        alternation->Required = FileFind::SearchTerm::Criteria::NAME_REGEX;
+        alternation->FileName = L"calc\\.exe|notepad\\.exe";
+        alternation->FileNameRegEx.assign(alternation->FileName, std::regex_constants::icase);
+        Assert::IsTrue(S_OK == finder.AddTerm(alternation));
+
+        auto path = std::make_shared<FileFind::SearchTerm>();
+        path->Required = FileFind::SearchTerm::Criteria::PATH_MATCH;
+        path->Path = L"*\\n?tepad.*";
+        Assert::IsTrue(S_OK == finder.AddTerm(path));
+
+        // a literal found in no name: never a candidate
+        auto absent = std::make_shared<FileFind::SearchTerm>(L"*wordpad*");
+        Assert::IsTrue(S_OK == finder.AddTerm(absent));
+
+        LocationSet locations(_L_);
+        AddImageLocations(locations, {image});
+
+        std::set<const FileFind::SearchTerm*> matched;
+        Assert::IsTrue(
+            S_OK
+            == finder.Find(
+                locations,
+                [&matched](const std::shared_ptr<FileFind::Match>& aMatch, bool& bStop) {
+                    for (const auto& name : aMatch->MatchingNames)
+                    {
+                        const auto pFileName = name.FILENAME();
+                        Assert::IsTrue(
+                            CompareStringOrdinal(
+                                pFileName->FileName, pFileName->FileNameLength, L"notepad.exe", -1, TRUE)
+                            == CSTR_EQUAL);
+                    }
+                    matched.insert(aMatch->Term.get());
+                },
+                false));
+
+        Assert::IsTrue(matched.count(wildcard.get()) == 1);
+        Assert::IsTrue(matched.count(regex.get()) == 1);
+        Assert::IsTrue(matched.count(alternation.get()) == 1);
+        Assert::IsTrue(matched.count(path.get()) == 1);
+        Assert::IsTrue(matched.count(absent.get()) == 0);
+    }
+
+    TEST_METHOD(FileFindDataCriteriaTest)
+    {
+        const auto image = ExtractImage();
+
+        FileFind finder(_L_, false);
+
+        using Criteria = FileFind::SearchTerm::Criteria;
+
+        const BYTE sha1[20] = {0x80, 0x07, 0x18, 0x6A, 0xB2, 0xB7, 0x1C, 0x48, 0x2E, 0xA2,
+                               0xC4, 0xBC, 0x43, 0x04, 0xB2, 0x4B, 0xDC, 0x68, 0x34, 0xEC};
+        const char szStub[] = "This program cannot be run in DOS mode";
+        const char szMissing[] = "This needle is not in notepad";
+
+        auto AddNotepadTerm = [&finder](Criteria criteria, std::string_view header, std::string_view contains) {
+            auto term = std::make_shared<FileFind::SearchTerm>(L"notepad.exe");
+            term->Required |= criteria;
+            if (!header.empty())
+            {
+                term->Header.SetData((LPCBYTE)header.data(), header.size());
+                term->HeaderLen = static_cast<DWORD>(header.size());
+            }
+            if (!contains.empty())
+                term->Contains.SetData((LPCBYTE)contains.data(), contains.size());
+            Assert::IsTrue(S_OK == finder.AddTerm(term));
+            return term;
+        };
+
+        // only the header is read
+        auto header = AddNotepadTerm(Criteria::HEADER_HEX, "MZ", "");
+        // the header, the whole data for its hash and the needle in a single read
+        auto all = AddNotepadTerm(Criteria::HEADER_HEX | Criteria::DATA_SHA1 | Criteria::CONTAINS, "MZ", szStub);
+        all->SHA1.SetData(sha1, sizeof(sha1));
+        // criteria evaluated in the same read but not matching
+        auto wrongHeader = AddNotepadTerm(Criteria::HEADER_HEX, "PK", "");
+        auto missing = AddNotepadTerm(Criteria::CONTAINS, "", szMissing);
+
+        // a term whose name never matches: its data criteria are never evaluated
+        auto other = std::make_shared<FileFind::SearchTerm>(L"*wordpad*");
+        other->Required |= Criteria::CONTAINS;
+        other->Contains.SetData((LPCBYTE)szStub, strlen(szStub));
+        Assert::IsTrue(S_OK == finder.AddTerm(other));
+
+        LocationSet locations(_L_);
+        AddImageLocations(locations, {image});
+
+        std::set<const FileFind::SearchTerm*> matched;
+        Assert::IsTrue(
+            S_OK
+            == finder.Find(
+                locations,
+                [&matched](const std::shared_ptr<FileFind::Match>& aMatch, bool& bStop) {
+                    matched.insert(aMatch->Term.get());
+                },
+                false));
+
+        Assert::IsTrue(matched.count(header.get()) == 1);
+        Assert::IsTrue(matched.count(all.get()) == 1);
+        Assert::IsTrue(matched.count(wrongHeader.get()) == 0);
+        Assert::IsTrue(matched.count(missing.get()) == 0);
+        Assert::IsTrue(matched.count(other.get()) == 0);
+
+        // the hash computed by the evaluation is the one of the match
+        for (const auto& aMatch : finder.Matches())
+        {
+            if (aMatch->Term != all)
+                continue;
+            Assert::IsTrue(aMatch->MatchingAttributes.size() == 1);
+            Assert::IsTrue(aMatch->MatchingAttributes.front().SHA1 == all->SHA1);
+        }
+    }
+
+    TEST_METHOD(FileFindParallelLocationsTest)
+    {
+        const std::vector<std::wstring> images = {ExtractImage(), ExtractImage(), ExtractImage()};
+
+        using MatchKey = std::tuple<std::wstring, std::wstring, ULONGLONG>;
+
+        auto FindAll = [this, &images](DWORD dwMaxLocations, DWORD dwMaxPerDisk) {
+            FileFind finder(_L_, false);
+            finder.SetParallelLocations(dwMaxLocations, dwMaxPerDisk);
+
+            Assert::IsTrue(S_OK == finder.AddTerm(std::make_shared<FileFind::SearchTerm>(L"*.exe")));
+            Assert::IsTrue(S_OK == finder.AddTerm(std::make_shared<FileFind::SearchTerm>(L"*.dll")));
+
+            LocationSet locations(_L_);
+            AddImageLocations(locations, images);
+
+            std::multiset<MatchKey> found;
+            Assert::IsTrue(
+                S_OK
+                == finder.Find(
+                    locations,
+                    [&found](const std::shared_ptr<FileFind::Match>& aMatch, bool& bStop) {
+                        for (const auto& name : aMatch->MatchingNames)
+                            found.emplace(
+                                aMatch->VolumeReader->GetLocation(),
+                                name.FullPathName,
+                                NtfsFullSegmentNumber(&aMatch->FRN));
+                    },
+                    false));
+
+            // the matches kept by the searcher are the ones passed to the callback
+            size_t ulNames = 0;
+            for (const auto& aMatch : finder.Matches())
+                ulNames += aMatch->MatchingNames.size();
+            Assert::IsTrue(ulNames == found.size());
+
+            return found;
+        };
+
+        const auto serial = FindAll(1, 1);
+        Assert::IsFalse(serial.empty());
+
+        // all the images walked at once, each one on its own disk
+        Assert::IsTrue(FindAll(4, 4) == serial);
+        // only two walks at once
+        Assert::IsTrue(FindAll(2, 1) == serial);
+    }
+
+    TEST_METHOD(FileFindParallelLocationsStopTest)
+    {
+        const std::vector<std::wstring> images = {ExtractImage(), ExtractImage(), ExtractImage()};
+
+        for (const DWORD dwMaxLocations : {1UL, 4UL})
+        {
+            FileFind finder(_L_, false);
+            finder.SetParallelLocations(dwMaxLocations, dwMaxLocations);
+
+            Assert::IsTrue(S_OK == finder.AddTerm(std::make_shared<FileFind::SearchTerm>(L"*.exe")));
+
+            LocationSet locations(_L_);
+            AddImageLocations(locations, images);
+
+            // a stop asked by the callback ends every walk, no match is reported after it
+            ULONG ulCalls = 0;
+            Assert::IsTrue(
+                S_OK
+                == finder.Find(
+                    locations,
+                    [&ulCalls](const std::shared_ptr<FileFind::Match>& aMatch, bool& bStop) {
+                        ulCalls++;
+                        bStop = true;
+                    },
+                    false));
+
+            Assert::IsTrue(ulCalls == 1);
+            Assert::IsTrue(finder.Matches().size() == 1);
+        }
+    }
+
+private:
+    std::vector<std::wstring> m_Images;
+
+    // Extracts a copy of the NTFS test image, deleted when the test ends
+    std::wstring ExtractImage()
+    {
+        const auto archive = helper.GetDirectoryName(__WFILE__) + L"\\ntfs_images\\ntfs.7z";
+        Archive::ArchiveItem extracted;
+
+        auto MakeArchiveStream = [this, &archive](std::shared_ptr<ByteStream>& stream) -> HRESULT {
+            auto fs = std::make_shared<FileStream>(_L_);
+            fs->ReadFrom(archive.c_str());
+
+            if (FAILED(fs->IsOpen()))
+                return E_FAIL;
+
+            stream = fs;
+            return S_OK;
+        };
+
+        auto ShouldItemBeExtracted = [](const std::wstring& strNameInArchive) -> bool { return true; };
+
+        auto MakeWriteStream = [this](Archive::ArchiveItem& item) -> std::shared_ptr<ByteStream> {
+            WCHAR szTempDir[MAX_PATH];
+            if (FAILED(UtilGetTempDirPath(szTempDir, MAX_PATH)))
+                return nullptr;
+
+            if (FAILED(UtilGetUniquePath(szTempDir, item.NameInArchive.c_str(), item.Path)))
+                return nullptr;
+
+            auto pStream = std::make_shared<FileStream>(_L_);
+            pStream->OpenFile(item.Path.c_str(), GENERIC_WRITE | GENERIC_READ, 0L, NULL, CREATE_ALWAYS, 0L, NULL);
+            return pStream;
+        };
+
+        auto ArchiveCallback = [&extracted](const Archive::ArchiveItem& item) { extracted = item; };
+
+        Assert::IsTrue(
+            S_OK
+            == helper.ExtractArchive(
+                _L_,
+                ArchiveFormat::SevenZip,
+                MakeArchiveStream,
+                ShouldItemBeExtracted,
+                MakeWriteStream,
+                ArchiveCallback));
+
+        extracted.Stream->Close();
+        m_Images.push_back(extracted.Path);
+        return extracted.Path;
+    }
+
+    // Each image is added with its own location, all of them are parsed
+    void AddImageLocations(LocationSet& locations, const std::vector<std::wstring>& images)
+    {
+        for (const auto& image : images)
+        {
+            auto loc = std::make_shared<Location>(_L_, image + L",part=1", Location::ImageFileDisk);
+            std::shared_ptr<Location> added;
+            Assert::IsTrue(S_OK == locations.AddLocation(loc, added));
+        }
+
+        locations.GetAltitude() = LocationSet::Altitude::Exact;
+        Assert::IsTrue(S_OK == locations.Consolidate(false, FSVBR::FSType::NTFS));
+        Assert::IsTrue(locations.GetAltitudeLocations().size() == images.size());
+    }
+};
+}  // namespace Orc::Test
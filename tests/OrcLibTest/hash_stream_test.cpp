@@ -9,13 +9,49 @@
 
 #include "LogFileWriter.h"
 #include "CryptoHashStream.h"
+#include "FuzzyHashStream.h"
+#include "NativeHash.h"
 #include "MemoryStream.h"
+#include "FileMappingStream.h"
+
+#include <chrono>
 
 using namespace Microsoft::VisualStudio::CppUnitTestFramework;
 using namespace Orc;
 using namespace Orc::Test;
 
 namespace Orc::Test {
+
+// Memory stream declaring some of its runs as holes, and counting the bytes read from it
+class SparseMemoryStream : public MemoryStream
+{
+public:
+    SparseMemoryStream(logger pLog, std::vector<DataRange> ranges)
+        : MemoryStream(std::move(pLog))
+        , m_Ranges(std::move(ranges))
+    {
+    }
+
+    STDMETHOD(GetDataRanges)(std::vector<DataRange>& ranges)
+    {
+        ranges = m_Ranges;
+        return S_OK;
+    }
+
+    STDMETHOD(Read)(PVOID pBuffer, ULONGLONG cbBytes, PULONGLONG pcbBytesRead)
+    {
+        HRESULT hr = MemoryStream::Read(pBuffer, cbBytes, pcbBytesRead);
+        if (SUCCEEDED(hr) && pcbBytesRead != nullptr)
+            BytesRead += *pcbBytesRead;
+        return hr;
+    }
+
+    ULONGLONG BytesRead = 0LL;
+
+private:
+    std::vector<DataRange> m_Ranges;
+};
+
 TEST_CLASS(HashStreamTest)
 {
 private:
@@ -195,5 +231,294 @@ public:
             Assert::IsTrue(!memcmp(md5.GetData(), md5Result, sizeof(md5Result)));
         }
     }
+
+    TEST_METHOD(HashStreamSparseCopyTest)
+    {
+        // data, a hole, data
+        const ULONGLONG ullHoleStart = 0x100000;
+        const ULONGLONG ullHoleEnd = 0x280000;
+        const ULONGLONG ullSize = 0x300000;
+
+        std::vector<BYTE> data(static_cast<size_t>(ullSize), 0);
+        for (size_t i = 0; i < data.size(); i++)
+        {
+            if (i < ullHoleStart || i >= ullHoleEnd)
+                data[i] = static_cast<BYTE>(i * 7 + 1);
+        }
+
+        std::vector<ByteStream::DataRange> ranges(3);
+        ranges[0].Length = ullHoleStart;
+        ranges[1].Offset = ullHoleStart;
+        ranges[1].Length = ullHoleEnd - ullHoleStart;
+        ranges[1].bHole = true;
+        ranges[2].Offset = ullHoleEnd;
+        ranges[2].Length = ullSize - ullHoleEnd;
+
+        auto sparse = std::make_shared<SparseMemoryStream>(_L_, ranges);
+        Assert::IsTrue(S_OK == sparse->OpenForReadWrite(static_cast<DWORD>(ullSize)));
+        ULONGLONG ullWritten = 0LL;
+        Assert::IsTrue(S_OK == sparse->Write(data.data(), ullSize, &ullWritten));
+        Assert::IsTrue(ullWritten == ullSize);
+
+        auto algs = CryptoHashStream::Algorithm::MD5 | CryptoHashStream::Algorithm::SHA1;
+
+        auto expected = std::make_shared<CryptoHashStream>(_L_);
+        Assert::IsTrue(S_OK == expected->OpenToWrite(algs, nullptr));
+        Assert::IsTrue(S_OK == expected->Write(data.data(), ullSize, &ullWritten));
+
+        // the hole is hashed without being read
+        auto hashstream = std::make_shared<CryptoHashStream>(_L_);
+        Assert::IsTrue(S_OK == hashstream->OpenToWrite(algs, nullptr));
+        Assert::IsTrue(S_OK == sparse->CopyTo(hashstream, &ullWritten));
+        Assert::IsTrue(ullWritten == ullSize);
+        Assert::IsTrue(sparse->BytesRead == ullSize - (ullHoleEnd - ullHoleStart));
+
+        for (auto alg : {CryptoHashStream::Algorithm::MD5, CryptoHashStream::Algorithm::SHA1})
+        {
+            CBinaryBuffer expectedHash, hash;
+            Assert::IsTrue(S_OK == expected->GetHash(alg, expectedHash));
+            Assert::IsTrue(S_OK == hashstream->GetHash(alg, hash));
+            Assert::IsTrue(expectedHash == hash);
+        }
+
+        // the hole is skipped over in a mapping of the paging file
+        auto mapping = std::make_shared<FileMappingStream>(_L_);
+        Assert::IsTrue(S_OK == mapping->Open(INVALID_HANDLE_VALUE, PAGE_READWRITE, ullSize, nullptr));
+        Assert::IsTrue(S_OK == sparse->CopyTo(mapping, &ullWritten));
+        Assert::IsTrue(ullWritten == ullSize);
+
+        auto mapped = mapping->GetMappedData();
+        Assert::IsTrue(mapped.GetCount() == ullSize);
+        Assert::IsTrue(!memcmp(mapped.GetData(), data.data(), data.size()));
+    }
+
+    TEST_METHOD(HashStreamBenchmark)
+    {
+        std::vector<BYTE> buffer(64 * 1024 * 1024);
+        for (size_t i = 0; i < buffer.size(); i++)
+            buffer[i] = static_cast<BYTE>((i * 2654435761LL) >> 13);
+
+        using Crypto = CryptoHashStream::Algorithm;
+        const Crypto cryptos[] = {Crypto::MD5,
+                                  Crypto::SHA1,
+                                  Crypto::SHA256,
+                                  Crypto::MD5 | Crypto::SHA1,
+                                  Crypto::MD5 | Crypto::SHA256,
+                                  Crypto::SHA1 | Crypto::SHA256,
+                                  Crypto::MD5 | Crypto::SHA1 | Crypto::SHA256};
+
+        // writes of 1MB are hashed by each algorithm on its own worker, writes of 32KB on the calling thread
+        auto Benchmark = [this, &buffer](Crypto algs, FuzzyHashStream::Algorithm fuzzy, size_t cbWrite) {
+            auto crypto = std::make_shared<CryptoHashStream>(_L_);
+            Assert::IsTrue(S_OK == crypto->OpenToWrite(algs, nullptr));
+
+            std::shared_ptr<ByteStream> stream = crypto;
+            std::shared_ptr<FuzzyHashStream> fuzzyhash;
+            if (fuzzy != FuzzyHashStream::Algorithm::Undefined)
+            {
+                fuzzyhash = std::make_shared<FuzzyHashStream>(_L_);
+                Assert::IsTrue(S_OK == fuzzyhash->OpenToWrite(fuzzy, crypto));
+                stream = fuzzyhash;
+            }
+
+            auto start = std::chrono::high_resolution_clock::now();
+            for (size_t offset = 0; offset < buffer.size(); offset += cbWrite)
+            {
+                ULONGLONG ullWritten = 0LL;
+                Assert::IsTrue(S_OK == stream->Write(buffer.data() + offset, cbWrite, &ullWritten));
+            }
+            auto elapsed = std::chrono::high_resolution_clock::now() - start;
+
+            const auto ms =
+                std::max<long long>(1LL, std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count());
+            log::Info(
+                _L_,
+                L"Hash %s%s, %Iu KB writes: %I64d MB/s\r\n",
+                CryptoHashStream::GetSupportedAlgorithm(algs).c_str(),
+                fuzzyhash ? (L"," + FuzzyHashStream::GetSupportedAlgorithm(fuzzy)).c_str() : L"",
+                cbWrite / 1024,
+                (buffer.size() * 1000LL / ms) / (1024 * 1024));
+
+            std::vector<CBinaryBuffer> hashes;
+            for (auto alg : {Crypto::MD5, Crypto::SHA1, Crypto::SHA256})
+            {
+                hashes.emplace_back();
+                if (alg & algs)
+                    Assert::IsTrue(S_OK == crypto->GetHash(alg, hashes.back()));
+            }
+            if (fuzzyhash)
+            {
+                hashes.emplace_back();
+                Assert::IsTrue(S_OK == fuzzyhash->GetHash(fuzzy, hashes.back()));
+            }
+            return hashes;
+        };
+
+        auto AreEqual = [](std::vector<CBinaryBuffer> left, std::vector<CBinaryBuffer> right) {
+            Assert::IsTrue(left.size() == right.size());
+            for (size_t i = 0; i < left.size(); i++)
+                Assert::IsTrue(left[i] == right[i]);
+        };
+
+        for (auto algs : cryptos)
+        {
+            AreEqual(
+                Benchmark(algs, FuzzyHashStream::Algorithm::Undefined, 1024 * 1024),
+                Benchmark(algs, FuzzyHashStream::Algorithm::Undefined, 32 * 1024));
+        }
+
+        const auto all = Crypto::MD5 | Crypto::SHA1 | Crypto::SHA256;
+        AreEqual(
+            Benchmark(all, FuzzyHashStream::Algorithm::TLSH, 1024 * 1024),
+            Benchmark(all, FuzzyHashStream::Algorithm::TLSH, 32 * 1024));
+    }
+
+    TEST_METHOD(NativeHashKnownAnswerTest)
+    {
+        struct KnownAnswer
+        {
+            std::string Message;
+            LPCWSTR szMD5;
+            LPCWSTR szSHA1;
+            LPCWSTR szSHA256;
+        };
+
+        // FIPS 180-2 and RFC 1321 test vectors
+        const KnownAnswer answers[] = {
+            {"",
+             L"D41D8CD98F00B204E9800998ECF8427E",
+             L"DA39A3EE5E6B4B0D3255BFEF95601890AFD80709",
+             L"E3B0C44298FC1C149AFBF4C8996FB92427AE41E4649B934CA495991B7852B855"},
+            {"abc",
+             L"900150983CD24FB0D6963F7D28E17F72",
+             L"A9993E364706816ABA3E25717850C26C9CD0D89D",
+             L"BA7816BF8F01CFEA414140DE5DAE2223B00361A396177A9CB410FF61F20015AD"},
+            {"abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq",
+             L"8215EF0796A20BCAAAE116D3876C664A",
+             L"84983E441C3BD26EBAAE4AA1F95129E5E54670F1",
+             L"248D6A61D20638B8E5C026930C3E6039A33CE45964FF2167F6ECEDD419DB06C1"},
+            {std::string(1000000, 'a'),
+             L"7707D6AE4E027C70EEA2A935C2296F21",
+             L"34AA973CD4C4DAA4F61EEB2BDBAD27316534016F",
+             L"CDC76E5C9914FB9281A1C7E284D73E67F1809A48A497200E046D39CCC7112CD0"}};
+
+        using Backend = CryptoHashStream::Backend;
+        using Crypto = CryptoHashStream::Algorithm;
+
+        for (auto backend : {Backend::CryptoAPI, Backend::NativeScalar, Backend::NativeSHANI})
+        {
+            if (CryptoHashStream::IsBackendSupported(backend) != S_OK)
+                continue;
+
+            for (const auto& answer : answers)
+            {
+                auto hashstream = std::make_shared<CryptoHashStream>(_L_);
+                Assert::IsTrue(S_OK == hashstream->SetBackend(backend));
+                Assert::IsTrue(S_OK == hashstream->OpenToWrite(Crypto::MD5 | Crypto::SHA1 | Crypto::SHA256, nullptr));
+
+                // odd write sizes put the messages across blocks
+                for (size_t offset = 0, cbWrite = 1; offset < answer.Message.size(); offset += cbWrite, cbWrite += 7)
+                {
+                    cbWrite = std::min(cbWrite, answer.Message.size() - offset);
+                    ULONGLONG ullWritten = 0LL;
+                    Assert::IsTrue(
+                        S_OK == hashstream->Write((PVOID)(answer.Message.data() + offset), cbWrite, &ullWritten));
+                }
+
+                std::wstring hash;
+                Assert::IsTrue(S_OK == hashstream->GetHash(Crypto::MD5, hash));
+                Assert::AreEqual(answer.szMD5, hash.c_str());
+                Assert::IsTrue(S_OK == hashstream->GetHash(Crypto::SHA1, hash));
+                Assert::AreEqual(answer.szSHA1, hash.c_str());
+                Assert::IsTrue(S_OK == hashstream->GetHash(Crypto::SHA256, hash));
+                Assert::AreEqual(answer.szSHA256, hash.c_str());
+            }
+        }
+
+        // digests can be read while hashing goes on
+        auto sha256 = NativeHash::MakeSHA256();
+        BYTE digest[32], again[32];
+        sha256->Update(reinterpret_cast<const BYTE*>("abc"), 3);
+        sha256->GetDigest(digest);
+        sha256->GetDigest(again);
+        Assert::IsTrue(!memcmp(digest, again, sizeof(digest)));
+    }
+
+    TEST_METHOD(NativeHashDefaultBackendTest)
+    {
+        using Backend = CryptoHashStream::Backend;
+
+        Assert::IsTrue(CryptoHashStream::GetSupportedBackend(L"native") == Backend::Native);
+        Assert::IsTrue(CryptoHashStream::GetSupportedBackend(L"NativeSHANI") == Backend::NativeSHANI);
+        Assert::IsTrue(CryptoHashStream::GetSupportedBackend(L"CryptoAPI") == Backend::CryptoAPI);
+        Assert::IsFalse(CryptoHashStream::GetSupportedBackend(L"Nat").has_value());
+        Assert::IsFalse(CryptoHashStream::GetSupportedBackend(L"NativeAVX").has_value());
+
+        // streams created after the default changed use it, existing ones keep theirs
+        auto before = std::make_shared<CryptoHashStream>(_L_);
+        Assert::IsTrue(before->GetBackend() == Backend::CryptoAPI);
+
+        Assert::IsTrue(S_OK == CryptoHashStream::SetDefaultBackend(Backend::NativeScalar));
+        auto after = std::make_shared<CryptoHashStream>(_L_);
+        Assert::IsTrue(after->GetBackend() == Backend::NativeScalar);
+        Assert::IsTrue(before->GetBackend() == Backend::CryptoAPI);
+
+        Assert::IsTrue(S_OK == CryptoHashStream::SetDefaultBackend(Backend::CryptoAPI));
+    }
+
+    BEGIN_TEST_METHOD_ATTRIBUTE(NativeHashBenchmark)
+    TEST_METHOD_ATTRIBUTE(L"TestCategory", L"Benchmark")
+    END_TEST_METHOD_ATTRIBUTE()
+    TEST_METHOD(NativeHashBenchmark)
+    {
+        std::vector<BYTE> buffer(64 * 1024 * 1024);
+        for (size_t i = 0; i < buffer.size(); i++)
+            buffer[i] = static_cast<BYTE>((i * 2654435761LL) >> 13);
+
+        using Backend = CryptoHashStream::Backend;
+        using Crypto = CryptoHashStream::Algorithm;
+
+        const std::pair<Backend, LPCWSTR> backends[] = {{Backend::CryptoAPI, L"CryptoAPI"},
+                                                        {Backend::NativeScalar, L"native scalar"},
+                                                        {Backend::NativeSHANI, L"native SHA-NI"}};
+
+        for (auto alg : {Crypto::MD5, Crypto::SHA1, Crypto::SHA256})
+        {
+            std::wstring reference;
+
+            for (const auto& backend : backends)
+            {
+                if (CryptoHashStream::IsBackendSupported(backend.first) != S_OK)
+                    continue;
+
+                auto hashstream = std::make_shared<CryptoHashStream>(_L_);
+                Assert::IsTrue(S_OK == hashstream->SetBackend(backend.first));
+                Assert::IsTrue(S_OK == hashstream->OpenToWrite(alg, nullptr));
+
+                auto start = std::chrono::high_resolution_clock::now();
+                for (size_t offset = 0; offset < buffer.size(); offset += 1024 * 1024)
+                {
+                    ULONGLONG ullWritten = 0LL;
+                    Assert::IsTrue(S_OK == hashstream->Write(buffer.data() + offset, 1024 * 1024, &ullWritten));
+                }
+                auto elapsed = std::chrono::high_resolution_clock::now() - start;
+
+                const auto ms =
+                    std::max<long long>(1LL, std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count());
+                log::Info(
+                    _L_,
+                    L"Hash %s with %s: %I64d MB/s\r\n",
+                    CryptoHashStream::GetSupportedAlgorithm(alg).c_str(),
+                    backend.second,
+                    (buffer.size() * 1000LL / ms) / (1024 * 1024));
+
+                std::wstring hash;
+                Assert::IsTrue(S_OK == hashstream->GetHash(alg, hash));
+                if (reference.empty())
+                    reference = hash;
+                Assert::AreEqual(reference, hash);
+            }
+        }
+    }
 };
 }  // namespace Orc::Test
@@ -0,0 +1,85 @@
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+//
+// Copyright © 2011-2019 ANSSI. All Rights Reserved.
+//
+// Author(s): Jean Gautier (ANSSI)
+//
+#include "stdafx.h"
+
+#include "LogFileWriter.h"
+#include "MFTBaseline.h"
+#include "NtfsDataStructures.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace Orc;
+using namespace Orc::Test;
+
+namespace Orc::Test {
+TEST_CLASS(MFTBaselineTest)
+{
+private:
+    logger _L_;
+    UnitTestHelper helper;
+
+    static constexpr ULONG BytesPerFRS = 1024;
+
+public:
+    TEST_METHOD_INITIALIZE(Initialize)
+    {
+        _L_ = std::make_shared<LogFileWriter>();
+        helper.InitLogFileWriter(_L_);
+    }
+
+    TEST_METHOD_CLEANUP(Finalize) { helper.FinalizeLogFileWriter(_L_); }
+
+    TEST_METHOD(MFTBaselineDigestTest)
+    {
+        std::vector<BYTE> frs(BytesPerFRS, 0);
+        auto pHeader = (PFILE_RECORD_SEGMENT_HEADER)frs.data();
+        CopyMemory(pHeader->MultiSectorHeader.Signature, "FILE", 4);
+        pHeader->Reserved1 = 0x1234;
+
+        const auto digest = MFTBaseline::GetDigest(frs.data(), BytesPerFRS);
+        Assert::IsTrue(digest.IsValid());
+        Assert::IsTrue(digest.llLSN == 0x1234);
+        Assert::IsTrue(digest == MFTBaseline::GetDigest(frs.data(), BytesPerFRS));
+
+        // a change in the upper bits of the last word must be seen
+        frs[BytesPerFRS - 1] ^= 0x80;
+        Assert::IsFalse(digest == MFTBaseline::GetDigest(frs.data(), BytesPerFRS));
+    }
+
+    TEST_METHOD(MFTBaselineRoleTest)
+    {
+        MFTBaseline baseline;
+        std::shared_ptr<const MFTBaseline::Digests> digests;
+
+        constexpr auto Live = Location::Type::ImageFileDisk;
+        constexpr auto Snapshot = Location::Type::Snapshot;
+
+        // a snapshot walked before its volume neither builds nor compares
+        Assert::IsTrue(baseline.BeginWalk(1LL, Snapshot, digests) == MFTBaseline::Role::None);
+
+        // first walk of the volume builds, other walks starting meanwhile do not compare
+        Assert::IsTrue(baseline.BeginWalk(1LL, Live, digests) == MFTBaseline::Role::Build);
+        Assert::IsTrue(baseline.BeginWalk(1LL, Live, digests) == MFTBaseline::Role::None);
+        Assert::IsTrue(baseline.BeginWalk(1LL, Snapshot, digests) == MFTBaseline::Role::None);
+        Assert::IsTrue(baseline.BeginWalk(2LL, Live, digests) == MFTBaseline::Role::Build);
+
+        // an incomplete walk lets the next walk of the volume build the baseline
+        baseline.EndWalk(2LL, nullptr);
+        Assert::IsTrue(baseline.BeginWalk(2LL, Snapshot, digests) == MFTBaseline::Role::None);
+        Assert::IsTrue(baseline.BeginWalk(2LL, Live, digests) == MFTBaseline::Role::Build);
+
+        baseline.EndWalk(1LL, std::make_shared<MFTBaseline::Digests>(16));
+        Assert::IsTrue(baseline.BeginWalk(1LL, Snapshot, digests) == MFTBaseline::Role::Compare);
+        Assert::IsTrue(digests != nullptr && digests->size() == 16);
+
+        // the volume itself never compares
+        digests.reset();
+        Assert::IsTrue(baseline.BeginWalk(1LL, Live, digests) == MFTBaseline::Role::None);
+        Assert::IsTrue(digests == nullptr);
+    }
+};
+}  // namespace Orc::Test
@@ -0,0 +1,183 @@
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+//
+// Copyright © 2011-2019 ANSSI. All Rights Reserved.
+//
+// Author(s): Jean Gautier (ANSSI)
+//
+#include "stdafx.h"
+
+#include "LogFileWriter.h"
+#include "MFTFetcher.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace Orc;
+using namespace Orc::Test;
+
+namespace Orc::Test {
+TEST_CLASS(MFTFetcherTest)
+{
+private:
+    logger _L_;
+    UnitTestHelper helper;
+
+    static constexpr ULONG BytesPerFRS = 1024;
+    static constexpr ULONG FRSCount = 64;
+
+    std::vector<BYTE> m_MFT;
+    std::vector<ULONGLONG> m_ReadOffsets;
+
+public:
+    TEST_METHOD_INITIALIZE(Initialize)
+    {
+        _L_ = std::make_shared<LogFileWriter>();
+        helper.InitLogFileWriter(_L_);
+
+        m_MFT.assign(BytesPerFRS * FRSCount, 0);
+        for (ULONG i = 0; i < FRSCount; i++)
+        {
+            auto pHeader = (PFILE_RECORD_SEGMENT_HEADER)(m_MFT.data() + i * BytesPerFRS);
+            CopyMemory(pHeader->MultiSectorHeader.Signature, "FILE", 4);
+            pHeader->SegmentNumberLowPart = i;
+            pHeader->SegmentNumberHighPart = 0;
+            pHeader->SequenceNumber = 1;
+        }
+        m_ReadOffsets.clear();
+    }
+
+    TEST_METHOD_CLEANUP(Finalize) { helper.FinalizeLogFileWriter(_L_); }
+
+    TEST_METHOD(MFTFetcherCoalesceTest)
+    {
+        auto fetcher = GetFetcher();
+        fetcher.SetGapThreshold(16);
+
+        std::vector<ULONGLONG> fetched;
+        auto frn = References({30, 6, 3, 5});
+
+        Assert::IsTrue(S_OK == fetcher.Fetch(frn, GetCallback(fetched)));
+
+        // 3, 5 and 6 are read at once, 30 is too far
+        Assert::IsTrue(m_ReadOffsets == std::vector<ULONGLONG>({3 * BytesPerFRS, 30 * BytesPerFRS}));
+        Assert::IsTrue(fetched == std::vector<ULONGLONG>({3, 5, 6, 30}));
+        Assert::IsTrue(frn.empty());
+
+        // no gap allowed
+        m_ReadOffsets.clear();
+        fetched.clear();
+        fetcher.SetCacheSize(0);
+        fetcher.SetGapThreshold(0);
+        frn = References({3, 5, 6});
+
+        Assert::IsTrue(S_OK == fetcher.Fetch(frn, GetCallback(fetched)));
+        Assert::IsTrue(m_ReadOffsets == std::vector<ULONGLONG>({3 * BytesPerFRS, 5 * BytesPerFRS}));
+        Assert::IsTrue(fetched == std::vector<ULONGLONG>({3, 5, 6}));
+    };
+
+    TEST_METHOD(MFTFetcherCacheTest)
+    {
+        auto fetcher = GetFetcher();
+        fetcher.SetCacheSize(2);
+
+        std::vector<ULONGLONG> fetched;
+        auto frn = References({10});
+        Assert::IsTrue(S_OK == fetcher.Fetch(frn, GetCallback(fetched)));
+
+        frn = References({10});
+        Assert::IsTrue(S_OK == fetcher.Fetch(frn, GetCallback(fetched)));
+
+        Assert::IsTrue(fetcher.Reads() == 1);
+        Assert::IsTrue(fetcher.CacheHits() == 1);
+        Assert::IsTrue(fetched == std::vector<ULONGLONG>({10, 10}));
+
+        // 10 is evicted by 40 and 50
+        frn = References({40, 50, 10});
+        Assert::IsTrue(S_OK == fetcher.Fetch(frn, GetCallback(fetched)));
+        Assert::IsTrue(fetcher.CacheHits() == 2);
+        Assert::IsTrue(fetcher.Reads() == 2);
+
+        frn = References({10});
+        Assert::IsTrue(S_OK == fetcher.Fetch(frn, GetCallback(fetched)));
+        Assert::IsTrue(fetcher.CacheHits() == 2);
+        Assert::IsTrue(fetcher.Reads() == 3);
+
+        // sequence number mismatches are not delivered, even from the cache
+        fetched.clear();
+        frn = References({50});
+        frn[0].SequenceNumber = 2;
+        Assert::IsTrue(S_OK == fetcher.Fetch(frn, GetCallback(fetched)));
+        Assert::IsTrue(fetched.empty());
+        Assert::AreEqual((size_t)1, frn.size(), L"references not delivered are left to the caller");
+    };
+
+    TEST_METHOD(MFTFetcherNotFoundTest)
+    {
+        auto fetcher = GetFetcher();
+
+        // 7 was reused (stale sequence number), 100 is beyond the MFT: both are left in frn
+        std::vector<ULONGLONG> fetched;
+        auto frn = References({4, 7, 100, 8});
+        frn[1].SequenceNumber = 3;
+
+        Assert::IsTrue(S_OK == fetcher.Fetch(frn, GetCallback(fetched)));
+        Assert::IsTrue(fetched == std::vector<ULONGLONG>({4, 8}));
+
+        Assert::AreEqual((size_t)2, frn.size());
+        Assert::AreEqual((ULONG)7, frn[0].SegmentNumberLowPart);
+        Assert::AreEqual((USHORT)3, frn[0].SequenceNumber);
+        Assert::AreEqual((ULONG)100, frn[1].SegmentNumberLowPart);
+
+        // the stale reference is not delivered from the cache either
+        fetched.clear();
+        Assert::IsTrue(S_OK == fetcher.Fetch(frn, GetCallback(fetched)));
+        Assert::IsTrue(fetched.empty());
+        Assert::AreEqual((size_t)2, frn.size());
+    };
+
+private:
+    MFTFetcher GetFetcher()
+    {
+        return MFTFetcher(
+            _L_,
+            BytesPerFRS,
+            [](ULONGLONG ullSegmentNumber, ULONGLONG& ullOffset, ULONGLONG& ullContiguousFRS) {
+                if (ullSegmentNumber >= FRSCount)
+                    return false;
+                ullOffset = ullSegmentNumber * BytesPerFRS;
+                ullContiguousFRS = FRSCount - ullSegmentNumber;
+                return true;
+            },
+            [this](ULONGLONG ullOffset, CBinaryBuffer& buffer, ULONGLONG ullBytesToRead, ULONGLONG& ullBytesRead) {
+                m_ReadOffsets.push_back(ullOffset);
+                ullBytesRead = std::min<ULONGLONG>(ullBytesToRead, m_MFT.size() - ullOffset);
+                if (!buffer.CheckCount(static_cast<size_t>(ullBytesRead)))
+                    return E_OUTOFMEMORY;
+                CopyMemory(buffer.GetData(), m_MFT.data() + ullOffset, static_cast<size_t>(ullBytesRead));
+                return S_OK;
+            });
+    }
+
+    static MFTUtils::EnumMFTRecordCall GetCallback(std::vector<ULONGLONG>& fetched)
+    {
+        return [&fetched](MFTUtils::SafeMFTSegmentNumber& ullRecordIndex, CBinaryBuffer& Data) -> HRESULT {
+            auto pHeader = (PFILE_RECORD_SEGMENT_HEADER)Data.GetData();
+            Assert::IsTrue(pHeader->SegmentNumberLowPart == ullRecordIndex);
+            fetched.push_back(ullRecordIndex);
+            return S_OK;
+        };
+    }
+
+    static std::vector<MFT_SEGMENT_REFERENCE> References(std::initializer_list<ULONG> segments)
+    {
+        std::vector<MFT_SEGMENT_REFERENCE> retval;
+        for (auto segment : segments)
+        {
+            MFT_SEGMENT_REFERENCE frn = {0};
+            frn.SegmentNumberLowPart = segment;
+            frn.SequenceNumber = 1;
+            retval.push_back(frn);
+        }
+        return retval;
+    }
+};
+}  // namespace Orc::Test
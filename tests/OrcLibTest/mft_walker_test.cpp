@@ -12,11 +12,23 @@
 #include "Partition.h"
 #include "Location.h"
 #include "MFTWalker.h"
+#include "CachedVolumeReader.h"
+#include "NTFSStream.h"
 #include "FileStream.h"
 #include "TemporaryStream.h"
 #include "Temporary.h"
 #include "MFTRecordFileInfo.h"
 #include "BinaryBuffer.h"
+#include "YaraScanner.h"
+
+#include <Psapi.h>
+#include <ppl.h>
+
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <random>
+#include <thread>
 
 using namespace Microsoft::VisualStudio::CppUnitTestFramework;
 using namespace Orc;
@@ -50,31 +62,632 @@ public:
         DeleteFile(m_ArchiveItem.Path.c_str());
     };
 
-private:
-    DWORD64 m_NbFiles;
-    DWORD64 m_NbFolders;
-    Archive::ArchiveItem m_ArchiveItem;
+    TEST_METHOD(MFTWalkerPipelinedTest)
+    {
+        m_NbFiles = 0;
+        m_NbFolders = 0;
+        ProcessArchive(_L_, helper.GetDirectoryName(__WFILE__) + L"\\ntfs_images\\ntfs.7z");
+
+        std::vector<std::wstring> serialNames;
+        std::swap(serialNames, m_Names);
+        DeleteFile(m_ArchiveItem.Path.c_str());
 
-    void ProcessArchive(const logger& pLog, const std::wstring& archive)
+        m_NbFiles = 0;
+        m_NbFolders = 0;
+        ProcessArchive(_L_, helper.GetDirectoryName(__WFILE__) + L"\\ntfs_images\\ntfs.7z", 4);
+
+        Assert::IsTrue(m_NbFiles == 0x16);
+        Assert::IsTrue(m_NbFolders == 0x9);
+
+        // callbacks must be called in the very same order as the serial walker
+        Assert::IsTrue(serialNames == m_Names);
+
+        DeleteFile(m_ArchiveItem.Path.c_str());
+    };
+
+    TEST_METHOD(MFTWalkerReadAheadTest)
     {
-        // first extract archive
-        LPCWSTR archiveStr = archive.c_str();
+        // synchronous reads of one record at a time
+        m_NbFiles = 0;
+        m_NbFolders = 0;
+        ProcessArchive(_L_, helper.GetDirectoryName(__WFILE__) + L"\\ntfs_images\\ntfs.7z", 0L, 1L, 1L);
 
-        Assert::IsTrue(S_OK == ExtractArchive(pLog, archiveStr));
+        std::vector<std::wstring> syncNames;
+        std::swap(syncNames, m_Names);
+        DeleteFile(m_ArchiveItem.Path.c_str());
 
-        std::shared_ptr<ByteStream>& ntfsImageStream = m_ArchiveItem.Stream;
-        LPCWSTR ntfsImage = m_ArchiveItem.Path.c_str();
+        // chunks not aligned on the MFT size, three reads queued
+        m_NbFiles = 0;
+        m_NbFolders = 0;
+        ProcessArchive(_L_, helper.GetDirectoryName(__WFILE__) + L"\\ntfs_images\\ntfs.7z", 0L, 7L, 3L);
 
-        PartitionTable pt(pLog);
-        Assert::IsTrue(S_OK == pt.LoadPartitionTable(ntfsImage));
-        Assert::IsTrue(1 == pt.Table().size());
-        const Partition& p(pt.Table()[0]);
+        Assert::IsTrue(m_NbFiles == 0x16);
+        Assert::IsTrue(m_NbFolders == 0x9);
+        Assert::IsTrue(syncNames == m_Names);
 
-        std::wstringstream ss;
-        ss << std::wstring(ntfsImage);
-        ss << L",part=1";
+        DeleteFile(m_ArchiveItem.Path.c_str());
+    };
+
+    TEST_METHOD(MFTWalkerFullNameTest)
+    {
+        std::shared_ptr<Location> loc =
+            OpenArchive(_L_, helper.GetDirectoryName(__WFILE__) + L"\\ntfs_images\\ntfs.7z");
+        Assert::IsTrue(S_OK == loc->GetReader()->LoadDiskProperties());
+
+        // first walk: parent and main name of each directory
+        std::map<ULONGLONG, std::pair<ULONGLONG, std::wstring>> directories;
+        {
+            MFTWalker::Callbacks callBacks;
+            MFTWalker walker(_L_);
+
+            callBacks.ElementCallback = [&directories](
+                                            const std::shared_ptr<VolumeReader>& volreader, MFTRecord* pElt) {
+                if (!pElt->IsBaseRecord() || !pElt->IsDirectory())
+                    return;
+                const PFILE_NAME pFileName = pElt->GetDefaultFileName();
+                if (pFileName == nullptr)
+                    return;
+                directories.emplace(
+                    NtfsFullSegmentNumber(&pElt->GetFileReferenceNumber()),
+                    std::make_pair(
+                        NtfsFullSegmentNumber(&pFileName->ParentDirectory),
+                        std::wstring(pFileName->FileName, pFileName->FileNameLength)));
+            };
+
+            Assert::IsTrue(S_OK == walker.Initialize(loc, false));
+            Assert::IsTrue(S_OK == walker.Walk(callBacks));
+        }
+        Assert::IsTrue(directories.size() >= 0x9);
+
+        // the full name as built by the walker before the directory index: walk up the parents, the root is "."
+        auto ReferenceName = [&directories](
+                                 const PFILE_NAME pFileName, const std::shared_ptr<DataAttribute>& pDataAttr) {
+            std::vector<std::wstring> components;
+            ULONGLONG ullCurrent = NtfsFullSegmentNumber(&pFileName->ParentDirectory);
+            bool bReachedRoot = false;
+            while (true)
+            {
+                auto it = directories.find(ullCurrent);
+                if (it == end(directories))
+                    break;
+                if (it->second.second == L".")
+                {
+                    bReachedRoot = true;
+                    break;
+                }
+                components.push_back(it->second.second);
+                ullCurrent = it->second.first;
+            }
+
+            std::wstring name;
+            if (bReachedRoot)
+            {
+                name = L"\\";
+            }
+            else
+            {
+                WCHAR szPlaceHolder[24];
+                swprintf_s(szPlaceHolder, L"\\__%.16I64X__\\", ullCurrent);
+                name = szPlaceHolder;
+            }
+            for (auto it = components.rbegin(); it != components.rend(); ++it)
+            {
+                name.append(*it);
+                name.push_back(L'\\');
+            }
+            name.append(pFileName->FileName, pFileName->FileNameLength);
+
+            if (pDataAttr != nullptr && pDataAttr->Header()->NameLength)
+            {
+                name.push_back(L':');
+                name.append(
+                    (WCHAR*)(((BYTE*)pDataAttr->Header()) + pDataAttr->Header()->NameOffset),
+                    pDataAttr->Header()->NameLength);
+            }
+            return name;
+        };
+
+        // second walk: every full name, directories and streams included, matches the reference
+        DWORD dwNames = 0L;
+        {
+            MFTWalker::Callbacks callBacks;
+            MFTWalker walker(_L_);
+
+            callBacks.FileNameAndDataCallback = [&](const std::shared_ptr<VolumeReader>& volreader,
+                                                    MFTRecord* pElt,
+                                                    const PFILE_NAME pFileName,
+                                                    const std::shared_ptr<DataAttribute>& pDataAttr) {
+                Assert::IsTrue(ReferenceName(pFileName, pDataAttr) == walker.GetFullNameBuilder()(pFileName, pDataAttr));
+                dwNames++;
+            };
+            callBacks.DirectoryCallback = [&](const std::shared_ptr<VolumeReader>& volreader,
+                                              MFTRecord* pElt,
+                                              const PFILE_NAME pFileName,
+                                              const std::shared_ptr<IndexAllocationAttribute>& pAttr) {
+                Assert::IsTrue(ReferenceName(pFileName, nullptr) == walker.GetFullNameBuilder()(pFileName, nullptr));
+                dwNames++;
+            };
+
+            Assert::IsTrue(S_OK == walker.Initialize(loc, false));
+            Assert::IsTrue(S_OK == walker.Walk(callBacks));
+        }
+        Assert::IsTrue(dwNames >= 0x16 + 0x9);
+
+        m_ArchiveItem.Stream->Close();
+        DeleteFile(m_ArchiveItem.Path.c_str());
+    };
+
+    TEST_METHOD(MFTWalkerBaselineOrderTest)
+    {
+        std::shared_ptr<Location> loc =
+            OpenArchive(_L_, helper.GetDirectoryName(__WFILE__) + L"\\ntfs_images\\ntfs.7z");
+        Assert::IsTrue(S_OK == loc->GetReader()->LoadDiskProperties());
+
+        const ULONGLONG ullSerial = loc->GetReader()->VolumeSerialNumber();
+        Assert::IsTrue(ullSerial != 0LL);
+
+        auto baseline = std::make_shared<MFTBaseline>();
+        std::shared_ptr<const MFTBaseline::Digests> digests;
+
+        // a snapshot of the volume is walked first: it can only walk in full
+        Assert::IsTrue(baseline->BeginWalk(ullSerial, Location::Type::Snapshot, digests) == MFTBaseline::Role::None);
+        Assert::IsTrue(digests == nullptr);
+
+        auto WalkWithBaseline = [this, &loc, &baseline]() {
+            m_NbFiles = 0;
+            m_NbFolders = 0;
+
+            MFTWalker::Callbacks callBacks;
+            MFTWalker walker(_L_);
+            walker.SetBaseline(baseline);
+
+            callBacks.FileNameAndDataCallback = [this](
+                                                    const std::shared_ptr<VolumeReader>& volreader,
+                                                    MFTRecord* pElt,
+                                                    const PFILE_NAME pFileName,
+                                                    const std::shared_ptr<DataAttribute>& pDataAttr) { m_NbFiles++; };
+            callBacks.DirectoryCallback = [this](
+                                              const std::shared_ptr<VolumeReader>& volreader,
+                                              MFTRecord* pElt,
+                                              const PFILE_NAME pFileName,
+                                              const std::shared_ptr<IndexAllocationAttribute>& pAttr) {
+                m_NbFolders++;
+            };
+
+            Assert::IsTrue(S_OK == walker.Initialize(loc, false));
+            Assert::IsTrue(S_OK == walker.Walk(callBacks));
+        };
+
+        // the volume itself builds the baseline and all its records are called back
+        WalkWithBaseline();
+        Assert::IsTrue(m_NbFiles == 0x16);
+        Assert::IsTrue(m_NbFolders == 0x9);
+
+        // walking it again does not skip its unchanged records
+        WalkWithBaseline();
+        Assert::IsTrue(m_NbFiles == 0x16);
+        Assert::IsTrue(m_NbFolders == 0x9);
+
+        // snapshots walked from now on compare to the baseline built from the volume
+        Assert::IsTrue(
+            baseline->BeginWalk(ullSerial, Location::Type::Snapshot, digests) == MFTBaseline::Role::Compare);
+        Assert::IsTrue(digests != nullptr && !digests->empty());
+
+        m_ArchiveItem.Stream->Close();
+        DeleteFile(m_ArchiveItem.Path.c_str());
+    };
+
+    BEGIN_TEST_METHOD_ATTRIBUTE(MFTWalkerArenaBenchmark)
+    TEST_METHOD_ATTRIBUTE(L"TestCategory", L"Benchmark")
+    END_TEST_METHOD_ATTRIBUTE()
+    TEST_METHOD(MFTWalkerArenaBenchmark)
+    {
+        std::shared_ptr<Location> loc =
+            OpenArchive(_L_, helper.GetDirectoryName(__WFILE__) + L"\\ntfs_images\\ntfs.7z");
+        Assert::IsTrue(S_OK == loc->GetReader()->LoadDiskProperties());
+
+        const auto iterations = 50;
+
+        auto PrivateUsage = []() -> SIZE_T {
+            PROCESS_MEMORY_COUNTERS_EX counters;
+            ZeroMemory(&counters, sizeof(counters));
+            GetProcessMemoryInfo(GetCurrentProcess(), (PPROCESS_MEMORY_COUNTERS)&counters, sizeof(counters));
+            return counters.PrivateUsage;
+        };
+
+        auto Benchmark = [this, &loc, &PrivateUsage, iterations](bool bUseArena, std::vector<std::wstring>& names) {
+            const SIZE_T baseline = PrivateUsage();
+            std::chrono::nanoseconds elapsed(0);
+
+            // memory is sampled from another thread so that the walk is timed without the sampling cost
+            std::atomic<SIZE_T> peak = baseline;
+            std::atomic<bool> bWalking = true;
+            std::thread sampler([&peak, &bWalking, &PrivateUsage]() {
+                while (bWalking)
+                {
+                    const auto usage = PrivateUsage();
+                    auto current = peak.load();
+                    while (usage > current && !peak.compare_exchange_weak(current, usage))
+                        ;
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                }
+            });
+
+            HRESULT hr = S_OK;
+            for (auto i = 0; i < iterations && SUCCEEDED(hr); i++)
+            {
+                names.clear();
+
+                MFTWalker::Callbacks callBacks;
+                MFTWalker walker(_L_);
+
+                callBacks.FileNameAndDataCallback = [&](const std::shared_ptr<VolumeReader>& volreader,
+                                                        MFTRecord* pElt,
+                                                        const PFILE_NAME pFileName,
+                                                        const std::shared_ptr<DataAttribute>& pDataAttr) {
+                    names.push_back(walker.GetFullNameBuilder()(pFileName, pDataAttr));
+                };
+
+                walker.SetUseArena(bUseArena);
+
+                auto start = std::chrono::high_resolution_clock::now();
+                if (SUCCEEDED(hr = walker.Initialize(loc, false)))
+                    hr = walker.Walk(callBacks);
+                elapsed += std::chrono::high_resolution_clock::now() - start;
+            }
+
+            bWalking = false;
+            sampler.join();
+            Assert::IsTrue(S_OK == hr);
+
+            log::Info(
+                _L_,
+                L"MFT walk %s arena: %I64d us per walk, peak private bytes +%Iu KB\r\n",
+                bUseArena ? L"with" : L"without",
+                std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count() / iterations,
+                (peak.load() - baseline) / 1024);
+        };
+
+        std::vector<std::wstring> heapNames;
+        Benchmark(false, heapNames);
+
+        std::vector<std::wstring> arenaNames;
+        Benchmark(true, arenaNames);
+
+        Assert::IsTrue(arenaNames.size() == 0x16);
+        Assert::IsTrue(heapNames == arenaNames);
+
+        m_ArchiveItem.Stream->Close();
+        DeleteFile(m_ArchiveItem.Path.c_str());
+    };
+
+    TEST_METHOD(ArenaStorageThreadsTest)
+    {
+        const size_t threads = 8;
+        const size_t allocations = 20000;
+
+        std::vector<std::vector<ULONG_PTR*>> blocks(threads);
+        {
+            ArenaStorage arena;
+
+            // each thread carves from its own chunk, blocks must never overlap
+            Concurrency::parallel_for(size_t(0), threads, [&](size_t i) {
+                for (size_t j = 0; j < allocations; j++)
+                {
+                    auto pBlock = static_cast<ULONG_PTR*>(arena.Allocate(2 * sizeof(ULONG_PTR)));
+                    pBlock[0] = i;
+                    pBlock[1] = j;
+                    blocks[i].push_back(pBlock);
+                }
+            });
+
+            MFTRecord::FileNameVector names {ArenaStorage::Allocator<PFILE_NAME>(&arena)};
+            for (size_t i = 0; i < 1000; i++)
+                names.push_back(nullptr);
+            Assert::AreEqual((size_t)1000, names.size());
+
+            Assert::IsTrue(
+                arena.ChunkCount() >= threads * allocations * 2 * sizeof(ULONG_PTR) / ArenaStorage::CHUNK_SIZE);
+        }
+
+        // blocks outlive the arena and are released from another thread
+        for (size_t i = 0; i < threads; i++)
+        {
+            for (size_t j = 0; j < allocations; j++)
+            {
+                Assert::AreEqual((ULONG_PTR)i, blocks[i][j][0]);
+                Assert::AreEqual((ULONG_PTR)j, blocks[i][j][1]);
+                ArenaStorage::Deallocate(blocks[i][j], 2 * sizeof(ULONG_PTR));
+            }
+        }
+    }
+
+    TEST_METHOD(VolumeReaderReadAtTest)
+    {
+        std::shared_ptr<Location> loc =
+            OpenArchive(_L_, helper.GetDirectoryName(__WFILE__) + L"\\ntfs_images\\ntfs.7z");
+        auto volReader = loc->GetReader();
+        Assert::IsTrue(S_OK == volReader->LoadDiskProperties());
+
+        const ULONGLONG ullReference = 0x100000;
+        CBinaryBuffer reference(true);
+        ULONGLONG ullBytesRead = 0LL;
+        Assert::IsTrue(S_OK == volReader->Read(0LL, reference, ullReference, ullBytesRead));
+        Assert::IsTrue(ullBytesRead == ullReference);
+
+        // unaligned offsets and sizes, into owned buffers and into misaligned memory
+        std::mt19937 generator(0x0AC);
+        std::vector<std::pair<ULONGLONG, ULONGLONG>> reads;
+        for (auto i = 0; i < 256; i++)
+        {
+            const auto ullOffset = std::uniform_int_distribution<ULONGLONG>(0, ullReference - 1)(generator);
+            const auto ullSize = std::uniform_int_distribution<ULONGLONG>(1, ullReference - ullOffset)(generator);
+            reads.emplace_back(ullOffset, ullSize);
+        }
+
+        auto ReadAndCheck = [&volReader, &reference](ULONGLONG ullOffset, ULONGLONG ullSize, size_t misalignment) {
+            CBinaryBuffer owned;
+            ULONGLONG ullRead = 0LL;
+            Assert::IsTrue(S_OK == volReader->ReadAt(ullOffset, owned, ullSize, ullRead));
+            Assert::IsTrue(ullRead == ullSize);
+            Assert::IsTrue(!memcmp(owned.GetData(), reference.GetData() + ullOffset, static_cast<size_t>(ullSize)));
+
+            std::vector<BYTE> memory(static_cast<size_t>(ullSize) + misalignment);
+            CBinaryBuffer wrapped(memory.data() + misalignment, static_cast<size_t>(ullSize));
+            Assert::IsTrue(S_OK == volReader->ReadAt(ullOffset, wrapped, ullSize, ullRead));
+            Assert::IsTrue(ullRead == ullSize);
+            Assert::IsTrue(!memcmp(wrapped.GetData(), reference.GetData() + ullOffset, static_cast<size_t>(ullSize)));
+        };
+
+        for (const auto& read : reads)
+            ReadAndCheck(read.first, read.second, 0);
+
+        // the same reader shared by concurrent readers
+        Concurrency::parallel_for(size_t(0), reads.size(), [&](size_t i) {
+            ReadAndCheck(reads[i].first, reads[i].second, i % 7);
+        });
+
+        m_ArchiveItem.Stream->Close();
+        DeleteFile(m_ArchiveItem.Path.c_str());
+    };
+
+    TEST_METHOD(NTFSStreamReadTest)
+    {
+        std::shared_ptr<Location> loc =
+            OpenArchive(_L_, helper.GetDirectoryName(__WFILE__) + L"\\ntfs_images\\ntfs.7z");
+        Assert::IsTrue(S_OK == loc->GetReader()->LoadDiskProperties());
+
+        MFTWalker::Callbacks callBacks;
+        MFTWalker walker(_L_);
+
+        std::mt19937 generator(0x0AC);
+        DWORD dwStreams = 0L;
+
+        callBacks.FileNameAndDataCallback = [this, &generator, &dwStreams](
+                                                const std::shared_ptr<VolumeReader>& volreader,
+                                                MFTRecord* pElt,
+                                                const PFILE_NAME pFileName,
+                                                const std::shared_ptr<DataAttribute>& pDataAttr) {
+            // compressed data is read through UncompressNTFSStream
+            if (pDataAttr == nullptr || !pDataAttr->IsNonResident()
+                || pDataAttr->Header()->Form.Nonresident.CompressionUnit != 0)
+                return;
+
+            NTFSStream stream(_L_);
+            Assert::IsTrue(S_OK == stream.OpenStream(volreader, pDataAttr));
+
+            const auto ullSize = stream.GetSize();
+            if (ullSize == 0LL)
+                return;
+            dwStreams++;
+
+            // the whole stream in one read, across all its segments
+            std::vector<BYTE> whole(static_cast<size_t>(ullSize));
+            ULONGLONG ullRead = 0LL;
+            Assert::IsTrue(S_OK == stream.Read(whole.data(), ullSize, &ullRead));
+            Assert::IsTrue(ullRead == ullSize);
+
+            // reads straddling segment boundaries
+            std::vector<BYTE> chunked(static_cast<size_t>(ullSize));
+            Assert::IsTrue(S_OK == stream.SetFilePointer(0LL, FILE_BEGIN, nullptr));
+            ULONGLONG ullTotal = 0LL;
+            do
+            {
+                Assert::IsTrue(
+                    S_OK
+                    == stream.Read(
+                        chunked.data() + ullTotal, std::min<ULONGLONG>(4097, ullSize - ullTotal), &ullRead));
+                ullTotal += ullRead;
+            } while (ullRead > 0 && ullTotal < ullSize);
+            Assert::IsTrue(ullTotal == ullSize);
+            Assert::IsTrue(whole == chunked);
+
+            // seeks from each origin
+            for (auto i = 0; i < 16; i++)
+            {
+                const auto ullOffset = std::uniform_int_distribution<ULONGLONG>(0, ullSize - 1)(generator);
+                BYTE buffer[512];
+                const auto ullToRead = std::min<ULONGLONG>(sizeof(buffer), ullSize - ullOffset);
+                ULONG64 ullPosition = 0LL;
+
+                switch (i % 3)
+                {
+                    case 0:
+                        Assert::IsTrue(S_OK == stream.SetFilePointer(ullOffset, FILE_BEGIN, &ullPosition));
+                        break;
+                    case 1:
+                        Assert::IsTrue(
+                            S_OK
+                            == stream.SetFilePointer(
+                                static_cast<LONGLONG>(ullOffset) - static_cast<LONGLONG>(ullSize),
+                                FILE_END,
+                                &ullPosition));
+                        break;
+                    case 2:
+                        Assert::IsTrue(S_OK == stream.SetFilePointer(0LL, FILE_BEGIN, nullptr));
+                        Assert::IsTrue(S_OK == stream.SetFilePointer(ullOffset, FILE_CURRENT, &ullPosition));
+                        break;
+                }
+                Assert::IsTrue(ullPosition == ullOffset);
+                Assert::IsTrue(S_OK == stream.Read(buffer, ullToRead, &ullRead));
+                Assert::IsTrue(ullRead == ullToRead);
+                Assert::IsTrue(!memcmp(buffer, whole.data() + ullOffset, static_cast<size_t>(ullToRead)));
+            }
+        };
+
+        Assert::IsTrue(S_OK == walker.Initialize(loc, false));
+        Assert::IsTrue(S_OK == walker.Walk(callBacks));
+        Assert::IsTrue(dwStreams > 0);
+
+        m_ArchiveItem.Stream->Close();
+        DeleteFile(m_ArchiveItem.Path.c_str());
+    };
+
+    TEST_METHOD(YaraFileMappingNTFSStreamTest)
+    {
+        using namespace std::string_literals;
+
+        std::shared_ptr<Location> loc =
+            OpenArchive(_L_, helper.GetDirectoryName(__WFILE__) + L"\\ntfs_images\\ntfs.7z");
+        Assert::IsTrue(S_OK == loc->GetReader()->LoadDiskProperties());
+
+        YaraScanner scanner(_L_);
+        Assert::IsTrue(SUCCEEDED(scanner.Initialize()));
+
+        auto config = std::make_unique<YaraConfig>();
+        Assert::IsTrue(SUCCEEDED(config->SetBlockSize(0x1000)));
+        Assert::IsTrue(SUCCEEDED(config->SetOverlapSize(0x1000)));
+        Assert::IsTrue(SUCCEEDED(config->SetScanMethod(L"filemapping")));
+        Assert::IsTrue(SUCCEEDED(scanner.Configure(config)));
+
+        // scanned by blocks, a stream would only ever be seen as at most a block long
+        const auto rules = R"(
+				rule whole_stream {
+					condition :
+						filesize > 0x1000
+				}
+				rule block_sized {
+					condition :
+						filesize <= 0x1000
+				}
+			)"s;
+        CBinaryBuffer buffer;
+        buffer.SetData((LPBYTE)rules.c_str(), rules.size());
+        Assert::IsTrue(SUCCEEDED(scanner.AddRules(buffer)));
+
+        MFTWalker::Callbacks callBacks;
+        MFTWalker walker(_L_);
+
+        DWORD dwLargeStreams = 0L;
+        callBacks.FileNameAndDataCallback = [this, &scanner, &dwLargeStreams](
+                                                const std::shared_ptr<VolumeReader>& volreader,
+                                                MFTRecord* pElt,
+                                                const PFILE_NAME pFileName,
+                                                const std::shared_ptr<DataAttribute>& pDataAttr) {
+            if (pDataAttr == nullptr || !pDataAttr->IsNonResident()
+                || pDataAttr->Header()->Form.Nonresident.CompressionUnit != 0)
+                return;
+
+            auto stream = std::make_shared<NTFSStream>(_L_);
+            Assert::IsTrue(S_OK == stream->OpenStream(volreader, pDataAttr));
+            if (stream->GetSize() == 0LL)
+                return;
+
+            MatchingRuleCollection matchingRules;
+            Assert::IsTrue(SUCCEEDED(scanner.Scan(stream, matchingRules)));
+            Assert::AreEqual(static_cast<size_t>(1), matchingRules.size());
 
-        std::shared_ptr<Location> loc = std::make_shared<Location>(pLog, ss.str(), Location::ImageFileDisk);
+            if (stream->GetSize() > 0x1000)
+            {
+                Assert::IsTrue(matchingRules.front() == "whole_stream");
+                dwLargeStreams++;
+            }
+            else
+                Assert::IsTrue(matchingRules.front() == "block_sized");
+        };
+
+        Assert::IsTrue(S_OK == walker.Initialize(loc, false));
+        Assert::IsTrue(S_OK == walker.Walk(callBacks));
+
+        // $MFT and $LogFile at least
+        Assert::IsTrue(dwLargeStreams > 0);
+
+        m_ArchiveItem.Stream->Close();
+        DeleteFile(m_ArchiveItem.Path.c_str());
+    };
+
+    TEST_METHOD(CachedVolumeReaderTest)
+    {
+        std::shared_ptr<Location> loc =
+            OpenArchive(_L_, helper.GetDirectoryName(__WFILE__) + L"\\ntfs_images\\ntfs.7z");
+        auto volReader = loc->GetReader();
+        Assert::IsTrue(S_OK == volReader->LoadDiskProperties());
+
+        const ULONGLONG ullReference = 0x100000;
+        CBinaryBuffer reference(true);
+        ULONGLONG ullBytesRead = 0LL;
+        Assert::IsTrue(S_OK == volReader->Read(0LL, reference, ullReference, ullBytesRead));
+        Assert::IsTrue(ullBytesRead == ullReference);
+
+        // a budget of 16 blocks, much smaller than the reads below so that blocks get evicted
+        auto cached = std::make_shared<CachedVolumeReader>(_L_, volReader, 16 * 4 * volReader->GetBytesPerCluster());
+        Assert::IsTrue(cached->GetBytesPerCluster() == volReader->GetBytesPerCluster());
+
+        std::mt19937 generator(0x0AC);
+        std::vector<std::pair<ULONGLONG, ULONGLONG>> reads;
+        for (auto i = 0; i < 512; i++)
+        {
+            const auto ullOffset = std::uniform_int_distribution<ULONGLONG>(0, ullReference - 1)(generator);
+            const auto ullSize = std::uniform_int_distribution<ULONGLONG>(1, 0x3000)(generator);
+            reads.emplace_back(ullOffset, std::min(ullSize, ullReference - ullOffset));
+        }
+        // one read of the bypass size
+        reads.emplace_back(0x1000, CachedVolumeReader::DEFAULT_BYPASS_SIZE);
+
+        auto ReadAndCheck = [&reference](
+                                const std::shared_ptr<VolumeReader>& reader, ULONGLONG ullOffset, ULONGLONG ullSize) {
+            CBinaryBuffer data;
+            ULONGLONG ullRead = 0LL;
+            Assert::IsTrue(S_OK == reader->ReadAt(ullOffset, data, ullSize, ullRead));
+            Assert::IsTrue(ullRead == ullSize);
+            Assert::IsTrue(!memcmp(data.GetData(), reference.GetData() + ullOffset, static_cast<size_t>(ullSize)));
+        };
+
+        for (const auto& read : reads)
+            ReadAndCheck(cached, read.first, read.second);
+
+        // the same reads again, concurrently and through a reader sharing the cache
+        auto reopened = cached->ReOpen(GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, 0L);
+        Assert::IsTrue(reopened != nullptr);
+        Concurrency::parallel_for(size_t(0), reads.size(), [&](size_t i) {
+            ReadAndCheck(i % 2 ? cached : reopened, reads[i].first, reads[i].second);
+        });
+
+        const auto stats = cached->GetStatistics();
+        Assert::IsTrue(stats.Hits > 0);
+        Assert::IsTrue(stats.Misses > 0);
+        Assert::IsTrue(stats.Evicted > 0);
+        Assert::IsTrue(stats.Bypassed == 2);
+        Assert::IsTrue(stats.BytesCached <= 16 * 4 * volReader->GetBytesPerCluster());
+
+        m_ArchiveItem.Stream->Close();
+        DeleteFile(m_ArchiveItem.Path.c_str());
+    };
+
+private:
+    DWORD64 m_NbFiles;
+    DWORD64 m_NbFolders;
+    std::vector<std::wstring> m_Names;
+    Archive::ArchiveItem m_ArchiveItem;
+
+    void ProcessArchive(
+        const logger& pLog,
+        const std::wstring& archive,
+        DWORD dwParseThreads = 0L,
+        DWORD dwFRSPerRead = 0L,
+        DWORD dwReadAhead = 0L)
+    {
+        std::shared_ptr<Location> loc = OpenArchive(pLog, archive);
         std::shared_ptr<VolumeReader> volReader = loc->GetReader();
 
         // update reader
@@ -115,6 +728,7 @@ private:
                 Assert::IsTrue(!memcmp(fi.GetDetails()->SHA1().GetData(), sha1, sizeof(sha1)));
             }
 
+            m_Names.push_back(walker.GetFullNameBuilder()(pFileName, pDataAttr));
             m_NbFiles++;
         };
 
@@ -124,10 +738,33 @@ private:
                                           const PFILE_NAME pFileName,
                                           const std::shared_ptr<IndexAllocationAttribute>& pAttr) { m_NbFolders++; };
 
+        walker.SetParseThreads(dwParseThreads);
+        walker.SetReadAhead(dwFRSPerRead, dwReadAhead);
+
         Assert::IsTrue(S_OK == walker.Initialize(loc, false));
         Assert::IsTrue(S_OK == walker.Walk(callBacks));
 
-        ntfsImageStream->Close();
+        m_ArchiveItem.Stream->Close();
+    }
+
+    std::shared_ptr<Location> OpenArchive(const logger& pLog, const std::wstring& archive)
+    {
+        // first extract archive
+        LPCWSTR archiveStr = archive.c_str();
+
+        Assert::IsTrue(S_OK == ExtractArchive(pLog, archiveStr));
+
+        LPCWSTR ntfsImage = m_ArchiveItem.Path.c_str();
+
+        PartitionTable pt(pLog);
+        Assert::IsTrue(S_OK == pt.LoadPartitionTable(ntfsImage));
+        Assert::IsTrue(1 == pt.Table().size());
+
+        std::wstringstream ss;
+        ss << std::wstring(ntfsImage);
+        ss << L",part=1";
+
+        return std::make_shared<Location>(pLog, ss.str(), Location::ImageFileDisk);
     }
 
     HRESULT ExtractArchive(const logger& pLog, LPCWSTR archive)
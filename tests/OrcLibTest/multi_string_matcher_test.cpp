@@ -0,0 +1,65 @@
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+//
+// Copyright © 2011-2019 ANSSI. All Rights Reserved.
+//
+// Author(s): Jean Gautier (ANSSI)
+//
+#include "stdafx.h"
+
+#include "LogFileWriter.h"
+#include "MultiStringMatcher.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace Orc;
+using namespace Orc::Test;
+
+namespace Orc::Test {
+TEST_CLASS(MultiStringMatcherTest)
+{
+private:
+    logger _L_;
+    UnitTestHelper helper;
+
+public:
+    TEST_METHOD_INITIALIZE(Initialize)
+    {
+        _L_ = std::make_shared<LogFileWriter>();
+        helper.InitLogFileWriter(_L_);
+    }
+
+    TEST_METHOD_CLEANUP(Finalize) { helper.FinalizeLogFileWriter(_L_); }
+
+    TEST_METHOD(MultiStringMatcherSearchTest)
+    {
+        MultiStringMatcher matcher;
+
+        Assert::IsTrue(S_OK == matcher.AddPattern(L"he", 0));
+        Assert::IsTrue(S_OK == matcher.AddPattern(L"she", 1));
+        Assert::IsTrue(S_OK == matcher.AddPattern(L"his", 2));
+        Assert::IsTrue(S_OK == matcher.AddPattern(L"hers", 3));
+        Assert::IsTrue(S_OK == matcher.AddPattern(L".EXE", 4));
+        Assert::IsTrue(E_INVALIDARG == matcher.AddPattern(L"", 5));
+        Assert::IsTrue(E_INVALIDARG == matcher.AddPattern(L"été", 5));
+
+        Assert::IsTrue(S_OK == matcher.Compile());
+
+        // "she" is found through "ushers", "he" and "hers" as suffixes
+        Assert::IsTrue(Search(matcher, L"ushers") == std::vector<BYTE>({1, 1, 0, 1, 0, 0}));
+        Assert::IsTrue(Search(matcher, L"hiS") == std::vector<BYTE>({0, 0, 1, 0, 0, 0}));
+        Assert::IsTrue(Search(matcher, L"notepad.exe") == std::vector<BYTE>({0, 0, 0, 0, 1, 0}));
+
+        // non ASCII characters reset the automaton
+        Assert::IsTrue(Search(matcher, L"hérs") == std::vector<BYTE>({0, 0, 0, 0, 0, 0}));
+        Assert::IsTrue(Search(matcher, L"") == std::vector<BYTE>({0, 0, 0, 0, 0, 0}));
+    }
+
+private:
+    static std::vector<BYTE> Search(const MultiStringMatcher& matcher, const std::wstring& str)
+    {
+        std::vector<BYTE> found(6, 0);
+        matcher.Search(str.c_str(), str.size(), found);
+        return found;
+    }
+};
+}  // namespace Orc::Test
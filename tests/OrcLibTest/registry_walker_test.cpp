@@ -0,0 +1,152 @@
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+//
+// Copyright © 2011-2019 ANSSI. All Rights Reserved.
+//
+// Author(s): Jean Gautier (ANSSI)
+//
+#include "stdafx.h"
+
+#include "LogFileWriter.h"
+#include "FileStream.h"
+#include "MemoryStream.h"
+#include "RegistryWalker.h"
+#include "Temporary.h"
+
+#include <tuple>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace Orc;
+using namespace Orc::Test;
+
+namespace Orc::Test {
+TEST_CLASS(RegistryWalkerTest)
+{
+private:
+    logger _L_;
+    UnitTestHelper helper;
+
+    std::wstring m_strHivePath;
+
+    using Value = std::tuple<std::string, std::string, ValueType, std::vector<BYTE>>;
+
+    struct WalkResult
+    {
+        std::vector<std::string> Keys;
+        std::vector<Value> Values;
+    };
+
+    // Creates a small application hive: a few hundred keys, small values and values spanning several pages
+    void CreateHive()
+    {
+        WCHAR szTempDir[MAX_PATH];
+        Assert::IsTrue(SUCCEEDED(UtilGetTempDirPath(szTempDir, MAX_PATH)));
+        Assert::IsTrue(SUCCEEDED(UtilGetUniquePath(szTempDir, L"registry_walker_test.hiv", m_strHivePath)));
+
+        HKEY hHive = NULL;
+        Assert::AreEqual(
+            ERROR_SUCCESS, RegLoadAppKeyW(m_strHivePath.c_str(), &hHive, KEY_ALL_ACCESS, REG_PROCESS_APPKEY, 0L));
+
+        for (DWORD i = 0; i < 256; i++)
+        {
+            HKEY hKey = NULL;
+            const auto strKey = fmt::format(L"Orc\\Key{}\\Sub{}", i % 16, i);
+            Assert::AreEqual(
+                ERROR_SUCCESS,
+                RegCreateKeyExW(hHive, strKey.c_str(), 0L, NULL, 0L, KEY_ALL_ACCESS, NULL, &hKey, NULL));
+
+            const auto strValue = fmt::format(L"Value of key {}", i);
+            RegSetValueExW(
+                hKey,
+                L"String",
+                0L,
+                REG_SZ,
+                (const BYTE*)strValue.c_str(),
+                (DWORD)((strValue.size() + 1) * sizeof(WCHAR)));
+            RegSetValueExW(hKey, L"Index", 0L, REG_DWORD, (const BYTE*)&i, sizeof(i));
+
+            if (i % 32 == 0)
+            {
+                std::vector<BYTE> data(12000);
+                for (size_t j = 0; j < data.size(); j++)
+                    data[j] = (BYTE)(i + j);
+                RegSetValueExW(hKey, L"Binary", 0L, REG_BINARY, data.data(), (DWORD)data.size());
+            }
+            RegCloseKey(hKey);
+        }
+
+        // the hive is written to its file when its last handle is closed
+        RegFlushKey(hHive);
+        Assert::AreEqual(ERROR_SUCCESS, RegCloseKey(hHive));
+    }
+
+    WalkResult Walk(const std::shared_ptr<ByteStream>& stream)
+    {
+        RegistryHive hive(_L_);
+        Assert::IsTrue(S_OK == hive.LoadHive(stream));
+
+        WalkResult result;
+        Assert::IsTrue(SUCCEEDED(hive.Walk(
+            [&result](const RegistryKey* const pKey) { result.Keys.push_back(pKey->GetKeyName()); },
+            [&result](const RegistryValue* const pValue) {
+                const BYTE* pData = nullptr;
+                auto size = pValue->GetDatas(&pData);
+                result.Values.emplace_back(
+                    pValue->GetParentKey()->GetKeyName(),
+                    pValue->GetValueName(),
+                    pValue->GetType(),
+                    std::vector<BYTE>(pData, pData + (pData != nullptr ? size : 0)));
+            })));
+        return result;
+    }
+
+public:
+    TEST_METHOD_INITIALIZE(Initialize)
+    {
+        _L_ = std::make_shared<LogFileWriter>();
+        helper.InitLogFileWriter(_L_);
+    }
+
+    TEST_METHOD_CLEANUP(Finalize)
+    {
+        if (!m_strHivePath.empty())
+        {
+            DeleteFileW(m_strHivePath.c_str());
+            DeleteFileW((m_strHivePath + L".LOG1").c_str());
+            DeleteFileW((m_strHivePath + L".LOG2").c_str());
+        }
+        helper.FinalizeLogFileWriter(_L_);
+    }
+
+    TEST_METHOD(MappedAndPagedHives)
+    {
+        CreateHive();
+
+        // a hive file is mapped
+        auto file_stream = std::make_shared<FileStream>(_L_);
+        Assert::IsTrue(SUCCEEDED(file_stream->ReadFrom(m_strHivePath.c_str())));
+        const auto mapped = Walk(file_stream);
+
+        // other streams are read page by page as the walk reaches their cells
+        auto source = std::make_shared<FileStream>(_L_);
+        Assert::IsTrue(SUCCEEDED(source->ReadFrom(m_strHivePath.c_str())));
+        auto memory_stream = std::make_shared<MemoryStream>(_L_);
+        Assert::IsTrue(SUCCEEDED(memory_stream->OpenForReadWrite((DWORD)source->GetSize())));
+        Assert::IsTrue(SUCCEEDED(source->CopyTo(memory_stream, nullptr)));
+        Assert::IsTrue(SUCCEEDED(memory_stream->SetFilePointer(0LL, FILE_BEGIN, nullptr)));
+        const auto paged = Walk(memory_stream);
+
+        // root, Orc, 16 Key and 256 Sub keys, with 2 values each and 8 binary values
+        Assert::AreEqual((size_t)(1 + 1 + 16 + 256), mapped.Keys.size());
+        Assert::AreEqual((size_t)(256 * 2 + 8), mapped.Values.size());
+
+        Assert::IsTrue(mapped.Keys == paged.Keys, L"keys must be walked alike");
+        Assert::IsTrue(mapped.Values == paged.Values, L"values must be walked alike");
+
+        const auto binaries = std::count_if(mapped.Values.cbegin(), mapped.Values.cend(), [](const Value& value) {
+            return std::get<2>(value) == ValueType::RegBin && std::get<3>(value).size() == 12000;
+        });
+        Assert::AreEqual((ptrdiff_t)8, binaries);
+    }
+};
+}  // namespace Orc::Test
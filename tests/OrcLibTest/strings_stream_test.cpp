@@ -0,0 +1,212 @@
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+//
+// Copyright © 2011-2019 ANSSI. All Rights Reserved.
+//
+// Author(s): Jean Gautier (ANSSI)
+//
+#include "stdafx.h"
+
+#include "LogFileWriter.h"
+#include "MemoryStream.h"
+#include "StringsStream.h"
+
+#include <chrono>
+#include <random>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace Orc;
+using namespace Orc::Test;
+
+namespace Orc::Test {
+TEST_CLASS(StringsStreamTest)
+{
+private:
+    logger _L_;
+    UnitTestHelper helper;
+
+    static constexpr StringsStream::ScanMethod Methods[] = {StringsStream::ScanMethod::Scalar,
+                                                           StringsStream::ScanMethod::SSE2,
+                                                           StringsStream::ScanMethod::AVX2,
+                                                           StringsStream::ScanMethod::Auto};
+
+public:
+    TEST_METHOD_INITIALIZE(Initialize)
+    {
+        _L_ = std::make_shared<LogFileWriter>();
+        helper.InitLogFileWriter(_L_);
+    }
+
+    TEST_METHOD_CLEANUP(Finalize) { helper.FinalizeLogFileWriter(_L_); }
+
+    TEST_METHOD(StringsStreamBasicTest)
+    {
+        const BYTE data[] = {0x01, 0x02, 'h', 'e', 'l',  'l', 'o', 0x00, 'w', 'o', 'r', 'l',
+                             'd',  0x01, 'w', 0x00, 'i', 0x00, 'd', 0x00, 'e', 0x00, 0x00};
+
+        std::vector<BYTE> buffer(std::cbegin(data), std::cend(data));
+
+        Assert::IsTrue(Extract(buffer, 4, StringsStream::ScanMethod::EachOffset, 0x100) == "hello\r\nworld\r\nwide\r\n");
+        for (auto method : Methods)
+        {
+            if (StringsStream::IsScanMethodSupported(method) == S_OK)
+                Assert::IsTrue(Extract(buffer, 4, method, 0x100) == "hello\r\nworld\r\nwide\r\n");
+        }
+    }
+
+    TEST_METHOD(StringsStreamScanMethodsTest)
+    {
+        const auto buffer = SyntheticBinary(4 * 1024 * 1024);
+
+        for (size_t minChars : {2, 3, 4, 8})
+        {
+            // odd read sizes put strings across reads
+            const auto reference = Extract(buffer, minChars, StringsStream::ScanMethod::EachOffset, 0x10001);
+            Assert::IsFalse(reference.empty());
+
+            for (auto method : Methods)
+            {
+                if (StringsStream::IsScanMethodSupported(method) != S_OK)
+                    continue;
+                Assert::IsTrue(Extract(buffer, minChars, method, 0x10001) == reference);
+            }
+        }
+    }
+
+    TEST_METHOD(StringsStreamBenchmark)
+    {
+        const auto buffer = SyntheticBinary(64 * 1024 * 1024);
+
+        auto Benchmark = [this, &buffer](StringsStream::ScanMethod method, LPCWSTR szName) {
+            auto start = std::chrono::high_resolution_clock::now();
+            auto strings = Extract(buffer, 4, method, 0x100000);
+            auto elapsed = std::chrono::high_resolution_clock::now() - start;
+
+            const auto ms = std::max<long long>(
+                1LL, std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count());
+            log::Info(
+                _L_,
+                L"Strings %s scan: %I64d ms, %I64d MB/s\r\n",
+                szName,
+                ms,
+                (buffer.size() * 1000LL / ms) / (1024 * 1024));
+            return strings;
+        };
+
+        const auto reference = Benchmark(StringsStream::ScanMethod::EachOffset, L"each offset");
+        Assert::IsTrue(Benchmark(StringsStream::ScanMethod::Scalar, L"scalar") == reference);
+
+        if (StringsStream::IsScanMethodSupported(StringsStream::ScanMethod::SSE2) == S_OK)
+            Assert::IsTrue(Benchmark(StringsStream::ScanMethod::SSE2, L"SSE2") == reference);
+        if (StringsStream::IsScanMethodSupported(StringsStream::ScanMethod::AVX2) == S_OK)
+            Assert::IsTrue(Benchmark(StringsStream::ScanMethod::AVX2, L"AVX2") == reference);
+    }
+
+private:
+    // Random bytes sprinkled with ascii and unicode strings of all lengths and x86 string pushes
+    static std::vector<BYTE> SyntheticBinary(size_t cbSize)
+    {
+        std::mt19937 generator(0x0AC);
+        auto Random = [&generator](size_t max) { return std::uniform_int_distribution<size_t>(0, max)(generator); };
+        auto Printable = [&Random]() { return static_cast<BYTE>(0x20 + Random(0x5E)); };
+
+        std::vector<BYTE> buffer;
+        buffer.reserve(cbSize + 0x10000);
+
+        while (buffer.size() < cbSize)
+        {
+            for (auto i = Random(0x200); i > 0; i--)
+                buffer.push_back(static_cast<BYTE>(Random(0xFF)));
+
+            switch (Random(9))
+            {
+                case 0:
+                case 1:
+                case 2:
+                    for (auto i = Random(40); i > 0; i--)
+                        buffer.push_back(Printable());
+                    break;
+                case 3:
+                    for (auto i = Random(40); i > 0; i--)
+                    {
+                        buffer.push_back(Printable());
+                        buffer.push_back(0);
+                    }
+                    break;
+                case 4:
+                    // ascii string running into a unicode one
+                    for (auto i = Random(8); i > 0; i--)
+                        buffer.push_back(Printable());
+                    for (auto i = Random(8); i > 0; i--)
+                    {
+                        buffer.push_back(Printable());
+                        buffer.push_back(0);
+                    }
+                    break;
+                case 5:
+                    // C7 45 xx imm32, mov dword [ebp+imm8]
+                    for (auto i = Random(6); i > 0; i--)
+                    {
+                        buffer.insert(std::end(buffer), {0xC7, 0x45, static_cast<BYTE>(Random(0xFF))});
+                        for (auto j = 0; j < 4; j++)
+                            buffer.push_back(Printable());
+                    }
+                    break;
+                case 6:
+                    // C6 85 xx xx xx xx imm8, mov byte [ebp+imm32]
+                    for (auto i = Random(10); i > 0; i--)
+                    {
+                        buffer.insert(std::end(buffer), {0xC6, 0x85, 0xF0, 0xFE, 0xFF, 0xFF, Printable()});
+                    }
+                    break;
+                case 7:
+                    // 66 C7 45 xx imm16, mov word [ebp+imm8], as unicode characters
+                    for (auto i = Random(10); i > 0; i--)
+                    {
+                        buffer.insert(std::end(buffer), {0x66, 0xC7, 0x45, static_cast<BYTE>(Random(0xFF))});
+                        buffer.insert(std::end(buffer), {Printable(), 0x00});
+                    }
+                    break;
+                case 8:
+                    // long runs, beyond the maximum string size
+                    if (Random(64) == 0)
+                    {
+                        for (auto i = 0x1000 + Random(0x4000); i > 0; i--)
+                            buffer.push_back(Printable());
+                    }
+                    break;
+                default:
+                    break;
+            }
+        }
+        return buffer;
+    }
+
+    std::string Extract(const std::vector<BYTE>& buffer, size_t minChars, StringsStream::ScanMethod method, size_t cbRead)
+    {
+        auto pMemStream = std::make_shared<MemoryStream>(_L_);
+        Assert::IsTrue(S_OK == pMemStream->OpenForReadOnly((PVOID)buffer.data(), buffer.size()));
+
+        auto pStrings = std::make_shared<StringsStream>(_L_);
+        Assert::IsTrue(S_OK == pStrings->OpenForStrings(pMemStream, minChars, 0x2000));
+        Assert::IsTrue(S_OK == pStrings->SetScanMethod(method));
+
+        std::string strings;
+        std::vector<CHAR> read(cbRead);
+        for (;;)
+        {
+            ULONGLONG cbBytesRead = 0LL;
+            Assert::IsTrue(SUCCEEDED(pStrings->Read(read.data(), read.size(), &cbBytesRead)));
+
+            strings.append(read.data(), std::min<size_t>(static_cast<size_t>(cbBytesRead), read.size()));
+
+            // a read may find no string at all, the end of the data is told by the chained stream
+            ULONG64 ullPosition = 0LL;
+            Assert::IsTrue(SUCCEEDED(pMemStream->SetFilePointer(0LL, FILE_CURRENT, &ullPosition)));
+            if (ullPosition >= pMemStream->GetSize())
+                break;
+        }
+        return strings;
+    }
+};
+}  // namespace Orc::Test
@@ -18,14 +18,76 @@
 #include "ParameterCheck.h"
 #include "FileStream.h"
 #include "MemoryStream.h"
+#include "DevNullStream.h"
 
 #include <safeint.h>
 
+#include <chrono>
+
 using namespace Microsoft::VisualStudio::CppUnitTestFramework;
 using namespace std;
 using namespace Orc;
 using namespace Orc::Test;
 
+namespace {
+
+// Keeps what a writer outputs, UTF-16 output is converted with WideCharToMultiByte as CSV::Writer did before it
+// formatted UTF-8 output directly
+class CaptureStream : public DevNullStream
+{
+public:
+    CaptureStream(logger pLog, bool bFromUTF16, bool bKeep)
+        : DevNullStream(std::move(pLog))
+        , m_bFromUTF16(bFromUTF16)
+        , m_bKeep(bKeep)
+    {
+    }
+
+    STDMETHOD(Write)
+    (const PVOID pWriteBuffer, ULONGLONG cbBytesToWrite, PULONGLONG pcbBytesWritten) override
+    {
+        if (m_ullWritten + cbBytesToWrite > FailAfter)
+            return HRESULT_FROM_WIN32(ERROR_DISK_FULL);
+        m_ullWritten += cbBytesToWrite;
+
+        std::string_view bytes(static_cast<const char*>(pWriteBuffer), static_cast<size_t>(cbBytesToWrite));
+
+        if (m_bFromUTF16 && cbBytesToWrite > 0)
+        {
+            const int cchWide = static_cast<int>(cbBytesToWrite / sizeof(WCHAR));
+            m_Converted.resize(cchWide * 3);
+            const int cbConverted = WideCharToMultiByte(
+                CP_UTF8,
+                0L,
+                static_cast<LPCWSTR>(pWriteBuffer),
+                cchWide,
+                m_Converted.data(),
+                static_cast<int>(m_Converted.size()),
+                NULL,
+                NULL);
+            bytes = std::string_view(m_Converted.data(), cbConverted);
+        }
+
+        if (m_bKeep)
+            Data.append(bytes);
+
+        if (pcbBytesWritten != nullptr)
+            *pcbBytesWritten = cbBytesToWrite;
+        return S_OK;
+    }
+
+    std::string Data;
+    ULONGLONG FailAfter = MAXULONGLONG;  // writes beyond this many bytes fail
+
+private:
+    bool m_bFromUTF16;
+    bool m_bKeep;
+    std::string m_Converted;
+    ULONGLONG m_ullWritten = 0LL;
+};
+
+}  // namespace
+
 namespace Orc::Test {
 TEST_CLASS(TableOutput)
 {
@@ -203,6 +265,211 @@ public:
         }
     }
 
+    // Rows like NTFSInfo's, with names that need escaping or are not ASCII when bUnusualValues is set
+    std::string WriteNTFSInfoRows(
+        OutputSpec::Encoding encoding,
+        DWORD dwRows,
+        bool bUnusualValues,
+        bool bKeep,
+        std::chrono::milliseconds& elapsed,
+        DWORD dwInFlightBuffers = 0L)
+    {
+        using namespace Orc::TableOutput;
+        using namespace std::string_view_literals;
+        using namespace std::string_literals;
+
+        auto options = std::make_unique<CSV::Options>();
+        options->Encoding = encoding;
+        options->bBOM = false;
+        options->dwBufferSize = 64 * 1024;
+        options->dwInFlightBuffers = dwInFlightBuffers;
+
+        auto writer = Orc::TableOutput::GetCSVWriter(_L_, std::move(options));
+        Assert::IsTrue((bool)writer);
+
+        auto stream = std::make_shared<CaptureStream>(_L_, encoding == OutputSpec::Encoding::UTF16, bKeep);
+        Assert::IsTrue(SUCCEEDED(writer->WriteToStream(stream, false)));
+
+        Schema schema {{ColumnType::UTF16Type, L"ComputerName"},
+                       {ColumnType::UInt64Type, L"VolumeID"},
+                       {ColumnType::UTF16Type, L"ParentName"},
+                       {ColumnType::UTF16Type, L"File"},
+                       {ColumnType::UInt64Type, L"SizeInBytes"},
+                       {ColumnType::UTF16Type, L"Attributes"},
+                       {ColumnType::TimeStampType, L"CreationDate"},
+                       {ColumnType::TimeStampType, L"LastModificationDate"},
+                       {ColumnType::UInt64Type, L"FRN"},
+                       {ColumnType::BinaryType, L"MD5"},
+                       {ColumnType::BinaryType, L"SHA1"},
+                       {ColumnType::FlagsType, L"FilenameFlags"},
+                       {ColumnType::UTF8Type, L"Extension"},
+                       {ColumnType::BoolType, L"IsDirectory"},
+                       {ColumnType::UInt32Type, L"SecurityID", L"SecurityID", L"0x{:08X}"},
+                       {ColumnType::EnumType, L"Kind"}};
+
+        schema[L"FilenameFlags"sv].FlagsValues = {{L"WIN32"s, 1 << 0}, {L"DOS"s, 1 << 1}};
+        schema[L"Kind"sv].EnumValues = {{L"File"s, 0}, {L"Directory"s, 1}};
+
+        Assert::IsTrue(SUCCEEDED(writer->SetSchema(schema)));
+
+        auto& output = *writer;
+
+        const std::wstring lone_surrogate {L'a', static_cast<WCHAR>(0xD800), L'b'};
+        const std::wstring long_name = std::wstring(6000, L'x') + L"\"" + std::wstring(6000, L'\u00e9');
+
+        BYTE md5[16] = {0};
+        BYTE sha1[20] = {0};
+
+        auto start = std::chrono::high_resolution_clock::now();
+        for (DWORD i = 0; i < dwRows; i++)
+        {
+            md5[i % 16] = static_cast<BYTE>(i);
+            sha1[i % 20] = static_cast<BYTE>(i * 7);
+
+            const auto name = fmt::format(L"file_{}.dll", i);
+
+            output.WriteString(L"WORKSTATION-42");
+            output.WriteInteger(static_cast<ULONGLONG>(0x5A3C7E12F00DLL));
+            output.WriteString(L"\\Windows\\System32\\DriverStore\\FileRepository\\netrtwlane.inf_amd64"sv);
+
+            if (!bUnusualValues)
+                output.WriteString(name);
+            else
+            {
+                switch (i % 8)
+                {
+                    case 0:
+                        output.WriteString(L"quote \"inside\" name.txt");
+                        break;
+                    case 1:
+                        output.WriteString(L"caf\u00e9 \u4e2d\u6587.txt");
+                        break;
+                    case 2:
+                        output.WriteString(L"emoji \U0001F600.txt");
+                        break;
+                    case 3:
+                        output.WriteString(lone_surrogate);
+                        break;
+                    case 4:
+                        output.WriteString(L"");
+                        break;
+                    case 5:
+                        output.WriteString(L"\"\"");
+                        break;
+                    case 6:
+                        output.WriteString(i % 100 == 6 ? long_name : name);
+                        break;
+                    default:
+                        output.WriteString(name);
+                        break;
+                }
+            }
+
+            output.WriteFileSize(static_cast<ULONGLONG>(i) * 4096 + 17);
+            output.WriteAttributes(i % 2 ? FILE_ATTRIBUTE_ARCHIVE : FILE_ATTRIBUTE_DIRECTORY | FILE_ATTRIBUTE_SYSTEM);
+            output.WriteFileTime(132500000000000000LL + i * 10000019LL);
+            output.WriteFileTime(132600000000000000LL + i * 20000023LL);
+            output.WriteInteger(static_cast<ULONGLONG>(0x0001000000000000LL) + i);
+            output.WriteBytes(md5, 16);
+            output.WriteBytes(sha1, 20);
+            output.WriteFlags(i % 4);
+
+            if (bUnusualValues && i % 3 == 1)
+                output.WriteString("caf\xc3\xa9 \"q\"");
+            else
+                output.WriteString("dll");
+
+            output.WriteBool(i % 3 == 0);
+            output.WriteInteger(static_cast<DWORD>(i));
+            output.WriteEnum(i % 3);
+            output.WriteEndOfLine();
+        }
+
+        Assert::IsTrue(SUCCEEDED(writer->Close()));
+        elapsed =
+            std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - start);
+
+        return std::move(stream->Data);
+    }
+
+    TEST_METHOD(CSVUTF8Output)
+    {
+        std::chrono::milliseconds elapsed;
+
+        // UTF-8 is formatted directly, it must be the conversion of the UTF-16 output
+        const auto direct = WriteNTFSInfoRows(OutputSpec::Encoding::UTF8, 2000, true, true, elapsed);
+        const auto converted = WriteNTFSInfoRows(OutputSpec::Encoding::UTF16, 2000, true, true, elapsed);
+
+        Assert::IsFalse(direct.empty());
+        Assert::IsTrue(direct == converted);
+
+        Assert::IsTrue(
+            WriteNTFSInfoRows(OutputSpec::Encoding::UTF8, 2000, false, true, elapsed)
+            == WriteNTFSInfoRows(OutputSpec::Encoding::UTF16, 2000, false, true, elapsed));
+    }
+
+    TEST_METHOD(CSVBackgroundFlush)
+    {
+        std::chrono::milliseconds elapsed;
+
+        // full buffers are written by a background task, the output must not change
+        for (auto encoding : {OutputSpec::Encoding::UTF8, OutputSpec::Encoding::UTF16})
+        {
+            const auto background = WriteNTFSInfoRows(encoding, 2000, true, true, elapsed, 2);
+            Assert::IsFalse(background.empty());
+            Assert::IsTrue(background == WriteNTFSInfoRows(encoding, 2000, true, true, elapsed));
+        }
+    }
+
+    TEST_METHOD(CSVBackgroundFlushError)
+    {
+        using namespace Orc::TableOutput;
+
+        auto options = std::make_unique<CSV::Options>();
+        options->dwBufferSize = 4096;
+        options->dwInFlightBuffers = 2;
+
+        auto writer = Orc::TableOutput::GetCSVWriter(_L_, std::move(options));
+        Assert::IsTrue((bool)writer);
+
+        auto stream = std::make_shared<CaptureStream>(_L_, false, false);
+        stream->FailAfter = 64 * 1024;
+        Assert::IsTrue(SUCCEEDED(writer->WriteToStream(stream, false)));
+
+        Schema schema {{ColumnType::UTF16Type, L"Name"}, {ColumnType::UInt64Type, L"Size"}};
+        Assert::IsTrue(SUCCEEDED(writer->SetSchema(schema)));
+
+        // once the background write failed, the error is returned while writing or at the latest by Close
+        HRESULT hrWrite = S_OK;
+        for (DWORD i = 0; i < 10000 && SUCCEEDED(hrWrite); i++)
+        {
+            writer->WriteString(L"some_file_name.txt");
+            writer->WriteFileSize(static_cast<ULONGLONG>(i));
+            hrWrite = writer->WriteEndOfLine();
+        }
+
+        Assert::AreEqual(HRESULT_FROM_WIN32(ERROR_DISK_FULL), writer->Close());
+    }
+
+    TEST_METHOD(CSVWriterBenchmark)
+    {
+        const DWORD dwRows = 200000;
+
+        std::chrono::milliseconds direct, converted, background;
+        WriteNTFSInfoRows(OutputSpec::Encoding::UTF8, dwRows, false, false, direct);
+        WriteNTFSInfoRows(OutputSpec::Encoding::UTF16, dwRows, false, false, converted);
+        WriteNTFSInfoRows(OutputSpec::Encoding::UTF8, dwRows, false, false, background, 2);
+
+        log::Info(
+            _L_,
+            L"%d NTFSInfo rows: UTF-8 direct %I64d ms, UTF-16 then WideCharToMultiByte %I64d ms, UTF-8 with background "
+            L"flush %I64d ms\r\n",
+            dwRows,
+            direct.count(),
+            converted.count(),
+            background.count());
+    }
+
     std::wstring GetFilePath(const std::wstring& strFileName)
     {
         std::wstring retval;
@@ -16,10 +16,12 @@
 #include "TemporaryStream.h"
 #include "Temporary.h"
 #include "NtfsDataStructures.h"
+#include "MemoryStream.h"
 
 #include <string>
 #include <memory>
 #include <algorithm>
+#include <tuple>
 #include <boost/algorithm/string.hpp>
 
 using namespace Microsoft::VisualStudio::CppUnitTestFramework;
@@ -167,6 +169,49 @@ public:
         }
     }
 
+    TEST_METHOD(USNJournalWalkerOfflineRecordVersionsTest)
+    {
+        // a leading gap, then version 2, 3 and 4 records and a record straddling two chunks
+        std::vector<BYTE> journal(0x6000, 0);
+        WriteRecord<USNJournalWalkerBase::USN_RECORD_V2>(journal, 0x3000, 2, 0x1000000000010ULL, L"a.txt");
+        WriteRecord<USNJournalWalkerBase::USN_RECORD_V3>(journal, 0x3100, 3, 0x2000000000020ULL, L"b.txt");
+        WriteRecord<USNJournalWalkerBase::USN_RECORD_V2>(journal, 0x3200, 4, 0x3000000000030ULL, L"range");
+        WriteRecord<USNJournalWalkerBase::USN_RECORD_V2>(journal, 0x41F8, 2, 0x4000000000040ULL, L"c.txt");
+
+        auto stream = std::make_shared<MemoryStream>(_L_);
+        Assert::IsTrue(S_OK == stream->OpenForReadWrite(static_cast<DWORD>(journal.size())));
+        ULONGLONG ullWritten = 0LL;
+        Assert::IsTrue(S_OK == stream->Write(journal.data(), journal.size(), &ullWritten));
+        Assert::IsTrue(S_OK == stream->SetFilePointer(0LL, FILE_BEGIN, NULL));
+
+        const auto dwBufferSize = USNJournalWalkerOffline::GetBufferSize();
+        USNJournalWalkerOffline::SetBufferSize(512);
+
+        std::vector<std::tuple<WORD, DWORDLONG, std::wstring>> records;
+
+        USNJournalWalkerOffline walker(_L_);
+        walker.SetUsnJournal(stream);
+
+        IUSNJournalWalker::Callbacks callbacks;
+        callbacks.RecordCallback =
+            [&records](const std::shared_ptr<VolumeReader>& volreader, WCHAR* szFullName, USN_RECORD* pElt) {
+                Assert::IsTrue(pElt->FileNameOffset == FIELD_OFFSET(USN_RECORD, FileName));
+                records.emplace_back(
+                    pElt->MajorVersion,
+                    pElt->FileReferenceNumber,
+                    std::wstring(pElt->FileName, pElt->FileNameLength / sizeof(WCHAR)));
+            };
+
+        const HRESULT hr = walker.ReadJournal(callbacks);
+        USNJournalWalkerOffline::SetBufferSize(dwBufferSize);
+
+        Assert::IsTrue(S_OK == hr);
+        Assert::IsTrue(records.size() == 3);
+        Assert::IsTrue(records[0] == std::make_tuple(WORD(2), 0x1000000000010ULL, std::wstring(L"a.txt")));
+        Assert::IsTrue(records[1] == std::make_tuple(WORD(2), 0x2000000000020ULL, std::wstring(L"b.txt")));
+        Assert::IsTrue(records[2] == std::make_tuple(WORD(2), 0x4000000000040ULL, std::wstring(L"c.txt")));
+    }
+
     TEST_METHOD(USNJournalWalkerOfflineDifferentOsTest)
     {
         // WIN XP
@@ -194,6 +239,21 @@ public:
     }
 
 private:
+    template <typename RecordT>
+    static void
+    WriteRecord(std::vector<BYTE>& journal, size_t offset, WORD wVersion, DWORDLONG frn, const std::wstring& name)
+    {
+        auto pRecord = reinterpret_cast<RecordT*>(journal.data() + offset);
+        const WORD cbName = static_cast<WORD>(name.size() * sizeof(WCHAR));
+
+        pRecord->RecordLength = (FIELD_OFFSET(RecordT, FileName) + cbName + 7) & ~7;
+        pRecord->MajorVersion = wVersion;
+        CopyMemory(&pRecord->FileReferenceNumber, &frn, sizeof(frn));
+        pRecord->FileNameLength = cbName;
+        pRecord->FileNameOffset = FIELD_OFFSET(RecordT, FileName);
+        CopyMemory(pRecord->FileName, name.data(), cbName);
+    }
+
     DWORD64 m_NbRecords;
     typedef std::map<int, Archive::ArchiveItem> ITEMS;
     typedef std::map<int, std::wstring> ITEM_PATHS;
@@ -9,6 +9,7 @@
 #include "stdafx.h"
 
 #include "LogFileWriter.h"
+#include "MemoryStream.h"
 #include "YaraScanner.h"
 
 using namespace Microsoft::VisualStudio::CppUnitTestFramework;
@@ -33,6 +34,39 @@ public:
 
     TEST_METHOD_CLEANUP(Finalize) { helper.FinalizeLogFileWriter(_L_); }
 
+    void AddStringRules(YaraScanner & scanner)
+    {
+        auto rules = R"(
+				rule in_block {
+					strings:
+						$text_string = "HelloWorld"
+					condition :
+						$text_string
+				}
+				rule across_blocks {
+					strings:
+						$text_string = "CrossingTheBoundary"
+					condition :
+						$text_string
+				}
+			)"s;
+
+        CBinaryBuffer buffer;
+        buffer.SetData((LPBYTE)rules.c_str(), rules.size());
+        Assert::IsTrue(SUCCEEDED(scanner.AddRules(buffer)));
+    }
+
+    std::shared_ptr<MemoryStream> MakeStream(const std::string& data)
+    {
+        auto stream = std::make_shared<MemoryStream>(_L_);
+        Assert::IsTrue(S_OK == stream->OpenForReadWrite(static_cast<DWORD>(data.size())));
+
+        ULONGLONG ullWritten = 0LL;
+        Assert::IsTrue(S_OK == stream->Write((const PVOID)data.data(), data.size(), &ullWritten));
+        Assert::AreEqual(static_cast<ULONGLONG>(data.size()), ullWritten);
+        return stream;
+    }
+
     TEST_METHOD(SimpleScan)
     {
         YaraScanner scanner(_L_);
@@ -104,5 +138,115 @@ public:
             }
         }
     }
+
+    TEST_METHOD(ParallelBlockScan)
+    {
+        YaraScanner scanner(_L_);
+        Assert::IsTrue(SUCCEEDED(scanner.Initialize()));
+        Assert::IsTrue(SUCCEEDED(scanner.Configure(std::unique_ptr<YaraConfig>())));
+        AddStringRules(scanner);
+
+        const ULONG blockSize = 0x1000;
+        std::string data(64 * blockSize, 'x');
+        data.replace(3 * blockSize + 100, 10, "HelloWorld");
+        data.replace(6 * blockSize - 8, 19, "CrossingTheBoundary");  // only found in the overlap of blocks 5 and 6
+        data.replace(32 * blockSize - 8, 19, "CrossingTheBoundary");
+        data.replace(40 * blockSize + 100, 10, "HelloWorld");
+
+        // as found by scanning the blocks one after the other, whichever the number of blocks scanned at once
+        const MatchingRuleCollection expected = {"in_block", "across_blocks", "across_blocks", "in_block"};
+
+        for (int i = 0; i < 4; i++)
+        {
+            MatchingRuleCollection matchingRules;
+            Assert::IsTrue(SUCCEEDED(scanner.Scan(MakeStream(data), blockSize, blockSize, matchingRules)));
+            Assert::IsTrue(expected == matchingRules, L"rules must match in block order");
+        }
+    }
+
+    TEST_METHOD(FileMappingScanOfStreams)
+    {
+        YaraScanner scanner(_L_);
+        Assert::IsTrue(SUCCEEDED(scanner.Initialize()));
+
+        auto config = std::make_unique<YaraConfig>();
+        Assert::IsTrue(SUCCEEDED(config->SetBlockSize(0x1000)));
+        Assert::IsTrue(SUCCEEDED(config->SetOverlapSize(0x1000)));
+        Assert::IsTrue(SUCCEEDED(config->SetScanMethod(L"filemapping")));
+        Assert::IsTrue(SUCCEEDED(scanner.Configure(config)));
+
+        auto rules = R"(
+				rule in_block {
+					strings:
+						$text_string = "HelloWorld"
+					condition :
+						$text_string
+				}
+				rule across_blocks {
+					strings:
+						$text_string = "GoodbyeWorld"
+					condition :
+						$text_string
+				}
+				rule whole_stream {
+					condition :
+						filesize == 0x40000 and uint8(0x3FFFF) == 0x7A
+				}
+			)"s;
+        CBinaryBuffer buffer;
+        buffer.SetData((LPBYTE)rules.c_str(), rules.size());
+        Assert::IsTrue(SUCCEEDED(scanner.AddRules(buffer)));
+
+        // a memory stream is not a file that can be mapped: it is read and scanned at once, as a mapped file would be
+        std::string data(0x40000, 'x');
+        data.replace(0x28100, 10, "HelloWorld");
+        data.replace(0x2A000 - 6, 12, "GoodbyeWorld");
+        data.back() = 'z';
+
+        auto stream = MakeStream(data);
+        MatchingRuleCollection matchingRules;
+        Assert::IsTrue(SUCCEEDED(scanner.Scan(stream, matchingRules)));
+        Assert::AreEqual(static_cast<size_t>(3), matchingRules.size(), L"we expect the three rules to match once");
+        Assert::IsTrue(
+            std::find(begin(matchingRules), end(matchingRules), "whole_stream") != end(matchingRules),
+            L"filesize and offsets must be those of the whole stream");
+
+        // the stream scanned is left untouched and can be scanned again
+        MatchingRuleCollection againRules;
+        Assert::IsTrue(SUCCEEDED(scanner.Scan(stream, againRules)));
+        Assert::IsTrue(matchingRules == againRules);
+    }
+
+    TEST_METHOD(ConcurrentStreamScan)
+    {
+        YaraScanner scanner(_L_);
+        Assert::IsTrue(SUCCEEDED(scanner.Initialize()));
+        Assert::IsTrue(SUCCEEDED(scanner.Configure(std::unique_ptr<YaraConfig>())));
+        AddStringRules(scanner);
+
+        std::vector<std::shared_ptr<ByteStream>> streams;
+        for (int i = 0; i < 64; i++)
+        {
+            std::string data(0x10000 + i * 0x100, 'x');
+            if (i % 2 == 0)
+                data.replace(i * 0x100, 10, "HelloWorld");
+            streams.push_back(MakeStream(data));
+        }
+
+        std::vector<MatchingRuleCollection> matchingRules;
+        Assert::IsTrue(SUCCEEDED(scanner.Scan(streams, matchingRules)));
+        Assert::AreEqual(streams.size(), matchingRules.size());
+
+        for (int i = 0; i < 64; i++)
+        {
+            if (i % 2 == 0)
+            {
+                Assert::AreEqual(static_cast<size_t>(1), matchingRules[i].size());
+                Assert::IsTrue(matchingRules[i].front() == "in_block");
+            }
+            else
+                Assert::IsTrue(matchingRules[i].empty(), L"we expect no rule to match");
+        }
+    }
 };
 }  // namespace Orc::Test
\ No newline at end of file
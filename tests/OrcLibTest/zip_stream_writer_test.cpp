@@ -0,0 +1,400 @@
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+//
+// Copyright © 2011-2019 ANSSI. All Rights Reserved.
+//
+// Author(s): Jean Gautier (ANSSI)
+//
+#include "stdafx.h"
+
+#include "LogFileWriter.h"
+#include "MemoryStream.h"
+#include "WideAnsi.h"
+#include "ZipStreamWriter.h"
+
+#include <algorithm>
+#include <map>
+#include <random>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace Orc;
+using namespace Orc::Test;
+
+namespace Orc::Test {
+
+// Memory stream failing to be read once it delivered a given number of bytes
+class FailingMemoryStream : public MemoryStream
+{
+public:
+    FailingMemoryStream(logger pLog, ULONGLONG ullFailAfter)
+        : MemoryStream(std::move(pLog))
+        , m_ullFailAfter(ullFailAfter)
+    {
+    }
+
+    STDMETHOD(Read)(PVOID pBuffer, ULONGLONG cbBytes, PULONGLONG pcbBytesRead)
+    {
+        if (m_ullRead >= m_ullFailAfter)
+        {
+            if (pcbBytesRead != nullptr)
+                *pcbBytesRead = 0LL;
+            return HRESULT_FROM_WIN32(ERROR_READ_FAULT);
+        }
+
+        ULONGLONG ullRead = 0LL;
+        HRESULT hr = MemoryStream::Read(pBuffer, std::min(cbBytes, m_ullFailAfter - m_ullRead), &ullRead);
+        m_ullRead += ullRead;
+        if (pcbBytesRead != nullptr)
+            *pcbBytesRead = ullRead;
+        return hr;
+    }
+
+private:
+    ULONGLONG m_ullFailAfter;
+    ULONGLONG m_ullRead = 0LL;
+};
+
+// Memory stream the zip writer does not know, as a pipe, it cannot rely on its size
+class UnknownMemoryStream : public MemoryStream
+{
+public:
+    UnknownMemoryStream(logger pLog)
+        : MemoryStream(std::move(pLog))
+    {
+    }
+
+    void Accept(ByteStreamVisitor& visitor) override { return visitor.Visit(static_cast<ByteStream&>(*this)); };
+};
+
+TEST_CLASS(ZipStreamWriterTest)
+{
+private:
+    logger _L_;
+    UnitTestHelper helper;
+
+    struct CentralEntry
+    {
+        std::string Name;
+        WORD Version = 0;
+        WORD Method = 0;
+        DWORD CRC = 0L;
+        ULONGLONG Offset = 0LL;
+    };
+
+    template <typename T>
+    static T Get(const CBinaryBuffer& buffer, ULONGLONG ullOffset)
+    {
+        Assert::IsTrue(ullOffset + sizeof(T) <= buffer.GetCount(), L"zip record out of the archive");
+        T value;
+        CopyMemory(&value, buffer.GetData() + ullOffset, sizeof(T));
+        return value;
+    }
+
+    static DWORD CRC32(const std::string& data)
+    {
+        DWORD crc = 0xFFFFFFFF;
+        for (const auto c : data)
+        {
+            crc ^= static_cast<BYTE>(c);
+            for (int bit = 0; bit < 8; bit++)
+                crc = (crc >> 1) ^ (crc & 1 ? 0xEDB88320 : 0);
+        }
+        return ~crc;
+    }
+
+    static std::string MakeData(size_t size, unsigned int seed)
+    {
+        std::minstd_rand rand(seed);
+        std::string data;
+        while (data.size() < size)
+            data += "line " + std::to_string(rand() % 10000) + " of a zip entry\r\n";
+        data.resize(size);
+        return data;
+    }
+
+    template <typename StreamType, typename... Args>
+    std::shared_ptr<StreamType> MakeStream(const std::string& data, Args&&... args)
+    {
+        auto stream = std::make_shared<StreamType>(_L_, std::forward<Args>(args)...);
+        Assert::IsTrue(S_OK == stream->OpenForReadWrite(static_cast<DWORD>(std::max<size_t>(data.size(), 0x1000))));
+
+        ULONGLONG ullWritten = 0LL;
+        if (!data.empty())
+            Assert::IsTrue(S_OK == stream->Write((const PVOID)data.data(), data.size(), &ullWritten));
+        Assert::AreEqual(static_cast<ULONGLONG>(data.size()), ullWritten);
+        Assert::IsTrue(S_OK == stream->SetFilePointer(0LL, FILE_BEGIN, nullptr));
+        return stream;
+    }
+
+    std::shared_ptr<MemoryStream> MakeArchive()
+    {
+        auto archive = std::make_shared<MemoryStream>(_L_);
+        Assert::IsTrue(S_OK == archive->OpenForReadWrite());
+        return archive;
+    }
+
+    // Reads the archive back with 7-Zip, which checks the CRC of each entry
+    // Entries are extracted one after the other: they are appended to a single memory stream
+    HRESULT Extract(const std::shared_ptr<MemoryStream>& archive, std::map<std::wstring, std::string>& entries)
+    {
+        auto output = std::make_shared<MemoryStream>(_L_);
+        if (FAILED(output->OpenForReadWrite()))
+            return E_OUTOFMEMORY;
+        ULONGLONG ullEntryOffset = 0LL;
+
+        auto MakeArchiveStream = [archive](std::shared_ptr<ByteStream>& stream) -> HRESULT {
+            stream = archive;
+            return archive->SetFilePointer(0LL, FILE_BEGIN, nullptr);
+        };
+
+        auto ShouldItemBeExtracted = [](const std::wstring& strNameInArchive) -> bool { return true; };
+
+        auto MakeWriteStream = [output, &ullEntryOffset](Archive::ArchiveItem& item) -> std::shared_ptr<ByteStream> {
+            ullEntryOffset = output->GetSize();
+            return output;
+        };
+
+        auto ArchiveCallback = [output, &ullEntryOffset, &entries](const Archive::ArchiveItem& item) {
+            const auto buffer = output->GetConstBuffer();
+            const auto cbEntry = static_cast<size_t>(buffer.GetCount() - ullEntryOffset);
+            entries[item.NameInArchive] = std::string((const char*)buffer.GetData() + ullEntryOffset, cbEntry);
+        };
+
+        return helper.ExtractArchive(
+            _L_, ArchiveFormat::Zip, MakeArchiveStream, ShouldItemBeExtracted, MakeWriteStream, ArchiveCallback);
+    }
+
+    // Parses the end of central directory records (the writer adds no comment) then the central directory
+    void ReadCentralDirectory(
+        const std::shared_ptr<MemoryStream>& archive,
+        std::vector<CentralEntry>& entries,
+        bool& bZip64End)
+    {
+        const auto buffer = archive->GetConstBuffer();
+        Assert::IsTrue(buffer.GetCount() >= 22);
+
+        const ULONGLONG ullEnd = buffer.GetCount() - 22;
+        Assert::AreEqual(0x06054b50UL, Get<DWORD>(buffer, ullEnd), L"end of central directory expected");
+
+        ULONGLONG ullEntries = Get<WORD>(buffer, ullEnd + 10);
+        ULONGLONG ullDirectoryOffset = Get<DWORD>(buffer, ullEnd + 16);
+
+        bZip64End = ullEnd >= 20 && Get<DWORD>(buffer, ullEnd - 20) == 0x07064b50;
+        if (bZip64End)
+        {
+            const auto ullZip64End = Get<ULONGLONG>(buffer, ullEnd - 20 + 8);
+            Assert::AreEqual(0x06064b50UL, Get<DWORD>(buffer, ullZip64End), L"zip64 end of central directory expected");
+            ullEntries = Get<ULONGLONG>(buffer, ullZip64End + 32);
+            ullDirectoryOffset = Get<ULONGLONG>(buffer, ullZip64End + 48);
+        }
+
+        entries.clear();
+        ULONGLONG ullOffset = ullDirectoryOffset;
+        for (ULONGLONG i = 0; i < ullEntries; i++)
+        {
+            Assert::AreEqual(0x02014b50UL, Get<DWORD>(buffer, ullOffset), L"central directory header expected");
+
+            CentralEntry entry;
+            entry.Version = Get<WORD>(buffer, ullOffset + 6);
+            entry.Method = Get<WORD>(buffer, ullOffset + 10);
+            entry.CRC = Get<DWORD>(buffer, ullOffset + 16);
+            entry.Offset = Get<DWORD>(buffer, ullOffset + 42);
+
+            const WORD wNameLength = Get<WORD>(buffer, ullOffset + 28);
+            const WORD wExtraLength = Get<WORD>(buffer, ullOffset + 30);
+            const WORD wCommentLength = Get<WORD>(buffer, ullOffset + 32);
+            Assert::IsTrue(ullOffset + 46 + wNameLength <= buffer.GetCount());
+            entry.Name.assign((const char*)buffer.GetData() + ullOffset + 46, wNameLength);
+
+            entries.push_back(std::move(entry));
+            ullOffset += 46LL + wNameLength + wExtraLength + wCommentLength;
+        }
+    }
+
+    // Empty, small and larger than the store buffer entries, in folders and with non-ASCII names
+    std::vector<std::pair<std::wstring, std::string>> Contents()
+    {
+        return {
+            {L"small.txt", MakeData(100, 1)},
+            {L"empty.txt", std::string()},
+            {L"dir\\large.txt", MakeData(3 * 1024 * 1024 + 17, 2)},
+            {L"dir\\r\u00e9pertoire\\caf\u00e9.txt", MakeData(0x1000, 3)},
+        };
+    }
+
+    // Writes the entries, reads the archive back and checks names, CRCs and contents
+    void CheckArchive(UINT uiLevel, const std::vector<std::pair<std::wstring, std::string>>& contents)
+    {
+        auto archive = MakeArchive();
+        ZipStreamWriter writer(_L_, archive, uiLevel);
+
+        for (const auto& [name, data] : contents)
+            Assert::IsTrue(S_OK == writer.AddEntry(name, MakeStream<MemoryStream>(data)));
+        Assert::IsTrue(S_OK == writer.Close());
+        Assert::AreEqual(archive->GetSize(), writer.GetArchiveSize());
+
+        std::vector<CentralEntry> central;
+        bool bZip64End = false;
+        ReadCentralDirectory(archive, central, bZip64End);
+        Assert::IsFalse(bZip64End);
+        Assert::AreEqual(contents.size(), central.size());
+
+        for (size_t i = 0; i < contents.size(); i++)
+        {
+            std::string strName;
+            Assert::IsTrue(S_OK == WideToAnsi(_L_, contents[i].first, strName));
+            std::replace(begin(strName), end(strName), '\\', '/');
+
+            Assert::IsTrue(strName == central[i].Name, L"zip entry names are UTF-8, with '/' separators");
+            Assert::AreEqual(CRC32(contents[i].second), central[i].CRC);
+            Assert::AreEqual(static_cast<WORD>(uiLevel == 0 ? 0 : 8), central[i].Method);
+            Assert::AreEqual(static_cast<WORD>(20), central[i].Version);
+        }
+
+        std::map<std::wstring, std::string> extracted;
+        Assert::IsTrue(S_OK == Extract(archive, extracted));
+        Assert::AreEqual(contents.size(), extracted.size());
+
+        for (const auto& [name, data] : contents)
+        {
+            auto it = extracted.find(name);
+            Assert::IsTrue(it != end(extracted), L"zip entry not extracted");
+            Assert::IsTrue(data == it->second, L"zip entry content differs from its input");
+        }
+    }
+
+public:
+    TEST_METHOD_INITIALIZE(Initialize)
+    {
+        _L_ = std::make_shared<LogFileWriter>();
+        helper.InitLogFileWriter(_L_);
+    }
+
+    TEST_METHOD_CLEANUP(Finalize) { helper.FinalizeLogFileWriter(_L_); }
+
+    TEST_METHOD(StoredEntries) { CheckArchive(0, Contents()); }
+
+    TEST_METHOD(DeflatedEntries) { CheckArchive(6, Contents()); }
+
+    TEST_METHOD(EmptyArchive)
+    {
+        auto archive = MakeArchive();
+        ZipStreamWriter writer(_L_, archive, 6);
+        Assert::IsTrue(S_OK == writer.Close());
+        Assert::AreEqual(22ULL, archive->GetSize(), L"an empty archive is its end of central directory");
+
+        std::vector<CentralEntry> central;
+        bool bZip64End = false;
+        ReadCentralDirectory(archive, central, bZip64End);
+        Assert::IsTrue(central.empty());
+
+        std::map<std::wstring, std::string> extracted;
+        Assert::IsTrue(S_OK == Extract(archive, extracted));
+        Assert::IsTrue(extracted.empty());
+    }
+
+    TEST_METHOD(TruncatedEntry)
+    {
+        const auto data = MakeData(0x3000, 4);
+        const auto after = MakeData(0x200, 5);
+        const ULONGLONG ullFailAfter = 0x1800;
+
+        for (const UINT uiLevel : {0, 6})
+        {
+            auto archive = MakeArchive();
+            ZipStreamWriter writer(_L_, archive, uiLevel);
+
+            Assert::IsTrue(
+                HRESULT_FROM_WIN32(ERROR_READ_FAULT)
+                    == writer.AddEntry(L"truncated.txt", MakeStream<FailingMemoryStream>(data, ullFailAfter)),
+                L"the read error is returned once the entry is completed");
+            Assert::IsTrue(S_OK == writer.AddEntry(L"after.txt", MakeStream<MemoryStream>(after)));
+            Assert::IsTrue(S_OK == writer.Close());
+            Assert::AreEqual(static_cast<size_t>(2), writer.GetEntryCount());
+
+            std::vector<CentralEntry> central;
+            bool bZip64End = false;
+            ReadCentralDirectory(archive, central, bZip64End);
+            Assert::AreEqual(static_cast<size_t>(2), central.size());
+            Assert::AreEqual(CRC32(data.substr(0, static_cast<size_t>(ullFailAfter))), central[0].CRC);
+            Assert::AreEqual(CRC32(after), central[1].CRC);
+
+            std::map<std::wstring, std::string> extracted;
+            Assert::IsTrue(S_OK == Extract(archive, extracted));
+            Assert::IsTrue(data.substr(0, static_cast<size_t>(ullFailAfter)) == extracted[L"truncated.txt"]);
+            Assert::IsTrue(after == extracted[L"after.txt"]);
+        }
+    }
+
+    TEST_METHOD(UnknownSizeEntry)
+    {
+        const auto data = MakeData(0x10000 + 3, 6);
+
+        for (const UINT uiLevel : {0, 6})
+        {
+            auto archive = MakeArchive();
+            ZipStreamWriter writer(_L_, archive, uiLevel);
+
+            Assert::IsTrue(S_OK == writer.AddEntry(L"unknown.txt", MakeStream<UnknownMemoryStream>(data)));
+            Assert::IsTrue(S_OK == writer.AddEntry(L"known.txt", MakeStream<MemoryStream>(data)));
+            Assert::IsTrue(S_OK == writer.Close());
+
+            std::vector<CentralEntry> central;
+            bool bZip64End = false;
+            ReadCentralDirectory(archive, central, bZip64End);
+            Assert::AreEqual(static_cast<size_t>(2), central.size());
+
+            // the local header of an entry of unknown size has a zip64 extra field, its data descriptor zip64 sizes
+            const auto buffer = archive->GetConstBuffer();
+            Assert::AreEqual(static_cast<WORD>(45), Get<WORD>(buffer, central[0].Offset + 4));
+            Assert::AreEqual(static_cast<WORD>(20), Get<WORD>(buffer, central[0].Offset + 28));
+            Assert::AreEqual(static_cast<WORD>(45), central[0].Version);
+
+            Assert::AreEqual(static_cast<WORD>(20), Get<WORD>(buffer, central[1].Offset + 4));
+            Assert::AreEqual(static_cast<WORD>(0), Get<WORD>(buffer, central[1].Offset + 28));
+            Assert::AreEqual(static_cast<WORD>(20), central[1].Version);
+
+            std::map<std::wstring, std::string> extracted;
+            Assert::IsTrue(S_OK == Extract(archive, extracted));
+            Assert::IsTrue(data == extracted[L"unknown.txt"]);
+            Assert::IsTrue(data == extracted[L"known.txt"]);
+        }
+    }
+
+    TEST_METHOD(Zip64EntryCount)
+    {
+        const size_t entryCount = 0x10000 + 2;
+
+        auto archive = MakeArchive();
+        ZipStreamWriter writer(_L_, archive, 0);
+
+        for (size_t i = 0; i < entryCount; i++)
+        {
+            const auto name = L"entries\\" + std::to_wstring(i) + L".txt";
+            Assert::IsTrue(S_OK == writer.AddEntry(name, MakeStream<MemoryStream>(std::to_string(i))));
+        }
+        Assert::IsTrue(S_OK == writer.Close());
+
+        std::vector<CentralEntry> central;
+        bool bZip64End = false;
+        ReadCentralDirectory(archive, central, bZip64End);
+        Assert::IsTrue(bZip64End, L"more than 65535 entries need a zip64 end of central directory");
+        Assert::AreEqual(entryCount, central.size());
+        for (size_t i = 0; i < entryCount; i++)
+        {
+            Assert::IsTrue("entries/" + std::to_string(i) + ".txt" == central[i].Name);
+            Assert::AreEqual(CRC32(std::to_string(i)), central[i].CRC);
+        }
+
+        std::map<std::wstring, std::string> extracted;
+        Assert::IsTrue(S_OK == Extract(archive, extracted));
+        Assert::AreEqual(entryCount, extracted.size());
+        for (size_t i = 0; i < entryCount; i++)
+        {
+            auto it = extracted.find(L"entries\\" + std::to_wstring(i) + L".txt");
+            Assert::IsTrue(it != end(extracted), L"zip entry not extracted");
+            Assert::IsTrue(std::to_string(i) == it->second);
+        }
+    }
+};
+}  // namespace Orc::Test
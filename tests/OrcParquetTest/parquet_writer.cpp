@@ -16,10 +16,14 @@
 #include "ParameterCheck.h"
 #include "Temporary.h"
 #include "FileStream.h"
+#include "MemoryStream.h"
 #include "OrcException.h"
 #include "ParquetWriter.h"
 #include "ParquetStream.h"
 
+#include <parquet/file_reader.h>
+#include <parquet/metadata.h>
+
 using namespace Microsoft::VisualStudio::CppUnitTestFramework;
 using namespace std;
 using namespace std::string_literals;
@@ -27,12 +31,129 @@ using namespace Orc;
 using namespace Orc::Test;
 
 namespace Orc::Test::Parquet {
+
+// Memory stream whose writes fail once it would hold more than a given number of bytes
+class FailingStream : public MemoryStream
+{
+public:
+    FailingStream(logger pLog, ULONGLONG ullFailAfter)
+        : MemoryStream(std::move(pLog))
+        , m_ullFailAfter(ullFailAfter)
+    {
+    }
+
+    STDMETHOD(Write)(const PVOID pWriteBuffer, ULONGLONG cbBytesToWrite, PULONGLONG pcbBytesWritten)
+    {
+        if (GetSize() + cbBytesToWrite > m_ullFailAfter)
+            return HRESULT_FROM_WIN32(ERROR_DISK_FULL);
+        return MemoryStream::Write(pWriteBuffer, cbBytesToWrite, pcbBytesWritten);
+    }
+
+private:
+    ULONGLONG m_ullFailAfter;
+};
+
 TEST_CLASS(ParquetWriter)
 {
 private:
     logger _L_;
     UnitTestHelper helper;
 
+    // Writes rows of varied values (some missing) in batches of 1000 rows, returns what Close returned
+    HRESULT WriteRows(const std::shared_ptr<ByteStream>& stream, std::optional<DWORD> inFlightBatches, UINT rowCount)
+    {
+        using namespace std::string_view_literals;
+        using namespace Orc::TableOutput;
+
+        auto options = std::make_unique<TableOutput::Parquet::Options>();
+        options->BatchSize = 1000;
+        options->InFlightBatches = inFlightBatches;
+
+        auto stream_writer = Orc::TableOutput::GetParquetWriter(_L_, std::move(options));
+        Assert::IsTrue((bool)stream_writer, L"Failed to instantiate parquet writer");
+
+        Schema schema {{ColumnType::UInt32Type, L"Index"sv},
+                       {ColumnType::UTF16Type, L"Name"sv},
+                       {ColumnType::UTF8Type, L"Extension"sv},
+                       {ColumnType::BoolType, L"IsEven"sv},
+                       {ColumnType::TimeStampType, L"Date"sv},
+                       {ColumnType::UInt64Type, L"Size"sv}};
+        Assert::IsTrue(SUCCEEDED(stream_writer->SetSchema(schema)), L"Failed to set parquet Schema");
+        Assert::IsTrue(SUCCEEDED(stream_writer->WriteToStream(stream, false)), L"Failed to write to parquet stream");
+
+        auto& output = *stream_writer;
+
+        HRESULT hr = S_OK;
+        for (UINT i = 0; i < rowCount && SUCCEEDED(hr); i++)
+        {
+            output.WriteInteger((DWORD)i);
+            if (i % 7 == 0)
+                output.WriteNothing();
+            else
+                output.WriteFormated(L"file_{}.txt", i);
+            output.WriteString(i % 3 ? "dll" : "exe");
+            output.WriteBool(i % 2 == 0);
+            output.WriteFileTime(132500000000000000LL + i * 10000019LL);
+            if (i % 5 == 0)
+                output.WriteNothing();
+            else
+                output.WriteInteger((ULONGLONG)i * 4096);
+
+            hr = output.WriteEndOfLine();
+        }
+
+        return stream_writer->Close();
+    }
+
+    // Writes rows of NTFSInfo like values in the columns of schema (in this order)
+    void WriteFiles(
+        const TableOutput::Schema& schema,
+        std::unique_ptr<TableOutput::Parquet::Options>&& options,
+        const std::wstring& strPath,
+        UINT rowCount)
+    {
+        auto stream_writer = Orc::TableOutput::GetParquetWriter(_L_, std::move(options));
+        Assert::IsTrue((bool)stream_writer, L"Failed to instantiate parquet writer");
+        Assert::IsTrue(SUCCEEDED(stream_writer->SetSchema(schema)), L"Failed to set parquet Schema");
+        Assert::IsTrue(SUCCEEDED(stream_writer->WriteToFile(strPath.c_str())), L"Failed to write to parquet");
+
+        auto& output = *stream_writer;
+
+        const WCHAR* extensions[] = {L"exe", L"dll", L"sys", L"txt", L"log", L"dat", L"ini", L"xml"};
+        for (UINT i = 0; i < rowCount; i++)
+        {
+            const auto extension = extensions[i % _countof(extensions)];
+
+            output.WriteString("WORKSTATION-01");
+            output.WriteString(extension);
+            output.WriteFormated(L"\\Windows\\System32\\Folder{}\\File{}.{}", i % 128, i, extension);
+            output.WriteInteger((ULONGLONG)i * 7);
+            output.WriteInteger((ULONGLONG)(i % 16) * 4096);
+
+            Assert::IsTrue(SUCCEEDED(output.WriteEndOfLine()));
+        }
+        Assert::IsTrue(SUCCEEDED(stream_writer->Close()), L"Failed to close parquet writer");
+    }
+
+    std::shared_ptr<parquet::FileMetaData> ReadMetadata(const std::wstring& strPath)
+    {
+        auto file_stream = std::make_shared<FileStream>(_L_);
+        Assert::IsTrue(SUCCEEDED(file_stream->ReadFrom(strPath.c_str())));
+
+        auto arrow_stream = std::make_shared<Orc::TableOutput::Parquet::Stream>(_L_);
+        Assert::IsTrue(SUCCEEDED(arrow_stream->Open(file_stream)));
+
+        return parquet::ParquetFileReader::Open(arrow_stream)->metadata();
+    }
+
+    static bool HasDictionary(const parquet::ColumnChunkMetaData& column)
+    {
+        const auto& encodings = column.encodings();
+        return std::any_of(encodings.cbegin(), encodings.cend(), [](auto encoding) {
+            return encoding == parquet::Encoding::PLAIN_DICTIONARY || encoding == parquet::Encoding::RLE_DICTIONARY;
+        });
+    }
+
 public:
     TEST_METHOD_INITIALIZE(Initialize)
     {
@@ -97,6 +218,106 @@ public:
         stream_writer->Close();
     }
 
+    TEST_METHOD(EncodingHints)
+    {
+        using namespace std::string_view_literals;
+        using namespace Orc::TableOutput;
+
+        // a few repetitive columns, a few mostly distinct ones, the last one is left to the writer
+        Schema schema {{ColumnType::UTF8Type, L"ComputerName"sv},
+                       {ColumnType::UTF16Type, L"Extension"sv},
+                       {ColumnType::UTF16Type, L"FullName"sv},
+                       {ColumnType::UInt64Type, L"FRN"sv},
+                       {ColumnType::UInt64Type, L"Size"sv}};
+        for (auto name : {L"ComputerName"sv, L"Extension"sv})
+            schema[name].Encoding = ColumnEncoding::Dictionary;
+        for (auto name : {L"FullName"sv, L"FRN"sv})
+            schema[name].Encoding = ColumnEncoding::Plain;
+        schema[L"FullName"sv].Compression = ColumnCompression::None;
+
+        auto options = std::make_unique<TableOutput::Parquet::Options>();
+        options->BatchSize = 5000;
+
+        const auto strPath = GetFilePath(L"%TEMP%\\testHints.parquet"s);
+        WriteFiles(schema, std::move(options), strPath, 20000);
+
+        auto metadata = ReadMetadata(strPath);
+        Assert::AreEqual(static_cast<int64_t>(20000), metadata->num_rows());
+        Assert::IsTrue(metadata->num_row_groups() > 0);
+
+        for (int i = 0; i < metadata->num_row_groups(); i++)
+        {
+            auto rowGroup = metadata->RowGroup(i);
+
+            Assert::IsTrue(HasDictionary(*rowGroup->ColumnChunk(0)), L"ComputerName must be dictionary encoded");
+            Assert::IsTrue(HasDictionary(*rowGroup->ColumnChunk(1)), L"Extension must be dictionary encoded");
+            Assert::IsFalse(HasDictionary(*rowGroup->ColumnChunk(2)), L"FullName must not be dictionary encoded");
+            Assert::IsFalse(HasDictionary(*rowGroup->ColumnChunk(3)), L"FRN must not be dictionary encoded");
+
+            Assert::IsTrue(rowGroup->ColumnChunk(2)->compression() == parquet::Compression::UNCOMPRESSED);
+            for (int column : {0, 1, 3, 4})
+                Assert::IsTrue(
+                    rowGroup->ColumnChunk(column)->compression() == parquet::Compression::GZIP,
+                    L"columns without a compression hint must use the file's compression");
+        }
+    }
+
+    TEST_METHOD(RowGroupSize)
+    {
+        using namespace std::string_view_literals;
+        using namespace Orc::TableOutput;
+
+        Schema schema {{ColumnType::UTF8Type, L"ComputerName"sv},
+                       {ColumnType::UTF16Type, L"Extension"sv},
+                       {ColumnType::UTF16Type, L"FullName"sv},
+                       {ColumnType::UInt64Type, L"FRN"sv},
+                       {ColumnType::UInt64Type, L"Size"sv}};
+
+        // no batch size: batches are only flushed once they hold RowGroupSize bytes, checked every 1024 rows
+        auto options = std::make_unique<TableOutput::Parquet::Options>();
+        options->RowGroupSize = 256 * 1024;
+
+        const auto strPath = GetFilePath(L"%TEMP%\\testRowGroupSize.parquet"s);
+        WriteFiles(schema, std::move(options), strPath, 100000);
+
+        auto metadata = ReadMetadata(strPath);
+        Assert::AreEqual(static_cast<int64_t>(100000), metadata->num_rows());
+        Assert::IsTrue(metadata->num_row_groups() > 1, L"rows must be split in several row groups");
+
+        for (int i = 0; i < metadata->num_row_groups() - 1; i++)
+        {
+            auto rowGroup = metadata->RowGroup(i);
+            Assert::IsTrue(rowGroup->num_rows() % 1024 == 0, L"row groups must be flushed when the size is checked");
+            Assert::IsTrue(rowGroup->num_rows() < 100000);
+        }
+    }
+
+    TEST_METHOD(BackgroundFlush)
+    {
+        // full batches are written by a background task, the file must not change
+        auto direct = std::make_shared<MemoryStream>(_L_);
+        Assert::IsTrue(SUCCEEDED(direct->OpenForReadWrite()));
+        Assert::IsTrue(SUCCEEDED(WriteRows(direct, std::nullopt, 20500)));
+
+        auto background = std::make_shared<MemoryStream>(_L_);
+        Assert::IsTrue(SUCCEEDED(background->OpenForReadWrite()));
+        Assert::IsTrue(SUCCEEDED(WriteRows(background, 2, 20500)));
+
+        const auto directBytes = direct->GetConstBuffer();
+        const auto backgroundBytes = background->GetConstBuffer();
+        Assert::IsTrue(directBytes.GetCount() > 0);
+        Assert::AreEqual(directBytes.GetCount(), backgroundBytes.GetCount());
+        Assert::IsTrue(memcmp(directBytes.GetData(), backgroundBytes.GetData(), directBytes.GetCount()) == 0);
+    }
+
+    TEST_METHOD(BackgroundFlushError)
+    {
+        // once a background write failed, the error is returned while writing or at the latest by Close
+        auto stream = std::make_shared<FailingStream>(_L_, 16 * 1024);
+        Assert::IsTrue(SUCCEEDED(stream->OpenForReadWrite()));
+        Assert::IsTrue(FAILED(WriteRows(stream, 2, 100000)));
+    }
+
     TEST_METHOD(ReadSimpeTypes)
     {
         auto file_stream = std::make_shared<FileStream>(_L_);